@@ -0,0 +1,551 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the build constants and box helpers
+// only accessible in this file
+namespace
+{
+	// Number of bins the surface area heuristic tries splits between.
+	const unsigned int SAH_BINS = 16;
+
+	// Cost of visiting a node relative to testing one item.
+	const float TRAVERSAL_COST = 1.0f;
+
+	// Leaves hold at most this many items, and ranges this small may stay a leaf.
+	const unsigned int MAX_LEAF_ITEMS = 8;
+	const unsigned int MIN_SPLIT_ITEMS = 3;
+
+	// Below this depth ranges are split at their median instead, which keeps
+	// the tree shallow for unevenly spread items.
+	const unsigned int MAX_SAH_DEPTH = 40;
+
+	float SurfaceArea(const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		float x = max.x - min.x;
+		float y = max.y - min.y;
+		float z = max.z - min.z;
+		return 2.0f * (x * y + y * z + z * x);
+	}
+
+	void Grow(XMFLOAT3& min, XMFLOAT3& max, const XMFLOAT3& otherMin, const XMFLOAT3& otherMax)
+	{
+		min = XMFLOAT3(std::min(min.x, otherMin.x), std::min(min.y, otherMin.y), std::min(min.z, otherMin.z));
+		max = XMFLOAT3(std::max(max.x, otherMax.x), std::max(max.y, otherMax.y), std::max(max.z, otherMax.z));
+	}
+
+	// Surface area of the box around two boxes.
+	float UnionArea(const XMFLOAT3& aMin, const XMFLOAT3& aMax, const XMFLOAT3& bMin, const XMFLOAT3& bMax)
+	{
+		XMFLOAT3 min = aMin;
+		XMFLOAT3 max = aMax;
+		Grow(min, max, bMin, bMax);
+		return SurfaceArea(min, max);
+	}
+
+	// An empty box that any Grow() replaces.
+	void EmptyBox(XMFLOAT3& min, XMFLOAT3& max)
+	{
+		min = XMFLOAT3(INFINITY, INFINITY, INFINITY);
+		max = XMFLOAT3(-INFINITY, -INFINITY, -INFINITY);
+	}
+
+	float Component(const XMFLOAT3& v, int axis)
+	{
+		return (&v.x)[axis];
+	}
+
+	bool BoxesOverlap(const XMFLOAT3& aMin, const XMFLOAT3& aMax, const XMFLOAT3& bMin, const XMFLOAT3& bMax)
+	{
+		return aMin.x <= bMax.x && aMax.x >= bMin.x &&
+			aMin.y <= bMax.y && aMax.y >= bMin.y &&
+			aMin.z <= bMax.z && aMax.z >= bMin.z;
+	}
+
+	bool SphereOverlapsBox(const XMFLOAT3& center, float radius, const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		// Distance from the center to the closest point of the box.
+		float x = std::max(min.x - center.x, std::max(0.0f, center.x - max.x));
+		float y = std::max(min.y - center.y, std::max(0.0f, center.y - max.y));
+		float z = std::max(min.z - center.z, std::max(0.0f, center.z - max.z));
+		return x * x + y * y + z * z <= radius * radius;
+	}
+
+	// Where a ray enters a box (slab test), if it does before "maxDistance".
+	bool RayHitsBox(const XMFLOAT3& origin, const XMFLOAT3& inverseDirection, const XMFLOAT3& min, const XMFLOAT3& max, float maxDistance, float& entry)
+	{
+		float x1 = (min.x - origin.x) * inverseDirection.x;
+		float x2 = (max.x - origin.x) * inverseDirection.x;
+		float y1 = (min.y - origin.y) * inverseDirection.y;
+		float y2 = (max.y - origin.y) * inverseDirection.y;
+		float z1 = (min.z - origin.z) * inverseDirection.z;
+		float z2 = (max.z - origin.z) * inverseDirection.z;
+		float enter = std::max(std::max(std::min(x1, x2), std::min(y1, y2)), std::max(std::min(z1, z2), 0.0f));
+		float exit = std::min(std::min(std::max(x1, x2), std::max(y1, y2)), std::min(std::max(z1, z2), maxDistance));
+		entry = enter;
+		return enter <= exit;
+	}
+
+	// Where a box is relative to a frustum.
+	enum class Containment { Outside, Intersecting, Inside };
+
+	Containment ClassifyBox(const Frustum& frustum, const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		Containment result = Containment::Inside;
+		for (const XMFLOAT4& plane : frustum.planes)
+		{
+			// The corners furthest along and against the plane's normal.
+			float farX = plane.x >= 0.0f ? max.x : min.x;
+			float farY = plane.y >= 0.0f ? max.y : min.y;
+			float farZ = plane.z >= 0.0f ? max.z : min.z;
+			float nearX = plane.x >= 0.0f ? min.x : max.x;
+			float nearY = plane.y >= 0.0f ? min.y : max.y;
+			float nearZ = plane.z >= 0.0f ? min.z : max.z;
+			if (plane.x * farX + plane.y * farY + plane.z * farZ + plane.w < 0.0f)
+				return Containment::Outside;
+			if (plane.x * nearX + plane.y * nearY + plane.z * nearZ + plane.w < 0.0f)
+				result = Containment::Intersecting;
+		}
+		return result;
+	}
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+}
+
+void BoundingVolumeHierarchy::Build(const AxisAlignedBox* boxes, size_t count)
+{
+	nodes.clear();
+	items.resize(count);
+	itemBoxes.resize(count);
+	if (count == 0)
+		return;
+
+	std::vector<BuildItem> buildItems(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		buildItems[i].box = boxes[i];
+		buildItems[i].center = XMFLOAT3(
+			(boxes[i].min.x + boxes[i].max.x) * 0.5f,
+			(boxes[i].min.y + boxes[i].max.y) * 0.5f,
+			(boxes[i].min.z + boxes[i].max.z) * 0.5f);
+		buildItems[i].index = (unsigned int)i;
+	}
+
+	// A binary tree over n leaves of at least one item has under 2n nodes,
+	// so reserving that keeps node references stable while building.
+	nodes.reserve(count * 2);
+	nodes.push_back(Node{});
+	BuildNode(buildItems.data(), 0, 0, (unsigned int)count, 0);
+
+	// Keep the items in the order the leaves ended up with.
+	for (size_t i = 0; i < count; i++)
+	{
+		items[i] = buildItems[i].index;
+		itemBoxes[i] = buildItems[i].box;
+	}
+}
+
+void BoundingVolumeHierarchy::BuildNode(BuildItem* buildItems, unsigned int node, unsigned int begin, unsigned int end, unsigned int depth)
+{
+	// Bounds of the items and of their centers.
+	XMFLOAT3 min, max, centerMin, centerMax;
+	EmptyBox(min, max);
+	EmptyBox(centerMin, centerMax);
+	for (unsigned int i = begin; i < end; i++)
+	{
+		Grow(min, max, buildItems[i].box.min, buildItems[i].box.max);
+		Grow(centerMin, centerMax, buildItems[i].center, buildItems[i].center);
+	}
+	nodes[node].min = min;
+	nodes[node].max = max;
+	nodes[node].first = begin;
+	nodes[node].count = end - begin;
+
+	unsigned int count = end - begin;
+	if (count < MIN_SPLIT_ITEMS)
+		return;
+
+	// Split along the axis the centers are most spread on.
+	XMFLOAT3 extent(centerMax.x - centerMin.x, centerMax.y - centerMin.y, centerMax.z - centerMin.z);
+	int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+	float axisMin = Component(centerMin, axis);
+	float axisExtent = Component(extent, axis);
+	unsigned int middle = begin + count / 2;
+
+	if (axisExtent <= 0.0f)
+	{
+		// Every center is in the same place, so only split to keep leaves small.
+		if (count <= MAX_LEAF_ITEMS)
+			return;
+	}
+	else if (depth >= MAX_SAH_DEPTH)
+	{
+		std::nth_element(buildItems + begin, buildItems + middle, buildItems + end,
+			[&](const BuildItem& a, const BuildItem& b) { return Component(a.center, axis) < Component(b.center, axis); });
+	}
+	else
+	{
+		// Drop each item's center into a bin along the axis.
+		unsigned int binCounts[SAH_BINS] = {};
+		XMFLOAT3 binMin[SAH_BINS], binMax[SAH_BINS];
+		for (unsigned int b = 0; b < SAH_BINS; b++)
+			EmptyBox(binMin[b], binMax[b]);
+		float binScale = SAH_BINS / axisExtent;
+		auto BinOf = [&](const BuildItem& item)
+		{
+			unsigned int bin = (unsigned int)((Component(item.center, axis) - axisMin) * binScale);
+			return std::min(bin, SAH_BINS - 1);
+		};
+		for (unsigned int i = begin; i < end; i++)
+		{
+			unsigned int bin = BinOf(buildItems[i]);
+			binCounts[bin]++;
+			Grow(binMin[bin], binMax[bin], buildItems[i].box.min, buildItems[i].box.max);
+		}
+
+		// Area and count of everything left of each split, then right of it.
+		float leftAreas[SAH_BINS - 1], rightAreas[SAH_BINS - 1];
+		unsigned int leftCounts[SAH_BINS - 1], rightCounts[SAH_BINS - 1];
+		XMFLOAT3 sweepMin, sweepMax;
+		EmptyBox(sweepMin, sweepMax);
+		unsigned int sweepCount = 0;
+		for (unsigned int b = 0; b < SAH_BINS - 1; b++)
+		{
+			sweepCount += binCounts[b];
+			if (binCounts[b] > 0)
+				Grow(sweepMin, sweepMax, binMin[b], binMax[b]);
+			leftCounts[b] = sweepCount;
+			leftAreas[b] = sweepCount > 0 ? SurfaceArea(sweepMin, sweepMax) : 0.0f;
+		}
+		EmptyBox(sweepMin, sweepMax);
+		sweepCount = 0;
+		for (unsigned int b = SAH_BINS - 1; b > 0; b--)
+		{
+			sweepCount += binCounts[b];
+			if (binCounts[b] > 0)
+				Grow(sweepMin, sweepMax, binMin[b], binMax[b]);
+			rightCounts[b - 1] = sweepCount;
+			rightAreas[b - 1] = sweepCount > 0 ? SurfaceArea(sweepMin, sweepMax) : 0.0f;
+		}
+
+		// Cheapest split, against the cost of testing every item in a leaf.
+		float area = std::max(SurfaceArea(min, max), 1e-20f);
+		float bestCost = INFINITY;
+		unsigned int bestSplit = 0;
+		for (unsigned int b = 0; b < SAH_BINS - 1; b++)
+		{
+			if (leftCounts[b] == 0 || rightCounts[b] == 0)
+				continue;
+			float cost = TRAVERSAL_COST + (leftAreas[b] * leftCounts[b] + rightAreas[b] * rightCounts[b]) / area;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = b;
+			}
+		}
+		if (bestCost >= (float)count && count <= MAX_LEAF_ITEMS)
+			return;
+
+		BuildItem* split = std::partition(buildItems + begin, buildItems + end,
+			[&](const BuildItem& item) { return BinOf(item) <= bestSplit; });
+		middle = (unsigned int)(split - buildItems);
+		if (middle == begin || middle == end)
+			middle = begin + count / 2;
+	}
+
+	// Siblings go next to each other at the end of the array.
+	unsigned int left = (unsigned int)nodes.size();
+	nodes.push_back(Node{});
+	nodes.push_back(Node{});
+	nodes[node].first = left;
+	nodes[node].count = 0;
+	BuildNode(buildItems, left, begin, middle, depth + 1);
+	BuildNode(buildItems, left + 1, middle, end, depth + 1);
+}
+
+void BoundingVolumeHierarchy::Refit(const AxisAlignedBox* boxes)
+{
+	for (size_t i = 0; i < items.size(); i++)
+		itemBoxes[i] = boxes[items[i]];
+	if (!nodes.empty())
+		RefitNode(0);
+}
+
+void BoundingVolumeHierarchy::RefitNode(unsigned int node)
+{
+	Node& n = nodes[node];
+	if (n.count > 0)
+	{
+		EmptyBox(n.min, n.max);
+		for (unsigned int i = n.first; i < n.first + n.count; i++)
+			Grow(n.min, n.max, itemBoxes[i].min, itemBoxes[i].max);
+		return;
+	}
+
+	// Children first, so the rotation below compares up to date bounds.
+	RefitNode(n.first);
+	RefitNode(n.first + 1);
+	RotateNode(node);
+	UpdateInternalBounds(node);
+}
+
+void BoundingVolumeHierarchy::RotateNode(unsigned int node)
+{
+	// Try swapping one child with one of the other child's children: the
+	// other child then only bounds the swapped-in node and its remaining
+	// child, and the rotation that shrinks it the most wins (Kopta et al.).
+	unsigned int children[2] = { nodes[node].first, nodes[node].first + 1 };
+	float bestGain = 0.0f;
+	unsigned int bestChild = 0;
+	unsigned int bestGrandchild = 0;
+	for (int c = 0; c < 2; c++)
+	{
+		const Node& child = nodes[children[c]];
+		const Node& other = nodes[children[1 - c]];
+		if (other.count > 0)
+			continue;
+
+		float otherArea = SurfaceArea(other.min, other.max);
+		for (unsigned int g = 0; g < 2; g++)
+		{
+			const Node& remaining = nodes[other.first + (1 - g)];
+			float gain = otherArea - UnionArea(child.min, child.max, remaining.min, remaining.max);
+			if (gain > bestGain)
+			{
+				bestGain = gain;
+				bestChild = children[c];
+				bestGrandchild = other.first + g;
+			}
+		}
+	}
+
+	// Ignore rotations that only win by rounding.
+	if (bestGain <= 1e-6f * SurfaceArea(nodes[node].min, nodes[node].max))
+		return;
+
+	// Swapping the records moves each subtree along with its node.
+	unsigned int parentOfGrandchild = (bestChild == children[0]) ? children[1] : children[0];
+	std::swap(nodes[bestChild], nodes[bestGrandchild]);
+	UpdateInternalBounds(parentOfGrandchild);
+}
+
+void BoundingVolumeHierarchy::UpdateInternalBounds(unsigned int node)
+{
+	Node& n = nodes[node];
+	const Node& left = nodes[n.first];
+	const Node& right = nodes[n.first + 1];
+	n.min = left.min;
+	n.max = left.max;
+	Grow(n.min, n.max, right.min, right.max);
+}
+
+size_t BoundingVolumeHierarchy::GetItemCount() const
+{
+	return items.size();
+}
+
+size_t BoundingVolumeHierarchy::GetNodeCount() const
+{
+	return nodes.size();
+}
+
+float BoundingVolumeHierarchy::GetCost() const
+{
+	if (nodes.empty())
+		return 0.0f;
+
+	// Each node costs its chance of being visited (its area relative to the
+	// root's) times the work done there.
+	float rootArea = std::max(SurfaceArea(nodes[0].min, nodes[0].max), 1e-20f);
+	double cost = 0.0;
+	for (const Node& node : nodes)
+		cost += SurfaceArea(node.min, node.max) / rootArea * (node.count > 0 ? (float)node.count : TRAVERSAL_COST);
+	return (float)cost;
+}
+
+void BoundingVolumeHierarchy::CollectItems(unsigned int node, std::vector<unsigned int>& results) const
+{
+	const Node& n = nodes[node];
+	if (n.count > 0)
+	{
+		results.insert(results.end(), items.begin() + n.first, items.begin() + n.first + n.count);
+		return;
+	}
+	CollectItems(n.first, results);
+	CollectItems(n.first + 1, results);
+}
+
+void BoundingVolumeHierarchy::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const
+{
+	results.clear();
+	if (nodes.empty())
+		return;
+
+	std::vector<unsigned int> stack;
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		unsigned int index = stack.back();
+		stack.pop_back();
+
+		// Whole subtrees inside the frustum need no more tests.
+		Containment containment = ClassifyBox(frustum, node.min, node.max);
+		if (containment == Containment::Outside)
+			continue;
+		if (containment == Containment::Inside)
+		{
+			CollectItems(index, results);
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			stack.push_back(node.first);
+			stack.push_back(node.first + 1);
+			continue;
+		}
+		for (unsigned int i = node.first; i < node.first + node.count; i++)
+		{
+			if (Culling::BoxInFrustum(frustum, itemBoxes[i]))
+				results.push_back(items[i]);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::QuerySphere(const XMFLOAT3& center, float radius, std::vector<unsigned int>& results) const
+{
+	results.clear();
+	if (nodes.empty())
+		return;
+
+	std::vector<unsigned int> stack;
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!SphereOverlapsBox(center, radius, node.min, node.max))
+			continue;
+
+		if (node.count == 0)
+		{
+			stack.push_back(node.first);
+			stack.push_back(node.first + 1);
+			continue;
+		}
+		for (unsigned int i = node.first; i < node.first + node.count; i++)
+		{
+			const AxisAlignedBox& box = itemBoxes[i];
+			if (SphereOverlapsBox(center, radius, box.min, box.max))
+				results.push_back(items[i]);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::QueryBox(const AxisAlignedBox& box, std::vector<unsigned int>& results) const
+{
+	results.clear();
+	if (nodes.empty())
+		return;
+
+	std::vector<unsigned int> stack;
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!BoxesOverlap(box.min, box.max, node.min, node.max))
+			continue;
+
+		if (node.count == 0)
+		{
+			stack.push_back(node.first);
+			stack.push_back(node.first + 1);
+			continue;
+		}
+		for (unsigned int i = node.first; i < node.first + node.count; i++)
+		{
+			const AxisAlignedBox& itemBox = itemBoxes[i];
+			if (BoxesOverlap(box.min, box.max, itemBox.min, itemBox.max))
+				results.push_back(items[i]);
+		}
+	}
+}
+
+unsigned int BoundingVolumeHierarchy::Raycast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, float& hitDistance) const
+{
+	unsigned int hit = NO_HIT;
+	hitDistance = maxDistance;
+	if (nodes.empty())
+		return hit;
+
+	XMFLOAT3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float rootEntry;
+	if (!RayHitsBox(origin, inverseDirection, nodes[0].min, nodes[0].max, hitDistance, rootEntry))
+		return hit;
+
+	// Nodes waiting to be visited, with where the ray enters them.
+	struct Entry
+	{
+		unsigned int node;
+		float distance;
+	};
+	std::vector<Entry> stack;
+	stack.push_back({ 0, rootEntry });
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+
+		// Something closer was hit since this node was pushed.
+		if (entry.distance > hitDistance)
+			continue;
+
+		const Node& node = nodes[entry.node];
+		if (node.count > 0)
+		{
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				const AxisAlignedBox& box = itemBoxes[i];
+				float distance;
+				if (RayHitsBox(origin, inverseDirection, box.min, box.max, hitDistance, distance) &&
+					(distance < hitDistance || hit == NO_HIT || (distance == hitDistance && items[i] < hit)))
+				{
+					hit = items[i];
+					hitDistance = distance;
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first by pushing it last.
+		float leftDistance, rightDistance;
+		bool hitsLeft = RayHitsBox(origin, inverseDirection, nodes[node.first].min, nodes[node.first].max, hitDistance, leftDistance);
+		bool hitsRight = RayHitsBox(origin, inverseDirection, nodes[node.first + 1].min, nodes[node.first + 1].max, hitDistance, rightDistance);
+		if (hitsLeft && hitsRight)
+		{
+			if (leftDistance <= rightDistance)
+			{
+				stack.push_back({ node.first + 1, rightDistance });
+				stack.push_back({ node.first, leftDistance });
+			}
+			else
+			{
+				stack.push_back({ node.first, leftDistance });
+				stack.push_back({ node.first + 1, rightDistance });
+			}
+		}
+		else if (hitsLeft)
+			stack.push_back({ node.first, leftDistance });
+		else if (hitsRight)
+			stack.push_back({ node.first + 1, rightDistance });
+	}
+
+	return hit;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "Culling.h"
+
+// --------------------------------------------------------
+// A bounding volume hierarchy over a set of world space
+// boxes (one per entity, in the order they were given).
+//
+// - Build() splits the boxes with the surface area heuristic
+//   (binned on the longest centroid axis) into leaves of a
+//   few items each
+// - Refit() takes the same items' new boxes, regrows every
+//   node around its children and rotates subtrees where
+//   swapping a child with a grandchild shrinks the surface
+//   area, so moving items do not need a full rebuild; call
+//   Build() again when items are added or removed
+// - Nodes are kept in one array and siblings are always
+//   next to each other, so a node only stores its first
+//   child (or its first item for a leaf)
+// - Queries return item indices
+// --------------------------------------------------------
+class BoundingVolumeHierarchy
+{
+public:
+	// Item index returned by Raycast() when nothing is hit.
+	static constexpr unsigned int NO_HIT = 0xFFFFFFFF;
+
+	BoundingVolumeHierarchy();
+
+	// Build the hierarchy over "count" boxes.
+	void Build(const AxisAlignedBox* boxes, size_t count);
+
+	// Update the hierarchy for new boxes of the same items, in the same order.
+	void Refit(const AxisAlignedBox* boxes);
+
+	// Number of items and nodes.
+	size_t GetItemCount() const;
+	size_t GetNodeCount() const;
+
+	// Surface area heuristic cost of the tree (lower traces and queries faster).
+	float GetCost() const;
+
+	// Items whose boxes are at least partly inside the frustum.
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const;
+
+	// Items whose boxes overlap a sphere or another box.
+	void QuerySphere(const DirectX::XMFLOAT3& center, float radius, std::vector<unsigned int>& results) const;
+	void QueryBox(const AxisAlignedBox& box, std::vector<unsigned int>& results) const;
+
+	// The item whose box a ray enters first, or NO_HIT.
+	// - "direction" does not need to be normalized; "hitDistance" is measured
+	//   in multiples of it, and is 0 when the ray starts inside the box
+	unsigned int Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, float& hitDistance) const;
+
+private:
+	// A node's bounds and either its children (count is 0 and "first" is the
+	// left child, with the right child after it) or its items (a range of
+	// "items" starting at "first").
+	struct Node
+	{
+		DirectX::XMFLOAT3 min;
+		unsigned int first;
+		DirectX::XMFLOAT3 max;
+		unsigned int count;
+	};
+
+	// An item's box and center while building, moved around together so
+	// each split reads them in order.
+	struct BuildItem
+	{
+		AxisAlignedBox box;
+		DirectX::XMFLOAT3 center;
+		unsigned int index;
+	};
+
+	// Split build items [begin, end) under a node.
+	void BuildNode(BuildItem* buildItems, unsigned int node, unsigned int begin, unsigned int end, unsigned int depth);
+
+	// Regrow a node and its subtree around the current boxes.
+	void RefitNode(unsigned int node);
+
+	// Swap a child of a node with one of its grandchildren if that shrinks the tree.
+	void RotateNode(unsigned int node);
+
+	// Grow a node around its two children.
+	void UpdateInternalBounds(unsigned int node);
+
+	// Add every item under a node to "results".
+	void CollectItems(unsigned int node, std::vector<unsigned int>& results) const;
+
+	std::vector<Node> nodes;
+
+	// Item indices, grouped so each leaf's items are consecutive, and each
+	// one's box in the same order so leaves read their boxes in one run.
+	std::vector<unsigned int> items;
+	std::vector<AxisAlignedBox> itemBoxes;
+};
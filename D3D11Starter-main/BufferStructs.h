@@ -7,17 +7,25 @@
 
 // using namespace DirectX;
 
+// Per-object data for the standard vertex shaders (register b0).
+// - Only what changes between entities, so each draw uploads 128 bytes
 struct BufferStructs
 {
 	//DirectX::XMFLOAT4 colorTint;
 	DirectX::XMMATRIX worldMatrix;
-	DirectX::XMMATRIX viewMatrix;
-	DirectX::XMMATRIX projectionMatrix;
 
 	// Add the inverse transpose matrix of the wSpace to get the right 
 	// rotation and scaling for the normals of the all objects in the
 	// world spacein relation to the camera.
 	DirectX::XMMATRIX worldInverseTransposeMatrix;
+};
+
+// Per-pass data for the standard vertex shaders (register b2), uploaded
+// once for the main pass and once for the shadow pass.
+struct VSPassData
+{
+	DirectX::XMFLOAT4X4 viewMatrix;
+	DirectX::XMFLOAT4X4 projectionMatrix;
 
 	// Add the light view and projection matrix for the standard vertex shader.
 	DirectX::XMFLOAT4X4 lightViewMatrix;
@@ -30,34 +38,33 @@ struct SkyBufferStruct
 	DirectX::XMMATRIX projectionMatrix;
 };
 
-struct PixelDataStruct
+// Per-frame data for the pixel shaders (register b0), uploaded once per frame.
+struct PixelFrameData
 {
 	// Add padding to fit HLSL 16 bytes standard.
-	DirectX::XMFLOAT4 colorTint;
-
 	DirectX::XMFLOAT2 time;
 	DirectX::XMFLOAT2 timePad;
 
-	DirectX::XMFLOAT2 scale;
-	DirectX::XMFLOAT2 scalePadding;
-
-	DirectX::XMFLOAT2 offset;
-	DirectX::XMFLOAT2 offsetPadding;
-
-	// Add and pass the current camera position and the entity's roughness for
-	// the only the pixel shader.
+	// Add and pass the current camera position for the only the pixel shader.
 	DirectX::XMFLOAT4 cameraCurrentPosition;
 
-	DirectX::XMFLOAT2 roughness;
-	DirectX::XMFLOAT2 roughnessPadding;
-
 	DirectX::XMFLOAT4 ambientColor;
 
 	// Add the Light struct object in the pixel shader struct.
 	Lights directionalLight1;
 
-	// Create an array of lights.
-	Lights lightArray[5];
+	// Directional lights reach every pixel, so they stay in the frame data.
+	// - Point and spot lights are in the clustered light buffers (t5 to t7)
+	Lights directionalLights[MAX_DIRECTIONAL_LIGHTS];
+	unsigned int directionalLightCount;
+
+	// What turns a pixel's view depth into its light cluster's slice, and its
+	// screen position into its tile.
+	float clusterSliceScale;
+	float clusterSliceBias;
+	float clusterPadding;
+	DirectX::XMFLOAT2 clusterTileScale;
+	DirectX::XMFLOAT2 clusterTilePadding;
 
 	/*Lights directionalLight2;
 	Lights pointLight1;
@@ -65,14 +72,37 @@ struct PixelDataStruct
 	Lights spotLight2;*/
 };
 
-// Create buffer struct for the shadow vertex shader CB data.
-struct ShadowVSData
+// Per-material data for the pixel shaders (register b1), kept in each
+// material's own constant buffer and only uploaded when it changes.
+struct PixelMaterialData
+{
+	DirectX::XMFLOAT4 colorTint;
+
+	DirectX::XMFLOAT2 scale;
+	DirectX::XMFLOAT2 scalePadding;
+
+	DirectX::XMFLOAT2 offset;
+	DirectX::XMFLOAT2 offsetPadding;
+
+	// The entity's roughness.
+	DirectX::XMFLOAT2 roughness;
+	DirectX::XMFLOAT2 roughnessPadding;
+};
+
+// Per-instance matrices in the instance buffer read by InstancedVertexShader.
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 worldMatrix;
+	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
+};
+
+// Per-draw data for InstancedVertexShader, shared by every instance.
+// - The camera and light matrices come from VSPassData
+struct InstancedVSData
 {
-	DirectX::XMFLOAT4X4 world;
-	DirectX::XMFLOAT4X4 lightView;
-	DirectX::XMFLOAT4X4 lightProjection;
-	//DirectX::XMFLOAT4X4 cameraView;
-	//DirectX::XMFLOAT4X4 cameraProjection;
+	// First instance of the draw in the instance buffer, padded to 16 bytes.
+	unsigned int instanceStart;
+	unsigned int instanceStartPadding[3];
 };
 
 // Create a buffer struct for the PP Blur Pixel Shader.
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "BoundingVolumeHierarchy.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless bounding volume hierarchy benchmark
+//
+// - Scatters 1k, 10k, 100k and 1M boxes at a constant
+//   density and times building the hierarchy, refitting it
+//   after every box moves, and frustum, ray, sphere and box
+//   queries against testing every box
+// - Queries are run again after the refit, so a bad refit
+//   or rotation shows up as a mismatch, and the tree's
+//   surface area cost is shown after building, after the
+//   refit and after rebuilding from the moved boxes
+// - Checks every query against the brute force answer and
+//   returns 1 if any differs
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers
+// only accessible in this file
+namespace
+{
+	const int RAY_QUERIES = 200;
+	const int OVERLAP_QUERIES = 200;
+
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Brute force versions of the hierarchy's queries.
+	void BruteFrustum(const std::vector<AxisAlignedBox>& boxes, const Frustum& frustum, std::vector<unsigned int>& results)
+	{
+		results.clear();
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (Culling::BoxInFrustum(frustum, boxes[i]))
+				results.push_back((unsigned int)i);
+		}
+	}
+
+	void BruteSphere(const std::vector<AxisAlignedBox>& boxes, const XMFLOAT3& center, float radius, std::vector<unsigned int>& results)
+	{
+		results.clear();
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			const AxisAlignedBox& b = boxes[i];
+			float x = std::max(b.min.x - center.x, std::max(0.0f, center.x - b.max.x));
+			float y = std::max(b.min.y - center.y, std::max(0.0f, center.y - b.max.y));
+			float z = std::max(b.min.z - center.z, std::max(0.0f, center.z - b.max.z));
+			if (x * x + y * y + z * z <= radius * radius)
+				results.push_back((unsigned int)i);
+		}
+	}
+
+	void BruteBox(const std::vector<AxisAlignedBox>& boxes, const AxisAlignedBox& box, std::vector<unsigned int>& results)
+	{
+		results.clear();
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			const AxisAlignedBox& b = boxes[i];
+			if (box.min.x <= b.max.x && box.max.x >= b.min.x &&
+				box.min.y <= b.max.y && box.max.y >= b.min.y &&
+				box.min.z <= b.max.z && box.max.z >= b.min.z)
+				results.push_back((unsigned int)i);
+		}
+	}
+
+	// Nearest box a ray enters, breaking ties by the lowest index like Raycast().
+	unsigned int BruteRay(const std::vector<AxisAlignedBox>& boxes, const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, float& hitDistance)
+	{
+		XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		unsigned int hit = BoundingVolumeHierarchy::NO_HIT;
+		hitDistance = maxDistance;
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			const AxisAlignedBox& b = boxes[i];
+			float x1 = (b.min.x - origin.x) * inverse.x, x2 = (b.max.x - origin.x) * inverse.x;
+			float y1 = (b.min.y - origin.y) * inverse.y, y2 = (b.max.y - origin.y) * inverse.y;
+			float z1 = (b.min.z - origin.z) * inverse.z, z2 = (b.max.z - origin.z) * inverse.z;
+			float enter = std::max(std::max(std::min(x1, x2), std::min(y1, y2)), std::max(std::min(z1, z2), 0.0f));
+			float exit = std::min(std::min(std::max(x1, x2), std::max(y1, y2)), std::min(std::max(z1, z2), maxDistance));
+			if (enter <= exit && (hit == BoundingVolumeHierarchy::NO_HIT || enter < hitDistance))
+			{
+				hit = (unsigned int)i;
+				hitDistance = enter;
+			}
+		}
+		return hit;
+	}
+
+	// Same items in any order.
+	bool SameItems(std::vector<unsigned int> a, std::vector<unsigned int> b)
+	{
+		std::sort(a.begin(), a.end());
+		std::sort(b.begin(), b.end());
+		return a == b;
+	}
+
+	// Query times for one state of the hierarchy.
+	struct QueryTimes
+	{
+		float frustum[2];
+		float ray[2];
+		float overlap[2];
+		size_t mismatches;
+	};
+
+	// Run every query through the hierarchy and by brute force.
+	QueryTimes RunQueries(const BoundingVolumeHierarchy& bvh, const std::vector<AxisAlignedBox>& boxes, float sceneSize, std::mt19937& random)
+	{
+		QueryTimes times = {};
+		std::vector<unsigned int> bvhResults, bruteResults;
+		std::uniform_real_distribution<float> positions(-sceneSize, sceneSize);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		// A camera at one side of the scene looking across it.
+		XMFLOAT4X4 viewProjection;
+		XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 0, -sceneSize, 0), XMVectorSet(0.3f, 0.1f, 1, 0), XMVectorSet(0, 1, 0, 0));
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, sceneSize);
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, projection));
+		Frustum frustum = Culling::ExtractFrustum(viewProjection);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		bvh.QueryFrustum(frustum, bvhResults);
+		times.frustum[0] = MillisecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+		BruteFrustum(boxes, frustum, bruteResults);
+		times.frustum[1] = MillisecondsSince(start);
+		if (!SameItems(bvhResults, bruteResults))
+			times.mismatches++;
+
+		// Picking rays from random points in random directions.
+		std::vector<XMFLOAT3> origins(RAY_QUERIES), directions(RAY_QUERIES);
+		for (int i = 0; i < RAY_QUERIES; i++)
+		{
+			origins[i] = XMFLOAT3(positions(random), positions(random), positions(random));
+			directions[i] = XMFLOAT3(unit(random), unit(random), unit(random));
+		}
+		std::vector<unsigned int> bvhHits(RAY_QUERIES), bruteHits(RAY_QUERIES);
+		std::vector<float> bvhDistances(RAY_QUERIES), bruteDistances(RAY_QUERIES);
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < RAY_QUERIES; i++)
+			bvhHits[i] = bvh.Raycast(origins[i], directions[i], 1e30f, bvhDistances[i]);
+		times.ray[0] = MillisecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < RAY_QUERIES; i++)
+			bruteHits[i] = BruteRay(boxes, origins[i], directions[i], 1e30f, bruteDistances[i]);
+		times.ray[1] = MillisecondsSince(start);
+		for (int i = 0; i < RAY_QUERIES; i++)
+		{
+			// Boxes entered at the same distance may be reported either way.
+			if (bvhHits[i] != bruteHits[i] && bvhDistances[i] != bruteDistances[i])
+				times.mismatches++;
+		}
+
+		// Sphere and box overlap queries of a few boxes' size.
+		std::uniform_real_distribution<float> radii(1.0f, 8.0f);
+		std::vector<XMFLOAT3> centers(OVERLAP_QUERIES);
+		std::vector<float> sizes(OVERLAP_QUERIES);
+		for (int i = 0; i < OVERLAP_QUERIES; i++)
+		{
+			centers[i] = XMFLOAT3(positions(random), positions(random), positions(random));
+			sizes[i] = radii(random);
+		}
+		size_t bvhFound = 0, bruteFound = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < OVERLAP_QUERIES; i++)
+		{
+			bvh.QuerySphere(centers[i], sizes[i], bvhResults);
+			bvhFound += bvhResults.size();
+			AxisAlignedBox box = { XMFLOAT3(centers[i].x - sizes[i], centers[i].y - sizes[i], centers[i].z - sizes[i]), XMFLOAT3(centers[i].x + sizes[i], centers[i].y + sizes[i], centers[i].z + sizes[i]) };
+			bvh.QueryBox(box, bvhResults);
+			bvhFound += bvhResults.size();
+		}
+		times.overlap[0] = MillisecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < OVERLAP_QUERIES; i++)
+		{
+			BruteSphere(boxes, centers[i], sizes[i], bruteResults);
+			bruteFound += bruteResults.size();
+			AxisAlignedBox box = { XMFLOAT3(centers[i].x - sizes[i], centers[i].y - sizes[i], centers[i].z - sizes[i]), XMFLOAT3(centers[i].x + sizes[i], centers[i].y + sizes[i], centers[i].z + sizes[i]) };
+			BruteBox(boxes, box, bruteResults);
+			bruteFound += bruteResults.size();
+		}
+		times.overlap[1] = MillisecondsSince(start);
+
+		// Compare the full results of one of each.
+		bvh.QuerySphere(centers[0], sizes[0] * 4.0f, bvhResults);
+		BruteSphere(boxes, centers[0], sizes[0] * 4.0f, bruteResults);
+		if (bvhFound != bruteFound || !SameItems(bvhResults, bruteResults))
+			times.mismatches++;
+
+		return times;
+	}
+
+	// Time one scene size and return the number of failed checks.
+	int RunBenchmark(size_t count, std::mt19937& random)
+	{
+		// Boxes of 0.5 to 2 units, spread so there are about eight per 1000 cubic units.
+		float sceneSize = 5.0f * std::cbrt((float)count);
+		std::uniform_real_distribution<float> positions(-sceneSize, sceneSize);
+		std::uniform_real_distribution<float> sizes(0.25f, 1.0f);
+		std::vector<AxisAlignedBox> boxes(count);
+		for (AxisAlignedBox& box : boxes)
+		{
+			XMFLOAT3 center(positions(random), positions(random), positions(random));
+			XMFLOAT3 half(sizes(random), sizes(random), sizes(random));
+			box.min = XMFLOAT3(center.x - half.x, center.y - half.y, center.z - half.z);
+			box.max = XMFLOAT3(center.x + half.x, center.y + half.y, center.z + half.z);
+		}
+
+		BoundingVolumeHierarchy bvh;
+		auto start = std::chrono::high_resolution_clock::now();
+		bvh.Build(boxes.data(), boxes.size());
+		float buildTime = MillisecondsSince(start);
+		float builtCost = bvh.GetCost();
+		QueryTimes built = RunQueries(bvh, boxes, sceneSize, random);
+
+		// Every box drifts, and one in a hundred jumps across the scene.
+		std::uniform_real_distribution<float> drift(-2.0f, 2.0f);
+		std::uniform_int_distribution<int> chance(0, 99);
+		for (AxisAlignedBox& box : boxes)
+		{
+			XMFLOAT3 offset(drift(random), drift(random), drift(random));
+			if (chance(random) == 0)
+				offset = XMFLOAT3(positions(random) - box.min.x, positions(random) - box.min.y, positions(random) - box.min.z);
+			box.min = XMFLOAT3(box.min.x + offset.x, box.min.y + offset.y, box.min.z + offset.z);
+			box.max = XMFLOAT3(box.max.x + offset.x, box.max.y + offset.y, box.max.z + offset.z);
+		}
+		start = std::chrono::high_resolution_clock::now();
+		bvh.Refit(boxes.data());
+		float refitTime = MillisecondsSince(start);
+		float refitCost = bvh.GetCost();
+		QueryTimes refit = RunQueries(bvh, boxes, sceneSize, random);
+
+		// The cost a full rebuild would reach, to compare the refit against.
+		BoundingVolumeHierarchy rebuilt;
+		rebuilt.Build(boxes.data(), boxes.size());
+
+		std::printf("%8zu %9.2f %9.2f %7.1f %7.1f %7.1f %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+			count, buildTime, refitTime, builtCost, refitCost, rebuilt.GetCost(),
+			built.frustum[0], built.frustum[1], built.ray[0], built.ray[1], built.overlap[0], built.overlap[1]);
+
+		size_t mismatches = built.mismatches + refit.mismatches;
+		if (mismatches > 0)
+		{
+			std::printf("FAIL: %zu hierarchy queries differ from brute force\n", mismatches);
+			return 1;
+		}
+		return 0;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(12345);
+
+	std::printf("%8s %9s %9s %7s %7s %7s %9s %9s %9s %9s %9s %9s\n",
+		"Boxes", "Build ms", "Refit ms", "Cost", "Refit", "Rebuilt",
+		"Frust ms", "(brute)", "Rays ms", "(brute)", "Overlap", "(brute)");
+	int failures = 0;
+	for (size_t count : { (size_t)1000, (size_t)10000, (size_t)100000, (size_t)1000000 })
+		failures += RunBenchmark(count, random);
+
+	return failures > 0 ? 1 : 0;
+}
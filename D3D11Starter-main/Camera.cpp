@@ -270,6 +270,16 @@ float Camera::GetPerspective()
     return isPerspective;
 }
 
+float Camera::GetNearClip()
+{
+    return nearClip;
+}
+
+float Camera::GetFarClip()
+{
+    return farClip;
+}
+
 Transform& Camera::GetTransform()
 {
     return transform;
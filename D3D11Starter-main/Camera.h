@@ -26,6 +26,10 @@ public:
 	// Get fov and perspective.
 	float GetFov();
 	float GetPerspective();
+
+	// Get the near and far clip plane distances.
+	float GetNearClip();
+	float GetFarClip();
 	
 	// Get the transform data.
 	Transform& GetTransform();
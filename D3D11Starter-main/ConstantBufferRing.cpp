@@ -0,0 +1,126 @@
+#include "ConstantBufferRing.h"
+
+ConstantBufferRing::ConstantBufferRing()
+	: capacity(0), head(0), tail(0), usedBytes(0), currentFrame(0), currentFrameBytes(0), inFrame(false)
+{
+}
+
+void ConstantBufferRing::Reset(unsigned int newCapacity)
+{
+	framesInFlight.clear();
+	capacity = newCapacity / ALIGNMENT * ALIGNMENT;
+	head = 0;
+	tail = 0;
+	usedBytes = 0;
+	currentFrameBytes = 0;
+}
+
+void ConstantBufferRing::BeginFrame(uint64_t frame)
+{
+	// Anything allocated before the frame began already counts toward it.
+	currentFrame = frame;
+	inFrame = true;
+}
+
+void ConstantBufferRing::EndFrame()
+{
+	if (!inFrame)
+		return;
+
+	// Empty frames are kept too, so retiring one still moves the tail up to it.
+	framesInFlight.push_back({ currentFrame, head, currentFrameBytes });
+	currentFrameBytes = 0;
+	inFrame = false;
+}
+
+unsigned int ConstantBufferRing::Allocate(unsigned int size)
+{
+	unsigned int alignedSize = Align(size);
+	if (alignedSize == 0 || alignedSize > capacity)
+		return INVALID_OFFSET;
+
+	// Nothing in use anywhere: start from the front, so the whole buffer is one free run.
+	if (usedBytes == 0)
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	// Head meeting tail with data in use means the buffer is full.
+	if (usedBytes > 0 && head == tail)
+		return INVALID_OFFSET;
+
+	unsigned int offset;
+	unsigned int padding = 0;
+	if (head >= tail)
+	{
+		// Free space is from the head to the end, then from the start to the tail.
+		if (capacity - head >= alignedSize)
+			offset = head;
+		else if (tail >= alignedSize)
+		{
+			// Skip the end of the buffer; the skipped bytes stay with this frame.
+			padding = capacity - head;
+			offset = 0;
+		}
+		else
+			return INVALID_OFFSET;
+	}
+	else
+	{
+		// Free space is between the head and the tail.
+		if (tail - head >= alignedSize)
+			offset = head;
+		else
+			return INVALID_OFFSET;
+	}
+
+	head = offset + alignedSize;
+	if (head == capacity)
+		head = 0;
+	usedBytes += padding + alignedSize;
+	currentFrameBytes += padding + alignedSize;
+	return offset;
+}
+
+void ConstantBufferRing::RetireFramesThrough(uint64_t frame)
+{
+	// Frames finish in order, so each retired frame moves the tail up to its end.
+	while (!framesInFlight.empty() && framesInFlight.front().frame <= frame)
+	{
+		const FrameRegion& region = framesInFlight.front();
+		tail = region.end;
+		usedBytes -= region.bytes;
+		framesInFlight.pop_front();
+	}
+}
+
+bool ConstantBufferRing::HasFramesInFlight() const
+{
+	return !framesInFlight.empty();
+}
+
+uint64_t ConstantBufferRing::GetOldestFrameInFlight() const
+{
+	return framesInFlight.empty() ? currentFrame : framesInFlight.front().frame;
+}
+
+unsigned int ConstantBufferRing::GetCapacity() const
+{
+	return capacity;
+}
+
+unsigned int ConstantBufferRing::GetUsedBytes() const
+{
+	return usedBytes;
+}
+
+unsigned int ConstantBufferRing::GetFrameBytes() const
+{
+	return currentFrameBytes;
+}
+
+unsigned int ConstantBufferRing::Align(unsigned int size)
+{
+	return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
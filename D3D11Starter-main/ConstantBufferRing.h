@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+// --------------------------------------------------------
+// Sub-allocator for one dynamic constant buffer shared by
+// several frames the GPU may still be reading.
+//
+// - Allocations are handed out in order around the buffer,
+//   aligned to 256 bytes (what *SetConstantBuffers1 needs)
+// - Everything allocated between BeginFrame() and
+//   EndFrame() belongs to that frame, and stays untouched
+//   until RetireFramesThrough() says the GPU finished it
+// - Allocate() fails instead of overwriting a frame still
+//   in flight, so the owner can wait or grow the buffer;
+//   Reset() starts over in a new, larger buffer
+// - Only tracks offsets, so it knows nothing about D3D
+// --------------------------------------------------------
+class ConstantBufferRing
+{
+public:
+	static constexpr unsigned int ALIGNMENT = 256;
+
+	// Returned by Allocate() when there is no room.
+	static constexpr unsigned int INVALID_OFFSET = 0xFFFFFFFF;
+
+	ConstantBufferRing();
+
+	// Start over with an empty buffer of "capacity" bytes (rounded down to the alignment).
+	// - Drops every frame in flight, as they live on in the old buffer
+	// - The frame being allocated, if any, keeps going in the new one
+	void Reset(unsigned int capacity);
+
+	// Start and finish the allocations of one frame.
+	// - Frame ids must increase from frame to frame
+	void BeginFrame(uint64_t frame);
+	void EndFrame();
+
+	// Reserve "size" bytes for the current frame and return their offset,
+	// or INVALID_OFFSET if they only fit over data a frame in flight still uses.
+	unsigned int Allocate(unsigned int size);
+
+	// Free the data of every ended frame up to and including "frame".
+	void RetireFramesThrough(uint64_t frame);
+
+	// Whether any ended frame still holds data, and the oldest one that does.
+	bool HasFramesInFlight() const;
+	uint64_t GetOldestFrameInFlight() const;
+
+	unsigned int GetCapacity() const;
+
+	// Bytes held by frames in flight and the current frame, wrap padding included.
+	unsigned int GetUsedBytes() const;
+
+	// Bytes the current frame has allocated so far, wrap padding included.
+	unsigned int GetFrameBytes() const;
+
+	// Round a size up to the alignment.
+	static unsigned int Align(unsigned int size);
+
+private:
+	// Where one ended frame's data stops, and how many bytes it holds.
+	struct FrameRegion
+	{
+		uint64_t frame;
+		unsigned int end;
+		unsigned int bytes;
+	};
+
+	std::deque<FrameRegion> framesInFlight;
+
+	unsigned int capacity;
+
+	// Next free byte, and the first byte still in use (by the oldest frame).
+	unsigned int head;
+	unsigned int tail;
+	unsigned int usedBytes;
+
+	uint64_t currentFrame;
+	unsigned int currentFrameBytes;
+	bool inFrame;
+};
@@ -0,0 +1,262 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ConstantBufferRing.h"
+
+// --------------------------------------------------------
+// Headless constant buffer ring benchmark
+//
+// - Plays frames of random constant uploads against a
+//   simulated GPU that finishes each frame one to three
+//   frames after the CPU ends it, and keeps its own record
+//   of which 256 byte block every unfinished frame uses
+// - ConstantBufferRing allocations (waiting for the oldest
+//   unfinished frame when one fails, and growing the buffer
+//   only once no earlier frame is left, as Game does) must
+//   never land on a block an unfinished frame uses, must be
+//   aligned and in bounds, and the buffer must never grow
+//   past twice the largest frame; returns 1 if any check fails
+// - Plays the same frames through the old allocator, which
+//   wraps to zero whenever it reaches the end of a fixed
+//   256,000 byte buffer, and prints how many of its uploads
+//   overwrote data the GPU had not read yet
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers
+// only accessible in this file
+namespace
+{
+	const uint64_t FREE_BLOCK = UINT64_MAX;
+	const unsigned int OLD_HEAP_SIZE = 1000 * 256;
+
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// The GPU side of the simulation: which frame, if any, still reads each block of one buffer.
+	struct SimulatedBuffer
+	{
+		std::vector<uint64_t> blockFrames;
+
+		void Resize(unsigned int capacity)
+		{
+			blockFrames.assign(capacity / ConstantBufferRing::ALIGNMENT, FREE_BLOCK);
+		}
+
+		// Free every block of a frame the GPU finished.
+		void Complete(uint64_t frame)
+		{
+			for (uint64_t& owner : blockFrames)
+			{
+				if (owner != FREE_BLOCK && owner <= frame)
+					owner = FREE_BLOCK;
+			}
+		}
+
+		// Claim the blocks of an upload, and return whether any was still unread.
+		bool Write(unsigned int offset, unsigned int size, uint64_t frame)
+		{
+			bool hazard = false;
+			unsigned int first = offset / ConstantBufferRing::ALIGNMENT;
+			unsigned int last = (offset + size - 1) / ConstantBufferRing::ALIGNMENT;
+			for (unsigned int block = first; block <= last && block < blockFrames.size(); block++)
+			{
+				if (blockFrames[block] != FREE_BLOCK)
+					hazard = true;
+				blockFrames[block] = frame;
+			}
+			return hazard;
+		}
+	};
+
+	// Upload sizes of one frame.
+	std::vector<unsigned int> MakeFrame(unsigned int uploadCount, std::mt19937& random)
+	{
+		// Mostly per-object matrices, some per-pass and per-frame blocks.
+		std::uniform_int_distribution<unsigned int> kinds(0, 9);
+		std::vector<unsigned int> sizes(uploadCount);
+		for (unsigned int& size : sizes)
+		{
+			unsigned int kind = kinds(random);
+			size = kind < 7 ? 128 : (kind < 9 ? 256 : 496);
+		}
+		return sizes;
+	}
+
+	// Play one scenario and return the number of failed checks.
+	// - "uploadCounts" gives the number of uploads of each frame
+	int RunScenario(const char* name, const std::vector<unsigned int>& uploadCounts, unsigned int startCapacity, std::mt19937& random)
+	{
+		std::uniform_int_distribution<unsigned int> latencies(1, 3);
+
+		ConstantBufferRing ring;
+		ring.Reset(startCapacity);
+		SimulatedBuffer ringGpu;
+		ringGpu.Resize(ring.GetCapacity());
+
+		SimulatedBuffer oldGpu;
+		oldGpu.Resize(OLD_HEAP_SIZE);
+		unsigned int oldOffset = 0;
+
+		// The GPU finishes each frame a random one to three frames later, in order.
+		std::vector<uint64_t> finishFrames;
+		uint64_t gpuFinished = 0;
+
+		size_t uploads = 0;
+		size_t ringHazards = 0;
+		size_t oldHazards = 0;
+		size_t boundsErrors = 0;
+		unsigned int growths = 0;
+		unsigned int peakUsed = 0;
+		unsigned int largestFrame = 0;
+		float allocateTime = 0.0f;
+
+		for (uint64_t frame = 1; frame <= uploadCounts.size(); frame++)
+		{
+			// Finish every frame whose time has come.
+			while (gpuFinished + 1 < frame && finishFrames[gpuFinished] <= frame)
+			{
+				gpuFinished++;
+				ringGpu.Complete(gpuFinished);
+				oldGpu.Complete(gpuFinished);
+			}
+			ring.RetireFramesThrough(gpuFinished);
+
+			std::vector<unsigned int> sizes = MakeFrame(uploadCounts[frame - 1], random);
+			ring.BeginFrame(frame);
+			auto start = std::chrono::high_resolution_clock::now();
+			for (unsigned int size : sizes)
+			{
+				unsigned int offset = ring.Allocate(size);
+
+				// Wait for the oldest unfinished frame and try again.
+				while (offset == ConstantBufferRing::INVALID_OFFSET && ring.HasFramesInFlight())
+				{
+					uint64_t oldest = ring.GetOldestFrameInFlight();
+					while (gpuFinished < oldest)
+					{
+						gpuFinished++;
+						ringGpu.Complete(gpuFinished);
+						oldGpu.Complete(gpuFinished);
+					}
+					ring.RetireFramesThrough(oldest);
+					offset = ring.Allocate(size);
+				}
+
+				// Only this frame is left and it still does not fit.
+				if (offset == ConstantBufferRing::INVALID_OFFSET)
+				{
+					// Frames in flight keep the old buffer's blocks, the new one starts empty.
+					ring.Reset(ring.GetCapacity() * 2);
+					ringGpu.Resize(ring.GetCapacity());
+					growths++;
+					offset = ring.Allocate(size);
+				}
+
+				if (offset == ConstantBufferRing::INVALID_OFFSET || offset % ConstantBufferRing::ALIGNMENT != 0 ||
+					offset + size > ring.GetCapacity())
+					boundsErrors++;
+				else if (ringGpu.Write(offset, size, frame))
+					ringHazards++;
+				if (ring.GetUsedBytes() > peakUsed)
+					peakUsed = ring.GetUsedBytes();
+
+				// The old allocator, exactly as Game::FillAndBindNextConstantBuffer had it.
+				unsigned int reserved = ConstantBufferRing::Align(size);
+				if (oldOffset + reserved >= OLD_HEAP_SIZE)
+					oldOffset = 0;
+				if (oldGpu.Write(oldOffset, size, frame))
+					oldHazards++;
+				oldOffset += reserved;
+
+				uploads++;
+			}
+			allocateTime += MillisecondsSince(start);
+			if (ring.GetFrameBytes() > largestFrame)
+				largestFrame = ring.GetFrameBytes();
+			ring.EndFrame();
+			finishFrames.push_back(frame + latencies(random));
+		}
+
+		std::printf("%-22s %8zu %10zu %8u %12.1f %12.1f %10zu %10zu %10.1f\n",
+			name, uploadCounts.size(), uploads, growths,
+			ring.GetCapacity() / 1024.0f, peakUsed / 1024.0f, ringHazards, oldHazards,
+			uploads > 0 ? allocateTime * 1000000.0f / uploads : 0.0f);
+
+		int failures = 0;
+		if (ringHazards > 0)
+		{
+			std::printf("FAIL: %zu ring uploads overwrote data the GPU had not read\n", ringHazards);
+			failures++;
+		}
+		if (boundsErrors > 0)
+		{
+			std::printf("FAIL: %zu ring uploads were unaligned or out of bounds\n", boundsErrors);
+			failures++;
+		}
+		if (growths > 0 && ring.GetCapacity() > 2 * largestFrame)
+		{
+			std::printf("FAIL: the buffer grew to %u bytes for frames of at most %u bytes\n", ring.GetCapacity(), largestFrame);
+			failures++;
+		}
+		return failures;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(12345);
+	int failures = 0;
+
+	// Basic ring behaviour on a four block buffer.
+	{
+		const unsigned int BLOCK = ConstantBufferRing::ALIGNMENT;
+		ConstantBufferRing ring;
+		ring.Reset(4 * BLOCK);
+		ring.BeginFrame(1);
+		bool ok = ring.Allocate(16) == 0 && ring.Allocate(BLOCK + 1) == BLOCK;
+		ring.EndFrame();
+
+		// Frame 1 holds blocks 0 to 2, so frame 2 gets block 3 and nothing more.
+		ring.BeginFrame(2);
+		ok = ok && ring.Allocate(BLOCK) == 3 * BLOCK;
+		ok = ok && ring.Allocate(BLOCK) == ConstantBufferRing::INVALID_OFFSET;
+
+		// Once frame 1 is done, frame 2 wraps around to the start.
+		ring.RetireFramesThrough(1);
+		ok = ok && ring.Allocate(2 * BLOCK) == 0;
+		ring.EndFrame();
+		ok = ok && ring.GetUsedBytes() == 3 * BLOCK && ring.GetOldestFrameInFlight() == 2;
+
+		ring.RetireFramesThrough(2);
+		ok = ok && ring.GetUsedBytes() == 0 && !ring.HasFramesInFlight();
+		if (!ok)
+		{
+			std::printf("FAIL: ring allocations on a four block buffer\n");
+			failures++;
+		}
+	}
+
+	std::printf("%-22s %8s %10s %8s %12s %12s %10s %10s %10s\n",
+		"Scenario", "Frames", "Uploads", "Growths", "Capacity KB", "Peak KB", "Hazards", "Old", "ns/upload");
+
+	// The Game scene: two passes over 42 entities plus a few pass and frame blocks.
+	failures += RunScenario("Game scene", std::vector<unsigned int>(2000, 100), 1000 * 256, random);
+
+	// A heavier scene than the old heap was sized for.
+	failures += RunScenario("1,000 entities", std::vector<unsigned int>(2000, 2000), 1000 * 256, random);
+
+	// Steady frames with occasional spikes, starting from a small buffer.
+	std::vector<unsigned int> spiky(4000);
+	std::uniform_int_distribution<unsigned int> steady(50, 400);
+	for (size_t i = 0; i < spiky.size(); i++)
+		spiky[i] = (i % 500 == 499) ? 6000 : steady(random);
+	failures += RunScenario("Spikes from 16 KB", spiky, 16 * 1024, random);
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,458 @@
+#include "CookTorrance.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the vector helpers and the four-wide shading
+// only accessible in this file
+namespace
+{
+	// HLSL's float3 operations, for the scalar functions.
+	XMFLOAT3 Add(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+	XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	XMFLOAT3 Multiply(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x * b.x, a.y * b.y, a.z * b.z); }
+	XMFLOAT3 Scale(const XMFLOAT3& a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	float Saturate(float value) { return std::min(std::max(value, 0.0f), 1.0f); }
+
+	XMFLOAT3 Normalize(const XMFLOAT3& a)
+	{
+		return Scale(a, 1.0f / std::sqrt(Dot(a, a)));
+	}
+
+	// Four pixels' worth of a float3, one vector per component.
+	struct Vector3x4
+	{
+		XMVECTOR x;
+		XMVECTOR y;
+		XMVECTOR z;
+	};
+
+	XMVECTOR Load(const std::vector<float>& values, size_t index)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&values[index]));
+	}
+
+	Vector3x4 Load(const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z, size_t index)
+	{
+		return { Load(x, index), Load(y, index), Load(z, index) };
+	}
+
+	Vector3x4 Replicate(const XMFLOAT3& value)
+	{
+		return { XMVectorReplicate(value.x), XMVectorReplicate(value.y), XMVectorReplicate(value.z) };
+	}
+
+	XMVECTOR Dot(const Vector3x4& a, const Vector3x4& b)
+	{
+		XMVECTOR dot = XMVectorMultiply(a.x, b.x);
+		dot = XMVectorMultiplyAdd(a.y, b.y, dot);
+		return XMVectorMultiplyAdd(a.z, b.z, dot);
+	}
+
+	Vector3x4 Normalize(const Vector3x4& a)
+	{
+		XMVECTOR length = XMVectorSqrt(Dot(a, a));
+		return { XMVectorDivide(a.x, length), XMVectorDivide(a.y, length), XMVectorDivide(a.z, length) };
+	}
+
+	// Four pixels' G-buffer values, and what they need for every light.
+	struct PixelLanes
+	{
+		Vector3x4 position;
+		Vector3x4 normal;
+		Vector3x4 unitNormal;
+		Vector3x4 albedo;
+		Vector3x4 specularColor;
+		Vector3x4 view;
+		XMVECTOR metalness;
+		XMVECTOR shadow;
+
+		// Roughness remapped for D_GGX and G_SchlickGGX, and the view's G term.
+		XMVECTOR a2;
+		XMVECTOR k;
+		XMVECTOR oneMinusK;
+		XMVECTOR viewShadowing;
+
+		Vector3x4 total;
+	};
+
+	// One light, replicated across the lanes.
+	struct LightLanes
+	{
+		int type;
+		bool shadowed;
+		Vector3x4 position;
+		Vector3x4 direction;
+		Vector3x4 color;
+		XMVECTOR rangeSquared;
+		XMVECTOR cosOuter;
+		XMVECTOR falloffRange;
+	};
+
+	void LoadPixels(const GBuffer& gbuffer, size_t index, const Vector3x4& cameraPosition, PixelLanes& pixels)
+	{
+		const XMVECTOR one = XMVectorSplatOne();
+
+		pixels.position = Load(gbuffer.positionX, gbuffer.positionY, gbuffer.positionZ, index);
+		pixels.normal = Load(gbuffer.normalX, gbuffer.normalY, gbuffer.normalZ, index);
+		pixels.unitNormal = Normalize(pixels.normal);
+		pixels.albedo = Load(gbuffer.albedoR, gbuffer.albedoG, gbuffer.albedoB, index);
+		pixels.metalness = Load(gbuffer.metalness, index);
+		pixels.shadow = Load(gbuffer.shadow, index);
+
+		// lerp(0.04f, surfaceColor, metalness)
+		XMVECTOR dielectric = XMVectorReplicate(0.04f);
+		pixels.specularColor.x = XMVectorMultiplyAdd(XMVectorSubtract(pixels.albedo.x, dielectric), pixels.metalness, dielectric);
+		pixels.specularColor.y = XMVectorMultiplyAdd(XMVectorSubtract(pixels.albedo.y, dielectric), pixels.metalness, dielectric);
+		pixels.specularColor.z = XMVectorMultiplyAdd(XMVectorSubtract(pixels.albedo.z, dielectric), pixels.metalness, dielectric);
+
+		pixels.view = Normalize({
+			XMVectorSubtract(cameraPosition.x, pixels.position.x),
+			XMVectorSubtract(cameraPosition.y, pixels.position.y),
+			XMVectorSubtract(cameraPosition.z, pixels.position.z) });
+
+		XMVECTOR roughness = Load(gbuffer.roughness, index);
+		XMVECTOR a = XMVectorMultiply(roughness, roughness);
+		pixels.a2 = XMVectorMax(XMVectorMultiply(a, a), XMVectorReplicate(CookTorrance::MIN_ROUGHNESS));
+		XMVECTOR roughnessPlusOne = XMVectorAdd(roughness, one);
+		pixels.k = XMVectorDivide(XMVectorMultiply(roughnessPlusOne, roughnessPlusOne), XMVectorReplicate(8.0f));
+		pixels.oneMinusK = XMVectorSubtract(one, pixels.k);
+		XMVECTOR NdotV = XMVectorSaturate(Dot(pixels.unitNormal, pixels.view));
+		pixels.viewShadowing = XMVectorDivide(one, XMVectorMultiplyAdd(NdotV, pixels.oneMinusK, pixels.k));
+
+		pixels.total = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+	}
+
+	// CookDirectionalLight, CookPointLight or CookSpotLight (times Attenuate) for four pixels.
+	void ShadeLight(const LightLanes& light, PixelLanes& pixels)
+	{
+		const XMVECTOR one = XMVectorSplatOne();
+
+		// Point and spot lights point from the light to the pixel.
+		Vector3x4 l = light.direction;
+		XMVECTOR factor = light.shadowed ? pixels.shadow : one;
+		if (light.type != LIGHT_TYPE_DIRECTIONAL)
+		{
+			Vector3x4 toPixel = {
+				XMVectorSubtract(pixels.position.x, light.position.x),
+				XMVectorSubtract(pixels.position.y, light.position.y),
+				XMVectorSubtract(pixels.position.z, light.position.z) };
+			XMVECTOR distanceSquared = Dot(toPixel, toPixel);
+			l = Normalize(toPixel);
+
+			XMVECTOR attenuate = XMVectorSaturate(XMVectorSubtract(one, XMVectorDivide(distanceSquared, light.rangeSquared)));
+			factor = XMVectorMultiply(attenuate, attenuate);
+
+			if (light.type == LIGHT_TYPE_SPOT)
+			{
+				XMVECTOR pixelAngle = XMVectorSaturate(Dot(l, light.direction));
+				XMVECTOR falloff = XMVectorSaturate(XMVectorDivide(XMVectorSubtract(light.cosOuter, pixelAngle), light.falloffRange));
+				factor = XMVectorMultiply(factor, falloff);
+			}
+		}
+
+		// DiffusePBR, with the unnormalized normal as the shader passes it.
+		XMVECTOR diffuse = XMVectorDivide(XMVectorSaturate(XMVectorNegate(Dot(pixels.normal, l))), XMVectorReplicate(CookTorrance::PI));
+
+		// MicrofacetBRDF's D and G terms, and its n.l.
+		Vector3x4 h = Normalize({
+			XMVectorAdd(pixels.view.x, l.x),
+			XMVectorAdd(pixels.view.y, l.y),
+			XMVectorAdd(pixels.view.z, l.z) });
+		XMVECTOR NdotH = XMVectorSaturate(Dot(pixels.unitNormal, h));
+		XMVECTOR denominator = XMVectorMultiplyAdd(XMVectorMultiply(NdotH, NdotH), XMVectorSubtract(pixels.a2, one), one);
+		XMVECTOR D = XMVectorDivide(pixels.a2, XMVectorMultiply(XMVectorReplicate(CookTorrance::PI), XMVectorMultiply(denominator, denominator)));
+
+		XMVECTOR NdotL = XMVectorSaturate(Dot(pixels.unitNormal, l));
+		XMVECTOR lightShadowing = XMVectorDivide(one, XMVectorMultiplyAdd(NdotL, pixels.oneMinusK, pixels.k));
+		XMVECTOR specular = XMVectorMultiply(XMVectorMultiply(D, XMVectorMultiply(pixels.viewShadowing, lightShadowing)), XMVectorReplicate(0.25f));
+		specular = XMVectorMultiply(specular, NdotL);
+
+		// F_Schlick, shared by the specular and the energy conserving diffuse.
+		XMVECTOR oneMinusVdotH = XMVectorSubtract(one, XMVectorSaturate(Dot(pixels.view, h)));
+		XMVECTOR fresnelWeight = XMVectorMultiply(oneMinusVdotH, oneMinusVdotH);
+		fresnelWeight = XMVectorMultiply(XMVectorMultiply(fresnelWeight, fresnelWeight), oneMinusVdotH);
+
+		XMVECTOR balancedDiffuse = XMVectorMultiply(diffuse, XMVectorSubtract(one, pixels.metalness));
+		XMVECTOR lightFactor[3] = {
+			XMVectorMultiply(light.color.x, factor),
+			XMVectorMultiply(light.color.y, factor),
+			XMVectorMultiply(light.color.z, factor) };
+		const XMVECTOR* f0[3] = { &pixels.specularColor.x, &pixels.specularColor.y, &pixels.specularColor.z };
+		const XMVECTOR* albedo[3] = { &pixels.albedo.x, &pixels.albedo.y, &pixels.albedo.z };
+		XMVECTOR* total[3] = { &pixels.total.x, &pixels.total.y, &pixels.total.z };
+		for (int c = 0; c < 3; c++)
+		{
+			XMVECTOR F = XMVectorMultiplyAdd(XMVectorSubtract(one, *f0[c]), fresnelWeight, *f0[c]);
+			XMVECTOR color = XMVectorMultiply(XMVectorMultiply(balancedDiffuse, XMVectorSubtract(one, F)), *albedo[c]);
+			color = XMVectorMultiplyAdd(specular, F, color);
+			*total[c] = XMVectorMultiplyAdd(color, lightFactor[c], *total[c]);
+		}
+	}
+}
+
+float CookTorrance::Attenuate(const Lights& light, const XMFLOAT3& worldPosition)
+{
+	XMFLOAT3 offset = Subtract(light.position, worldPosition);
+	float dist = std::sqrt(Dot(offset, offset));
+	float attenuate = Saturate(1.0f - (dist * dist / (light.range * light.range)));
+	return attenuate * attenuate;
+}
+
+float CookTorrance::D_GGX(const XMFLOAT3& n, const XMFLOAT3& h, float roughness)
+{
+	float NdotH = Saturate(Dot(n, h));
+	float NdotH2 = NdotH * NdotH;
+
+	float a = roughness * roughness;
+	float a2 = std::max(a * a, MIN_ROUGHNESS);
+
+	float denomToSquare = NdotH2 * (a2 - 1) + 1;
+	return a2 / (PI * denomToSquare * denomToSquare);
+}
+
+float CookTorrance::G_SchlickGGX(const XMFLOAT3& n, const XMFLOAT3& v, float roughness)
+{
+	float k = std::pow(roughness + 1, 2.0f) / 8.0f;
+	float NdotV = Saturate(Dot(n, v));
+	return 1 / (NdotV * (1 - k) + k);
+}
+
+XMFLOAT3 CookTorrance::F_Schlick(const XMFLOAT3& v, const XMFLOAT3& h, const XMFLOAT3& f0)
+{
+	float VdotH = Saturate(Dot(v, h));
+	float weight = std::pow(1 - VdotH, 5.0f);
+	return XMFLOAT3(
+		f0.x + (1 - f0.x) * weight,
+		f0.y + (1 - f0.y) * weight,
+		f0.z + (1 - f0.z) * weight);
+}
+
+float CookTorrance::DiffusePBR(const XMFLOAT3& inputNormal, const XMFLOAT3& normalizedLightDirection)
+{
+	return Saturate(-Dot(inputNormal, normalizedLightDirection)) / PI;
+}
+
+XMFLOAT3 CookTorrance::MicrofacetBRDF(const XMFLOAT3& n, const XMFLOAT3& l, const XMFLOAT3& v, float roughness, const XMFLOAT3& f0)
+{
+	XMFLOAT3 h = Normalize(Add(v, l));
+
+	float D = D_GGX(n, h, roughness);
+	XMFLOAT3 F = F_Schlick(v, h, f0);
+	float G = G_SchlickGGX(n, v, roughness) * G_SchlickGGX(n, l, roughness);
+
+	XMFLOAT3 specularResult = Scale(F, D * G / 4);
+	return Scale(specularResult, Saturate(Dot(n, l)));
+}
+
+XMFLOAT3 CookTorrance::CookDirectionalLight(
+	const Lights& light,
+	const XMFLOAT3& inputNormal,
+	const XMFLOAT3& normalizedLightDirection,
+	const XMFLOAT3& inputPixelWorldPosition,
+	const XMFLOAT3& cameraPosition,
+	float roughness,
+	const XMFLOAT3& surfaceColor,
+	const XMFLOAT3& specularColor,
+	float metalness)
+{
+	float diff = DiffusePBR(inputNormal, normalizedLightDirection);
+	XMFLOAT3 normalVVDirOfCam = Normalize(Subtract(cameraPosition, inputPixelWorldPosition));
+
+	XMFLOAT3 spec = MicrofacetBRDF(
+		Normalize(inputNormal),
+		Normalize(normalizedLightDirection),
+		normalVVDirOfCam,
+		roughness,
+		specularColor);
+
+	// The shader normalizes the (already normalized) half vector again.
+	XMFLOAT3 h = Normalize(Normalize(Add(normalVVDirOfCam, normalizedLightDirection)));
+	XMFLOAT3 Fresnel = F_Schlick(normalVVDirOfCam, h, specularColor);
+
+	// DiffuseEnergyConserve
+	XMFLOAT3 balancedDiff(
+		diff * (1 - Fresnel.x) * (1 - metalness),
+		diff * (1 - Fresnel.y) * (1 - metalness),
+		diff * (1 - Fresnel.z) * (1 - metalness));
+
+	XMFLOAT3 finalLight = Add(Multiply(balancedDiff, surfaceColor), spec);
+	return Multiply(Scale(finalLight, light.intensity), light.color);
+}
+
+XMFLOAT3 CookTorrance::CookPointLight(
+	const Lights& light,
+	const XMFLOAT3& inputNormal,
+	const XMFLOAT3& inputPixelWorldPosition,
+	const XMFLOAT3& cameraPosition,
+	float roughness,
+	const XMFLOAT3& surfaceColor,
+	const XMFLOAT3& specularColor,
+	float metalness)
+{
+	XMFLOAT3 dirOfLightPosFromPixelPos = Subtract(light.position, inputPixelWorldPosition);
+	XMFLOAT3 normalizedLightDirection = Normalize(Scale(dirOfLightPosFromPixelPos, -1.0f));
+
+	return CookDirectionalLight(
+		light,
+		inputNormal,
+		normalizedLightDirection,
+		inputPixelWorldPosition,
+		cameraPosition,
+		roughness,
+		surfaceColor,
+		specularColor,
+		metalness);
+}
+
+XMFLOAT3 CookTorrance::CookSpotLight(
+	const Lights& light,
+	const XMFLOAT3& inputNormal,
+	const XMFLOAT3& normalizedLightDirection,
+	const XMFLOAT3& inputPixelWorldPosition,
+	const XMFLOAT3& cameraPosition,
+	float roughness,
+	const XMFLOAT3& surfaceColor,
+	const XMFLOAT3& specularColor,
+	float metalness)
+{
+	XMFLOAT3 normalizedLightPosDir = Normalize(Subtract(inputPixelWorldPosition, light.position));
+	XMFLOAT3 normalizeLightDir = Normalize(normalizedLightDirection);
+	float pixelAngle = Saturate(Dot(normalizedLightPosDir, normalizeLightDir));
+
+	float cosOfOuterRange = std::cos(light.spotOuterAngle);
+	float cosOfInnerrange = std::cos(light.spotInnerAngle);
+	float fallOfRange = cosOfOuterRange - cosOfInnerrange;
+	float linearSpotLightFalloff = Saturate((cosOfOuterRange - pixelAngle) / fallOfRange);
+
+	XMFLOAT3 pointLight = CookPointLight(
+		light,
+		inputNormal,
+		inputPixelWorldPosition,
+		cameraPosition,
+		roughness,
+		surfaceColor,
+		specularColor,
+		metalness);
+	return Scale(pointLight, linearSpotLightFalloff);
+}
+
+XMFLOAT3 CookTorrance::ShadePixel(
+	const GBuffer& gbuffer,
+	size_t pixel,
+	const Lights* lights,
+	size_t lightCount,
+	const XMFLOAT3& cameraPosition)
+{
+	XMFLOAT3 worldPosition(gbuffer.positionX[pixel], gbuffer.positionY[pixel], gbuffer.positionZ[pixel]);
+	XMFLOAT3 normal(gbuffer.normalX[pixel], gbuffer.normalY[pixel], gbuffer.normalZ[pixel]);
+	XMFLOAT3 surfaceColor(gbuffer.albedoR[pixel], gbuffer.albedoG[pixel], gbuffer.albedoB[pixel]);
+	float roughness = gbuffer.roughness[pixel];
+	float metalness = gbuffer.metalness[pixel];
+
+	// lerp(0.04f, surfaceColor.rgb, metalness)
+	XMFLOAT3 specularColor(
+		0.04f + (surfaceColor.x - 0.04f) * metalness,
+		0.04f + (surfaceColor.y - 0.04f) * metalness,
+		0.04f + (surfaceColor.z - 0.04f) * metalness);
+
+	XMFLOAT3 totalLight(0.0f, 0.0f, 0.0f);
+	for (size_t i = 0; i < lightCount; i++)
+	{
+		const Lights& light = lights[i];
+		switch (light.type)
+		{
+		case LIGHT_TYPE_DIRECTIONAL:
+		{
+			XMFLOAT3 result = CookDirectionalLight(light, normal, Normalize(Scale(light.direction, -1.0f)),
+				worldPosition, cameraPosition, roughness, surfaceColor, specularColor, metalness);
+			if (i == 0)
+				result = Scale(result, gbuffer.shadow[pixel]);
+			totalLight = Add(totalLight, result);
+			break;
+		}
+
+		case LIGHT_TYPE_POINT:
+			totalLight = Add(totalLight, Scale(
+				CookPointLight(light, normal, worldPosition, cameraPosition, roughness, surfaceColor, specularColor, metalness),
+				Attenuate(light, worldPosition)));
+			break;
+
+		case LIGHT_TYPE_SPOT:
+			totalLight = Add(totalLight, Scale(
+				CookSpotLight(light, normal, Normalize(Scale(light.direction, -1.0f)),
+					worldPosition, cameraPosition, roughness, surfaceColor, specularColor, metalness),
+				Attenuate(light, worldPosition)));
+			break;
+		}
+	}
+	return totalLight;
+}
+
+void CookTorrance::ShadePixels(
+	const GBuffer& gbuffer,
+	size_t first,
+	size_t count,
+	const Lights* lights,
+	size_t lightCount,
+	const XMFLOAT3& cameraPosition,
+	XMFLOAT3* colors)
+{
+	Vector3x4 camera = Replicate(cameraPosition);
+	size_t end = first + count;
+	size_t pixel = first;
+
+	for (; pixel + 8 <= end; pixel += 8)
+	{
+		PixelLanes halves[2];
+		LoadPixels(gbuffer, pixel, camera, halves[0]);
+		LoadPixels(gbuffer, pixel + 4, camera, halves[1]);
+
+		for (size_t i = 0; i < lightCount; i++)
+		{
+			// Each light's setup is shared by both halves.
+			const Lights& light = lights[i];
+			LightLanes lightLanes = {};
+			lightLanes.type = light.type;
+			lightLanes.shadowed = (i == 0 && light.type == LIGHT_TYPE_DIRECTIONAL);
+			lightLanes.position = Replicate(light.position);
+			lightLanes.color = Replicate(Scale(light.color, light.intensity));
+			if (light.type != LIGHT_TYPE_POINT)
+				lightLanes.direction = Replicate(Normalize(Scale(light.direction, -1.0f)));
+			lightLanes.rangeSquared = XMVectorReplicate(light.range * light.range);
+			float cosOuter = std::cos(light.spotOuterAngle);
+			lightLanes.cosOuter = XMVectorReplicate(cosOuter);
+			lightLanes.falloffRange = XMVectorReplicate(cosOuter - std::cos(light.spotInnerAngle));
+
+			ShadeLight(lightLanes, halves[0]);
+			ShadeLight(lightLanes, halves[1]);
+		}
+
+		for (int half = 0; half < 2; half++)
+		{
+			XMFLOAT4A r, g, b;
+			XMStoreFloat4A(&r, halves[half].total.x);
+			XMStoreFloat4A(&g, halves[half].total.y);
+			XMStoreFloat4A(&b, halves[half].total.z);
+			XMFLOAT3* out = colors + pixel + half * 4;
+			out[0] = XMFLOAT3(r.x, g.x, b.x);
+			out[1] = XMFLOAT3(r.y, g.y, b.y);
+			out[2] = XMFLOAT3(r.z, g.z, b.z);
+			out[3] = XMFLOAT3(r.w, g.w, b.w);
+		}
+	}
+
+	for (; pixel < end; pixel++)
+		colors[pixel] = ShadePixel(gbuffer, pixel, lights, lightCount, cameraPosition);
+}
+
+XMFLOAT3 CookTorrance::GammaCorrect(const XMFLOAT3& color)
+{
+	return XMFLOAT3(
+		std::pow(color.x, 1.0f / 2.2f),
+		std::pow(color.y, 1.0f / 2.2f),
+		std::pow(color.z, 1.0f / 2.2f));
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "Lights.h"
+
+// --------------------------------------------------------
+// Pixels ready to light, one array per value so
+// CookTorrance::ShadePixels can read four at a time.
+//
+// - What PixelShader.hlsl has once it has sampled its
+//   textures: the world position, the final (unit length,
+//   normal mapped) normal, the linear albedo (already
+//   gamma corrected and tinted), roughness, metalness and
+//   the shadow map's amount for the first light
+// --------------------------------------------------------
+struct GBuffer
+{
+	size_t width;
+	size_t height;
+
+	std::vector<float> positionX;
+	std::vector<float> positionY;
+	std::vector<float> positionZ;
+	std::vector<float> normalX;
+	std::vector<float> normalY;
+	std::vector<float> normalZ;
+	std::vector<float> albedoR;
+	std::vector<float> albedoG;
+	std::vector<float> albedoB;
+	std::vector<float> roughness;
+	std::vector<float> metalness;
+	std::vector<float> shadow;
+
+	GBuffer() : width(0), height(0) {}
+
+	void Resize(size_t newWidth, size_t newHeight)
+	{
+		width = newWidth;
+		height = newHeight;
+		size_t count = width * height;
+		for (std::vector<float>* values : { &positionX, &positionY, &positionZ, &normalX, &normalY, &normalZ,
+			&albedoR, &albedoG, &albedoB, &roughness, &metalness, &shadow })
+			values->assign(count, 0.0f);
+	}
+};
+
+// --------------------------------------------------------
+// C++ port of the Cook-Torrance lighting in
+// ShaderIncludeFile.hlsli, so shading changes can be
+// checked and measured off Windows.
+//
+// - The scalar functions follow the HLSL one for one, odd
+//   parts included (the light vector the point lights pass
+//   to the specular term, the double normalize of the half
+//   vector), so a change to one side must be made to both
+// - ShadePixels lights the same pixels eight at a time, as
+//   two four-wide vectors sharing each light's setup
+// --------------------------------------------------------
+namespace CookTorrance
+{
+	constexpr float PI = 3.14159265359f;
+	constexpr float MIN_ROUGHNESS = 0.0000001f;
+
+	// Light falloff over a point or spot light's range.
+	float Attenuate(const Lights& light, const DirectX::XMFLOAT3& worldPosition);
+
+	// Share of microfacets facing the half vector.
+	float D_GGX(const DirectX::XMFLOAT3& n, const DirectX::XMFLOAT3& h, float roughness);
+
+	// Geometric shadowing for one direction, with the 1 / (n.v) of the BRDF's
+	// denominator folded in.
+	float G_SchlickGGX(const DirectX::XMFLOAT3& n, const DirectX::XMFLOAT3& v, float roughness);
+
+	DirectX::XMFLOAT3 F_Schlick(const DirectX::XMFLOAT3& v, const DirectX::XMFLOAT3& h, const DirectX::XMFLOAT3& f0);
+
+	// Lambert diffuse (the HLSL returns it in all three channels).
+	float DiffusePBR(const DirectX::XMFLOAT3& inputNormal, const DirectX::XMFLOAT3& normalizedLightDirection);
+
+	DirectX::XMFLOAT3 MicrofacetBRDF(
+		const DirectX::XMFLOAT3& n,
+		const DirectX::XMFLOAT3& l,
+		const DirectX::XMFLOAT3& v,
+		float roughness,
+		const DirectX::XMFLOAT3& f0);
+
+	DirectX::XMFLOAT3 CookDirectionalLight(
+		const Lights& light,
+		const DirectX::XMFLOAT3& inputNormal,
+		const DirectX::XMFLOAT3& normalizedLightDirection,
+		const DirectX::XMFLOAT3& inputPixelWorldPosition,
+		const DirectX::XMFLOAT3& cameraPosition,
+		float roughness,
+		const DirectX::XMFLOAT3& surfaceColor,
+		const DirectX::XMFLOAT3& specularColor,
+		float metalness);
+
+	DirectX::XMFLOAT3 CookPointLight(
+		const Lights& light,
+		const DirectX::XMFLOAT3& inputNormal,
+		const DirectX::XMFLOAT3& inputPixelWorldPosition,
+		const DirectX::XMFLOAT3& cameraPosition,
+		float roughness,
+		const DirectX::XMFLOAT3& surfaceColor,
+		const DirectX::XMFLOAT3& specularColor,
+		float metalness);
+
+	DirectX::XMFLOAT3 CookSpotLight(
+		const Lights& light,
+		const DirectX::XMFLOAT3& inputNormal,
+		const DirectX::XMFLOAT3& normalizedLightDirection,
+		const DirectX::XMFLOAT3& inputPixelWorldPosition,
+		const DirectX::XMFLOAT3& cameraPosition,
+		float roughness,
+		const DirectX::XMFLOAT3& surfaceColor,
+		const DirectX::XMFLOAT3& specularColor,
+		float metalness);
+
+	// Light one G-buffer pixel with every light, as PixelShader.hlsl's light
+	// loop does, and return the linear color (before gamma).
+	// - The shadow amount darkens the first light, as the shader's does
+	DirectX::XMFLOAT3 ShadePixel(
+		const GBuffer& gbuffer,
+		size_t pixel,
+		const Lights* lights,
+		size_t lightCount,
+		const DirectX::XMFLOAT3& cameraPosition);
+
+	// Light "count" pixels from "first" on, writing linear colors to colors[pixel].
+	// - Eight pixels at a time; any last few go through ShadePixel
+	void ShadePixels(
+		const GBuffer& gbuffer,
+		size_t first,
+		size_t count,
+		const Lights* lights,
+		size_t lightCount,
+		const DirectX::XMFLOAT3& cameraPosition,
+		DirectX::XMFLOAT3* colors);
+
+	// Gamma encode a linear color as the pixel shader's output does.
+	DirectX::XMFLOAT3 GammaCorrect(const DirectX::XMFLOAT3& color);
+}
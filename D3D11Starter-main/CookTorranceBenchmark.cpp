@@ -0,0 +1,461 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "CookTorrance.h"
+#include "Parallel.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless Cook-Torrance shading benchmark and regression
+// test
+//
+// - Ray casts a G-buffer of a floor and two rows of spheres
+//   (roughness rising across, dielectric then metal) and
+//   lights it with the Game's five default lights plus a
+//   near point light
+// - Checks the port's terms against hand worked values
+//   (G_SchlickGGX's folded form, D_GGX, F_Schlick,
+//   Attenuate), the spot light falloff's direction, and
+//   that ShadePixels matches ShadePixel on every pixel
+// - Compares a small render against the golden image
+//   (Assets/Golden/CookTorrance.ppm, or the path given);
+//   "--update" rewrites it after an intended change
+// - Times ShadePixel, ShadePixels and ShadePixels on every
+//   thread; returns 1 if any check fails
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers
+// only accessible in this file
+namespace
+{
+	const size_t GOLDEN_WIDTH = 64;
+	const size_t GOLDEN_HEIGHT = 36;
+
+	// 8 bit levels a golden pixel may be off by, for other compilers and math libraries.
+	const int GOLDEN_TOLERANCE = 2;
+
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	XMFLOAT3 Normalize(const XMFLOAT3& v)
+	{
+		float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+		return XMFLOAT3(v.x / length, v.y / length, v.z / length);
+	}
+
+	bool Near(float value, float expected, float tolerance)
+	{
+		return std::fabs(value - expected) <= tolerance * (1.0f + std::fabs(expected));
+	}
+
+	bool Near(const XMFLOAT3& value, const XMFLOAT3& expected, float tolerance)
+	{
+		return Near(value.x, expected.x, tolerance) && Near(value.y, expected.y, tolerance) && Near(value.z, expected.z, tolerance);
+	}
+
+	const XMFLOAT3 CAMERA_POSITION(0.0f, 7.0f, -10.0f);
+
+	// The Game's five default lights (see Game::Initialize), and a point light near the spheres.
+	std::vector<Lights> MakeLights()
+	{
+		std::vector<Lights> lights(6);
+		for (Lights& light : lights)
+			light = {};
+
+		lights[0].type = LIGHT_TYPE_DIRECTIONAL;
+		lights[0].direction = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		lights[1].type = LIGHT_TYPE_DIRECTIONAL;
+		lights[1].direction = XMFLOAT3(-2.0f, 0.0f, 0.0f);
+		lights[2].type = LIGHT_TYPE_DIRECTIONAL;
+		lights[2].direction = XMFLOAT3(10.0f, -3.0f, -6.0f);
+		for (int i = 0; i < 3; i++)
+		{
+			lights[i].color = XMFLOAT3(0.8f, 0.8f, 0.8f);
+			lights[i].intensity = 1.0f;
+		}
+
+		lights[3].type = LIGHT_TYPE_POINT;
+		lights[3].position = XMFLOAT3(0.0f, 10.0f, 0.0f);
+		lights[3].range = 10.0f;
+		lights[3].direction = XMFLOAT3(4.0f, 4.0f, 0.0f);
+		lights[3].color = XMFLOAT3(0.0f, 0.0f, 1.0f);
+		lights[3].intensity = 4.0f;
+
+		lights[4].type = LIGHT_TYPE_SPOT;
+		lights[4].position = XMFLOAT3(0.0f, 5.0f, 0.0f);
+		lights[4].range = 10.0f;
+		lights[4].spotInnerAngle = XMConvertToRadians(30.0f);
+		lights[4].spotOuterAngle = XMConvertToRadians(60.0f);
+		lights[4].direction = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		lights[4].color = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		lights[4].intensity = 5.0f;
+
+		lights[5].type = LIGHT_TYPE_POINT;
+		lights[5].position = XMFLOAT3(3.0f, 2.5f, -2.5f);
+		lights[5].range = 6.0f;
+		lights[5].color = XMFLOAT3(1.0f, 0.9f, 0.6f);
+		lights[5].intensity = 3.0f;
+		return lights;
+	}
+
+	// Ray cast the test scene into a G-buffer.
+	// - A floor at y = 0 (its left half in shadow) and two rows of four spheres,
+	//   roughness rising left to right, dielectric in front and metal behind
+	void BuildScene(size_t width, size_t height, GBuffer& gbuffer)
+	{
+		gbuffer.Resize(width, height);
+
+		// Look at the spheres from above and in front, with a 50 degree vertical field of view.
+		XMFLOAT3 forward = Normalize(XMFLOAT3(0.0f, 0.5f - CAMERA_POSITION.y, 1.0f - CAMERA_POSITION.z));
+		XMFLOAT3 right = Normalize(XMFLOAT3(forward.z, 0.0f, -forward.x));
+		XMFLOAT3 up(
+			forward.y * right.z - forward.z * right.y,
+			forward.z * right.x - forward.x * right.z,
+			forward.x * right.y - forward.y * right.x);
+		float tanHalfFov = std::tan(XMConvertToRadians(25.0f));
+		float aspect = (float)width / height;
+
+		const float sphereRadius = 0.9f;
+		const XMFLOAT3 sphereColors[4] = {
+			XMFLOAT3(0.8f, 0.1f, 0.1f), XMFLOAT3(0.1f, 0.7f, 0.2f), XMFLOAT3(0.2f, 0.3f, 0.9f), XMFLOAT3(0.9f, 0.8f, 0.3f) };
+
+		for (size_t y = 0; y < height; y++)
+		{
+			for (size_t x = 0; x < width; x++)
+			{
+				float u = ((x + 0.5f) / width * 2.0f - 1.0f) * tanHalfFov * aspect;
+				float v = (1.0f - (y + 0.5f) / height * 2.0f) * tanHalfFov;
+				XMFLOAT3 ray = Normalize(XMFLOAT3(
+					forward.x + right.x * u + up.x * v,
+					forward.y + right.y * u + up.y * v,
+					forward.z + right.z * u + up.z * v));
+
+				// The floor, which every ray below the horizon reaches.
+				float nearest = -CAMERA_POSITION.y / ray.y;
+				XMFLOAT3 normal(0.0f, 1.0f, 0.0f);
+				XMFLOAT3 albedo(0.5f, 0.5f, 0.5f);
+				float roughness = 0.6f;
+				float metalness = 0.0f;
+
+				for (int row = 0; row < 2; row++)
+				{
+					for (int column = 0; column < 4; column++)
+					{
+						XMFLOAT3 center(-3.3f + column * 2.2f, sphereRadius, row * 2.4f);
+						XMFLOAT3 offset(CAMERA_POSITION.x - center.x, CAMERA_POSITION.y - center.y, CAMERA_POSITION.z - center.z);
+						float b = offset.x * ray.x + offset.y * ray.y + offset.z * ray.z;
+						float c = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z - sphereRadius * sphereRadius;
+						float discriminant = b * b - c;
+						if (discriminant < 0.0f)
+							continue;
+
+						float t = -b - std::sqrt(discriminant);
+						if (t <= 0.0f || t >= nearest)
+							continue;
+
+						nearest = t;
+						normal = Normalize(XMFLOAT3(
+							CAMERA_POSITION.x + ray.x * t - center.x,
+							CAMERA_POSITION.y + ray.y * t - center.y,
+							CAMERA_POSITION.z + ray.z * t - center.z));
+						albedo = sphereColors[column];
+						roughness = 0.1f + column * 0.3f;
+						metalness = (float)row;
+					}
+				}
+
+				size_t pixel = y * width + x;
+				gbuffer.positionX[pixel] = CAMERA_POSITION.x + ray.x * nearest;
+				gbuffer.positionY[pixel] = CAMERA_POSITION.y + ray.y * nearest;
+				gbuffer.positionZ[pixel] = CAMERA_POSITION.z + ray.z * nearest;
+				gbuffer.normalX[pixel] = normal.x;
+				gbuffer.normalY[pixel] = normal.y;
+				gbuffer.normalZ[pixel] = normal.z;
+				gbuffer.albedoR[pixel] = albedo.x;
+				gbuffer.albedoG[pixel] = albedo.y;
+				gbuffer.albedoB[pixel] = albedo.z;
+				gbuffer.roughness[pixel] = roughness;
+				gbuffer.metalness[pixel] = metalness;
+				gbuffer.shadow[pixel] = (gbuffer.positionX[pixel] < 0.0f && normal.y == 1.0f) ? 0.3f : 1.0f;
+			}
+		}
+	}
+
+	// Gamma corrected 8 bit RGB, as the back buffer would hold it.
+	std::vector<unsigned char> ToBytes(const std::vector<XMFLOAT3>& colors)
+	{
+		std::vector<unsigned char> bytes(colors.size() * 3);
+		for (size_t i = 0; i < colors.size(); i++)
+		{
+			XMFLOAT3 color = CookTorrance::GammaCorrect(colors[i]);
+			float channels[3] = { color.x, color.y, color.z };
+			for (int c = 0; c < 3; c++)
+			{
+				float value = channels[c] < 0.0f ? 0.0f : (channels[c] > 1.0f ? 1.0f : channels[c]);
+				bytes[i * 3 + c] = (unsigned char)(value * 255.0f + 0.5f);
+			}
+		}
+		return bytes;
+	}
+
+	bool WritePPM(const std::string& path, size_t width, size_t height, const std::vector<unsigned char>& bytes)
+	{
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+		file << "P6\n" << width << " " << height << "\n255\n";
+		file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		return (bool)file;
+	}
+
+	bool ReadPPM(const std::string& path, size_t& width, size_t& height, std::vector<unsigned char>& bytes)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::string magic;
+		int maxValue = 0;
+		if (!(file >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255)
+			return false;
+		file.get();
+		bytes.resize(width * height * 3);
+		file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+		return (bool)file;
+	}
+
+	// The port's terms against values worked out by hand; returns the number of failed checks.
+	int CheckTerms()
+	{
+		int failures = 0;
+		const XMFLOAT3 n(0.0f, 1.0f, 0.0f);
+
+		// Rough 0.5, n.v 0.5: k = 1.5^2 / 8 = 0.28125, G = 1 / (0.5 * 0.71875 + 0.28125).
+		XMFLOAT3 v = Normalize(XMFLOAT3(std::sqrt(3.0f), 1.0f, 0.0f));
+		if (!Near(CookTorrance::G_SchlickGGX(n, v, 0.5f), 1.0f / 0.640625f, 1e-5f) ||
+			!Near(CookTorrance::G_SchlickGGX(n, n, 0.5f), 1.0f, 1e-5f))
+		{
+			std::printf("FAIL: G_SchlickGGX differs from 1 / (n.v (1 - k) + k), k = (roughness + 1)^2 / 8\n");
+			failures++;
+		}
+
+		// Rough 0.5, n.h 1: a2 = 0.0625, D = a2 / (PI a2^2) = 1 / (PI 0.0625).
+		if (!Near(CookTorrance::D_GGX(n, n, 0.5f), 1.0f / (CookTorrance::PI * 0.0625f), 1e-5f))
+		{
+			std::printf("FAIL: D_GGX differs from the GGX distribution\n");
+			failures++;
+		}
+
+		// Head on, Fresnel is f0; at a grazing angle, it is 1.
+		XMFLOAT3 f0(0.04f, 0.5f, 0.9f);
+		if (!Near(CookTorrance::F_Schlick(n, n, f0), f0, 1e-6f) ||
+			!Near(CookTorrance::F_Schlick(n, XMFLOAT3(1.0f, 0.0f, 0.0f), f0), XMFLOAT3(1.0f, 1.0f, 1.0f), 1e-6f))
+		{
+			std::printf("FAIL: F_Schlick differs from Schlick's approximation\n");
+			failures++;
+		}
+
+		// Half way out: (1 - 0.25)^2.
+		Lights light = {};
+		light.type = LIGHT_TYPE_POINT;
+		light.range = 4.0f;
+		if (!Near(CookTorrance::Attenuate(light, XMFLOAT3(0.0f, 2.0f, 0.0f)), 0.5625f, 1e-6f) ||
+			CookTorrance::Attenuate(light, XMFLOAT3(0.0f, 4.5f, 0.0f)) != 0.0f)
+		{
+			std::printf("FAIL: Attenuate differs from saturate(1 - d^2 / range^2)^2\n");
+			failures++;
+		}
+
+		// A spot light shining down (its cone opens along -direction) lights a point on
+		// its axis fully, one on the cone's edge not at all, and one at the falloff's
+		// middle angle half.
+		Lights spot = {};
+		spot.type = LIGHT_TYPE_SPOT;
+		spot.position = XMFLOAT3(0.0f, 4.0f, 0.0f);
+		spot.range = 10.0f;
+		spot.direction = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		spot.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		spot.intensity = 1.0f;
+		spot.spotInnerAngle = XMConvertToRadians(20.0f);
+		spot.spotOuterAngle = XMConvertToRadians(40.0f);
+		XMFLOAT3 axis = Normalize(XMFLOAT3(-spot.direction.x, -spot.direction.y, -spot.direction.z));
+		XMFLOAT3 camera(0.0f, 3.0f, -3.0f);
+		XMFLOAT3 albedo(0.5f, 0.5f, 0.5f);
+		XMFLOAT3 specularColor(0.04f, 0.04f, 0.04f);
+
+		float middleCos = (std::cos(spot.spotInnerAngle) + std::cos(spot.spotOuterAngle)) * 0.5f;
+		float angles[3] = { 0.0f, std::acos(middleCos), spot.spotOuterAngle + 0.01f };
+		float expected[3] = { 1.0f, 0.5f, 0.0f };
+		bool spotOk = true;
+		for (int i = 0; i < 3; i++)
+		{
+			// A point on the floor at that angle from the axis.
+			XMFLOAT3 position(std::tan(angles[i]) * spot.position.y, 0.0f, 0.0f);
+			XMFLOAT3 spotResult = CookTorrance::CookSpotLight(spot, n, axis, position, camera, 0.5f, albedo, specularColor, 0.0f);
+			XMFLOAT3 pointResult = CookTorrance::CookPointLight(spot, n, position, camera, 0.5f, albedo, specularColor, 0.0f);
+			XMFLOAT3 scaled(pointResult.x * expected[i], pointResult.y * expected[i], pointResult.z * expected[i]);
+			spotOk = spotOk && pointResult.x > 0.0f && Near(spotResult, scaled, 1e-3f);
+		}
+		if (!spotOk)
+		{
+			std::printf("FAIL: spot light falloff is not 1 on its axis, 0.5 half way and 0 past its outer angle\n");
+			failures++;
+		}
+		return failures;
+	}
+
+	// Largest difference between the two shading paths, relative to the color.
+	float CompareShading(const GBuffer& gbuffer, const std::vector<Lights>& lights, const std::vector<XMFLOAT3>& colors)
+	{
+		float worst = 0.0f;
+		for (size_t pixel = 0; pixel < colors.size(); pixel++)
+		{
+			XMFLOAT3 expected = CookTorrance::ShadePixel(gbuffer, pixel, lights.data(), lights.size(), CAMERA_POSITION);
+			float pairs[3][2] = { { colors[pixel].x, expected.x }, { colors[pixel].y, expected.y }, { colors[pixel].z, expected.z } };
+			for (const float* pair : pairs)
+			{
+				float difference = std::fabs(pair[0] - pair[1]) / (1.0f + std::fabs(pair[1]));
+				if (!(difference <= worst))
+					worst = difference;
+			}
+		}
+		return worst;
+	}
+
+	// Render the golden image's G-buffer and check it (or rewrite it); returns the number of failed checks.
+	int CheckGolden(const std::string& path, bool update)
+	{
+		GBuffer gbuffer;
+		BuildScene(GOLDEN_WIDTH, GOLDEN_HEIGHT, gbuffer);
+		std::vector<Lights> lights = MakeLights();
+		std::vector<XMFLOAT3> colors(GOLDEN_WIDTH * GOLDEN_HEIGHT);
+		for (size_t pixel = 0; pixel < colors.size(); pixel++)
+			colors[pixel] = CookTorrance::ShadePixel(gbuffer, pixel, lights.data(), lights.size(), CAMERA_POSITION);
+		std::vector<unsigned char> bytes = ToBytes(colors);
+
+		if (update)
+		{
+			if (!WritePPM(path, GOLDEN_WIDTH, GOLDEN_HEIGHT, bytes))
+			{
+				std::printf("FAIL: could not write the golden image %s\n", path.c_str());
+				return 1;
+			}
+			std::printf("Wrote the golden image %s\n", path.c_str());
+			return 0;
+		}
+
+		size_t width = 0;
+		size_t height = 0;
+		std::vector<unsigned char> golden;
+		if (!ReadPPM(path, width, height, golden) || width != GOLDEN_WIDTH || height != GOLDEN_HEIGHT)
+		{
+			std::printf("FAIL: could not read a %zu x %zu golden image from %s (run with --update to make one)\n",
+				GOLDEN_WIDTH, GOLDEN_HEIGHT, path.c_str());
+			return 1;
+		}
+
+		size_t differentPixels = 0;
+		int worst = 0;
+		for (size_t pixel = 0; pixel < colors.size(); pixel++)
+		{
+			bool different = false;
+			for (int c = 0; c < 3; c++)
+			{
+				int difference = std::abs((int)bytes[pixel * 3 + c] - (int)golden[pixel * 3 + c]);
+				worst = difference > worst ? difference : worst;
+				different = different || difference > GOLDEN_TOLERANCE;
+			}
+			if (different)
+				differentPixels++;
+		}
+
+		std::printf("Golden image: %zu of %zu pixels off by more than %d levels (worst %d)\n",
+			differentPixels, colors.size(), GOLDEN_TOLERANCE, worst);
+		if (differentPixels > 0)
+		{
+			std::printf("FAIL: shading differs from the golden image %s\n", path.c_str());
+			return 1;
+		}
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string goldenPath = "Assets/Golden/CookTorrance.ppm";
+	bool update = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--update") == 0)
+			update = true;
+		else
+			goldenPath = argv[i];
+	}
+
+	int failures = CheckTerms();
+	failures += CheckGolden(goldenPath, update);
+
+	// Time a 640 x 360 frame with the test lights, and with many more point lights
+	// (as a busy light cluster would hand a pixel).
+	GBuffer gbuffer;
+	BuildScene(640, 360, gbuffer);
+	size_t pixelCount = gbuffer.width * gbuffer.height;
+	std::vector<XMFLOAT3> colors(pixelCount);
+
+	std::vector<Lights> manyLights = MakeLights();
+	for (int i = 0; i < 26; i++)
+	{
+		Lights light = manyLights[5];
+		light.position = XMFLOAT3(-5.0f + (i % 6) * 2.0f, 0.5f + (i % 3), -2.0f + (i / 6) * 1.5f);
+		light.range = 3.0f;
+		manyLights.push_back(light);
+	}
+
+	unsigned int threadCount = Parallel::GetThreadCount();
+	std::printf("%u threads, %zu x %zu pixels\n", threadCount, gbuffer.width, gbuffer.height);
+	std::printf("%8s %12s %12s %12s %10s %12s\n", "Lights", "Scalar ms", "8 wide ms", "Threads ms", "Speedup", "Worst diff");
+	std::vector<Lights> testLights = MakeLights();
+	for (const std::vector<Lights>* lights : { &testLights, &manyLights })
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t pixel = 0; pixel < pixelCount; pixel++)
+			colors[pixel] = CookTorrance::ShadePixel(gbuffer, pixel, lights->data(), lights->size(), CAMERA_POSITION);
+		float scalarTime = MillisecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		CookTorrance::ShadePixels(gbuffer, 0, pixelCount, lights->data(), lights->size(), CAMERA_POSITION, colors.data());
+		float simdTime = MillisecondsSince(start);
+
+		// Whole rows of eight pixels per job, so only the image's end takes the scalar path.
+		start = std::chrono::high_resolution_clock::now();
+		size_t blockCount = (pixelCount + 7) / 8;
+		Parallel::ForRanges(blockCount, Parallel::GetJobCount(blockCount, 1024, threadCount),
+			[&](size_t begin, size_t end, size_t)
+			{
+				size_t first = begin * 8;
+				size_t last = end * 8 < pixelCount ? end * 8 : pixelCount;
+				CookTorrance::ShadePixels(gbuffer, first, last - first, lights->data(), lights->size(), CAMERA_POSITION, colors.data());
+			});
+		float threadedTime = MillisecondsSince(start);
+
+		// D_GGX's 1 - (n.h)^2 (1 - a2) cancels in a smooth surface's highlight, so one
+		// rounding step there moves the result by about 1 / a2 of it.
+		float worst = CompareShading(gbuffer, *lights, colors);
+		std::printf("%8zu %12.3f %12.3f %12.3f %9.2fx %12.2e\n",
+			lights->size(), scalarTime, simdTime, threadedTime,
+			threadedTime > 0.0f ? scalarTime / threadedTime : 0.0f, worst);
+		if (!(worst <= 1e-2f))
+		{
+			std::printf("FAIL: ShadePixels differs from ShadePixel by %g\n", worst);
+			failures++;
+		}
+	}
+
+	return failures > 0 ? 1 : 0;
+}
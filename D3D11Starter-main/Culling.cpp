@@ -0,0 +1,192 @@
+#include "Culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+Frustum Culling::ExtractFrustum(const XMFLOAT4X4& m)
+{
+	// Clip space is v * M, so each plane is a sum of the matrix columns.
+	Frustum frustum = {};
+	frustum.planes[0] = XMFLOAT4(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41); // Left
+	frustum.planes[1] = XMFLOAT4(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41); // Right
+	frustum.planes[2] = XMFLOAT4(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42); // Bottom
+	frustum.planes[3] = XMFLOAT4(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42); // Top
+	frustum.planes[4] = XMFLOAT4(m._13, m._23, m._33, m._43);                                 // Near
+	frustum.planes[5] = XMFLOAT4(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43); // Far
+
+	// Normalize so plane distances are real distances.
+	for (XMFLOAT4& plane : frustum.planes)
+	{
+		float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.0f)
+		{
+			float scale = 1.0f / length;
+			plane = XMFLOAT4(plane.x * scale, plane.y * scale, plane.z * scale, plane.w * scale);
+		}
+	}
+
+	return frustum;
+}
+
+bool Culling::SphereInFrustum(const Frustum& frustum, const XMFLOAT3& center, float radius)
+{
+	for (const XMFLOAT4& plane : frustum.planes)
+	{
+		if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+bool Culling::BoxInFrustum(const Frustum& frustum, const AxisAlignedBox& box)
+{
+	// Test the corner furthest along each plane's normal.
+	for (const XMFLOAT4& plane : frustum.planes)
+	{
+		float x = plane.x >= 0.0f ? box.max.x : box.min.x;
+		float y = plane.y >= 0.0f ? box.max.y : box.min.y;
+		float z = plane.z >= 0.0f ? box.max.z : box.min.z;
+		if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+void Culling::SphereAroundBox(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, XMFLOAT3& center, float& radius)
+{
+	center = XMFLOAT3((boxMin.x + boxMax.x) * 0.5f, (boxMin.y + boxMax.y) * 0.5f, (boxMin.z + boxMax.z) * 0.5f);
+	XMFLOAT3 half((boxMax.x - boxMin.x) * 0.5f, (boxMax.y - boxMin.y) * 0.5f, (boxMax.z - boxMin.z) * 0.5f);
+	radius = std::sqrt(half.x * half.x + half.y * half.y + half.z * half.z);
+}
+
+void Culling::TransformSphere(const XMFLOAT4X4& m, const XMFLOAT3& center, float radius, XMFLOAT3& worldCenter, float& worldRadius)
+{
+	// Row vector convention: the center is (x, y, z, 1) * M.
+	worldCenter = XMFLOAT3(
+		center.x * m._11 + center.y * m._21 + center.z * m._31 + m._41,
+		center.x * m._12 + center.y * m._22 + center.z * m._32 + m._42,
+		center.x * m._13 + center.y * m._23 + center.z * m._33 + m._43);
+
+	// The rows are the scaled local axes.
+	float scaleX = m._11 * m._11 + m._12 * m._12 + m._13 * m._13;
+	float scaleY = m._21 * m._21 + m._22 * m._22 + m._23 * m._23;
+	float scaleZ = m._31 * m._31 + m._32 * m._32 + m._33 * m._33;
+	worldRadius = radius * std::sqrt(std::max(scaleX, std::max(scaleY, scaleZ)));
+}
+
+void Culling::TransformBox(const XMFLOAT4X4& m, const AxisAlignedBox& box, AxisAlignedBox& worldBox)
+{
+	// Start from the translation and add the smaller and larger product of
+	// each matrix element with the box's extent on that axis (Arvo).
+	const float* boxMin = &box.min.x;
+	const float* boxMax = &box.max.x;
+	float newMin[3] = { m._41, m._42, m._43 };
+	float newMax[3] = { m._41, m._42, m._43 };
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 3; column++)
+		{
+			float a = m.m[row][column] * boxMin[row];
+			float b = m.m[row][column] * boxMax[row];
+			newMin[column] += std::min(a, b);
+			newMax[column] += std::max(a, b);
+		}
+	}
+	worldBox.min = XMFLOAT3(newMin[0], newMin[1], newMin[2]);
+	worldBox.max = XMFLOAT3(newMax[0], newMax[1], newMax[2]);
+}
+
+size_t Culling::CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, unsigned char* visible)
+{
+	size_t count = spheres.radius.size();
+	const float* centerX = spheres.centerX.data();
+	const float* centerY = spheres.centerY.data();
+	const float* centerZ = spheres.centerZ.data();
+	const float* radius = spheres.radius.data();
+
+	// Each plane component splatted across a register.
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = XMVectorReplicate(frustum.planes[p].x);
+		planeY[p] = XMVectorReplicate(frustum.planes[p].y);
+		planeZ[p] = XMVectorReplicate(frustum.planes[p].z);
+		planeW[p] = XMVectorReplicate(frustum.planes[p].w);
+	}
+
+	// Smallest signed distance plus radius over all planes, for four spheres;
+	// a sphere is outside when it is below zero.
+	auto Margins = [&](const float* x4, const float* y4, const float* z4, const float* r4)
+	{
+		XMVECTOR x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(x4));
+		XMVECTOR y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(y4));
+		XMVECTOR z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(z4));
+		XMVECTOR r = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(r4));
+
+		XMVECTOR margin = XMVectorZero();
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = XMVectorMultiplyAdd(x, planeX[p], planeW[p]);
+			distance = XMVectorMultiplyAdd(y, planeY[p], distance);
+			distance = XMVectorMultiplyAdd(z, planeZ[p], distance);
+			distance = XMVectorAdd(distance, r);
+			margin = (p == 0) ? distance : XMVectorMin(margin, distance);
+		}
+		return margin;
+	};
+
+	size_t visibleCount = 0;
+	XMFLOAT4A margins[2];
+	for (size_t i = 0; i < count; i += 8)
+	{
+		// Pad the last group by repeating its final sphere.
+		const float* x = centerX + i;
+		const float* y = centerY + i;
+		const float* z = centerZ + i;
+		const float* r = radius + i;
+		size_t groupCount = std::min<size_t>(8, count - i);
+		float padded[4][8];
+		if (groupCount < 8)
+		{
+			for (size_t k = 0; k < 8; k++)
+			{
+				size_t source = std::min(k, groupCount - 1);
+				padded[0][k] = x[source];
+				padded[1][k] = y[source];
+				padded[2][k] = z[source];
+				padded[3][k] = r[source];
+			}
+			x = padded[0];
+			y = padded[1];
+			z = padded[2];
+			r = padded[3];
+		}
+
+		XMStoreFloat4A(&margins[0], Margins(x, y, z, r));
+		XMStoreFloat4A(&margins[1], Margins(x + 4, y + 4, z + 4, r + 4));
+		const float lanes[8] =
+		{
+			margins[0].x, margins[0].y, margins[0].z, margins[0].w,
+			margins[1].x, margins[1].y, margins[1].z, margins[1].w,
+		};
+		for (size_t k = 0; k < groupCount; k++)
+		{
+			visible[i + k] = lanes[k] >= 0.0f ? 1 : 0;
+			visibleCount += visible[i + k];
+		}
+	}
+
+	return visibleCount;
+}
+
+bool Culling::IsConeBackfacing(const XMFLOAT3& apex, const XMFLOAT3& axis, float cutoff, const XMFLOAT3& cameraPosition)
+{
+	// The cone is back facing when the view direction from the camera to the
+	// apex is within the cone's complementary angle of the axis.
+	XMFLOAT3 view(apex.x - cameraPosition.x, apex.y - cameraPosition.y, apex.z - cameraPosition.z);
+	float viewDot = view.x * axis.x + view.y * axis.y + view.z * axis.z;
+	float viewLength = std::sqrt(view.x * view.x + view.y * view.y + view.z * view.z);
+	return cutoff < 1.0f && viewDot >= cutoff * viewLength;
+}
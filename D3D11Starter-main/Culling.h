@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Six planes bounding a view volume.
+//
+// - Each plane is (a, b, c, d) with a normalized (a, b, c)
+//   pointing inwards, so ax + by + cz + d >= 0 is inside
+// - Planes are in whatever space the matrix they were
+//   extracted from maps out of (world * view * projection
+//   gives planes in the mesh's local space)
+// --------------------------------------------------------
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[6];
+};
+
+// --------------------------------------------------------
+// An axis aligned box, given by its smallest and largest
+// corners.
+// --------------------------------------------------------
+struct AxisAlignedBox
+{
+	DirectX::XMFLOAT3 min;
+	DirectX::XMFLOAT3 max;
+};
+
+// --------------------------------------------------------
+// Bounding spheres of a set of objects, one array per
+// component so CullSpheres can test four at a time.
+// --------------------------------------------------------
+struct BoundingSpheres
+{
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+
+	void Resize(size_t count)
+	{
+		centerX.resize(count);
+		centerY.resize(count);
+		centerZ.resize(count);
+		radius.resize(count);
+	}
+};
+
+// --------------------------------------------------------
+// Platform-neutral visibility tests shared by the culling
+// passes.
+// --------------------------------------------------------
+namespace Culling
+{
+	// Extract the planes of a (row vector) view-projection matrix, using
+	// Direct3D's [0, 1] clip space depth (Gribb-Hartmann).
+	Frustum ExtractFrustum(const DirectX::XMFLOAT4X4& matrix);
+
+	// Check whether a sphere is at least partly inside the frustum.
+	bool SphereInFrustum(const Frustum& frustum, const DirectX::XMFLOAT3& center, float radius);
+
+	// Check whether an axis aligned box is at least partly inside the frustum.
+	// - Conservative: a box just outside a frustum corner can pass
+	bool BoxInFrustum(const Frustum& frustum, const AxisAlignedBox& box);
+
+	// Bounding sphere of an axis aligned box (its center and half diagonal).
+	void SphereAroundBox(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, DirectX::XMFLOAT3& center, float& radius);
+
+	// Move a local space sphere into world space.
+	// - The radius grows by the largest axis scale, so it stays conservative
+	//   under non-uniform scaling
+	void TransformSphere(const DirectX::XMFLOAT4X4& worldMatrix, const DirectX::XMFLOAT3& center, float radius, DirectX::XMFLOAT3& worldCenter, float& worldRadius);
+
+	// Axis aligned box around a local space box moved into world space.
+	void TransformBox(const DirectX::XMFLOAT4X4& worldMatrix, const AxisAlignedBox& box, AxisAlignedBox& worldBox);
+
+	// Test every sphere against the frustum, writing 1 to "visible" for the
+	// ones at least partly inside and 0 for the rest.
+	// - Eight spheres are tested per loop as two groups of four, one sphere
+	//   per SIMD lane; the result matches SphereInFrustum except for
+	//   rounding when a sphere just touches a plane
+	// - Returns the number of visible spheres
+	size_t CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, unsigned char* visible);
+
+	// Check whether every triangle in a normal cone faces away from the camera.
+	// - "cutoff" is the sine of the cone's spread, or 1 for a cone that can never be culled
+	bool IsConeBackfacing(const DirectX::XMFLOAT3& apex, const DirectX::XMFLOAT3& axis, float cutoff, const DirectX::XMFLOAT3& cameraPosition);
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Culling.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless frustum culling benchmark
+//
+// - Scatters 10k, 100k and 1M bounding spheres through a
+//   random scene and culls them against a perspective
+//   camera frustum and an orthographic light volume, once
+//   with SphereInFrustum per sphere and once with the
+//   eight-at-a-time CullSpheres pass
+// - Checks that both agree on every sphere that is not
+//   within rounding of a plane, and returns 1 if any other
+//   sphere differs
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers
+// only accessible in this file
+namespace
+{
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Smallest distance from a sphere's surface to the inside of any plane.
+	float PlaneMargin(const Frustum& frustum, const XMFLOAT3& center, float radius)
+	{
+		float margin = 1e30f;
+		for (const XMFLOAT4& plane : frustum.planes)
+			margin = std::min(margin, plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w + radius);
+		return margin;
+	}
+
+	// Cull one scene against one volume, print a row and return the number of failed checks.
+	int RunVolume(const char* name, const XMFLOAT4X4& viewProjection, const BoundingSpheres& spheres)
+	{
+		size_t count = spheres.radius.size();
+		Frustum frustum = Culling::ExtractFrustum(viewProjection);
+		std::vector<unsigned char> scalarVisible(count);
+		std::vector<unsigned char> simdVisible(count);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < count; i++)
+		{
+			XMFLOAT3 center(spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]);
+			scalarVisible[i] = Culling::SphereInFrustum(frustum, center, spheres.radius[i]) ? 1 : 0;
+		}
+		float scalarTime = MillisecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		size_t simdCount = Culling::CullSpheres(frustum, spheres, simdVisible.data());
+		float simdTime = MillisecondsSince(start);
+
+		// Spheres touching a plane may go either way.
+		size_t mismatches = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (scalarVisible[i] == simdVisible[i])
+				continue;
+			XMFLOAT3 center(spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]);
+			if (std::fabs(PlaneMargin(frustum, center, spheres.radius[i])) > 1e-3f)
+				mismatches++;
+		}
+
+		std::printf("%10zu %-8s %10zu %10zu %12.3f %12.3f %10zu\n",
+			count, name, simdCount, count - simdCount, scalarTime, simdTime, mismatches);
+
+		if (mismatches > 0)
+		{
+			std::printf("FAIL: %s culling differs from SphereInFrustum\n", name);
+			return 1;
+		}
+		return 0;
+	}
+
+	// Time one scene size and return the number of failed checks.
+	int RunBenchmark(size_t count, std::mt19937& random)
+	{
+		// Objects scattered through a 2km cube around the origin.
+		std::uniform_real_distribution<float> positions(-1000.0f, 1000.0f);
+		std::uniform_real_distribution<float> radii(0.5f, 20.0f);
+		BoundingSpheres spheres;
+		spheres.Resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			spheres.centerX[i] = positions(random);
+			spheres.centerY[i] = positions(random);
+			spheres.centerZ[i] = positions(random);
+			spheres.radius[i] = radii(random);
+		}
+
+		// A camera near the middle of the scene looking down +Z, as Camera builds it.
+		XMFLOAT4X4 cameraViewProjection;
+		XMMATRIX cameraView = XMMatrixLookToLH(XMVectorSet(0, 10, -200, 0), XMVectorSet(0.2f, -0.1f, 1, 0), XMVectorSet(0, 1, 0, 0));
+		XMMATRIX cameraProjection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f);
+		XMStoreFloat4x4(&cameraViewProjection, XMMatrixMultiply(cameraView, cameraProjection));
+
+		// A directional light's orthographic volume, as Game::Update builds it.
+		XMFLOAT4X4 lightViewProjection;
+		XMMATRIX lightView = XMMatrixLookToLH(XMVectorSet(200, 400, -200, 0), XMVectorSet(-1, -2, 1, 0), XMVectorSet(0, 1, 0, 0));
+		XMMATRIX lightProjection = XMMatrixOrthographicLH(600.0f, 600.0f, 1.0f, 1500.0f);
+		XMStoreFloat4x4(&lightViewProjection, XMMatrixMultiply(lightView, lightProjection));
+
+		int failures = 0;
+		failures += RunVolume("camera", cameraViewProjection, spheres);
+		failures += RunVolume("light", lightViewProjection, spheres);
+		return failures;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(12345);
+
+	std::printf("%10s %-8s %10s %10s %12s %12s %10s\n", "Spheres", "Volume", "Visible", "Culled", "Scalar ms", "SIMD ms", "Mismatch");
+	int failures = 0;
+	for (size_t count : { (size_t)10000, (size_t)100000, (size_t)1000000 })
+		failures += RunBenchmark(count, random);
+
+	return failures > 0 ? 1 : 0;
+}
@@ -1,27 +1,31 @@
 // Add a shader include file.
 #include "ShaderIncludeFile.hlsli"
 
-// Create a cbuffer struct for the pixel shader.
-cbuffer PSExternalData1 : register(b0)
+// Per-frame data, the same for every entity (uploaded once per frame).
+cbuffer PSFrameData : register(b0)
 {
-    float4 colorTint;
-	
     float2 time;
     float2 timePadding;
-	
+
+	// Get the camera position.
+    float4 cameraCurrentPosition;
+
+    float4 ambientColor;
+}
+
+// Per-material data, uploaded by the material only when it changes.
+cbuffer PSMaterialData : register(b1)
+{
+    float4 colorTint;
+
     float2 scale;
     float2 scalePadding;
-	
+
     float2 offset;
     float2 offsetPadding;
-	
-	// Get the camera position and the entity material object.
-    float4 cameraCurrentPosition;
-	
+
     float2 roughness;
     float2 roughnessPadding;
-	
-    float4 ambientColor;
 }
 
 // --------------------------------------------------------
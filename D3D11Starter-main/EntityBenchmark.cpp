@@ -0,0 +1,233 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "EntityRegistry.h"
+#include "TransformSystem.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless entity storage benchmark
+//
+// - Spawns 100k entities the way Game used to (an Entity
+//   with a Transform and shared_ptrs to its mesh and
+//   material, copied into a std::vector) and into an
+//   EntityRegistry with mesh and material indices
+// - Times spawning, one draw loop style pass over every
+//   entity (world matrix, material tint and mesh triangle
+//   count) and destroying and respawning a tenth of them
+// - Checks that both passes read the same values, that
+//   handles to destroyed entities are rejected and that the
+//   surviving handles still find their components, and
+//   returns 1 if any check fails
+// - Meshes and materials are small stand-ins, since the real
+//   ones need a D3D11 device
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers
+// only accessible in this file
+namespace
+{
+	// Stand-ins for the parts of Mesh and Material the draw loop reads.
+	struct MeshInfo
+	{
+		unsigned int triangleCount;
+	};
+
+	struct MaterialInfo
+	{
+		XMFLOAT4 colorTint;
+	};
+
+	// An entity as Game used to store them, with getters returning
+	// shared_ptrs by value like Entity's did.
+	class OldEntity
+	{
+	public:
+		OldEntity(std::shared_ptr<MeshInfo> mesh, std::shared_ptr<MaterialInfo> material)
+			: mesh(mesh), material(material)
+		{
+		}
+
+		Transform& GetTransform() { return transform; }
+		std::shared_ptr<MeshInfo> GetMesh() { return mesh; }
+		std::shared_ptr<MaterialInfo> GetMaterial() { return material; }
+
+	private:
+		Transform transform;
+		std::shared_ptr<MeshInfo> mesh;
+		std::shared_ptr<MaterialInfo> material;
+	};
+
+	const size_t ENTITY_COUNT = 100000;
+	const unsigned int MESH_COUNT = 7;
+	const unsigned int MATERIAL_COUNT = 13;
+	const int ITERATION_PASSES = 20;
+
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Mesh and material of the i-th spawned entity.
+	unsigned int MeshOf(size_t i) { return (unsigned int)(i % MESH_COUNT); }
+	unsigned int MaterialOf(size_t i) { return (unsigned int)((i * 7) % MATERIAL_COUNT); }
+
+	// Position of the i-th spawned entity.
+	XMFLOAT3 PositionOf(size_t i)
+	{
+		return XMFLOAT3((float)(i % 100), (float)((i / 100) % 100), (float)(i / 10000));
+	}
+}
+
+int main()
+{
+	std::vector<std::shared_ptr<MeshInfo>> meshes;
+	std::vector<std::shared_ptr<MaterialInfo>> materials;
+	for (unsigned int i = 0; i < MESH_COUNT; i++)
+		meshes.push_back(std::make_shared<MeshInfo>(MeshInfo{ 12 * (i + 1) }));
+	for (unsigned int i = 0; i < MATERIAL_COUNT; i++)
+		materials.push_back(std::make_shared<MaterialInfo>(MaterialInfo{ XMFLOAT4(i * 0.1f, 0.5f, 1.0f, 1.0f) }));
+
+	TransformSystem& system = TransformSystem::Global();
+	system.Reserve(ENTITY_COUNT * 2 + 16);
+	int failures = 0;
+
+	// Spawn, copying each entity into the vector as Game did.
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<OldEntity> oldEntities;
+	for (size_t i = 0; i < ENTITY_COUNT; i++)
+	{
+		OldEntity entity(meshes[MeshOf(i)], materials[MaterialOf(i)]);
+		entity.GetTransform().SetPosition(PositionOf(i));
+		oldEntities.push_back(entity);
+	}
+	float oldSpawnTime = MillisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	EntityRegistry registry;
+	registry.Reserve(ENTITY_COUNT);
+	std::vector<EntityHandle> handles;
+	handles.reserve(ENTITY_COUNT);
+	for (size_t i = 0; i < ENTITY_COUNT; i++)
+	{
+		EntityHandle entity = registry.Create(MeshOf(i), MaterialOf(i));
+		registry.GetTransform(entity).SetPosition(PositionOf(i));
+		handles.push_back(entity);
+	}
+	float registrySpawnTime = MillisecondsSince(start);
+
+	// Build every matrix up front so the passes below only read them.
+	system.UpdateDirty();
+
+	// One draw loop pass, reading through the shared_ptr getters.
+	double oldSum = 0.0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int pass = 0; pass < ITERATION_PASSES; pass++)
+	{
+		for (size_t i = 0; i < oldEntities.size(); i++)
+		{
+			XMFLOAT4X4 world = oldEntities[i].GetTransform().GetWorldMatrix();
+			XMFLOAT4 tint = oldEntities[i].GetMaterial()->colorTint;
+			unsigned int triangles = oldEntities[i].GetMesh()->triangleCount;
+			oldSum += world._41 + world._42 + world._43 + tint.x + triangles;
+		}
+	}
+	float oldIterateTime = MillisecondsSince(start) / ITERATION_PASSES;
+
+	// The same pass over the dense arrays, with index lookups into the tables.
+	double registrySum = 0.0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int pass = 0; pass < ITERATION_PASSES; pass++)
+	{
+		Transform* transforms = registry.GetTransforms();
+		const unsigned int* meshIndices = registry.GetMeshIndices();
+		const unsigned int* materialIndices = registry.GetMaterialIndices();
+		for (size_t i = 0; i < registry.GetCount(); i++)
+		{
+			XMFLOAT4X4 world = transforms[i].GetWorldMatrix();
+			XMFLOAT4 tint = materials[materialIndices[i]].get()->colorTint;
+			unsigned int triangles = meshes[meshIndices[i]].get()->triangleCount;
+			registrySum += world._41 + world._42 + world._43 + tint.x + triangles;
+		}
+	}
+	float registryIterateTime = MillisecondsSince(start) / ITERATION_PASSES;
+
+	if (std::fabs(oldSum - registrySum) > 1e-6 * std::fabs(oldSum))
+	{
+		std::printf("FAIL: iteration sums differ (%f vs %f)\n", oldSum, registrySum);
+		failures++;
+	}
+
+	// Destroy every tenth entity and spawn replacements, which reuse the freed slots.
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < ENTITY_COUNT; i += 10)
+		registry.Destroy(handles[i]);
+	std::vector<EntityHandle> respawned;
+	for (size_t i = 0; i < ENTITY_COUNT; i += 10)
+		respawned.push_back(registry.Create(MESH_COUNT, MATERIAL_COUNT));
+	float churnTime = MillisecondsSince(start);
+
+	// Stale handles are rejected, and every other handle still finds its own components.
+	size_t handleErrors = 0;
+	for (size_t i = 0; i < ENTITY_COUNT; i++)
+	{
+		EntityHandle entity = handles[i];
+		if (i % 10 == 0)
+		{
+			bool threw = false;
+			try
+			{
+				registry.GetMeshIndex(entity);
+			}
+			catch (const std::invalid_argument&)
+			{
+				threw = true;
+			}
+			if (registry.IsAlive(entity) || !threw)
+				handleErrors++;
+			continue;
+		}
+
+		XMFLOAT3 position = registry.GetTransform(entity).GetPosition();
+		XMFLOAT3 expected = PositionOf(i);
+		if (!registry.IsAlive(entity) ||
+			registry.GetMeshIndex(entity) != MeshOf(i) ||
+			registry.GetMaterialIndex(entity) != MaterialOf(i) ||
+			position.x != expected.x || position.y != expected.y || position.z != expected.z)
+			handleErrors++;
+	}
+	for (EntityHandle entity : respawned)
+	{
+		if (!registry.IsAlive(entity) || registry.GetMeshIndex(entity) != MESH_COUNT)
+			handleErrors++;
+	}
+	if (registry.GetCount() != ENTITY_COUNT)
+		handleErrors++;
+
+	// The dense arrays stay in step: each handle's dense index points back at it.
+	const EntityHandle* denseHandles = registry.GetHandles();
+	for (size_t i = 0; i < registry.GetCount(); i++)
+	{
+		if (registry.GetDenseIndex(denseHandles[i]) != i)
+			handleErrors++;
+	}
+
+	if (handleErrors > 0)
+	{
+		std::printf("FAIL: %zu handle lookups were wrong after destroying and respawning\n", handleErrors);
+		failures++;
+	}
+
+	std::printf("%-24s %12s %12s %12s\n", "Entities (100k)", "Spawn ms", "Iterate ms", "Churn ms");
+	std::printf("%-24s %12.2f %12.3f %12s\n", "vector<Entity>", oldSpawnTime, oldIterateTime, "-");
+	std::printf("%-24s %12.2f %12.3f %12.2f\n", "EntityRegistry", registrySpawnTime, registryIterateTime, churnTime);
+
+	return failures > 0 ? 1 : 0;
+}
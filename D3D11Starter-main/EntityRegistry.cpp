@@ -0,0 +1,131 @@
+#include "EntityRegistry.h"
+
+#include <stdexcept>
+#include <utility>
+
+EntityRegistry::EntityRegistry()
+{
+}
+
+EntityHandle EntityRegistry::Create(unsigned int meshIndex, unsigned int materialIndex)
+{
+	EntityHandle entity;
+	if (!freeSlots.empty())
+	{
+		entity.index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		entity.index = (unsigned int)generations.size();
+		generations.push_back(0);
+		denseIndices.push_back(0);
+	}
+	entity.generation = generations[entity.index];
+
+	denseIndices[entity.index] = (unsigned int)handles.size();
+	handles.push_back(entity);
+	transforms.emplace_back();
+	meshIndices.push_back(meshIndex);
+	materialIndices.push_back(materialIndex);
+	return entity;
+}
+
+void EntityRegistry::Destroy(EntityHandle entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	// Move the last entity into the gap.
+	size_t dense = denseIndices[entity.index];
+	size_t last = handles.size() - 1;
+	if (dense != last)
+	{
+		handles[dense] = handles[last];
+		transforms[dense] = std::move(transforms[last]);
+		meshIndices[dense] = meshIndices[last];
+		materialIndices[dense] = materialIndices[last];
+		denseIndices[handles[dense].index] = (unsigned int)dense;
+	}
+
+	handles.pop_back();
+	transforms.pop_back();
+	meshIndices.pop_back();
+	materialIndices.pop_back();
+
+	// Invalidate every handle to the slot before it is reused.
+	generations[entity.index]++;
+	freeSlots.push_back(entity.index);
+}
+
+bool EntityRegistry::IsAlive(EntityHandle entity) const
+{
+	return entity.index < generations.size() && generations[entity.index] == entity.generation;
+}
+
+void EntityRegistry::Reserve(size_t count)
+{
+	generations.reserve(count);
+	denseIndices.reserve(count);
+	handles.reserve(count);
+	transforms.reserve(count);
+	meshIndices.reserve(count);
+	materialIndices.reserve(count);
+}
+
+size_t EntityRegistry::GetCount() const
+{
+	return handles.size();
+}
+
+size_t EntityRegistry::GetDenseIndex(EntityHandle entity) const
+{
+	if (!IsAlive(entity))
+		throw std::invalid_argument("Entity handle refers to a destroyed entity");
+	return denseIndices[entity.index];
+}
+
+Transform& EntityRegistry::GetTransform(EntityHandle entity)
+{
+	return transforms[GetDenseIndex(entity)];
+}
+
+unsigned int EntityRegistry::GetMeshIndex(EntityHandle entity) const
+{
+	return meshIndices[GetDenseIndex(entity)];
+}
+
+unsigned int EntityRegistry::GetMaterialIndex(EntityHandle entity) const
+{
+	return materialIndices[GetDenseIndex(entity)];
+}
+
+void EntityRegistry::SetMeshIndex(EntityHandle entity, unsigned int meshIndex)
+{
+	meshIndices[GetDenseIndex(entity)] = meshIndex;
+}
+
+void EntityRegistry::SetMaterialIndex(EntityHandle entity, unsigned int materialIndex)
+{
+	materialIndices[GetDenseIndex(entity)] = materialIndex;
+}
+
+const EntityHandle* EntityRegistry::GetHandles() const
+{
+	return handles.data();
+}
+
+Transform* EntityRegistry::GetTransforms()
+{
+	return transforms.data();
+}
+
+const unsigned int* EntityRegistry::GetMeshIndices() const
+{
+	return meshIndices.data();
+}
+
+const unsigned int* EntityRegistry::GetMaterialIndices() const
+{
+	return materialIndices.data();
+}
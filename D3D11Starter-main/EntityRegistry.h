@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Transform.h"
+
+// --------------------------------------------------------
+// A generational handle to an entity in an EntityRegistry.
+//
+// - "index" picks a slot in the registry's sparse table and
+//   "generation" must match the slot's, so a handle to a
+//   destroyed entity is detected instead of silently
+//   pointing at whatever entity reuses the slot
+// --------------------------------------------------------
+struct EntityHandle
+{
+	unsigned int index;
+	unsigned int generation;
+};
+
+// --------------------------------------------------------
+// Dense storage for every entity in the scene.
+//
+// - Components are kept in parallel arrays (transform,
+//   mesh index, material index) with no gaps, so drawing
+//   walks them front to back
+// - Meshes and materials are indices into tables the owner
+//   keeps, so iterating never touches a shared_ptr
+// - Destroying an entity moves the last one into its place,
+//   so dense indices change but handles stay valid
+// --------------------------------------------------------
+class EntityRegistry
+{
+public:
+	EntityRegistry();
+
+	// Add an entity with an identity transform.
+	EntityHandle Create(unsigned int meshIndex, unsigned int materialIndex);
+
+	// Remove an entity. Destroying a stale handle does nothing.
+	void Destroy(EntityHandle entity);
+
+	// Check whether a handle still refers to a live entity.
+	bool IsAlive(EntityHandle entity) const;
+
+	// Reserve room for "count" entities so creating them does not reallocate.
+	void Reserve(size_t count);
+
+	// Number of live entities (the length of the dense arrays).
+	size_t GetCount() const;
+
+	// Position of an entity in the dense arrays.
+	// - Throws std::invalid_argument for a stale handle
+	size_t GetDenseIndex(EntityHandle entity) const;
+
+	// Components of one entity.
+	Transform& GetTransform(EntityHandle entity);
+	unsigned int GetMeshIndex(EntityHandle entity) const;
+	unsigned int GetMaterialIndex(EntityHandle entity) const;
+	void SetMeshIndex(EntityHandle entity, unsigned int meshIndex);
+	void SetMaterialIndex(EntityHandle entity, unsigned int materialIndex);
+
+	// Dense component arrays, GetCount() long and in the same order.
+	const EntityHandle* GetHandles() const;
+	Transform* GetTransforms();
+	const unsigned int* GetMeshIndices() const;
+	const unsigned int* GetMaterialIndices() const;
+
+private:
+	// Sparse table: the generation of each slot, and where its entity is
+	// in the dense arrays.
+	std::vector<unsigned int> generations;
+	std::vector<unsigned int> denseIndices;
+	std::vector<unsigned int> freeSlots;
+
+	// Dense arrays.
+	std::vector<EntityHandle> handles;
+	std::vector<Transform> transforms;
+	std::vector<unsigned int> meshIndices;
+	std::vector<unsigned int> materialIndices;
+};
@@ -19,11 +19,13 @@
 // Include buffer struct header.
 #include "BufferStructs.h"
 #include "Transform.h"
-
-// Include entity class.
-#include "Entity.h"
+#include "TransformSystem.h"
 
 #include <DirectXMath.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
 
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
@@ -45,26 +47,34 @@ Game::Game()
 	// Set the context of the constant buffer heap.
 	Graphics::Context->QueryInterface<ID3D11DeviceContext1>(ringBufferContext.GetAddressOf());
 
-	// The location of the constant buffer heap in byte starts at 0.
-	cbHeapOffsetInByte = 0;
+	// No frame drawn yet, so no fence is pending and the heap has not grown.
+	cbFrameIndex = 0;
+	cbHeapGrowths = 0;
+
+	// Nothing uploaded yet.
+	cbFrameBytesCopied = 0;
+	cbFrameBytesReserved = 0;
+	materialFrameBytes = 0;
+	cbLastFrameBytesCopied = 0;
+	cbLastFrameBytesReserved = 0;
+	materialLastFrameBytes = 0;
 
 	// Cb Buffer needed for 50 object * with 2 constant buffer each * 3 frames = 300 Cb.
 	// Constant buffer heap size of: 1000 * 256 bytes = 266,000 bytes.
 	// It is enough for a 266 object or a 1000 Cb.
 	cbHeapSizeInByte = 1000 * 256;
 
-	// The heap size must be in the next multiple of 256 (needed byte size).
-	cbHeapSizeInByte = (cbHeapSizeInByte + 255) / 256 * 256;
+	// Create the CBH (it grows if a frame ever needs more).
+	CreateConstantBufferHeap(cbHeapSizeInByte);
 
-	// Create the set of options or instructions to create the CBH.
-	D3D11_BUFFER_DESC cbHeapDesc = {};
-	cbHeapDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	cbHeapDesc.ByteWidth = cbHeapSizeInByte;
-	cbHeapDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	cbHeapDesc.Usage = D3D11_USAGE_DYNAMIC;
-
-	// Create the CBH.
-	Graphics::Device->CreateBuffer(&cbHeapDesc, 0, constantBufferHeap.GetAddressOf());
+	// Create one event query per frame in flight to fence the heap's frames.
+	D3D11_QUERY_DESC fenceDesc = {};
+	fenceDesc.Query = D3D11_QUERY_EVENT;
+	for (unsigned int i = 0; i < CB_FRAMES_IN_FLIGHT; i++)
+	{
+		Graphics::Device->CreateQuery(&fenceDesc, cbFrameFences[i].GetAddressOf());
+		cbFenceFrames[i] = 0;
+	}
 
 	// Get the wide string asset path of both pictures.
 	const std::wstring pavement = L"..\\..\\Assets\\Textures\\rock.png";
@@ -309,6 +319,9 @@ Game::Game()
 	// Load shadow vertex shader.
 	LoadShadowVertexShader();
 
+	// Load the vertex shader for instanced entities.
+	LoadInstancedVertexShader();
+
 
 	// Create the Sky textures string.
 	const wchar_t* right = L"..\\..\\Assets\\Skies\\Clouds_Blue\\right.png";
@@ -465,6 +478,53 @@ Game::Game()
 	// Initialize count to 0.
 	count = 0;
 
+	// Draw meshes at the coarsest level of detail that stays within a pixel of full detail.
+	useMeshLods = true;
+	lodPixelError = 1.0f;
+
+	// Skip meshlets that are off screen or facing away from the camera.
+	useMeshletCulling = true;
+	meshletTrianglesDrawn = 0;
+	meshletTrianglesTotal = 0;
+
+	// Skip entities outside the camera and light volumes.
+	useFrustumCulling = true;
+	mainPassVisibleCount = 0;
+	shadowPassVisibleCount = 0;
+
+	// Skip entities hidden behind the largest ones in each view.
+	useOcclusionCulling = true;
+	mainPassOccludedCount = 0;
+	shadowPassOccludedCount = 0;
+
+	// Sort each pass's draws to share state between them.
+	useDrawSorting = true;
+	mainPassUnsortedChanges = {};
+	mainPassStateChanges = {};
+	shadowPassUnsortedChanges = {};
+	shadowPassStateChanges = {};
+
+	// Draw batches of matching entities with one instanced draw each.
+	// - The instance buffer is created on the first frame that needs it
+	useInstancing = true;
+	instanceCapacity = 0;
+
+	// No clustered light buffers yet, and only the five lights the UI edits.
+	localLightCapacity = 0;
+	clusterRangeCapacity = 0;
+	clusterIndexCapacity = 0;
+	scatteredLightCount = 0;
+	clusterLightIndexCount = 0;
+	clusterBuildMilliseconds = 0.0f;
+	mainPassDrawCalls = 0;
+	shadowPassDrawCalls = 0;
+
+	// Cull and pick through the entity hierarchy, which is built on the first frame.
+	useEntityBvh = true;
+	entityBvhBuiltCost = 0.0f;
+	pickedEntity = {};
+	hasPickedEntity = false;
+
 	// Intialize the current and previous background & border color.
 	//previousBgColor = new float[4] { 0.0f, 0.0f, 0.0f, 0.0f };
 	bgColor = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
@@ -664,6 +724,7 @@ void Game::Initialize()
 		dLight1.intensity = 40.0f;
 
 		// Make five directional lights and add them to the array.
+		lightArray.resize(5);
 		for (int i = 0; i < 5; i++)
 		{
 			// If i is less than 3 set type and direction to directional light.
@@ -814,6 +875,23 @@ void Game::LoadVertexShader()
 	}
 }
 
+/// <summary>
+/// Loads the vertex shader for instanced entities. It reads the same
+/// vertices as VertexShader.hlsl, so it uses the same input layout.
+/// </summary>
+void Game::LoadInstancedVertexShader()
+{
+	ID3DBlob* vertexShaderBlob;
+	D3DReadFileToBlob(FixPath(L"InstancedVertexShader.cso").c_str(), &vertexShaderBlob);
+	Graphics::Device->CreateVertexShader(
+		vertexShaderBlob->GetBufferPointer(),
+		vertexShaderBlob->GetBufferSize(),
+		0,
+		instancedVertexShader.GetAddressOf());
+
+	vertexShaderBlob->Release();
+}
+
 //Load the vertex shader.
 void Game::LoadShadowVertexShader()
 {
@@ -1268,19 +1346,18 @@ void Game::buildImGuiCustomizedUI()
 	if (ImGui::TreeNode("Entities"))
 	{
 		// Create a loop of entities to be displayed.
-		for (int i = 0; i < listOfEntities.size(); i++)
+		for (int i = 0; i < entities.GetCount(); i++)
 		{
 			std::string number = "Entity " + std::to_string(i + 1);
 
 			if (ImGui::TreeNode(number.c_str()))
 			{
 				// Get the transform address to get its data.
-				Transform& entityTransform = listOfEntities[i].GetTransform();
+				Transform& entityTransform = entities.GetTransforms()[i];
 				
 				// Get the material of the entity.
-				//Material& entityMaterial = *(listOfEntities[i].GetMaterial().get());
-				// Changing the material shared pointer will change its material properties.
-				std::shared_ptr<Material> entityMaterial = listOfEntities[i].GetMaterial();
+				// Changing the material will change it for every entity that shares it.
+				Material* entityMaterial = entityMaterials[entities.GetMaterialIndices()[i]].get();
 
 				// Create Push ID to make an edited variable of transform 
 				// element to be unique to each entity for each loop.
@@ -1416,6 +1493,14 @@ void Game::buildImGuiCustomizedUI()
 			}
 		}
 
+		// Scatter more point and spot lights over the scene to see the light clusters at work.
+		if (ImGui::SliderInt("Scattered Lights", &scatteredLightCount, 0, 16384))
+		{
+			ScatterLights(scatteredLightCount);
+		}
+		ImGui::Text("%zu point and spot lights, %zu cluster light indices, clustered in %.3f ms",
+			localLights.size(), clusterLightIndexCount, clusterBuildMilliseconds);
+
 		// Ambient color:
 		// Create tree node for changing the window color using color picker.
 		if (ImGui::TreeNode("Change Ambient Color"))
@@ -1486,6 +1571,157 @@ void Game::buildImGuiCustomizedUI()
 		ImGui::TreePop();
 	}
 
+	// Create UI for the mesh levels of detail, culling and draw batching.
+	if (ImGui::TreeNode("Mesh Loading"))
+	{
+		// Show the generated levels of detail of each loaded mesh.
+		if (ImGui::TreeNode("Mesh LODs"))
+		{
+			ImGui::Checkbox("Use mesh LODs", &useMeshLods);
+			ImGui::SliderFloat("Max LOD pixel error", &lodPixelError, 0.25f, 8.0f);
+
+			const char* meshNames[] = { "cube", "cylinder", "helix", "quad", "quad_double_sided", "sphere", "torus" };
+			std::shared_ptr<Mesh> meshes[] = { cube, cylinder, helix, quad, quad_Double_Sided, sphere, torus };
+
+			for (int i = 0; i < 7; i++)
+			{
+				for (unsigned int lod = 0; lod < meshes[i]->GetLodCount(); lod++)
+				{
+					MeshLod range = meshes[i]->GetLod(lod);
+					ImGui::Text("%s LOD %u: %u triangles, error %.4f", meshNames[i], lod, range.indexCount / 3, range.error);
+				}
+			}
+
+			ImGui::TreePop();
+		}
+
+		// Move each row of entities as a group through its parent transform.
+		if (ImGui::TreeNode("Entity Rows"))
+		{
+			for (int i = 0; i < 6; i++)
+			{
+				ImGui::PushID(i);
+				ImGui::Text("Row %d", i + 1);
+
+				XMFLOAT3 position = entityRows[i].GetPosition();
+				XMFLOAT3 rotation = entityRows[i].GetPitchYawRoll();
+				if (ImGui::DragFloat3("Position", &position.x, 0.1f))
+					entityRows[i].SetPosition(position);
+				if (ImGui::DragFloat3("Rotation", &rotation.x, 0.1f))
+					entityRows[i].SetRotation(rotation);
+
+				ImGui::PopID();
+			}
+			ImGui::TreePop();
+		}
+
+		// Toggle meshlet culling and show how many triangles it skipped last frame.
+		if (ImGui::TreeNode("Meshlet Culling"))
+		{
+			ImGui::Checkbox("Cull meshlets", &useMeshletCulling);
+			ImGui::Text("Triangles drawn: %u of %u", meshletTrianglesDrawn, meshletTrianglesTotal);
+			ImGui::TreePop();
+		}
+
+		// Toggle entity frustum culling and show how many entities each pass drew last frame.
+		if (ImGui::TreeNode("Frustum Culling"))
+		{
+			unsigned int entityCount = (unsigned int)entities.GetCount();
+			ImGui::Checkbox("Cull entities", &useFrustumCulling);
+			ImGui::Text("Main pass: %u drawn, %u culled", mainPassVisibleCount, entityCount - mainPassVisibleCount);
+			ImGui::Text("Shadow pass: %u drawn, %u culled", shadowPassVisibleCount, entityCount - shadowPassVisibleCount);
+
+			// Hierarchy stats and the entity picked with a right click.
+			ImGui::Checkbox("Use bounding volume hierarchy", &useEntityBvh);
+			ImGui::Text("Hierarchy: %u nodes, cost %.1f (built at %.1f)", (unsigned int)entityBvh.GetNodeCount(), entityBvh.GetCost(), entityBvhBuiltCost);
+			if (hasPickedEntity && entities.IsAlive(pickedEntity))
+				ImGui::Text("Picked: Entity %u", (unsigned int)entities.GetDenseIndex(pickedEntity) + 1);
+			else
+				ImGui::Text("Picked: none (right click an entity)");
+			ImGui::TreePop();
+		}
+
+		// Toggle occlusion culling and show what each pass's occluders hid last frame.
+		if (ImGui::TreeNode("Occlusion Culling"))
+		{
+			ImGui::Checkbox("Cull hidden entities", &useOcclusionCulling);
+			ImGui::Text("Main pass: %u occluders (%u triangles), %u hidden",
+				(unsigned int)mainPassOcclusion.GetOccluderCount(), (unsigned int)mainPassOcclusion.GetTriangleCount(), mainPassOccludedCount);
+			ImGui::Text("Shadow pass: %u occluders (%u triangles), %u hidden",
+				(unsigned int)shadowPassOcclusion.GetOccluderCount(), (unsigned int)shadowPassOcclusion.GetTriangleCount(), shadowPassOccludedCount);
+			ImGui::TreePop();
+		}
+
+		// Toggle draw sorting and instancing, and show the draw calls and binds
+		// each pass did last frame against what the same draws need in dense order.
+		if (ImGui::TreeNode("Draw Sorting and Instancing"))
+		{
+			ImGui::Checkbox("Sort draws by state", &useDrawSorting);
+			ImGui::Checkbox("Instance matching draws", &useInstancing);
+			ImGui::Text("Main pass: %u draw calls for %u entities", mainPassDrawCalls, mainPassVisibleCount);
+			ImGui::Text("Shadow pass: %u draw calls for %u entities", shadowPassDrawCalls, shadowPassVisibleCount);
+			const RenderQueue::StateChanges* sorted[2] = { &mainPassStateChanges, &shadowPassStateChanges };
+			const RenderQueue::StateChanges* unsorted[2] = { &mainPassUnsortedChanges, &shadowPassUnsortedChanges };
+			const char* passNames[2] = { "Main pass", "Shadow pass" };
+			for (int pass = 0; pass < 2; pass++)
+			{
+				// The shadow pass binds no material textures.
+				unsigned int unsortedMaterials = pass == 0 ? unsorted[pass]->materials : 0;
+				unsigned int bound = sorted[pass]->shaders + sorted[pass]->materials + sorted[pass]->meshes;
+				unsigned int unsortedBound = unsorted[pass]->shaders + unsortedMaterials + unsorted[pass]->meshes;
+				ImGui::Text("%s: %u shader, %u material, %u mesh binds (%u avoided)",
+					passNames[pass], sorted[pass]->shaders, sorted[pass]->materials, sorted[pass]->meshes,
+					unsortedBound > bound ? unsortedBound - bound : 0);
+			}
+			ImGui::TreePop();
+		}
+
+		// Show the constant data uploaded last frame, against what uploading
+		// every per-frame and per-pass value again for each entity would take.
+		if (ImGui::TreeNode("Constant Buffer Traffic"))
+		{
+			// Ring reservations are rounded up to 256 bytes.
+			auto reserved = [](unsigned int size) { return (size + 255) / 256 * 256; };
+			unsigned int perEntityMain =
+				reserved(sizeof(BufferStructs) + sizeof(VSPassData)) +
+				reserved(sizeof(PixelFrameData) + sizeof(PixelMaterialData));
+			unsigned int perEntityShadow = reserved(sizeof(XMFLOAT4X4) * 3);
+			unsigned int perEntityBytes = mainPassVisibleCount * perEntityMain + shadowPassVisibleCount * perEntityShadow;
+
+			ImGui::Text("Ring buffer: %.1f KB copied, %.1f KB reserved",
+				cbLastFrameBytesCopied / 1024.0f, cbLastFrameBytesReserved / 1024.0f);
+			ImGui::Text("Heap: %.1f KB, %.1f KB held by frames in flight, grew %u times",
+				cbHeapSizeInByte / 1024.0f, cbRing.GetUsedBytes() / 1024.0f, cbHeapGrowths);
+			ImGui::Text("Material constants: %u bytes updated", materialLastFrameBytes);
+			ImGui::Text("Per-entity layout: %.1f KB reserved", perEntityBytes / 1024.0f);
+			ImGui::TreePop();
+		}
+
+		// Show how much vertex welding saved for each loaded mesh.
+		if (ImGui::TreeNode("Vertex Welding"))
+		{
+			const char* meshNames[] = { "cube", "cylinder", "helix", "quad", "quad_double_sided", "sphere", "torus" };
+			std::shared_ptr<Mesh> meshes[] = { cube, cylinder, helix, quad, quad_Double_Sided, sphere, torus };
+
+			for (int i = 0; i < 7; i++)
+			{
+				// Memory for the vertex and index buffers, before welding (32-bit indices)
+				// and after welding (at the index width the mesh was uploaded with).
+				int before = meshes[i]->GetUnweldedVertexCount();
+				int after = meshes[i]->GetVertexCount();
+				size_t indexSize = (meshes[i]->GetIndexFormat() == DXGI_FORMAT_R16_UINT) ? sizeof(uint16_t) : sizeof(unsigned int);
+				float beforeKB = before * (sizeof(Vertex) + sizeof(unsigned int)) / 1024.0f;
+				float afterKB = (after * sizeof(Vertex) + meshes[i]->GetIndexCount() * indexSize) / 1024.0f;
+
+				ImGui::Text("%s: %d -> %d vertices, %.1f KB -> %.1f KB", meshNames[i], before, after, beforeKB, afterKB);
+			}
+
+			ImGui::TreePop();
+		}
+
+		ImGui::TreePop();
+	}
+
 	// Create UI for Postprocessing Effects.
 	if (ImGui::TreeNode("Post Process Effects"))
 	{
@@ -1628,153 +1864,507 @@ void Game::CreateGeometry()
 
 
 
-	// Create entities using the first list of materials.
-	entity1 = Entity(*(cube.get()), listOfMaterials[0]);
-	entity2 = Entity(*(cylinder.get()), listOfMaterials[0]);
-	entity3 = Entity(*(helix.get()), listOfMaterials[0]);
-
-	// Create two entities that have the same shared mesh as entity3
-	entity4 = Entity(*(quad.get()), listOfMaterials[0]);
-	entity5 = Entity(*(quad_Double_Sided.get()), listOfMaterials[0]);
-	entity6 = Entity(*(sphere.get()), listOfMaterials[0]);
-	entity7 = Entity(*(torus.get()), listOfMaterials[0]);
-
-	// Use mesh to create and push in three distinct entities with different meshes.
-	// Create a for loop the that push the entities 3 times.
+	// Put the meshes in the table entities index into, in the order each row lists them.
+	unsigned int rowMeshes[7] =
+	{
+		AddEntityMesh(torus),
+		AddEntityMesh(sphere),
+		AddEntityMesh(quad_Double_Sided),
+		AddEntityMesh(quad),
+		AddEntityMesh(helix),
+		AddEntityMesh(cylinder),
+		AddEntityMesh(cube),
+	};
+
+	// Reserve room for six rows of seven entities and the ground.
+	entities.Reserve(6 * 7 + 1);
+
+	// Create a row of seven entities for each group of materials.
 	for (int x = 0; x < 6; x++)
 	{
-		// Create a shared pointer material that holds a different material for each loop.
-		std::shared_ptr<Material> loopMaterial;
-
-		if (x == 1)
+		for (int j = 0; j < 7; j++)
 		{
-			loopMaterial = listOfMaterials[x];
+			// The second row is all spheres, each with a different PBR material.
+			// The rest use the row's material on every mesh.
+			EntityHandle entity = (x == 1) ?
+				entities.Create(rowMeshes[1], AddEntityMaterial(materialPBRs[j])) :
+				entities.Create(rowMeshes[j], AddEntityMaterial(listOfMaterials[x]));
+
+			// Transform the meshes position to their new position within the row.
+			Transform& entityTransform = entities.GetTransform(entity);
+			entityTransform.SetPosition(static_cast<float>(-9 + 3 * j), 0, 0);
+
+			// Group the row under its parent.
+			entityTransform.SetParent(&entityRows[x]);
 		}
 
-		if (x == 2)
-		{
-			loopMaterial = listOfMaterials[x];
-		}
+		// Move the y of the row's parent transform by 4 each time.
+		entityRows[x].SetPosition(0, static_cast<float>(4 * x), 0);
+	}
 
-		if (x == 3)
-		{
-			loopMaterial = listOfMaterials[x];
-		}
+	// Create an plane for the ground and add the plane to the list of entities.
+	groundEntity = entities.Create(AddEntityMesh(quad_Double_Sided), AddEntityMaterial(pShader));
+	entities.GetTransform(groundEntity).SetPosition(0, -4.0f, 0);
+	entities.GetTransform(groundEntity).SetScale(50, 50, 50);
+}
 
-		if (x == 4)
-		{
-			loopMaterial = listOfMaterials[x];
-		}
 
-		if (x == 5)
-		{
-			loopMaterial = listOfMaterials[x];
-		}
+// --------------------------------------------------------
+// Add a mesh to the table entities index into, reusing its
+// index if it is already there.
+// --------------------------------------------------------
+unsigned int Game::AddEntityMesh(std::shared_ptr<Mesh> mesh)
+{
+	for (unsigned int i = 0; i < entityMeshes.size(); i++)
+	{
+		if (entityMeshes[i] == mesh)
+			return i;
+	}
 
-		// If the loop is greater than 0 *and less than 3*.
-		if (x > 0)
-		{
-			if (x != 1)
-			{
-				// Set loop material type for each group of looped entities.
-				// Create entities.
-				entity1.SetMaterial(loopMaterial);
-				entity2.SetMaterial(loopMaterial);
-				entity3.SetMaterial(loopMaterial);
-				entity4.SetMaterial(loopMaterial);
-				entity5.SetMaterial(loopMaterial);
-				entity6.SetMaterial(loopMaterial);
-				entity7.SetMaterial(loopMaterial);
-			}
+	entityMeshes.push_back(mesh);
+	return static_cast<unsigned int>(entityMeshes.size() - 1);
+}
 
-			if (x == 1)
-			{
-				// Set loop material type for each group of looped entities.
-				// Create entities.
-				/*entity1.SetMaterial(loopMaterial);
-				entity2.SetMaterial(loopMaterial);
-				entity3.SetMaterial(loopMaterial);
-				entity4.SetMaterial(loopMaterial);
-				entity5.SetMaterial(loopMaterial);
-				entity6.SetMaterial(loopMaterial);
-				entity7.SetMaterial(loopMaterial);*/
-
-				// Set PBR Material.
-				/*entity1.SetMaterial(materialPBRs[0]);
-				entity2.SetMaterial(materialPBRs[1]);
-				entity3.SetMaterial(materialPBRs[2]);
-				entity4.SetMaterial(materialPBRs[3]);
-				entity5.SetMaterial(materialPBRs[4]);
-				entity6.SetMaterial(materialPBRs[5]);
-				entity7.SetMaterial(materialPBRs[6]);*/
-
-				for (int i = 0; i < 7; i++)
-				{
-					entity6.SetMaterial(materialPBRs[i]);
 
-					// Push the entities with a changed material in the list.
-					listOfEntities.push_back(entity6);
-				}
-			}
-		}
-		
-		//if (x == 1)
-		//{
-		//	// Push the entities with a changed material in the list.
-		//	listOfEntities.push_back(entity6);
-		//	listOfEntities.push_back(entity6);
-		//	listOfEntities.push_back(entity6);
-		//	listOfEntities.push_back(entity6);
-		//	listOfEntities.push_back(entity6);
-		//	listOfEntities.push_back(entity6);
-		//	listOfEntities.push_back(entity6);
-		//}
-		
-		if (x != 1)
-		{
-			// Push the entities with a changed material in the list.
-			listOfEntities.push_back(entity7);
-			listOfEntities.push_back(entity6);
-			listOfEntities.push_back(entity5);
-			listOfEntities.push_back(entity4);
-			listOfEntities.push_back(entity3);
-			listOfEntities.push_back(entity2);
-			listOfEntities.push_back(entity1);
-		}
+// --------------------------------------------------------
+// Add a material to the table entities index into, reusing
+// its index if it is already there.
+// --------------------------------------------------------
+unsigned int Game::AddEntityMaterial(std::shared_ptr<Material> material)
+{
+	for (unsigned int i = 0; i < entityMaterials.size(); i++)
+	{
+		if (entityMaterials[i] == material)
+			return i;
 	}
 
-	// Set the float y = 0 for use after the loop.
-	float y = 0.0f;
+	// Start from the next unused program ids.
+	unsigned int program = 0;
+	unsigned int depthProgram = 0;
+	for (unsigned int i = 0; i < entityMaterials.size(); i++)
+	{
+		if (entityMaterialPrograms[i] >= program)
+			program = entityMaterialPrograms[i] + 1;
+		if (entityMaterialDepthPrograms[i] >= depthProgram)
+			depthProgram = entityMaterialDepthPrograms[i] + 1;
+	}
 
-	// For each entities group in the list, transform their y position by 3.
-	for (int i = 0; i < 6; i++)
+	// Share the ids of earlier materials that use the same shaders.
+	for (unsigned int i = 0; i < entityMaterials.size(); i++)
 	{
-		// Get the index of the entities.
-		int indexMultiple = 7 * i;
-
-		// Move the y of the enties position by 4 each time.
-		y = static_cast<float>(4 * i);
-
-		// Transform the meshes position to their new position.
-		listOfEntities[0 + indexMultiple].GetTransform().SetPosition(-9, y, 0);
-		listOfEntities[1 + indexMultiple].GetTransform().SetPosition(-6, y, 0);
-		listOfEntities[2 + indexMultiple].GetTransform().SetPosition(-3, y, 0);
-		listOfEntities[3 + indexMultiple].GetTransform().SetPosition(0, y, 0);
-		listOfEntities[4 + indexMultiple].GetTransform().SetPosition(3, y, 0);
-		listOfEntities[5 + indexMultiple].GetTransform().SetPosition(6, y, 0);
-		listOfEntities[6 + indexMultiple].GetTransform().SetPosition(9, y, 0);
-		//listOfEntities[6 + indexMultiple].GetTransform().SetPosition(9, y, 0);
+		Material* other = entityMaterials[i].get();
+		if (other->GetInputLayout() != material->GetInputLayout() ||
+			other->GetVertexShader() != material->GetVertexShader())
+			continue;
+
+		depthProgram = entityMaterialDepthPrograms[i];
+		if (other->GetPixelShader() == material->GetPixelShader())
+			program = entityMaterialPrograms[i];
 	}
 
-	// Create an plane for the ground and add the plane to the list of entities.
-	// Use a previous entity.
-	listOfEntities.push_back(entity5);
-	listOfEntities[listOfEntities.size() - 1].SetMaterial(pShader);
-	listOfEntities[listOfEntities.size() - 1].GetTransform().SetPosition(0, -4.0f, 0);
-	listOfEntities[listOfEntities.size() - 1].GetTransform().SetScale(50, 50, 50);
+	entityMaterials.push_back(material);
+	entityMaterialPrograms.push_back(program);
+	entityMaterialDepthPrograms.push_back(depthProgram);
+	return static_cast<unsigned int>(entityMaterials.size() - 1);
 }
 
 
+// --------------------------------------------------------
+// Set a material's input layout and vertex shader, and its
+// pixel shader when "bindPixelShader" is true.
+// --------------------------------------------------------
+void Game::BindMaterialShaders(Material& material, bool bindPixelShader)
+{
+	Graphics::Context->IASetInputLayout(material.GetInputLayout().Get());
+	Graphics::Context->VSSetShader(material.GetVertexShader().Get(), 0, 0);
+
+	// Skip the pixel shader for depth only passes.
+	if (bindPixelShader)
+		Graphics::Context->PSSetShader(material.GetPixelShader().Get(), 0, 0);
+}
+
+
+// --------------------------------------------------------
+// Move each entity's mesh bounding sphere and box into
+// world space, in the same order as the registry's dense
+// arrays, then refit the entity hierarchy to the boxes.
+// --------------------------------------------------------
+void Game::UpdateEntityBounds()
+{
+	size_t count = entities.GetCount();
+	entityBounds.Resize(count);
+	entityBoxes.resize(count);
+
+	Transform* entityTransforms = entities.GetTransforms();
+	const unsigned int* entityMeshIndices = entities.GetMeshIndices();
+	for (size_t i = 0; i < count; i++)
+	{
+		Mesh* entityMesh = entityMeshes[entityMeshIndices[i]].get();
+		XMFLOAT4X4 world = entityTransforms[i].GetWorldMatrix();
+
+		XMFLOAT3 center;
+		Culling::TransformSphere(world, entityMesh->GetBoundsCenter(), entityMesh->GetBoundsRadius(), center, entityBounds.radius[i]);
+		entityBounds.centerX[i] = center.x;
+		entityBounds.centerY[i] = center.y;
+		entityBounds.centerZ[i] = center.z;
+
+		AxisAlignedBox localBox = { entityMesh->GetBoundsMin(), entityMesh->GetBoundsMax() };
+		Culling::TransformBox(world, localBox, entityBoxes[i]);
+	}
+
+	// Rebuild when entities were added or removed, or when moving entities
+	// have made the refit tree twice as costly as a fresh one.
+	if (entityBvh.GetItemCount() == count)
+		entityBvh.Refit(entityBoxes.data());
+	if (entityBvh.GetItemCount() != count || entityBvh.GetCost() > entityBvhBuiltCost * 2.0f)
+	{
+		entityBvh.Build(entityBoxes.data(), count);
+		entityBvhBuiltCost = entityBvh.GetCost();
+	}
+}
+
+
+// --------------------------------------------------------
+// Cast a ray from the camera through the mouse cursor and
+// remember the first entity box it enters.
+// --------------------------------------------------------
+void Game::PickEntity()
+{
+	// Unproject the cursor at the near and far planes.
+	XMFLOAT4X4 view = activeCamera->GetViewMatrix();
+	XMFLOAT4X4 projection = activeCamera->GetProjectionMatrix();
+	XMMATRIX inverseViewProjection = XMMatrixInverse(0, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+	float x = 2.0f * Input::GetMouseX() / Window::Width() - 1.0f;
+	float y = 1.0f - 2.0f * Input::GetMouseY() / Window::Height();
+	XMFLOAT3 nearPoint, farPoint;
+	XMStoreFloat3(&nearPoint, XMVector3TransformCoord(XMVectorSet(x, y, 0.0f, 1.0f), inverseViewProjection));
+	XMStoreFloat3(&farPoint, XMVector3TransformCoord(XMVectorSet(x, y, 1.0f, 1.0f), inverseViewProjection));
+
+	// The ray's length is the near to far distance, so 1 reaches the far plane.
+	XMFLOAT3 direction(farPoint.x - nearPoint.x, farPoint.y - nearPoint.y, farPoint.z - nearPoint.z);
+	float hitDistance;
+	unsigned int hit = entityBvh.Raycast(nearPoint, direction, 1.0f, hitDistance);
+
+	// The hierarchy was built from last frame's dense order.
+	hasPickedEntity = hit != BoundingVolumeHierarchy::NO_HIT && hit < entities.GetCount();
+	if (hasPickedEntity)
+		pickedEntity = entities.GetHandles()[hit];
+}
+
+
+// --------------------------------------------------------
+// Test the entity bounds against a view volume, setting
+// each entity's entry in "visible" to 1 when it should be
+// drawn, through the entity hierarchy or by testing every
+// sphere. Everything is visible with culling turned off.
+// --------------------------------------------------------
+unsigned int Game::CullEntities(const XMFLOAT4X4& viewProjectionMatrix, std::vector<unsigned char>& visible)
+{
+	size_t count = entityBounds.radius.size();
+	visible.resize(count);
+	if (!useFrustumCulling)
+	{
+		std::fill(visible.begin(), visible.end(), (unsigned char)1);
+		return (unsigned int)count;
+	}
+
+	Frustum frustum = Culling::ExtractFrustum(viewProjectionMatrix);
+	if (!useEntityBvh)
+		return (unsigned int)Culling::CullSpheres(frustum, entityBounds, visible.data());
+
+	// Only the hierarchy's nodes that reach into the frustum are visited.
+	std::fill(visible.begin(), visible.end(), (unsigned char)0);
+	entityBvh.QueryFrustum(frustum, entityQueryResults);
+	for (unsigned int entity : entityQueryResults)
+		visible[entity] = 1;
+	return (unsigned int)entityQueryResults.size();
+}
+
+
+// --------------------------------------------------------
+// Draw the visible entities that look largest in a view
+// (bounding sphere radius over depth) into an occlusion
+// buffer, then unmark the other visible entities whose
+// boxes are hidden behind them. Nothing is hidden with
+// occlusion culling turned off.
+// --------------------------------------------------------
+unsigned int Game::OccludeEntities(const XMFLOAT4X4& viewMatrix, const XMFLOAT4X4& viewProjectionMatrix, OcclusionBuffer& buffer, std::vector<unsigned char>& visible)
+{
+	buffer.Begin(viewProjectionMatrix);
+	if (!useOcclusionCulling)
+		return 0;
+
+	// Entities nearer than their own radius count as filling the view.
+	const unsigned int* entityMeshIndices = entities.GetMeshIndices();
+	occluderCandidates.clear();
+	for (unsigned int i = 0; i < visible.size(); i++)
+	{
+		if (!visible[i] || entityMeshes[entityMeshIndices[i]]->GetOccluder().indices.empty())
+			continue;
+
+		float depth =
+			entityBounds.centerX[i] * viewMatrix._13 +
+			entityBounds.centerY[i] * viewMatrix._23 +
+			entityBounds.centerZ[i] * viewMatrix._33 +
+			viewMatrix._43;
+		float radius = entityBounds.radius[i];
+		occluderCandidates.push_back({ radius / (depth > radius ? depth : radius), i });
+	}
+
+	size_t occluderCount = occluderCandidates.size() < MAX_OCCLUDERS ? occluderCandidates.size() : MAX_OCCLUDERS;
+	std::partial_sort(occluderCandidates.begin(), occluderCandidates.begin() + occluderCount, occluderCandidates.end(),
+		[](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) { return a.first > b.first; });
+
+	Transform* entityTransforms = entities.GetTransforms();
+	for (size_t o = 0; o < occluderCount; o++)
+	{
+		unsigned int i = occluderCandidates[o].second;
+		buffer.RasterizeOccluder(entityMeshes[entityMeshIndices[i]]->GetOccluder(), entityTransforms[i].GetWorldMatrix());
+	}
+	buffer.BuildHierarchy();
+
+	// Leave the occluders out of the test, since their boxes can be hidden
+	// behind their own faces.
+	for (size_t o = 0; o < occluderCount; o++)
+		visible[occluderCandidates[o].second] = 0;
+	unsigned int hidden = (unsigned int)buffer.CullBoxes(entityBoxes.data(), visible.size(), visible.data());
+	for (size_t o = 0; o < occluderCount; o++)
+		visible[occluderCandidates[o].second] = 1;
+	return hidden;
+}
+
+
+// --------------------------------------------------------
+// Add a draw for every visible entity to the draw queue,
+// keyed by the pass, its material's shader program, its
+// material, its mesh and the depth of its bounding sphere
+// in the given view, then sort the queue unless sorting is
+// turned off (which leaves it in dense order).
+// Returns the state changes the draws need in dense order.
+// --------------------------------------------------------
+RenderQueue::StateChanges Game::BuildDrawQueue(unsigned int pass, const std::vector<unsigned char>& visible, const XMFLOAT4X4& viewMatrix)
+{
+	const unsigned int* entityMeshIndices = entities.GetMeshIndices();
+	const unsigned int* entityMaterialIndices = entities.GetMaterialIndices();
+	const std::vector<unsigned int>& programs = pass == SHADOW_DRAW_PASS ? entityMaterialDepthPrograms : entityMaterialPrograms;
+
+	drawQueue.Clear();
+	drawQueue.Reserve(visible.size());
+	for (unsigned int i = 0; i < visible.size(); i++)
+	{
+		if (!visible[i])
+			continue;
+
+		// View space depth of the bounding sphere's center.
+		float depth =
+			entityBounds.centerX[i] * viewMatrix._13 +
+			entityBounds.centerY[i] * viewMatrix._23 +
+			entityBounds.centerZ[i] * viewMatrix._33 +
+			viewMatrix._43;
+
+		// The shadow pass binds no material textures, so its draws only group by mesh.
+		unsigned int material = entityMaterialIndices[i];
+		unsigned int materialKey = pass == SHADOW_DRAW_PASS ? 0 : material;
+		drawQueue.Add(RenderQueue::MakeKey(pass, programs[material], materialKey, entityMeshIndices[i], RenderQueue::QuantizeDepth(depth)), i);
+	}
+
+	RenderQueue::StateChanges unsortedChanges = drawQueue.CountStateChanges();
+	if (useDrawSorting)
+		drawQueue.Sort();
+	return unsortedChanges;
+}
+
+
+// --------------------------------------------------------
+// Write the world and inverse transpose world matrices of
+// every queued draw into the instance buffer, in queue
+// order, so a batch's instances start at its first draw,
+// then bind it to the vertex shader. The buffer is grown
+// to the next power of two when the queue outgrows it.
+// --------------------------------------------------------
+void Game::UploadInstances()
+{
+	unsigned int count = (unsigned int)drawQueue.GetCount();
+	if (count == 0)
+		return;
+
+	if (count > instanceCapacity)
+	{
+		unsigned int capacity = instanceCapacity > 0 ? instanceCapacity : 64;
+		while (capacity < count)
+			capacity *= 2;
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.ByteWidth = capacity * sizeof(InstanceData);
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = sizeof(InstanceData);
+		instanceBuffer.Reset();
+		instanceSRV.Reset();
+		Graphics::Device->CreateBuffer(&bufferDesc, 0, instanceBuffer.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = capacity;
+		Graphics::Device->CreateShaderResourceView(instanceBuffer.Get(), &srvDesc, instanceSRV.GetAddressOf());
+		instanceCapacity = capacity;
+	}
+
+	// Write straight into the mapped buffer.
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	Graphics::Context->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	InstanceData* instances = static_cast<InstanceData*>(mapped.pData);
+	Transform* entityTransforms = entities.GetTransforms();
+	const RenderQueue::DrawItem* drawItems = drawQueue.GetItems();
+	for (unsigned int d = 0; d < count; d++)
+	{
+		Transform& transform = entityTransforms[drawItems[d].entity];
+		instances[d].worldMatrix = transform.GetWorldMatrix();
+		instances[d].worldInverseTransposeMatrix = transform.GetInverseTransposeMatrix();
+	}
+	Graphics::Context->Unmap(instanceBuffer.Get(), 0);
+
+	Graphics::Context->VSSetShaderResources(0, 1, instanceSRV.GetAddressOf());
+}
+
+
+// --------------------------------------------------------
+// Upload an array to a dynamic structured buffer
+// 
+// - Grows by doubling from 64 elements, and always keeps at
+//   least one element so the view is valid while empty
+// --------------------------------------------------------
+void Game::UploadStructuredBuffer(
+	const void* data,
+	unsigned int count,
+	unsigned int stride,
+	Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv,
+	unsigned int& capacity)
+{
+	if (count > capacity || !buffer)
+	{
+		unsigned int newCapacity = capacity > 0 ? capacity : 64;
+		while (newCapacity < count)
+			newCapacity *= 2;
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.ByteWidth = newCapacity * stride;
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = stride;
+		buffer.Reset();
+		srv.Reset();
+		Graphics::Device->CreateBuffer(&bufferDesc, 0, buffer.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = newCapacity;
+		Graphics::Device->CreateShaderResourceView(buffer.Get(), &srvDesc, srv.GetAddressOf());
+		capacity = newCapacity;
+	}
+
+	if (count == 0)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	Graphics::Context->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	memcpy(mapped.pData, data, (size_t)count * stride);
+	Graphics::Context->Unmap(buffer.Get(), 0);
+}
+
+// --------------------------------------------------------
+// Cluster the scene's point and spot lights
+// 
+// - Directional lights reach every pixel and stay in the
+//   pixel shaders' frame data, so they are skipped here
+// - An orthographic camera has no depth slicing to use, so
+//   every cluster then lists every light
+// --------------------------------------------------------
+void Game::BuildLightClusters()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Split the point and spot lights out of the scene's lights.
+	localLights.clear();
+	clusterLights.clear();
+	for (const Lights& light : lightArray)
+	{
+		if (light.type == LIGHT_TYPE_DIRECTIONAL)
+			continue;
+
+		localLights.push_back(light);
+		ClusterLight clusterLight = {};
+		clusterLight.type = (unsigned int)light.type;
+		clusterLight.position = light.position;
+		clusterLight.range = light.range;
+		clusterLight.direction = light.direction;
+		clusterLight.spotOuterAngle = light.spotOuterAngle;
+		clusterLights.push_back(clusterLight);
+	}
+
+	// Assign them to the active camera's clusters.
+	lightClusters.SetProjection(activeCamera->GetProjectionMatrix(), activeCamera->GetNearClip(), activeCamera->GetFarClip());
+	if (activeCamera->GetPerspective())
+		clusterLightIndexCount = lightClusters.Build(activeCamera->GetViewMatrix(), clusterLights.data(), clusterLights.size());
+	else
+		clusterLightIndexCount = lightClusters.BuildAll(clusterLights.size());
+
+	// Upload the lights, every cluster's range and the index list, and bind them.
+	UploadStructuredBuffer(localLights.data(), (unsigned int)localLights.size(), sizeof(Lights),
+		localLightBuffer, localLightSRV, localLightCapacity);
+	UploadStructuredBuffer(lightClusters.GetRanges(), LightClusters::CLUSTER_COUNT, sizeof(LightClusters::ClusterRange),
+		clusterRangeBuffer, clusterRangeSRV, clusterRangeCapacity);
+	UploadStructuredBuffer(lightClusters.GetLightIndices(), (unsigned int)clusterLightIndexCount, sizeof(unsigned int),
+		clusterIndexBuffer, clusterIndexSRV, clusterIndexCapacity);
+
+	ID3D11ShaderResourceView* clusterSRVs[3] = { localLightSRV.Get(), clusterRangeSRV.Get(), clusterIndexSRV.Get() };
+	Graphics::Context->PSSetShaderResources(5, 3, clusterSRVs);
+
+	clusterBuildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Scatter random point and spot lights over the entities
+// 
+// - Seeded the same way every time, so a count always
+//   gives the same lights
+// --------------------------------------------------------
+void Game::ScatterLights(int count)
+{
+	lightArray.resize(5 + (count > 0 ? count : 0));
+
+	std::mt19937 random(2024);
+	std::uniform_real_distribution<float> xs(-14.0f, 14.0f);
+	std::uniform_real_distribution<float> ys(-3.0f, 26.0f);
+	std::uniform_real_distribution<float> zs(-6.0f, 6.0f);
+	std::uniform_real_distribution<float> ranges(1.5f, 5.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (size_t i = 5; i < lightArray.size(); i++)
+	{
+		Lights light = {};
+		light.type = (i % 2 == 0) ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT;
+		light.position = XMFLOAT3(xs(random), ys(random), zs(random));
+		light.range = ranges(random);
+		light.color = XMFLOAT3(unit(random), unit(random), unit(random));
+		light.intensity = 1.0f + 2.0f * unit(random);
+
+		// Spot lights shine down (the cone opens along -direction).
+		light.direction = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		light.spotInnerAngle = XMConvertToRadians(20.0f);
+		light.spotOuterAngle = XMConvertToRadians(40.0f);
+		lightArray[i] = light;
+	}
+}
+
 // --------------------------------------------------------
 // Handle resizing to match the new window size
 //  - Eventually, we'll want to update our 3D camera
@@ -1813,25 +2403,51 @@ void Game::FillAndBindNextConstantBuffer(void* data, unsigned int dataSizeInByte
 {
 	// How much reserved byte space is avialiable for this cb heap data.
 	// It has to be a multiple of 256.
-	unsigned int reservationDataSize = (dataSizeInBytes + 255) / 256 * 256;
+	unsigned int reservationDataSize = ConstantBufferRing::Align(dataSizeInBytes);
+
+	// Ask the ring for the next portion no frame still in flight uses.
+	unsigned int cbHeapOffsetInByte = cbRing.Allocate(dataSizeInBytes);
+
+	// If it only fits over data the GPU may still read, first free whatever
+	// frames have finished since the frame started and try again.
+	if (cbHeapOffsetInByte == ConstantBufferRing::INVALID_OFFSET)
+	{
+		RetireFinishedConstantFrames();
+		cbHeapOffsetInByte = cbRing.Allocate(dataSizeInBytes);
+	}
 
-	// If the next location byte in memory plus the new data byte size for the data
-	// is greater||= than the total heap bype size, it is out of bounds and reset the
-	// ring buffer loop location to the start 0. If byte location after the last byte.
-	if (cbHeapOffsetInByte + reservationDataSize >= cbHeapSizeInByte)
+	// Still no room: the space is held by frames the GPU has not finished, so
+	// wait for the oldest one and try again rather than grow the heap for a
+	// GPU hitch.
+	while (cbHeapOffsetInByte == ConstantBufferRing::INVALID_OFFSET && cbRing.HasFramesInFlight())
 	{
-		// Set cb heap location in byte to 0 (loop back).
-		cbHeapOffsetInByte = 0;
+		WaitForConstantFrame(cbRing.GetOldestFrameInFlight());
+		cbHeapOffsetInByte = cbRing.Allocate(dataSizeInBytes);
+	}
+
+	// Still no room with every earlier frame freed: this frame alone needs more
+	// than the heap holds, so grow it. The draws already recorded keep reading
+	// the old heap, which D3D keeps alive until they are done.
+	if (cbHeapOffsetInByte == ConstantBufferRing::INVALID_OFFSET)
+	{
+		unsigned int newSize = cbHeapSizeInByte * 2;
+		while (newSize < reservationDataSize)
+			newSize *= 2;
+		CreateConstantBufferHeap(newSize);
+		cbHeapGrowths++;
+		cbHeapOffsetInByte = cbRing.Allocate(dataSizeInBytes);
 	}
 
 	// Map/Find the CBH data by overwiting data not used by the GPU.
+	// - A new heap is mapped with discard once, so the driver knows it starts empty
 	D3D11_MAPPED_SUBRESOURCE map{};
 	ringBufferContext->Map(
 		constantBufferHeap.Get(),
 		0,
-		D3D11_MAP_WRITE_NO_OVERWRITE,
+		cbHeapNeedsDiscard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE,
 		0,
 		&map);
+	cbHeapNeedsDiscard = false;
 
 	// Get the address of the location of the unpecified type of data using the
 	// address index of the mapped{} CHB in and the added index of the location
@@ -1875,8 +2491,76 @@ void Game::FillAndBindNextConstantBuffer(void* data, unsigned int dataSizeInByte
 			break;
 	}
 
-	// Get the new offest position for the next data location memcopy.
-	cbHeapOffsetInByte += reservationDataSize;
+	// Count the traffic for the constant data report.
+	cbFrameBytesCopied += dataSizeInBytes;
+	cbFrameBytesReserved += reservationDataSize;
+}
+
+// --------------------------------------------------------
+// Create the constant buffer heap with the given size
+// 
+// - Starts the ring over in the new heap; frames still in
+//   flight keep reading the old one, which D3D releases
+//   once the GPU is done with it
+// --------------------------------------------------------
+void Game::CreateConstantBufferHeap(unsigned int sizeInBytes)
+{
+	// The heap size must be in the next multiple of 256 (needed byte size).
+	cbHeapSizeInByte = ConstantBufferRing::Align(sizeInBytes);
+
+	// Create the set of options or instructions to create the CBH.
+	D3D11_BUFFER_DESC cbHeapDesc = {};
+	cbHeapDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbHeapDesc.ByteWidth = cbHeapSizeInByte;
+	cbHeapDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	cbHeapDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+	// Create the CBH.
+	constantBufferHeap.Reset();
+	Graphics::Device->CreateBuffer(&cbHeapDesc, 0, constantBufferHeap.GetAddressOf());
+
+	cbRing.Reset(cbHeapSizeInByte);
+	cbHeapNeedsDiscard = true;
+}
+
+// --------------------------------------------------------
+// Free the heap space of every finished frame
+// 
+// - Frames finish in order, so this stops at the first
+//   fence the GPU has not passed
+// - Never flushes or waits, so it is cheap to call
+//   whenever an allocation does not fit
+// --------------------------------------------------------
+void Game::RetireFinishedConstantFrames()
+{
+	while (cbRing.HasFramesInFlight())
+	{
+		uint64_t frame = cbRing.GetOldestFrameInFlight();
+		ID3D11Query* fence = cbFrameFences[frame % CB_FRAMES_IN_FLIGHT].Get();
+		if (Graphics::Context->GetData(fence, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			break;
+
+		cbRing.RetireFramesThrough(frame);
+		cbFenceFrames[frame % CB_FRAMES_IN_FLIGHT] = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Wait for the GPU to finish a frame, then free the heap
+// space of every frame up to it
+// 
+// - Flushes first so the frame's fence is actually
+//   submitted, and yields while waiting instead of spinning
+// --------------------------------------------------------
+void Game::WaitForConstantFrame(uint64_t frame)
+{
+	ID3D11Query* fence = cbFrameFences[frame % CB_FRAMES_IN_FLIGHT].Get();
+	Graphics::Context->Flush();
+	while (Graphics::Context->GetData(fence, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_FALSE)
+		std::this_thread::yield();
+
+	cbRing.RetireFramesThrough(frame);
+	cbFenceFrames[frame % CB_FRAMES_IN_FLIGHT] = 0;
 }
 
 
@@ -1919,11 +2603,14 @@ void Game::Update(float deltaTime, float totalTime)
 	//// Rotate the third square with time on its z axis.
 	//listOfEntities[2].GetTransform().Rotate(XMFLOAT3(0.0f, 0.0f, static_cast<float>(deltaTime * 3.5)));
 
-	// Rotate all the entities except the last entity with time.
-	for (int i = 0; i < listOfEntities.size() - 1; i++)
+	// Rotate all the entities except the ground with time.
+	const EntityHandle* entityHandles = entities.GetHandles();
+	Transform* entityTransforms = entities.GetTransforms();
+	for (int i = 0; i < entities.GetCount(); i++)
 	{
 		// Get the object transformation and rotate with time.
-		listOfEntities[i].GetTransform().Rotate(XMFLOAT3(0.0f, 1.0f * deltaTime, 0.0f));
+		if (entityHandles[i].index != groundEntity.index)
+			entityTransforms[i].Rotate(XMFLOAT3(0.0f, 1.0f * deltaTime, 0.0f));
 	}
 
 	// Create a light view and projection matrix based on light[2] directional light.
@@ -1946,6 +2633,14 @@ void Game::Update(float deltaTime, float totalTime)
 	// Update the input and view matrix camera each frame.
 	// Get update the active camera each time.
 	activeCamera.get()->Update(deltaTime);
+
+	// Rebuild the matrices of every transform changed this frame in one batch,
+	// before anything is drawn.
+	TransformSystem::Global().UpdateDirty();
+
+	// Pick the entity under the mouse with a right click.
+	if (Input::MouseRightPress())
+		PickEntity();
 }
 
 
@@ -1958,6 +2653,24 @@ void Game::Draw(float deltaTime, float totalTime)
 	// - These things should happen ONCE PER FRAME
 	// - At the beginning of Game::Draw() before drawing *anything*
 	{
+		// Keep the last frame's constant data traffic and start counting again.
+		cbLastFrameBytesCopied = cbFrameBytesCopied;
+		cbLastFrameBytesReserved = cbFrameBytesReserved;
+		materialLastFrameBytes = materialFrameBytes;
+		cbFrameBytesCopied = 0;
+		cbFrameBytesReserved = 0;
+		materialFrameBytes = 0;
+
+		// Start this frame's portion of the constant buffer heap.
+		// - The fence this frame reuses belongs to the frame CB_FRAMES_IN_FLIGHT ago,
+		//   so wait for that one (it is almost always done already)
+		cbFrameIndex++;
+		unsigned int fenceSlot = (unsigned int)(cbFrameIndex % CB_FRAMES_IN_FLIGHT);
+		if (cbFenceFrames[fenceSlot] != 0)
+			WaitForConstantFrame(cbFenceFrames[fenceSlot]);
+		RetireFinishedConstantFrames();
+		cbRing.BeginFrame(cbFrameIndex);
+
 		// Clear the back buffer (erase what's on screen) and depth buffer
 		// Use the color picker values to create a float array.
 		float color[4] = { colorPicker.x, colorPicker.y, colorPicker.z, colorPicker.w };
@@ -1994,35 +2707,106 @@ void Game::Draw(float deltaTime, float totalTime)
 			// Set and bind the vertex shader for the shadowVS.
 			Graphics::Context->VSSetShader(shadowVS.Get(), 0, 0);
 
-			// Set the shadow VS data.
-			ShadowVSData vsdata = {};
-			vsdata.lightView = lightViewMatrix;
-			vsdata.lightProjection = lightProjectionMatrix;
-
-			// Loop all entities.
-			for (int i = 0; i < listOfEntities.size(); i++)
+			// Set the shadow VS data once for the whole pass.
+			// - The light's matrices stand in for the camera's
+			VSPassData shadowPassData = {};
+			shadowPassData.viewMatrix = lightViewMatrix;
+			shadowPassData.projectionMatrix = lightProjectionMatrix;
+			shadowPassData.lightViewMatrix = lightViewMatrix;
+			shadowPassData.lightProjectionMatrix = lightProjectionMatrix;
+			FillAndBindNextConstantBuffer(&shadowPassData, sizeof(VSPassData), D3D11_VERTEX_SHADER, 2);
+
+			// Skip entities outside the light's orthographic volume.
+			// - The world bounds gathered here are reused by the main pass
+			UpdateEntityBounds();
+			XMFLOAT4X4 lightViewProjection;
+			XMStoreFloat4x4(&lightViewProjection, XMMatrixMultiply(XMLoadFloat4x4(&lightViewMatrix), XMLoadFloat4x4(&lightProjectionMatrix)));
+			shadowPassVisibleCount = CullEntities(lightViewProjection, shadowPassVisible);
+
+			// Skip casters hidden from the light behind larger ones.
+			shadowPassOccludedCount = OccludeEntities(lightViewMatrix, lightViewProjection, shadowPassOcclusion, shadowPassVisible);
+			shadowPassVisibleCount -= shadowPassOccludedCount;
+
+			// Sort the visible entities by depth program and mesh, nearest the light first.
+			shadowPassUnsortedChanges = BuildDrawQueue(SHADOW_DRAW_PASS, shadowPassVisible, lightViewMatrix);
+			shadowPassStateChanges = {};
+
+			// Group the queue into batches of the same depth program and mesh.
+			drawQueue.BuildBatches(nullptr, useInstancing ? MAX_INSTANCES_PER_DRAW : 1, drawBatches);
+			if (drawBatches.size() < drawQueue.GetCount())
+				UploadInstances();
+			shadowPassDrawCalls = 0;
+
+			InstancedVSData instancedVSData = {};
+
+			// Loop the batches through the dense component arrays, only binding
+			// shaders and mesh buffers when they differ from the last batch's.
+			// - Batches of more than one entity whose material uses the standard
+			//   vertex shader are drawn with one instanced draw
+			Transform* entityTransforms = entities.GetTransforms();
+			const unsigned int* entityMeshIndices = entities.GetMeshIndices();
+			const unsigned int* entityMaterialIndices = entities.GetMaterialIndices();
+			const RenderQueue::DrawItem* drawItems = drawQueue.GetItems();
+			bool lastInstanced = false;
+			for (size_t b = 0; b < drawBatches.size(); b++)
 			{
-				// Get the transform class world matrix.
-				XMFLOAT4X4 entityTransformWorldMatrix = listOfEntities[i].GetTransform().GetWorldMatrix();
-
-				// Set world data to ShadowVSData.
-				vsdata.world = entityTransformWorldMatrix;
-
-				// Fill and bind the data in the CBH.
-				FillAndBindNextConstantBuffer(
-					&vsdata,
-					sizeof(ShadowVSData),
-					D3D11_VERTEX_SHADER,
-					0);
-
-				//Graphics::Context->PSSetSamplers(1, 1, shadowSampler.GetAddressOf());
-				// Set sampler in the rendering loop after binding PS material.
-				/*Graphics::Context->PSSetShaderResources(4, 1, shadowSRV.GetAddressOf());
-				Graphics::Context->PSSetSamplers(1, 1, shadowSampler.GetAddressOf());*/
-
-				// Draw the entities after their world matrix have be updated in the vertex shader
-				// using the constant shader.
-				listOfEntities[i].Draw(false);
+				const RenderQueue::DrawBatch& batch = drawBatches[b];
+				unsigned int first = drawItems[batch.first].entity;
+				unsigned int previous = b == 0 ? 0 : drawItems[drawBatches[b - 1].first].entity;
+				Mesh* entityMesh = entityMeshes[entityMeshIndices[first]].get();
+				Material* entityMaterial = entityMaterials[entityMaterialIndices[first]].get();
+
+				bool instanced = batch.count > 1 && entityMaterial->GetVertexShader() == vertexShader;
+				bool newProgram = b == 0 || instanced != lastInstanced || entityMaterialDepthPrograms[entityMaterialIndices[first]] != entityMaterialDepthPrograms[entityMaterialIndices[previous]];
+				bool newMesh = b == 0 || entityMeshIndices[first] != entityMeshIndices[previous];
+				lastInstanced = instanced;
+
+				if (newProgram)
+				{
+					BindMaterialShaders(*entityMaterial, false);
+					if (instanced)
+						Graphics::Context->VSSetShader(instancedVertexShader.Get(), 0, 0);
+					shadowPassStateChanges.shaders++;
+				}
+				if (newMesh)
+					shadowPassStateChanges.meshes++;
+
+				if (instanced)
+				{
+					instancedVSData.instanceStart = batch.first;
+					FillAndBindNextConstantBuffer(
+						&instancedVSData,
+						sizeof(InstancedVSData),
+						D3D11_VERTEX_SHADER,
+						0);
+
+					entityMesh->DrawInstanced(0, batch.count, newMesh);
+					shadowPassDrawCalls++;
+					continue;
+				}
+
+				for (unsigned int d = batch.first; d < batch.first + batch.count; d++)
+				{
+					// Set the per-object data from the transform class world matrices.
+					Transform& entityTransform = entityTransforms[drawItems[d].entity];
+					XMFLOAT4X4 entityTransformWorldMatrix = entityTransform.GetWorldMatrix();
+					XMFLOAT4X4 entityWorldInverseTransposeMatrix = entityTransform.GetInverseTransposeMatrix();
+					BufferStructs vsdata = {};
+					vsdata.worldMatrix = XMLoadFloat4x4(&entityTransformWorldMatrix);
+					vsdata.worldInverseTransposeMatrix = XMLoadFloat4x4(&entityWorldInverseTransposeMatrix);
+
+					// Fill and bind the data in the CBH.
+					FillAndBindNextConstantBuffer(
+						&vsdata,
+						sizeof(BufferStructs),
+						D3D11_VERTEX_SHADER,
+						0);
+
+					// Draw the entities after their world matrix have be updated in the vertex shader
+					// using the constant shader.
+					entityMesh->Draw(0, newMesh && d == batch.first);
+					shadowPassDrawCalls++;
+				}
 			}
 
 			// Reset the pipeline and switch/bind the ShadowDSV to the defualt RTV and DSV.
@@ -2059,137 +2843,209 @@ void Game::Draw(float deltaTime, float totalTime)
 		Graphics::Context->OMSetRenderTargets(1, ppBlurRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
 	}
 
-	// Use a for each to draw the mesh.
-	for (int i = 0; i < listOfEntities.size(); i++)
+	// View-projection and position of the camera for frustum and meshlet culling.
+	XMFLOAT4X4 cullViewProjection;
+	XMFLOAT4X4 cullView = activeCamera->GetViewMatrix();
+	XMFLOAT4X4 cullProjection = activeCamera->GetProjectionMatrix();
+	XMStoreFloat4x4(&cullViewProjection, XMMatrixMultiply(XMLoadFloat4x4(&cullView), XMLoadFloat4x4(&cullProjection)));
+	XMFLOAT3 cullCameraPosition = activeCamera->GetTransform().GetPosition();
+	meshletTrianglesDrawn = 0;
+	meshletTrianglesTotal = 0;
+
+	// Skip entities outside the camera's frustum.
+	mainPassVisibleCount = CullEntities(cullViewProjection, mainPassVisible);
+
+	// Skip entities hidden behind the largest ones in front of the camera.
+	mainPassOccludedCount = OccludeEntities(cullView, cullViewProjection, mainPassOcclusion, mainPassVisible);
+	mainPassVisibleCount -= mainPassOccludedCount;
+
+	// Sort the visible entities by shader program, material and mesh, front to back.
+	mainPassUnsortedChanges = BuildDrawQueue(MAIN_DRAW_PASS, mainPassVisible, cullView);
+	mainPassStateChanges = {};
+
+	// Pick each queued entity's level of detail from how large it is on screen.
+	Transform* entityTransforms = entities.GetTransforms();
+	const unsigned int* entityMeshIndices = entities.GetMeshIndices();
+	const unsigned int* entityMaterialIndices = entities.GetMaterialIndices();
+	const RenderQueue::DrawItem* drawItems = drawQueue.GetItems();
+	entityLods.assign(entities.GetCount(), 0);
+	if (useMeshLods)
 	{
-		// Create two new variables that hold the new struct data for the constant buffer.
-		// Using the buffer struct model.
-		BufferStructs cbStruct = {};
-
-		// Get the transform class world matrix.
-		XMFLOAT4X4 entityTransformWorldMatrix = listOfEntities[i].GetTransform().GetWorldMatrix();
-
-		// Store the loaded SIMD identity matrix of the transform class to the world matrix.
-		//XMStoreFloat4x4(&worldMatrix, XMLoadFloat4x4(&entityTranform.GetWorldMatrix()));
-
-		// Create a color tint.
-		// cbStruct.colorTint = listOfEntities[i].GetMaterial().get()->GetColorTint();
-
-		// Store the SIMD identity matrix to the world matrix.
-		cbStruct.worldMatrix = XMLoadFloat4x4(&entityTransformWorldMatrix);
-
-		// Get the view and projection matrix of our camera and set it to the constant buffer.
-		XMFLOAT4X4 cameraViewMatrix = activeCamera.get()->GetViewMatrix();
-		cbStruct.viewMatrix = XMLoadFloat4x4(&cameraViewMatrix);
-
-		XMFLOAT4X4 cameraProjectionMatrix = activeCamera.get()->GetProjectionMatrix();
-		cbStruct.projectionMatrix = XMLoadFloat4x4(&cameraProjectionMatrix);
-
-		// Get the inverse transpose matrix of the world space for the all the objects in the scene.
-		XMFLOAT4X4 entityWorldInverseTransposeMatrix = listOfEntities[i].GetTransform().GetInverseTransposeMatrix();
-
-		// Load the stored entity world IT matrix into the CBH struct.
-		cbStruct.worldInverseTransposeMatrix = XMLoadFloat4x4(&entityWorldInverseTransposeMatrix);
-
-		// Add the light view and projection to the standard VS.
-		cbStruct.lightViewMatrix = lightViewMatrix;
-		cbStruct.lightProjectionMatrix = lightProjectionMatrix;
-
-		// Call the CBH method for copying data.
-		FillAndBindNextConstantBuffer(
-			&cbStruct,
-			sizeof(cbStruct),
-			D3D11_VERTEX_SHADER,
-			0);
-
-		// Map out or get the data of the constant buffer to pause data use and
-		// address moving in the GPU.
-		//D3D11_MAPPED_SUBRESOURCE mappedPSBuffer = {};
-		//Graphics::Context->Map(
-		//	psConstantBuffer.Get(),
-		//	0,
-		//	D3D11_MAP_WRITE_DISCARD,
-		//	0,
-		//	&mappedPSBuffer
-		//);
-
-		//// Copy the new struct data into the constant buffer with the approximate size.
-		//memcpy(mappedPSBuffer.pData, &psCB1, sizeof(psCB1));
-
-		//// Unmap or realease the address of the constant buffer for the GPU to use and
-		//// move the files if necessary.
-		//Graphics::Context->Unmap(psConstantBuffer.Get(), 0);
-
-		// Create a psConstantBuffer using the pixel shader struct.
-		PixelDataStruct psCBH1 = {};
-		
-		// Add paddings to
-
-		// Set the color tint of pixel shader cbuffer to the material color.
-		psCBH1.colorTint = listOfEntities[i].GetMaterial().get()->GetColorTint();
-		psCBH1.time = DirectX::XMFLOAT2(tTime, tTime);
-
-		// Get the time and the offset of the entity material.
-		psCBH1.scale = listOfEntities[i].GetMaterial()->GetTextureScale();
-		psCBH1.offset = listOfEntities[i].GetMaterial()->GetTextureOffset();
+		for (size_t d = 0; d < drawQueue.GetCount(); d++)
+		{
+			unsigned int i = drawItems[d].entity;
+			entityLods[i] = entityMeshes[entityMeshIndices[i]]->SelectLod(entityTransforms[i].GetWorldMatrix(), *activeCamera, (float)Window::Height(), lodPixelError);
+		}
+	}
 
-		// Get the camera position and the entity material rougness value.
-		DirectX::XMFLOAT3 cameraPos = activeCamera->GetTransform().GetPosition();
+	// Group the queue into batches sharing material, mesh and level of detail.
+	drawQueue.BuildBatches(entityLods.data(), useInstancing ? MAX_INSTANCES_PER_DRAW : 1, drawBatches);
+	if (drawBatches.size() < drawQueue.GetCount())
+		UploadInstances();
+	mainPassDrawCalls = 0;
+
+	// Cluster the point and spot lights, so each pixel only lights itself with its cluster's.
+	BuildLightClusters();
+
+	// The camera and light matrices every entity shares, uploaded once for the pass.
+	VSPassData mainPassData = {};
+	mainPassData.viewMatrix = activeCamera.get()->GetViewMatrix();
+	mainPassData.projectionMatrix = activeCamera.get()->GetProjectionMatrix();
+	mainPassData.lightViewMatrix = lightViewMatrix;
+	mainPassData.lightProjectionMatrix = lightProjectionMatrix;
+	FillAndBindNextConstantBuffer(&mainPassData, sizeof(VSPassData), D3D11_VERTEX_SHADER, 2);
+	InstancedVSData instancedVSData = {};
+
+	// Create a pixel shader frame buffer with everything that is the same for
+	// every entity this frame, uploaded once.
+	{
+		PixelFrameData psFrameData = {};
+		psFrameData.time = DirectX::XMFLOAT2(tTime, tTime);
 
 		// Get the camera position.
-		psCBH1.cameraCurrentPosition = DirectX::XMFLOAT4(cameraPos.x, cameraPos.y, cameraPos.z, 0.0f);
-
-		// Get the roughness of the material.
-		psCBH1.roughness = listOfEntities[i].GetMaterial()->GetRoughness();
+		DirectX::XMFLOAT3 cameraPos = activeCamera->GetTransform().GetPosition();
+		psFrameData.cameraCurrentPosition = DirectX::XMFLOAT4(cameraPos.x, cameraPos.y, cameraPos.z, 0.0f);
 
 		// Get the ambient color.
 		// Use the background color picker.
-		psCBH1.ambientColor = colorPicker;
+		psFrameData.ambientColor = colorPicker;
 
 		// Copy the initialized direction light struct of the game class to 
 		// the pixel shader struct light using memcpy.
-		memcpy(&psCBH1.directionalLight1, &dLight1, sizeof(Lights));
+		memcpy(&psFrameData.directionalLight1, &dLight1, sizeof(Lights));
 
-		// Copy the light array to the struct for the CBH.
-		memcpy(&psCBH1.lightArray[0], &lightArray[0], sizeof(Lights) * 5);
+		// Copy the directional lights to the struct for the CBH.
+		// - The point and spot lights are in the light clusters
+		for (const Lights& light : lightArray)
+		{
+			if (light.type == LIGHT_TYPE_DIRECTIONAL && psFrameData.directionalLightCount < MAX_DIRECTIONAL_LIGHTS)
+			{
+				psFrameData.directionalLights[psFrameData.directionalLightCount++] = light;
+			}
+		}
+
+		// Tiles per pixel across and down the screen, and the depth slicing.
+		psFrameData.clusterTileScale = DirectX::XMFLOAT2(
+			(float)LightClusters::TILES_X / Window::Width(),
+			(float)LightClusters::TILES_Y / Window::Height());
+		psFrameData.clusterSliceScale = lightClusters.GetSliceScale();
+		psFrameData.clusterSliceBias = lightClusters.GetSliceBias();
 
 		FillAndBindNextConstantBuffer(
-			&psCBH1,
-			sizeof(PixelDataStruct),
+			&psFrameData,
+			sizeof(PixelFrameData),
 			D3D11_PIXEL_SHADER,
 			0);
+	}
+
+	// Walk the batches through the dense component arrays to draw the meshes.
+	// - Meshes and materials are looked up by index, so no shared_ptr is copied per entity
+	// - Shaders, material textures and mesh buffers are only bound when they
+	//   differ from the previous batch's
+	// - Batches of more than one entity whose material uses the standard vertex
+	//   shader are drawn with one instanced draw and InstancedVertexShader
+	bool lastInstanced = false;
+	for (size_t b = 0; b < drawBatches.size(); b++)
+	{
+		const RenderQueue::DrawBatch& batch = drawBatches[b];
+		unsigned int first = drawItems[batch.first].entity;
+		unsigned int previous = b == 0 ? 0 : drawItems[drawBatches[b - 1].first].entity;
+
+		// Get the batch's mesh and material.
+		Mesh* entityMesh = entityMeshes[entityMeshIndices[first]].get();
+		Material* entityMaterial = entityMaterials[entityMaterialIndices[first]].get();
+		unsigned int lod = entityLods[first];
+
+		bool instanced = batch.count > 1 && entityMaterial->GetVertexShader() == vertexShader;
+		bool newProgram = b == 0 || instanced != lastInstanced || entityMaterialPrograms[entityMaterialIndices[first]] != entityMaterialPrograms[entityMaterialIndices[previous]];
+		bool newMaterial = b == 0 || entityMaterialIndices[first] != entityMaterialIndices[previous];
+		bool newMesh = b == 0 || entityMeshIndices[first] != entityMeshIndices[previous];
+		lastInstanced = instanced;
+
+		// Get the material of the current entity and set its texture srv's, sampler state
+		// and constants (tint, texture scale and offset, roughness) active by binding them
+		// to its pshaders registers for use.
+		// - The constants are only uploaded again when the material changed them
+		if (newMaterial)
+		{
+			entityMaterial->BindTexturesAndSamplers();
+			materialFrameBytes += entityMaterial->BindConstants();
+			mainPassStateChanges.materials++;
+		}
+
+		// Bind the material's shaders, swapping in the instanced vertex shader.
+		if (newProgram)
+		{
+			BindMaterialShaders(*entityMaterial, true);
+			if (instanced)
+				Graphics::Context->VSSetShader(instancedVertexShader.Get(), 0, 0);
+			mainPassStateChanges.shaders++;
+		}
+		if (newMesh)
+			mainPassStateChanges.meshes++;
+
+		unsigned int lodTriangles = entityMesh->GetLod(lod).indexCount / 3;
+		meshletTrianglesTotal += lodTriangles * batch.count;
+
+		// Draw every instance of the batch at once.
+		// - Meshlets are not culled per instance, so instanced batches draw their whole level
+		if (instanced)
+		{
+			instancedVSData.instanceStart = batch.first;
+			FillAndBindNextConstantBuffer(
+				&instancedVSData,
+				sizeof(InstancedVSData),
+				D3D11_VERTEX_SHADER,
+				0);
+
+			entityMesh->DrawInstanced(lod, batch.count, newMesh);
+			meshletTrianglesDrawn += lodTriangles * batch.count;
+			mainPassDrawCalls++;
+			continue;
+		}
 
-		// ---------------------------------------------------------------------------------------
-
-		// Map out or get the data of the constant buffer to pause data use and
-		// address moving in the GPU.
-		//D3D11_MAPPED_SUBRESOURCE mappedBuffer = {};
-		//Graphics::Context->Map(
-		//	constantBuffer.Get(),
-		//	0,
-		//	D3D11_MAP_WRITE_DISCARD,
-		//	0,
-		//	&mappedBuffer
-		//);
-
-		//// Copy the new struct data into the constant buffer with the approximate size.
-		//memcpy(mappedBuffer.pData, &cbStruct, sizeof(cbStruct));
-
-		//// Unmap or realease the address of the constant buffer for the GPU to use and
-		//// move the files if necessary.
-		//Graphics::Context->Unmap(constantBuffer.Get(), 0);
-
-		// Get the material of the current entity and set its texture srv's and sampler state 
-		// active by binding it to its pshaders register for use.
-		listOfEntities[i].GetMaterial()->BindTexturesAndSamplers();
-
-		//// Set sampler in the rendering loop after binding PS material.
-		//Graphics::Context->PSSetShaderResources(4, 1, shadowSRV.GetAddressOf());
-		//Graphics::Context->PSSetSamplers(1, 1, shadowSampler.GetAddressOf());
-
-		// Draw the entities after their world matrix have be updated in the vertex shader
-		// using the constant shader.
-		listOfEntities[i].Draw(true);
+		// Otherwise draw the batch's entities one at a time.
+		for (unsigned int d = batch.first; d < batch.first + batch.count; d++)
+		{
+			unsigned int i = drawItems[d].entity;
+
+			// Create a new variable that holds the per-object struct data for the constant buffer.
+			// Using the buffer struct model.
+			// - The camera and light matrices are already bound for the whole pass
+			BufferStructs cbStruct = {};
+
+			// Get the transform class world matrix.
+			XMFLOAT4X4 entityTransformWorldMatrix = entityTransforms[i].GetWorldMatrix();
+
+			// Store the SIMD identity matrix to the world matrix.
+			cbStruct.worldMatrix = XMLoadFloat4x4(&entityTransformWorldMatrix);
+
+			// Get the inverse transpose matrix of the world space for the all the objects in the scene.
+			XMFLOAT4X4 entityWorldInverseTransposeMatrix = entityTransforms[i].GetInverseTransposeMatrix();
+
+			// Load the stored entity world IT matrix into the CBH struct.
+			cbStruct.worldInverseTransposeMatrix = XMLoadFloat4x4(&entityWorldInverseTransposeMatrix);
+
+			// Call the CBH method for copying data.
+			FillAndBindNextConstantBuffer(
+				&cbStruct,
+				sizeof(cbStruct),
+				D3D11_VERTEX_SHADER,
+				0);
+
+			// Draw the entities after their world matrix have be updated in the vertex shader
+			// using the constant shader.
+			// - With meshlet culling only the meshlets the camera can see are drawn
+			bool bindBuffers = newMesh && d == batch.first;
+			if (useMeshletCulling)
+				meshletTrianglesDrawn += entityMesh->DrawCulled(lod, entityTransformWorldMatrix, cullViewProjection, cullCameraPosition, bindBuffers);
+			else
+			{
+				entityMesh->Draw(lod, bindBuffers);
+				meshletTrianglesDrawn += lodTriangles;
+			}
+			mainPassDrawCalls++;
+		}
 	}
 
 	// Draw the sky last to minimin rendering pixel behind objects that are not displayed.
@@ -2316,7 +3172,7 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	// Tells Imgui to gets its buffer data information and feed the data to another funtion.
 	{
-		ImGui::Render(); // Turns this frames UI into renderable triangles
+		ImGui::Render(); // Turns this frames UI into renderable triangles
 		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData()); // Draws it to the screen
 	}
 
@@ -2324,6 +3180,13 @@ void Game::Draw(float deltaTime, float totalTime)
 	// - These should happen exactly ONCE PER FRAME
 	// - At the very end of the frame (after drawing *everything*)
 	{
+		// Fence this frame's constant data: once the GPU passes the query,
+		// its portion of the heap can be handed out again.
+		unsigned int fenceSlot = (unsigned int)(cbFrameIndex % CB_FRAMES_IN_FLIGHT);
+		Graphics::Context->End(cbFrameFences[fenceSlot].Get());
+		cbFenceFrames[fenceSlot] = cbFrameIndex;
+		cbRing.EndFrame();
+
 		// Present at the end of the frame
 		bool vsync = Graphics::VsyncState();
 		Graphics::SwapChain->Present(
@@ -5,13 +5,23 @@
 #include <wrl/client.h>
 #include <vector>
 #include <memory>
+#include <utility>
 #include <DirectXMath.h>
 
 // Include the mesh class.
 #include "Mesh.h"
 
-// Include entity class.
-#include "Entity.h"
+// Include the entity registry and the hierarchy over its bounds.
+#include "EntityRegistry.h"
+#include "BoundingVolumeHierarchy.h"
+#include "OcclusionBuffer.h"
+#include "RenderQueue.h"
+
+// Include the constant buffer heap's frame-by-frame allocator.
+#include "ConstantBufferRing.h"
+
+// Include the clustered light assignment.
+#include "LightClusters.h"
 
 // Add a camera class.
 #include "Camera.h"
@@ -67,6 +77,7 @@ public:
 
 	void LoadVertexShader();
 	void LoadShadowVertexShader();
+	void LoadInstancedVertexShader();
 	//void LoadPixelShader(std::wstring shaderCso, Microsoft::WRL::ComPtr<ID3D11PixelShader>& pixelShaderType);
 	void LoadPPVertexShader();
 	void LoadPPBlurPixelShader();
@@ -81,6 +92,59 @@ private:
 	//void LoadShaders();
 	void CreateGeometry();
 
+	// Add a mesh or material to the tables entities index into, returning its index.
+	unsigned int AddEntityMesh(std::shared_ptr<Mesh> mesh);
+	unsigned int AddEntityMaterial(std::shared_ptr<Material> material);
+
+	// Set a material's input layout and shaders.
+	void BindMaterialShaders(Material& material, bool bindPixelShader);
+
+	// Gather every entity's world bounding sphere and box, and bring the
+	// entity hierarchy up to date with them.
+	void UpdateEntityBounds();
+
+	// Pick the entity under the mouse by casting a ray through the hierarchy.
+	void PickEntity();
+
+	// Fill the draw queue with a pass's visible entities and sort it by state.
+	RenderQueue::StateChanges BuildDrawQueue(unsigned int pass, const std::vector<unsigned char>& visible, const DirectX::XMFLOAT4X4& viewMatrix);
+
+	// Copy the queued entities' matrices into the instance buffer and bind it.
+	void UploadInstances();
+
+	// Write "count" elements of "stride" bytes into a dynamic structured buffer,
+	// growing it (and its view) first if they do not fit.
+	void UploadStructuredBuffer(
+		const void* data,
+		unsigned int count,
+		unsigned int stride,
+		Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer,
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv,
+		unsigned int& capacity);
+
+	// Cluster the point and spot lights for the active camera, upload the
+	// lights and cluster lists and bind them to pixel shader t5 to t7.
+	void BuildLightClusters();
+
+	// Replace the lights after the first five with "count" random point and spot lights.
+	void ScatterLights(int count);
+
+	// (Re)create the constant buffer heap with the given size, starting the ring over.
+	void CreateConstantBufferHeap(unsigned int sizeInBytes);
+
+	// Free the heap space of every frame the GPU has finished, oldest first,
+	// without waiting for the ones it has not.
+	void RetireFinishedConstantFrames();
+
+	// Wait for the GPU to finish a frame, then free the heap space of every frame up to it.
+	void WaitForConstantFrame(uint64_t frame);
+
+	// Mark the entities inside a view-projection's frustum, returning how many are.
+	unsigned int CullEntities(const DirectX::XMFLOAT4X4& viewProjectionMatrix, std::vector<unsigned char>& visible);
+
+	// Unmark the visible entities hidden behind the largest ones in a view, returning how many were.
+	unsigned int OccludeEntities(const DirectX::XMFLOAT4X4& viewMatrix, const DirectX::XMFLOAT4X4& viewProjectionMatrix, OcclusionBuffer& buffer, std::vector<unsigned char>& visible);
+
 	// Create a count pointer for ImGui initialization.
 	int count;
 
@@ -117,6 +181,10 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> vertexShader;
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
 
+	// Vertex shader for instanced entities; it takes the same vertices as
+	// vertexShader, so it shares its input layout.
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> instancedVertexShader;
+
 	// Create 3 pixel shader that uses the uv data, normal data and a custom pixel shader.
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> debugUVsPS;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> debugNormalsPS;
@@ -138,6 +206,79 @@ private:
 	std::shared_ptr<Material> materialForShaders2;
 	std::shared_ptr<Material> customMaterialForShaders;
 
+	// Mesh level of detail selection.
+	bool useMeshLods;
+	float lodPixelError;
+
+	// Meshlet culling, and the triangles drawn out of those submitted last frame.
+	bool useMeshletCulling;
+	unsigned int meshletTrianglesDrawn;
+	unsigned int meshletTrianglesTotal;
+
+	// Entity frustum culling: world bounding spheres gathered once per frame,
+	// which entities each pass draws, and how many were drawn and skipped.
+	bool useFrustumCulling;
+	BoundingSpheres entityBounds;
+	std::vector<unsigned char> mainPassVisible;
+	std::vector<unsigned char> shadowPassVisible;
+	unsigned int mainPassVisibleCount;
+	unsigned int shadowPassVisibleCount;
+
+	// Hierarchy over the entities' world boxes for culling and picking.
+	// - Refit every frame and rebuilt when its cost has grown too far past
+	//   the cost it was built with
+	bool useEntityBvh;
+	std::vector<AxisAlignedBox> entityBoxes;
+	BoundingVolumeHierarchy entityBvh;
+	float entityBvhBuiltCost;
+	std::vector<unsigned int> entityQueryResults;
+
+	// Occlusion culling: each pass draws the coarsest levels of detail of the
+	// MAX_OCCLUDERS visible entities that look largest into a low resolution
+	// depth buffer, then skips the entities whose boxes are hidden behind them.
+	// - The shadow pass looks from the light, since casters hidden from the
+	//   light add nothing to the shadow map
+	static constexpr unsigned int MAX_OCCLUDERS = 16;
+	bool useOcclusionCulling;
+	OcclusionBuffer mainPassOcclusion;
+	OcclusionBuffer shadowPassOcclusion;
+	std::vector<std::pair<float, unsigned int>> occluderCandidates;
+	unsigned int mainPassOccludedCount;
+	unsigned int shadowPassOccludedCount;
+
+	// The entity last picked with a right click.
+	EntityHandle pickedEntity;
+	bool hasPickedEntity;
+
+	// Draw queue pass ids; the shadow pass is drawn first.
+	static constexpr unsigned int SHADOW_DRAW_PASS = 0;
+	static constexpr unsigned int MAIN_DRAW_PASS = 1;
+
+	// Each pass's visible entities with their sort keys, sorted so draws
+	// sharing shaders, materials and meshes are submitted together.
+	// - The state changes are counted before and after sorting to show
+	//   how many binds the sort saved last frame
+	bool useDrawSorting;
+	RenderQueue drawQueue;
+	RenderQueue::StateChanges mainPassUnsortedChanges;
+	RenderQueue::StateChanges mainPassStateChanges;
+	RenderQueue::StateChanges shadowPassUnsortedChanges;
+	RenderQueue::StateChanges shadowPassStateChanges;
+
+	// Instanced drawing: runs of queued draws sharing material, mesh and
+	// level of detail are drawn with one DrawIndexedInstanced, reading
+	// their matrices from a structured buffer filled once per pass.
+	// - The instance buffer grows to fit the largest queue so far
+	static constexpr unsigned int MAX_INSTANCES_PER_DRAW = 1024;
+	bool useInstancing;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> instanceSRV;
+	unsigned int instanceCapacity;
+	std::vector<RenderQueue::DrawBatch> drawBatches;
+	std::vector<unsigned int> entityLods;
+	unsigned int mainPassDrawCalls;
+	unsigned int shadowPassDrawCalls;
+
 	// Create PRB materials for Pixel Shader.
 	// Create a material vector list to hold created shared pointer materials.
 	std::vector <std::shared_ptr<Material>> listOfMaterials;
@@ -160,10 +301,37 @@ private:
 	// Create a size of the ring constant buffer heap in byte for the memory.
 	unsigned int cbHeapSizeInByte;
 
-	// Create a size for the position of the next empty unused portion of the
-	// constant buffer heap memory to keep track of unallocated byte space in
-	// the memory.
-	unsigned int cbHeapOffsetInByte;
+	// Hands out the portions of the constant buffer heap, and keeps each frame's
+	// portions untouched until that frame's fence says the GPU has read them.
+	ConstantBufferRing cbRing;
+
+	// How many frames the heap keeps data for at once; starting a frame waits
+	// for the fence of the frame this many frames ago.
+	static constexpr unsigned int CB_FRAMES_IN_FLIGHT = 4;
+
+	// An event query ended after each frame's commands, used as the frame's
+	// fence, and the frame each one was last ended for (0 if none is pending).
+	Microsoft::WRL::ComPtr<ID3D11Query> cbFrameFences[CB_FRAMES_IN_FLIGHT];
+	uint64_t cbFenceFrames[CB_FRAMES_IN_FLIGHT];
+
+	// Id of the frame being drawn, counted from 1.
+	uint64_t cbFrameIndex;
+
+	// Whether the heap is new, so its first map discards instead of appending.
+	bool cbHeapNeedsDiscard;
+
+	// How many times a frame overflowed the heap and it had to grow.
+	unsigned int cbHeapGrowths;
+
+	// Constant data traffic: bytes copied into and reserved from the heap
+	// and bytes materials uploaded to their own buffers, counted through
+	// the frame and kept from the last whole frame for the UI.
+	unsigned int cbFrameBytesCopied;
+	unsigned int cbFrameBytesReserved;
+	unsigned int materialFrameBytes;
+	unsigned int cbLastFrameBytesCopied;
+	unsigned int cbLastFrameBytesReserved;
+	unsigned int materialLastFrameBytes;
 
 	// Create a pixel constant buffer using the pixeldata struct.
 	Microsoft::WRL::ComPtr<ID3D11Buffer> psConstantBuffer;
@@ -182,17 +350,24 @@ private:
 	std::shared_ptr<Mesh> sphere;
 	std::shared_ptr<Mesh> torus;
 
-	// Create an five entity.
-	Entity entity1;
-	Entity entity2;
-	Entity entity3;
-	Entity entity4;
-	Entity entity5;
-	Entity entity6;
-	Entity entity7;
-	
-	// Create a list of entities.
-	std::vector<Entity> listOfEntities;
+	// Every entity in the scene, and the mesh and material tables their
+	// mesh and material indices point into.
+	EntityRegistry entities;
+	std::vector<std::shared_ptr<Mesh>> entityMeshes;
+	std::vector<std::shared_ptr<Material>> entityMaterials;
+
+	// Shader program ids of each entity material, for the draw queue keys:
+	// materials with the same input layout, vertex and pixel shader share
+	// a program, and the depth program ignores the pixel shader.
+	std::vector<unsigned int> entityMaterialPrograms;
+	std::vector<unsigned int> entityMaterialDepthPrograms;
+
+	// The ground plane, which does not spin with the other entities.
+	EntityHandle groundEntity;
+
+	// Parent transforms for the six rows of seven entities, so each row can
+	// be moved as a group.
+	Transform entityRows[6];
 
 	// Add a shared ptr Camera Class.
 	std::shared_ptr<Camera> camera1;
@@ -209,8 +384,29 @@ private:
 	// Create a Light struct object and fill it with data values.
 	Lights dLight1;
 
-	// Create five light and place them in an array.
-	Lights lightArray[5];
+	// Create the scene lights and place them in an array.
+	// - The first five are the ones the UI edits, any after them are scattered
+	//   point and spot lights
+	std::vector<Lights> lightArray;
+
+	// Clustered forward lighting: directional lights go in the pixel shaders'
+	// frame data, point and spot lights are split out each frame and listed
+	// per light cluster in structured buffers.
+	LightClusters lightClusters;
+	std::vector<ClusterLight> clusterLights;
+	std::vector<Lights> localLights;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> localLightBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> localLightSRV;
+	unsigned int localLightCapacity;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterRangeBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterRangeSRV;
+	unsigned int clusterRangeCapacity;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterIndexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterIndexSRV;
+	unsigned int clusterIndexCapacity;
+	int scatteredLightCount;
+	size_t clusterLightIndexCount;
+	float clusterBuildMilliseconds;
 
 	// Boolean to initialize once.
 	bool lightInitialized;
@@ -0,0 +1,63 @@
+// Add the include shader file here.
+#include "ShaderIncludeFile.hlsli"
+
+// Per-draw data shared by every instance of the draw.
+cbuffer VSExternalData : register(b0)
+{
+    // Where this draw's instances start in the instance buffer
+    // (SV_InstanceID always starts at 0).
+    uint instanceStart;
+}
+
+// Same per-pass data as VertexShader.hlsl.
+cbuffer VSPassData : register(b2)
+{
+    matrix viewMatrix;
+    matrix projectionMatrix;
+    matrix lightView;
+    matrix lightProjection;
+}
+
+// Per-instance matrices, filled once per pass by Game::Draw.
+struct InstanceData
+{
+    matrix worldMatrix;
+    matrix worldInverseTransposeMatrix;
+};
+
+StructuredBuffer<InstanceData> instances : register(t0);
+
+// --------------------------------------------------------
+// Vertex shader for entities drawn with DrawIndexedInstanced
+//
+// - Reads each instance's world and inverse transpose world
+//   matrices from the instance buffer, then does exactly
+//   what VertexShader.hlsl does with them
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input, uint instanceID : SV_InstanceID)
+{
+    InstanceData instance = instances[instanceStart + instanceID];
+    matrix worldMatrix = instance.worldMatrix;
+
+	// Set up output struct
+    VertexToPixel output;
+
+	// Get the world, to view, to projection matrix.
+    matrix wvp = mul(projectionMatrix, mul(viewMatrix, worldMatrix));
+    output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+
+    output.uv = input.uv;
+
+	// The tangent and normal need to be in world space.
+    output.tangent = normalize(mul((float3x3) worldMatrix, input.tangent));
+    output.normal = normalize(mul((float3x3) instance.worldInverseTransposeMatrix, input.normal));
+
+	// Get the world position of the vertex using the local position and the world matrix.
+    output.worldPosition = mul(worldMatrix, float4(input.localPosition, 1.0f)).xyz;
+
+    // Get the shadow map position.
+    matrix shadowWVP = mul(lightProjection, mul(lightView, worldMatrix));
+    output.shadowMapPos = mul(shadowWVP, float4(input.localPosition, 1.0f));
+
+    return output;
+}
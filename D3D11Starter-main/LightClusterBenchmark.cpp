@@ -0,0 +1,266 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "LightClusters.h"
+#include "Parallel.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless light clustering benchmark
+//
+// - Scatters 1k to 64k point and spot lights (half of each)
+//   in front of a camera like the Game's and times
+//   LightClusters::Build on one thread and on all of them
+// - Checks that any thread count gives the same lists, that every list
+//   holds exactly the lights a one cluster at a time scalar
+//   test finds, and that any point a light can reach (inside
+//   its range and cone) finds that light in its cluster the
+//   way the pixel shaders look it up; returns 1 if any check
+//   fails
+// - Prints how many lights an average and the busiest
+//   cluster hold, against the whole list every pixel used to
+//   loop over
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers
+// only accessible in this file
+namespace
+{
+	const float NEAR_CLIP = 0.01f;
+	const float FAR_CLIP = 900.0f;
+
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Transform a point by a row vector matrix.
+	XMFLOAT3 TransformPoint(const XMFLOAT4X4& m, const XMFLOAT3& p)
+	{
+		return XMFLOAT3(
+			p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41,
+			p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42,
+			p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43);
+	}
+
+	std::vector<ClusterLight> MakeLights(size_t count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> xs(-200.0f, 200.0f);
+		std::uniform_real_distribution<float> ys(-5.0f, 60.0f);
+		std::uniform_real_distribution<float> zs(-80.0f, 500.0f);
+		std::uniform_real_distribution<float> ranges(2.0f, 15.0f);
+		std::uniform_real_distribution<float> angles(0.1f, 1.4f);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		std::vector<ClusterLight> lights(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			ClusterLight& light = lights[i];
+			light.type = (i % 2 == 0) ? 1 : 2;
+			light.position = XMFLOAT3(xs(random), ys(random), zs(random));
+			light.range = ranges(random);
+			light.direction = XMFLOAT3(unit(random), unit(random), unit(random));
+			if (light.direction.x == 0.0f && light.direction.y == 0.0f && light.direction.z == 0.0f)
+				light.direction.y = 1.0f;
+			light.spotOuterAngle = angles(random);
+		}
+		return lights;
+	}
+
+	// Whether a world space point gets any light, the way the pixel shaders'
+	// attenuation and spot falloff decide it (with a small margin).
+	bool LightReaches(const ClusterLight& light, const XMFLOAT3& point)
+	{
+		float dx = point.x - light.position.x;
+		float dy = point.y - light.position.y;
+		float dz = point.z - light.position.z;
+		float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		if (distance >= light.range * 0.999f)
+			return false;
+		if (light.type != 2)
+			return true;
+
+		float axisLength = std::sqrt(light.direction.x * light.direction.x + light.direction.y * light.direction.y + light.direction.z * light.direction.z);
+		float cosAngle = -(dx * light.direction.x + dy * light.direction.y + dz * light.direction.z) / (distance * axisLength);
+		return distance > 0.0f && cosAngle > std::cos(light.spotOuterAngle) + 0.001f;
+	}
+
+	// Time one light count and return the number of failed checks.
+	int RunBenchmark(size_t count, const XMFLOAT4X4& viewMatrix, const XMFLOAT4X4& projectionMatrix, LightClusters& clusters, std::mt19937& random)
+	{
+		std::vector<ClusterLight> lights = MakeLights(count, random);
+
+		// One warm up build, then the timed ones.
+		clusters.Build(viewMatrix, lights.data(), count, 1);
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t indexCount = clusters.Build(viewMatrix, lights.data(), count, 1);
+		float singleTime = MillisecondsSince(start);
+		std::vector<LightClusters::ClusterRange> singleRanges(clusters.GetRanges(), clusters.GetRanges() + LightClusters::CLUSTER_COUNT);
+		std::vector<unsigned int> singleIndices(clusters.GetLightIndices(), clusters.GetLightIndices() + indexCount);
+
+		start = std::chrono::high_resolution_clock::now();
+		indexCount = clusters.Build(viewMatrix, lights.data(), count, 0);
+		float threadedTime = MillisecondsSince(start);
+
+		// Seven threads, whatever the machine has, so slices are always shared unevenly.
+		indexCount = clusters.Build(viewMatrix, lights.data(), count, 7);
+		const LightClusters::ClusterRange* ranges = clusters.GetRanges();
+		const unsigned int* indices = clusters.GetLightIndices();
+
+		size_t threadErrors = indexCount != singleIndices.size() ? 1 : 0;
+		for (unsigned int c = 0; c < LightClusters::CLUSTER_COUNT && threadErrors == 0; c++)
+		{
+			if (ranges[c].offset != singleRanges[c].offset || ranges[c].count != singleRanges[c].count)
+				threadErrors++;
+		}
+		for (size_t i = 0; i < indexCount && threadErrors == 0; i++)
+		{
+			if (indices[i] != singleIndices[i])
+				threadErrors++;
+		}
+
+		// Every light's clusters, one scalar test at a time: a listed light must touch its
+		// cluster with a slightly larger sphere, and one touching it with a slightly smaller
+		// sphere must be listed (so rounding in the four-wide test does not count).
+		std::vector<std::vector<unsigned int>> clusterLights(LightClusters::CLUSTER_COUNT);
+		for (unsigned int c = 0; c < LightClusters::CLUSTER_COUNT; c++)
+			clusterLights[c].assign(indices + ranges[c].offset, indices + ranges[c].offset + ranges[c].count);
+
+		size_t visibleLights = 0;
+		size_t listErrors = 0;
+		std::vector<unsigned int> position(LightClusters::CLUSTER_COUNT, 0);
+		for (size_t i = 0; i < count; i++)
+		{
+			LightClusters::LightBounds bounds = clusters.GetLightBounds(viewMatrix, lights[i]);
+			if (bounds.visible)
+				visibleLights++;
+			LightClusters::LightBounds larger = bounds;
+			LightClusters::LightBounds smaller = bounds;
+			larger.radius *= 1.0001f;
+			smaller.radius *= 0.9999f;
+
+			for (unsigned int c = 0; c < LightClusters::CLUSTER_COUNT; c++)
+			{
+				// Lists hold lights in order, so each cluster's next entry is this light or a later one.
+				bool isListed = position[c] < clusterLights[c].size() && clusterLights[c][position[c]] == i;
+				if (isListed)
+					position[c]++;
+
+				unsigned int x = c % LightClusters::TILES_X;
+				unsigned int y = (c / LightClusters::TILES_X) % LightClusters::TILES_Y;
+				unsigned int s = c / (LightClusters::TILES_X * LightClusters::TILES_Y);
+				bool inRange = bounds.visible &&
+					s >= bounds.firstSlice && s <= bounds.lastSlice &&
+					y >= bounds.firstTileY && y <= bounds.lastTileY &&
+					x >= bounds.firstTileX && x <= bounds.lastTileX;
+				if (isListed && !(inRange && clusters.SphereTouchesCluster(larger, x, y, s)))
+					listErrors++;
+				if (!isListed && inRange && clusters.SphereTouchesCluster(smaller, x, y, s))
+					listErrors++;
+			}
+		}
+		for (unsigned int c = 0; c < LightClusters::CLUSTER_COUNT; c++)
+		{
+			if (position[c] != clusterLights[c].size())
+				listErrors++;
+		}
+
+		// Points each light reaches, on screen, must find the light in their cluster.
+		std::uniform_int_distribution<size_t> pickLight(0, count - 1);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		size_t pointsTested = 0;
+		size_t pointErrors = 0;
+		for (int attempt = 0; attempt < 200000; attempt++)
+		{
+			size_t i = pickLight(random);
+			const ClusterLight& light = lights[i];
+			XMFLOAT3 point(
+				light.position.x + unit(random) * light.range,
+				light.position.y + unit(random) * light.range,
+				light.position.z + unit(random) * light.range);
+			if (!LightReaches(light, point))
+				continue;
+
+			// Points off screen would clamp to an edge tile, which need not list the light.
+			XMFLOAT3 viewPoint = TransformPoint(viewMatrix, point);
+			if (viewPoint.z < NEAR_CLIP || viewPoint.z > FAR_CLIP * 0.999f ||
+				std::fabs(viewPoint.x / viewPoint.z * projectionMatrix._11) > 0.999f ||
+				std::fabs(viewPoint.y / viewPoint.z * projectionMatrix._22) > 0.999f)
+				continue;
+
+			const std::vector<unsigned int>& list = clusterLights[clusters.GetClusterOfPoint(viewPoint)];
+			bool found = false;
+			for (unsigned int listedLight : list)
+				found = found || listedLight == i;
+
+			pointsTested++;
+			if (!found)
+				pointErrors++;
+		}
+
+		// How many lights the clusters that hold any hold, against every pixel looping over all of them.
+		size_t busyClusters = 0;
+		unsigned int mostLights = 0;
+		for (unsigned int c = 0; c < LightClusters::CLUSTER_COUNT; c++)
+		{
+			if (ranges[c].count > 0)
+				busyClusters++;
+			if (ranges[c].count > mostLights)
+				mostLights = ranges[c].count;
+		}
+
+		std::printf("%8zu %8zu %10zu %10.1f %8u %10.3f %10.3f %8.2fx\n",
+			count, visibleLights, indexCount,
+			busyClusters > 0 ? (float)indexCount / busyClusters : 0.0f, mostLights,
+			singleTime, threadedTime, threadedTime > 0.0f ? singleTime / threadedTime : 0.0f);
+
+		int failures = 0;
+		if (threadErrors > 0)
+		{
+			std::printf("FAIL: threaded lists differ from single threaded ones\n");
+			failures++;
+		}
+		if (listErrors > 0)
+		{
+			std::printf("FAIL: %zu cluster lists differ from the scalar test\n", listErrors);
+			failures++;
+		}
+		if (pointErrors > 0)
+		{
+			std::printf("FAIL: %zu of %zu lit points did not find their light in their cluster\n", pointErrors, pointsTested);
+			failures++;
+		}
+		return failures;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(12345);
+	int failures = 0;
+
+	// A camera at the Game's second camera's spot (0, 10, -60), looking down +z but
+	// turned a little so the view matrix has a rotation too.
+	XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0.0f, 10.0f, -60.0f, 0.0f), XMVectorSet(0.2f, -0.1f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, NEAR_CLIP, FAR_CLIP);
+	XMFLOAT4X4 viewMatrix, projectionMatrix;
+	XMStoreFloat4x4(&viewMatrix, view);
+	XMStoreFloat4x4(&projectionMatrix, projection);
+
+	LightClusters clusters;
+	clusters.SetProjection(projectionMatrix, NEAR_CLIP, FAR_CLIP);
+
+	std::printf("%u x %u x %u clusters, %u threads\n",
+		LightClusters::TILES_X, LightClusters::TILES_Y, LightClusters::SLICES, Parallel::GetThreadCount());
+	std::printf("%8s %8s %10s %10s %8s %10s %10s %9s\n",
+		"Lights", "Visible", "Indices", "Avg/clstr", "Max", "1 thr ms", "N thr ms", "Speedup");
+	for (size_t count : { (size_t)1000, (size_t)4000, (size_t)16000, (size_t)64000 })
+		failures += RunBenchmark(count, viewMatrix, projectionMatrix, clusters, random);
+
+	return failures > 0 ? 1 : 0;
+}
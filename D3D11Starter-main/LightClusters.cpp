@@ -0,0 +1,343 @@
+#include "LightClusters.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the clustering helpers
+// only accessible in this file
+namespace
+{
+	// Light types, as Lights.h defines them.
+	const unsigned int POINT_LIGHT = 1;
+	const unsigned int SPOT_LIGHT = 2;
+
+	// Fewest lights worth handing to another thread.
+	const size_t MIN_LIGHTS_PER_JOB = 256;
+
+	static_assert(LightClusters::TILES_X % 4 == 0, "Tile rows are tested four tiles at a time");
+
+	unsigned int ClampToTile(float position, unsigned int tileCount)
+	{
+		if (!(position > 0.0f))
+			return 0;
+		unsigned int tile = (unsigned int)position;
+		return tile < tileCount ? tile : tileCount - 1;
+	}
+
+	// Distance from a value to a range, 0 inside it.
+	float DistanceOutside(float value, float rangeMin, float rangeMax)
+	{
+		float below = rangeMin - value;
+		float above = value - rangeMax;
+		float outside = below > above ? below : above;
+		return outside > 0.0f ? outside : 0.0f;
+	}
+}
+
+LightClusters::LightClusters()
+	: xScale(1.0f), yScale(1.0f), nearClip(0.1f), farClip(1000.0f), sliceScale(0.0f), sliceBias(0.0f), sliceDepths()
+{
+	boxMinX.resize(SLICES * TILES_X);
+	boxMaxX.resize(SLICES * TILES_X);
+	boxMinY.resize(SLICES * TILES_Y);
+	boxMaxY.resize(SLICES * TILES_Y);
+	sliceLists.resize(SLICES);
+	ranges.assign(CLUSTER_COUNT, { 0, 0 });
+	SetProjection(XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0), nearClip, farClip);
+}
+
+void LightClusters::SetProjection(const XMFLOAT4X4& projectionMatrix, float nearClipPlane, float farClipPlane)
+{
+	xScale = projectionMatrix._11;
+	yScale = projectionMatrix._22;
+	nearClip = nearClipPlane;
+	farClip = farClipPlane;
+
+	// Slice s starts at near * (far / near)^(s / SLICES), so
+	// slice = log(depth) * scale + bias.
+	float logRatio = std::log(farClip / nearClip);
+	sliceScale = SLICES / logRatio;
+	sliceBias = -(float)SLICES * std::log(nearClip) / logRatio;
+	for (unsigned int s = 0; s <= SLICES; s++)
+		sliceDepths[s] = nearClip * std::pow(farClip / nearClip, (float)s / SLICES);
+	sliceDepths[SLICES] = farClip;
+
+	// A tile's x (or y) over depth is depth times a slope, so its box spans
+	// the slopes at both ends of the slice.
+	for (unsigned int s = 0; s < SLICES; s++)
+	{
+		float sliceNear = sliceDepths[s];
+		float sliceFar = sliceDepths[s + 1];
+		for (unsigned int x = 0; x < TILES_X; x++)
+		{
+			float left = (2.0f * x / TILES_X - 1.0f) / xScale;
+			float right = (2.0f * (x + 1) / TILES_X - 1.0f) / xScale;
+			boxMinX[s * TILES_X + x] = left < 0.0f ? sliceFar * left : sliceNear * left;
+			boxMaxX[s * TILES_X + x] = right > 0.0f ? sliceFar * right : sliceNear * right;
+		}
+
+		// Rows count down from the top of the screen.
+		for (unsigned int y = 0; y < TILES_Y; y++)
+		{
+			float top = (1.0f - 2.0f * y / TILES_Y) / yScale;
+			float bottom = (1.0f - 2.0f * (y + 1) / TILES_Y) / yScale;
+			boxMinY[s * TILES_Y + y] = bottom < 0.0f ? sliceFar * bottom : sliceNear * bottom;
+			boxMaxY[s * TILES_Y + y] = top > 0.0f ? sliceFar * top : sliceNear * top;
+		}
+	}
+}
+
+LightClusters::LightBounds LightClusters::GetLightBounds(const XMFLOAT4X4& viewMatrix, const ClusterLight& light) const
+{
+	LightBounds bounds = {};
+	if (!(light.range > 0.0f) || (light.type != POINT_LIGHT && light.type != SPOT_LIGHT))
+		return bounds;
+
+	// World space bounding sphere: the whole range for a point light (or a spot
+	// light at least as wide as a hemisphere), the smallest sphere around the cone otherwise.
+	XMFLOAT3 center = light.position;
+	float radius = light.range;
+	float halfAngle = light.spotOuterAngle;
+	if (light.type == SPOT_LIGHT && halfAngle < XM_PIDIV2)
+	{
+		XMFLOAT3 axis(-light.direction.x, -light.direction.y, -light.direction.z);
+		float axisLength = std::sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+		if (axisLength > 0.0f)
+		{
+			float cosAngle = std::cos(halfAngle);
+			float offset;
+			if (halfAngle > XM_PIDIV4)
+			{
+				// Wide cones: the sphere through the cap's rim.
+				offset = light.range * cosAngle;
+				radius = light.range * std::sin(halfAngle);
+			}
+			else
+			{
+				// Narrow cones: the sphere through the apex and the cap's rim.
+				offset = light.range / (2.0f * cosAngle);
+				radius = offset;
+			}
+			center.x += axis.x / axisLength * offset;
+			center.y += axis.y / axisLength * offset;
+			center.z += axis.z / axisLength * offset;
+		}
+	}
+
+	// Move the center into view space.
+	XMVECTOR viewCenter = XMVectorMultiplyAdd(XMVectorReplicate(center.x), XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&viewMatrix._11)),
+		XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&viewMatrix._41)));
+	viewCenter = XMVectorMultiplyAdd(XMVectorReplicate(center.y), XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&viewMatrix._21)), viewCenter);
+	viewCenter = XMVectorMultiplyAdd(XMVectorReplicate(center.z), XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&viewMatrix._31)), viewCenter);
+	XMStoreFloat3(&bounds.center, viewCenter);
+	bounds.radius = radius;
+
+	// Depths the sphere covers inside the frustum.
+	float nearest = bounds.center.z - radius;
+	float farthest = bounds.center.z + radius;
+	if (nearest < nearClip)
+		nearest = nearClip;
+	if (farthest > farClip)
+		farthest = farClip;
+	if (nearest > farthest)
+		return bounds;
+
+	// Over that depth range x / depth and y / depth are largest and smallest
+	// at the corners of the box around the sphere.
+	float left = bounds.center.x - radius;
+	float right = bounds.center.x + radius;
+	float bottom = bounds.center.y - radius;
+	float top = bounds.center.y + radius;
+	float minX = (left < 0.0f ? left / nearest : left / farthest) * xScale;
+	float maxX = (right > 0.0f ? right / nearest : right / farthest) * xScale;
+	float minY = (bottom < 0.0f ? bottom / nearest : bottom / farthest) * yScale;
+	float maxY = (top > 0.0f ? top / nearest : top / farthest) * yScale;
+	if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+		return bounds;
+
+	bounds.firstSlice = ClampToTile(std::log(nearest) * sliceScale + sliceBias, SLICES);
+	bounds.lastSlice = ClampToTile(std::log(farthest) * sliceScale + sliceBias, SLICES);
+	bounds.firstTileX = ClampToTile((minX * 0.5f + 0.5f) * TILES_X, TILES_X);
+	bounds.lastTileX = ClampToTile((maxX * 0.5f + 0.5f) * TILES_X, TILES_X);
+	bounds.firstTileY = ClampToTile((0.5f - maxY * 0.5f) * TILES_Y, TILES_Y);
+	bounds.lastTileY = ClampToTile((0.5f - minY * 0.5f) * TILES_Y, TILES_Y);
+	bounds.visible = true;
+	return bounds;
+}
+
+bool LightClusters::SphereTouchesCluster(const LightBounds& bounds, unsigned int tileX, unsigned int tileY, unsigned int slice) const
+{
+	float dz = DistanceOutside(bounds.center.z, sliceDepths[slice], sliceDepths[slice + 1]);
+	float dy = DistanceOutside(bounds.center.y, boxMinY[slice * TILES_Y + tileY], boxMaxY[slice * TILES_Y + tileY]);
+	float dx = DistanceOutside(bounds.center.x, boxMinX[slice * TILES_X + tileX], boxMaxX[slice * TILES_X + tileX]);
+	return dx * dx + (dy * dy + dz * dz) <= bounds.radius * bounds.radius;
+}
+
+void LightClusters::BuildSlice(unsigned int slice, SliceLists& lists) const
+{
+	lists.pairTiles.clear();
+	lists.pairLights.clear();
+	for (unsigned int& tileCount : lists.tileCounts)
+		tileCount = 0;
+
+	float sliceNear = sliceDepths[slice];
+	float sliceFar = sliceDepths[slice + 1];
+	const float* rowMinX = boxMinX.data() + slice * TILES_X;
+	const float* rowMaxX = boxMaxX.data() + slice * TILES_X;
+	XMFLOAT4A distances;
+
+	for (size_t i = 0; i < lightBounds.size(); i++)
+	{
+		const LightBounds& bounds = lightBounds[i];
+		if (!bounds.visible || slice < bounds.firstSlice || slice > bounds.lastSlice)
+			continue;
+
+		float radiusSquared = bounds.radius * bounds.radius;
+		float dz = DistanceOutside(bounds.center.z, sliceNear, sliceFar);
+		XMVECTOR centerX = XMVectorReplicate(bounds.center.x);
+		XMVECTOR radiusSquaredV = XMVectorReplicate(radiusSquared);
+
+		for (unsigned int y = bounds.firstTileY; y <= bounds.lastTileY; y++)
+		{
+			float dy = DistanceOutside(bounds.center.y, boxMinY[slice * TILES_Y + y], boxMaxY[slice * TILES_Y + y]);
+			float dyz = dy * dy + dz * dz;
+			if (dyz > radiusSquared)
+				continue;
+			XMVECTOR dyzV = XMVectorReplicate(dyz);
+
+			// Squared distance from the sphere's center to four boxes of the row at once,
+			// minus the squared radius: a box is touched when it is not above zero.
+			for (unsigned int x0 = bounds.firstTileX & ~3u; x0 <= bounds.lastTileX; x0 += 4)
+			{
+				XMVECTOR minX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(rowMinX + x0));
+				XMVECTOR maxX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(rowMaxX + x0));
+				XMVECTOR dx = XMVectorMax(XMVectorMax(XMVectorSubtract(minX, centerX), XMVectorSubtract(centerX, maxX)), XMVectorZero());
+				XMStoreFloat4A(&distances, XMVectorSubtract(XMVectorMultiplyAdd(dx, dx, dyzV), radiusSquaredV));
+
+				const float lanes[4] = { distances.x, distances.y, distances.z, distances.w };
+				for (unsigned int k = 0; k < 4; k++)
+				{
+					unsigned int x = x0 + k;
+					if (x < bounds.firstTileX || x > bounds.lastTileX || lanes[k] > 0.0f)
+						continue;
+					unsigned int tile = y * TILES_X + x;
+					lists.pairTiles.push_back(tile);
+					lists.pairLights.push_back((unsigned int)i);
+					lists.tileCounts[tile]++;
+				}
+			}
+		}
+	}
+
+	// Sort the pairs into per-tile lists, keeping lights in order.
+	unsigned int tileOffsets[TILES_X * TILES_Y];
+	unsigned int offset = 0;
+	for (unsigned int t = 0; t < TILES_X * TILES_Y; t++)
+	{
+		tileOffsets[t] = offset;
+		offset += lists.tileCounts[t];
+	}
+	lists.lightIndices.resize(lists.pairLights.size());
+	for (size_t p = 0; p < lists.pairLights.size(); p++)
+		lists.lightIndices[tileOffsets[lists.pairTiles[p]]++] = lists.pairLights[p];
+}
+
+size_t LightClusters::Build(const XMFLOAT4X4& viewMatrix, const ClusterLight* lights, size_t count, unsigned int threadCount)
+{
+	// Bound every light first, splitting the lights across threads.
+	lightBounds.resize(count);
+	Parallel::ForRanges(count, Parallel::GetJobCount(count, MIN_LIGHTS_PER_JOB, threadCount),
+		[&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i < end; i++)
+				lightBounds[i] = GetLightBounds(viewMatrix, lights[i]);
+		});
+
+	// Then bin them slice by slice; threads take the next slice as they finish,
+	// since near slices are small and far ones catch more lights.
+	size_t jobCount = Parallel::GetJobCount(count, MIN_LIGHTS_PER_JOB, threadCount);
+	if (jobCount > SLICES)
+		jobCount = SLICES;
+	std::atomic<unsigned int> nextSlice(0);
+	Parallel::RunOnThreads(jobCount, [&](size_t)
+		{
+			for (unsigned int slice = nextSlice++; slice < SLICES; slice = nextSlice++)
+				BuildSlice(slice, sliceLists[slice]);
+		});
+
+	// Join the slices' lists into one index list.
+	size_t total = 0;
+	for (const SliceLists& lists : sliceLists)
+		total += lists.lightIndices.size();
+	lightIndices.resize(total);
+
+	unsigned int offset = 0;
+	for (unsigned int s = 0; s < SLICES; s++)
+	{
+		const SliceLists& lists = sliceLists[s];
+		for (unsigned int t = 0; t < TILES_X * TILES_Y; t++)
+		{
+			ranges[s * TILES_X * TILES_Y + t] = { offset, lists.tileCounts[t] };
+			offset += lists.tileCounts[t];
+		}
+		if (!lists.lightIndices.empty())
+			std::copy(lists.lightIndices.begin(), lists.lightIndices.end(), lightIndices.begin() + (offset - lists.lightIndices.size()));
+	}
+	return total;
+}
+
+size_t LightClusters::BuildAll(size_t count)
+{
+	// Every cluster shares the one list.
+	lightIndices.resize(count);
+	for (size_t i = 0; i < count; i++)
+		lightIndices[i] = (unsigned int)i;
+	for (ClusterRange& range : ranges)
+		range = { 0, (unsigned int)count };
+	return count;
+}
+
+unsigned int LightClusters::GetClusterOfPoint(const XMFLOAT3& viewPosition) const
+{
+	float depth = viewPosition.z > nearClip ? viewPosition.z : nearClip;
+	unsigned int slice = ClampToTile(std::log(depth) * sliceScale + sliceBias, SLICES);
+	float ndcX = viewPosition.x / depth * xScale;
+	float ndcY = viewPosition.y / depth * yScale;
+	unsigned int tileX = ClampToTile((ndcX * 0.5f + 0.5f) * TILES_X, TILES_X);
+	unsigned int tileY = ClampToTile((0.5f - ndcY * 0.5f) * TILES_Y, TILES_Y);
+	return GetClusterIndex(tileX, tileY, slice);
+}
+
+unsigned int LightClusters::GetClusterIndex(unsigned int tileX, unsigned int tileY, unsigned int slice)
+{
+	return (slice * TILES_Y + tileY) * TILES_X + tileX;
+}
+
+float LightClusters::GetSliceScale() const
+{
+	return sliceScale;
+}
+
+float LightClusters::GetSliceBias() const
+{
+	return sliceBias;
+}
+
+const LightClusters::ClusterRange* LightClusters::GetRanges() const
+{
+	return ranges.data();
+}
+
+const unsigned int* LightClusters::GetLightIndices() const
+{
+	return lightIndices.data();
+}
+
+size_t LightClusters::GetLightIndexCount() const
+{
+	return lightIndices.size();
+}
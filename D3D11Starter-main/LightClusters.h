@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// A point or spot light as the light clusters see it: only
+// what bounds the space it can reach.
+//
+// - "type" uses the LIGHT_TYPE_ values of Lights.h (1 for
+//   point and 2 for spot lights)
+// - A spot light's cone opens along -direction, with half
+//   angle spotOuterAngle, as the pixel shaders light it
+// --------------------------------------------------------
+struct ClusterLight
+{
+	unsigned int type;
+	DirectX::XMFLOAT3 position;
+	float range;
+	DirectX::XMFLOAT3 direction;
+	float spotOuterAngle;
+};
+
+// --------------------------------------------------------
+// Clustered light assignment for forward shading.
+//
+// - The view frustum is split into TILES_X by TILES_Y
+//   screen tiles and SLICES depth slices, spaced
+//   exponentially between the near and far planes
+// - Build() bounds every light with a view space sphere and
+//   lists, for each cluster, the lights whose sphere touches
+//   the cluster's box, so a pixel only loops over the
+//   lights of its own cluster
+// - Sphere and box tests run on four tiles at a time, and
+//   slices are spread across threads
+// - Clusters are numbered slice by slice, then row by row,
+//   then tile by tile, as the pixel shaders look them up
+// --------------------------------------------------------
+class LightClusters
+{
+public:
+	// Keep in sync with the CLUSTER_ defines of ShaderIncludeFile.hlsli.
+	static constexpr unsigned int TILES_X = 16;
+	static constexpr unsigned int TILES_Y = 9;
+	static constexpr unsigned int SLICES = 24;
+	static constexpr unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+	// Where a cluster's light indices start in the index list, and how many there are.
+	struct ClusterRange
+	{
+		unsigned int offset;
+		unsigned int count;
+	};
+
+	// A light's view space bounding sphere and the clusters it can reach.
+	// - "visible" is false when the sphere misses the frustum entirely
+	struct LightBounds
+	{
+		DirectX::XMFLOAT3 center;
+		float radius;
+		unsigned int firstSlice;
+		unsigned int lastSlice;
+		unsigned int firstTileX;
+		unsigned int lastTileX;
+		unsigned int firstTileY;
+		unsigned int lastTileY;
+		bool visible;
+	};
+
+	LightClusters();
+
+	// Set the camera projection the clusters split up.
+	// - "projectionMatrix" is a perspective matrix as Camera makes it; only
+	//   its x and y scale are used
+	void SetProjection(const DirectX::XMFLOAT4X4& projectionMatrix, float nearClip, float farClip);
+
+	// Assign lights to clusters and return the number of light indices written.
+	// - Uses one thread per hardware thread when "threadCount" is 0
+	size_t Build(const DirectX::XMFLOAT4X4& viewMatrix, const ClusterLight* lights, size_t count, unsigned int threadCount = 0);
+
+	// List every one of "count" lights in every cluster, for cameras the
+	// clusters cannot split up (orthographic ones).
+	size_t BuildAll(size_t count);
+
+	// Bound one light for the given view.
+	LightBounds GetLightBounds(const DirectX::XMFLOAT4X4& viewMatrix, const ClusterLight& light) const;
+
+	// Check a light's sphere against one cluster's box (one lane of what Build() tests).
+	bool SphereTouchesCluster(const LightBounds& bounds, unsigned int tileX, unsigned int tileY, unsigned int slice) const;
+
+	// Cluster a view space point falls in, found the way the pixel shaders do.
+	unsigned int GetClusterOfPoint(const DirectX::XMFLOAT3& viewPosition) const;
+
+	static unsigned int GetClusterIndex(unsigned int tileX, unsigned int tileY, unsigned int slice);
+
+	// Scale and bias that turn log(view depth) into a slice, for the pixel shaders.
+	float GetSliceScale() const;
+	float GetSliceBias() const;
+
+	const ClusterRange* GetRanges() const;
+	const unsigned int* GetLightIndices() const;
+	size_t GetLightIndexCount() const;
+
+private:
+	// Per-slice output of Build(), merged once every slice is done.
+	struct SliceLists
+	{
+		// (tile, light) pairs in light order, then sorted into per-tile lists.
+		std::vector<unsigned int> pairTiles;
+		std::vector<unsigned int> pairLights;
+		std::vector<unsigned int> lightIndices;
+		unsigned int tileCounts[TILES_X * TILES_Y];
+	};
+
+	// Bin every visible light that reaches one slice into its clusters.
+	void BuildSlice(unsigned int slice, SliceLists& lists) const;
+
+	float xScale;
+	float yScale;
+	float nearClip;
+	float farClip;
+	float sliceScale;
+	float sliceBias;
+
+	// View depth where each slice starts (and the last one ends).
+	float sliceDepths[SLICES + 1];
+
+	// x and y view space bounds of each cluster's box, per slice then tile.
+	std::vector<float> boxMinX;
+	std::vector<float> boxMaxX;
+	std::vector<float> boxMinY;
+	std::vector<float> boxMaxY;
+
+	// The lights of the current Build(), and each slice's lists.
+	std::vector<LightBounds> lightBounds;
+	std::vector<SliceLists> sliceLists;
+
+	std::vector<ClusterRange> ranges;
+	std::vector<unsigned int> lightIndices;
+};
@@ -1,7 +1,6 @@
 #pragma once
 
-// Add the directX 11 header files.
-#include <d3d11.h>
+// Only DirectXMath, so CookTorrance can share the struct off Windows.
 #include <DirectXMath.h>
 
 // Define 5 major light types for the light structs.
@@ -9,6 +8,10 @@
 #define LIGHT_TYPE_POINT			1
 #define LIGHT_TYPE_SPOT				2
 
+// Directional lights the pixel shaders' frame data holds; point and spot
+// lights have no limit, as they are clustered.
+#define MAX_DIRECTIONAL_LIGHTS		4
+
 struct Lights
 {
 	int type;						// Which kind of light? 0, 1 or 2 (see above)
@@ -0,0 +1,136 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	data = nullptr;
+	size = 0;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* path)
+{
+	// Release any previous mapping first.
+	Close();
+
+#ifdef _WIN32
+	// Open the file for shared reading.
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Get the size of the file.
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	// An empty file can not be mapped, but it is still a valid (empty) file.
+	if (size == 0)
+		return true;
+
+	// Create the read-only mapping and a view over the whole file.
+	HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (mapping == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mappingHandle = mapping;
+	data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	// Open the file for reading.
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	// Get the size of the file.
+	struct stat fileStats = {};
+	if (fstat(file, &fileStats) != 0)
+	{
+		close(file);
+		return false;
+	}
+
+	size = static_cast<size_t>(fileStats.st_size);
+
+	// The descriptor is not needed once the mapping exists.
+	if (size > 0)
+	{
+		void* view = mmap(0, size, PROT_READ, MAP_PRIVATE, file, 0);
+		data = (view == MAP_FAILED) ? nullptr : static_cast<const char*>(view);
+
+		// Tell the kernel the whole file will be read front to back.
+		if (data)
+			madvise(view, size, MADV_SEQUENTIAL);
+	}
+	close(file);
+
+	// Use a non-null handle to mark the file as open.
+	fileHandle = this;
+#endif
+
+	// Mapping failed on a non-empty file.
+	if (size > 0 && data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mappingHandle)
+		CloseHandle(static_cast<HANDLE>(mappingHandle));
+	if (fileHandle)
+		CloseHandle(static_cast<HANDLE>(fileHandle));
+#else
+	if (data)
+		munmap(const_cast<char*>(data), size);
+#endif
+
+	data = nullptr;
+	size = 0;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+}
+
+const char* MappedFile::GetData() const
+{
+	return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return fileHandle != nullptr;
+}
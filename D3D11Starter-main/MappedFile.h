@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// A read-only memory mapping of a whole file.
+//
+// - The file contents are exposed as a single char range so
+//   parsers can tokenize in place without copying lines out.
+// - Uses the Win32 file mapping API on Windows and mmap()
+//   everywhere else, so mesh tools can be built off Windows.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete; // Remove copy constructor
+	MappedFile& operator=(const MappedFile&) = delete; // Remove copy-assignment operator
+
+	// Open and map the file. Returns false if the file can not be opened.
+	bool Open(const char* path);
+	void Close();
+
+	// Getters for the mapped range.
+	const char* GetData() const;
+	size_t GetSize() const;
+	bool IsOpen() const;
+
+private:
+	const char* data;
+	size_t size;
+
+	// Platform handles for the open file and the mapping.
+	void* fileHandle;
+	void* mappingHandle;
+};
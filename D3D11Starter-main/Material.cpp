@@ -1,6 +1,7 @@
 #include "Material.h"
 #include "Graphics.h"
 #include "PathHelpers.h"
+#include "BufferStructs.h"
 #include <d3dcompiler.h>
 #include <string>
 
@@ -60,6 +61,9 @@ Microsoft::WRL::ComPtr<ID3D11InputLayout> Material::GetInputLayout()
 
 void Material::SetColorTint(DirectX::XMFLOAT4 color)
 {
+    // Only a real change needs a new upload (ImGui sets it every frame).
+    if (color.x != colorTint.x || color.y != colorTint.y || color.z != colorTint.z || color.w != colorTint.w)
+        constantsDirty = true;
     colorTint = color;
 }
 
@@ -168,11 +172,15 @@ DirectX::XMFLOAT2 Material::GetTextureOffset()
 
 DirectX::XMFLOAT2 Material::SetTextureScale(DirectX::XMFLOAT2 scale)
 {
+	if (scale.x != textureScale.x || scale.y != textureScale.y)
+		constantsDirty = true;
 	return textureScale = scale;
 }
 
 DirectX::XMFLOAT2 Material::SetTextureOffset(DirectX::XMFLOAT2 offset)
 {
+	if (offset.x != textureOffset.x || offset.y != textureOffset.y)
+		constantsDirty = true;
 	return textureOffset = offset;
 }
 
@@ -195,9 +203,43 @@ DirectX::XMFLOAT2 Material::GetRoughness()
 void Material::SetRoughness(DirectX::XMFLOAT2 value)
 {
 	// Set roughness value.
+	if (value.x != roughness.x || value.y != roughness.y)
+		constantsDirty = true;
 	roughness = value;
 }
 
+unsigned int Material::BindConstants()
+{
+	unsigned int uploadedBytes = 0;
+
+	// Create the buffer the first time the material is drawn.
+	if (!constantBuffer)
+	{
+		D3D11_BUFFER_DESC cbDesc = {};
+		cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		cbDesc.ByteWidth = sizeof(PixelMaterialData);
+		cbDesc.Usage = D3D11_USAGE_DEFAULT;
+		Graphics::Device->CreateBuffer(&cbDesc, 0, constantBuffer.GetAddressOf());
+		constantsDirty = true;
+	}
+
+	// Values rarely change, so a default usage buffer updated in place is enough.
+	if (constantsDirty)
+	{
+		PixelMaterialData data = {};
+		data.colorTint = colorTint;
+		data.scale = textureScale;
+		data.offset = textureOffset;
+		data.roughness = roughness;
+		Graphics::Context->UpdateSubresource(constantBuffer.Get(), 0, 0, &data, 0, 0);
+		constantsDirty = false;
+		uploadedBytes = sizeof(PixelMaterialData);
+	}
+
+	Graphics::Context->PSSetConstantBuffers(1, 1, constantBuffer.GetAddressOf());
+	return uploadedBytes;
+}
+
 //#include "Material.h"
 //#include "Graphics.h"
 //#include "PathHelpers.h"
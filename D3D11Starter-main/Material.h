@@ -42,6 +42,11 @@ public:
 	// Create a method that sets all the textue SRV and samplers active.
 	void BindTexturesAndSamplers();
 
+	// Bind the tint, texture scale and offset and roughness to pixel shader
+	// register b1, first uploading them if they changed since the last upload.
+	// - Returns the number of bytes uploaded (0 when nothing changed)
+	unsigned int BindConstants();
+
 	// Get method for the scale and offset.
 	DirectX::XMFLOAT2 GetTextureScale();
 	DirectX::XMFLOAT2 GetTextureOffset();
@@ -84,5 +89,10 @@ private:
 
 	// Add a roughness or the shininess scale of the material.
 	DirectX::XMFLOAT2 roughness;
+
+	// The material's own constant buffer, and whether the values above have
+	// changed since it was last uploaded.
+	Microsoft::WRL::ComPtr<ID3D11Buffer> constantBuffer;
+	bool constantsDirty = true;
 };
 
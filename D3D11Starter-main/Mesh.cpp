@@ -29,63 +29,16 @@ Mesh::Mesh(Vertex* vertices, unsigned int* indices, int numberOfVerticies, int n
 {
 	// Call the Calculate tangent method:
 	CalculateTangents(vertices, numberOfVerticies, indices, numberOfIndices);
+	MeshProcessing::CalculateBounds(vertices, numberOfVerticies, boundsMin, boundsMax);
+	Culling::SphereAroundBox(boundsMin, boundsMax, boundsCenter, boundsRadius);
 
-	// Save the mesh vertices and indices count.
-	vertexCount = numberOfVerticies;
-	indexCount = numberOfIndices;
-
-	// Create a VERTEX BUFFER
-	// - This holds the vertex data of triangles for a single object
-	// - This buffer is created on the GPU, which is where the data needs to
-	//    be if we want the GPU to act on it (as in: draw it to the screen)
-	{
-		// First, we need to describe the buffer we want Direct3D to make on the GPU
-		//  - Note that this variable is created on the stack since we only need it once
-		//  - After the buffer is created, this description variable is unnecessary
-		D3D11_BUFFER_DESC vbd = {};
-		vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth = sizeof(Vertex) * numberOfVerticies;       // 3 = number of vertices in the buffer
-		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
-		vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		vbd.MiscFlags = 0;
-		vbd.StructureByteStride = 0;
-
-		// Create the proper struct to hold the initial vertex data
-		// - This is how we initially fill the buffer with data
-		// - Essentially, we're specifying a pointer to the data to copy
-		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer on the GPU with the initial data
-		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
-		Graphics::Device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
-	}
-
-	// Create an INDEX BUFFER
-	// - This holds indices to elements in the vertex buffer
-	// - This is most useful when vertices are shared among neighboring triangles
-	// - This buffer is created on the GPU, which is where the data needs to
-	//    be if we want the GPU to act on it (as in: draw it to the screen)
-	{
-		// Describe the buffer, as we did above, with two major differences
-		//  - Byte Width (3 unsigned integers vs. 3 whole vertices)
-		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
-		D3D11_BUFFER_DESC ibd = {};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(unsigned int) * numberOfIndices;	// 3 = number of indices in the buffer
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
-		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		ibd.MiscFlags = 0;
-		ibd.StructureByteStride = 0;
-
-		// Specify the initial data for this buffer, similar to above
-		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer with the initial data
-		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-		Graphics::Device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
-	}
+	// Create the vertex and index buffer
+	MeshData<unsigned int> data;
+	data.vertices.assign(vertices, vertices + numberOfVerticies);
+	data.indices.assign(indices, indices + numberOfIndices);
+	CreateBuffersWithSmallestIndices(data);
+	lods.push_back({ 0, (unsigned int)numberOfIndices, 0.0f, 0, 0 });
+	occluder = MakeOccluderMesh(vertices, numberOfVerticies, indices, lods.back());
 }
 
 Mesh::~Mesh()
@@ -95,274 +48,127 @@ Mesh::~Mesh()
 
 Mesh::Mesh(const char* name)
 {
-	// Using a text file mesh loading code written by my professor Chris Casioli (LinkIn: https://www.linkedin.com/in/chris-cascioli/):
-	
-	// Author: Chris Cascioli
-	// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
-	// 
-	// - You are allowed to directly copy/paste this into your code base
-	//   for assignments, given that you clearly cite that this is not
-	//   code of your own design.
-
-	// *************************************
-	//      IMPLEMENTATION NOTES (1/2)
-	//
-	//  - You'll need to #include both
-	//      <fstream> and <stdexcept>
-	//
-	//  - You will need to integrate
-	//      this code into a function or
-	//      constructor of your own making
-	//
-	//  - There is MORE TO DO after pasting 
-	//      this code in - see the bottom for
-	//      what to do *after* including 
-	//      this code in your mesh class
-	//
-	// *************************************
-
 	// Get the name.
 	this->filePath = name;
 
-	// File input object
-	std::ifstream obj(name);
-
-	// Check for successful open
-	if (!obj.is_open())
-		throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
-
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;	// Positions from the file
-	std::vector<XMFLOAT3> normals;		// Normals from the file
-	std::vector<XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-
-	// Still have data left?
-	while (obj.good())
+	// Use the binary cache next to the .obj file if it is still up to date.
+	// - The cache already holds welded vertices with tangents, so its mapped
+	//   arrays go straight to the GPU without any parsing
+	MappedFile cacheFile;
+	const MeshCacheHeader* header = nullptr;
+	if (MeshCache::Open(name, cacheFile, header))
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
+		unweldedVertexCount = header->unweldedVertexCount;
+		boundsMin = header->boundsMin;
+		boundsMax = header->boundsMax;
+		Culling::SphereAroundBox(boundsMin, boundsMax, boundsCenter, boundsRadius);
+		lods.assign(header->lods, header->lods + header->lodCount);
+		meshlets.assign(MeshCache::GetMeshlets(header), MeshCache::GetMeshlets(header) + header->meshletCount);
+
+		if (header->indexCount == 0)
+			return;
+		if (lods.empty())
+			lods.push_back({ 0, header->indexCount, 0.0f, 0, 0 });
+
+		// Upload the indices at the width they were saved with, and keep the
+		// coarsest level of detail for occlusion culling.
+		const Vertex* vertices = MeshCache::GetVertices(header);
+		if (header->indexSize == 2)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
+			const uint16_t* indices = static_cast<const uint16_t*>(MeshCache::GetIndices(header));
+			CreateBuffers(vertices, indices, (int)header->vertexCount, (int)header->indexCount);
+			occluder = MakeOccluderMesh(vertices, header->vertexCount, indices, lods.back());
 		}
-		else if (chars[0] == 'f')
+		else
 		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(XMFLOAT2(0, 0));
-			}
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.uv = uvs[i[1] - 1];
-			v1.normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.uv = uvs[i[4] - 1];
-			v2.normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.uv = uvs[i[7] - 1];
-			v3.normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.uv.y = 1.0f - v1.uv.y;
-			v2.uv.y = 1.0f - v2.uv.y;
-			v3.uv.y = 1.0f - v3.uv.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.normal.z *= -1.0f;
-			v2.normal.z *= -1.0f;
-			v3.normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.uv = uvs[i[10] - 1];
-				v4.normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.uv.y = 1.0f - v4.uv.y;
-				v4.Position.z *= -1.0f;
-				v4.normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-			}
+			const unsigned int* indices = static_cast<const unsigned int*>(MeshCache::GetIndices(header));
+			CreateBuffers(vertices, indices, (int)header->vertexCount, (int)header->indexCount);
+			occluder = MakeOccluderMesh(vertices, header->vertexCount, indices, lods.back());
 		}
+		return;
+	}
+
+	// Parse, weld and optimize the .obj file and generate its tangents.
+	// - MeshProcessing is the platform-neutral half of loading, this
+	//   constructor only uploads what it returns
+	// - It throws std::invalid_argument if the file can not be opened
+	MeshData<unsigned int> data = MeshProcessing::ProcessObj(name);
+
+	// Save the finished arrays so the next launch can skip parsing.
+	// - Failing to write (e.g. read-only assets) only means the next load parses again
+	if (!data.indices.empty())
+	{
+		MeshCache::Write(name, &data.vertices[0], (unsigned int)data.vertices.size(),
+			&data.indices[0], (unsigned int)data.indices.size(), (unsigned int)data.cornerCount, data.boundsMin, data.boundsMax,
+			data.lods.data(), (unsigned int)data.lods.size(), data.meshlets.data(), (unsigned int)data.meshlets.size());
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
+	Upload(data);
+}
 
-	// Update the vertex and indicies count information.
-	vertexCount = static_cast<unsigned int>(vertCounter);
-	indexCount = static_cast<unsigned int>(indexCounter);
+Mesh::Mesh(const MeshData<unsigned int>& data)
+{
+	Upload(data);
+}
+
+/// <summary>
+/// Copies the counts and bounds of already processed mesh data and
+/// creates its GPU buffers.
+/// </summary>
+void Mesh::Upload(const MeshData<unsigned int>& data)
+{
+	// Keep the corner count to compare against the welded vertex count.
+	unweldedVertexCount = (unsigned int)data.cornerCount;
+	boundsMin = data.boundsMin;
+	boundsMax = data.boundsMax;
+	Culling::SphereAroundBox(boundsMin, boundsMax, boundsCenter, boundsRadius);
+
+	// Nothing to draw from an empty file.
+	if (data.indices.empty())
+		return;
+
+	// Without generated levels the whole index buffer is the only one.
+	lods = data.lods;
+	meshlets = data.meshlets;
+	if (lods.empty())
+		lods.push_back({ 0, (unsigned int)data.indices.size(), 0.0f, 0, 0 });
+	occluder = MakeOccluderMesh(data.vertices.data(), data.vertices.size(), data.indices.data(), lods.back());
 
 	// Create the vertex and index buffer
+	CreateBuffersWithSmallestIndices(data);
+}
 
+/// <summary>
+/// Narrows the indices to 16 bits when every index fits, so small meshes
+/// use half the index memory and bandwidth, then creates the buffers.
+/// The narrowing is ConvertIndexWidth, which MeshBenchmark checks.
+/// </summary>
+void Mesh::CreateBuffersWithSmallestIndices(const MeshData<unsigned int>& data)
+{
+	if (FitsIn16BitIndices(data.vertices.size()))
+	{
+		MeshData<uint16_t> narrow = ConvertIndexWidth<uint16_t>(data);
+		CreateBuffers(narrow.vertices.data(), narrow.indices.data(), (int)narrow.vertices.size(), (int)narrow.indices.size());
+	}
+	else
+	{
+		CreateBuffers(data.vertices.data(), data.indices.data(), (int)data.vertices.size(), (int)data.indices.size());
+	}
+}
 
-	// *************************************
-	//      IMPLEMENTATION NOTES (2/2)
-	//
-	// - At this point, "verts" is a std::vector 
-	//     of Vertex structs, and can be used
-	//     to create your mesh's vertex buffer
-	//
-	// - NOTE: Use &verts[0] for the address of 
-	//     the first vertx, NOT JUST &verts
-	//
-	// - The vector "indices" is similar. It's 
-	//     a std::vector of unsigned ints and
-	//     can be used to create the index 
-	//     buffer (again, &indices[0] is the 
-	//     address of the first integer)
-	//
-	// - Make sure your mesh class actually SAVES
-	//     the number of vertices and indices, or
-	//     drawing may have unintended problems.
-	//     - "vertCounter" is the number of vertices
-	//     - "indexCounter" is the number of indices
-	//
-	// - If you dig into the code, you may notice 
-	//     that  "vertCounter" and "indexCounter" 
-	//     end up being the same.  Recall that OBJs 
-	//     do not index entire vertices, making
-	//     it complex to detect duplicate vertices.
-	//     This also means an index buffer isn't
-	//     doing much for us.  We could try to 
-	//     detect duplicate vertices ourselves, 
-	//     but at that point it would be better 
-	//     to use a more sophisticated mesh loading
-	//     library like TinyOBJLoader or 
-	//     The Open Asset Importer Library, both
-	//     of which are unnecessary for now.
-	//
-	// *************************************
+/// <summary>
+/// Creates the immutable vertex and index buffers on the GPU and
+/// saves the vertex and index counts and index format for drawing.
+/// </summary>
+template <typename IndexType>
+void Mesh::CreateBuffers(const Vertex* vertices, const IndexType* indices, int numberOfVerticies, int numberOfIndices)
+{
+	static_assert(sizeof(IndexType) == 2 || sizeof(IndexType) == 4, "Index buffers are 16 or 32-bit");
 
-	// Call the Calculate tangent method:
-	CalculateTangents(&verts[0], vertCounter, &indices[0], indexCount);
+	// Save the mesh vertices and indices count.
+	vertexCount = numberOfVerticies;
+	indexCount = numberOfIndices;
+	indexFormat = (sizeof(IndexType) == 2) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 
 	// Create a VERTEX BUFFER
 	// - This holds the vertex data of triangles for a single object
@@ -374,7 +180,7 @@ Mesh::Mesh(const char* name)
 		//  - After the buffer is created, this description variable is unnecessary
 		D3D11_BUFFER_DESC vbd = {};
 		vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth = sizeof(Vertex) * vertexCount;       // 3 = number of vertices in the buffer
+		vbd.ByteWidth = sizeof(Vertex) * numberOfVerticies;       // 3 = number of vertices in the buffer
 		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
 		vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
 		vbd.MiscFlags = 0;
@@ -384,7 +190,7 @@ Mesh::Mesh(const char* name)
 		// - This is how we initially fill the buffer with data
 		// - Essentially, we're specifying a pointer to the data to copy
 		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = &verts[0]; // pSysMem = Pointer to System Memory
+		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
 
 		// Actually create the buffer on the GPU with the initial data
 		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
@@ -398,11 +204,11 @@ Mesh::Mesh(const char* name)
 	//    be if we want the GPU to act on it (as in: draw it to the screen)
 	{
 		// Describe the buffer, as we did above, with two major differences
-		//  - Byte Width (3 unsigned integers vs. 3 whole vertices)
+		//  - Byte Width (16 or 32-bit indices vs. whole vertices)
 		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
 		D3D11_BUFFER_DESC ibd = {};
 		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(unsigned int) * indexCount;	// 3 = number of indices in the buffer
+		ibd.ByteWidth = sizeof(IndexType) * numberOfIndices;	// 3 = number of indices in the buffer
 		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
 		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
 		ibd.MiscFlags = 0;
@@ -410,7 +216,7 @@ Mesh::Mesh(const char* name)
 
 		// Specify the initial data for this buffer, similar to above
 		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = &indices[0]; // pSysMem = Pointer to System Memory
+		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
 
 		// Actually create the buffer with the initial data
 		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
@@ -438,6 +244,88 @@ int Mesh::GetIndexCount()
     return indexCount;
 }
 
+int Mesh::GetUnweldedVertexCount()
+{
+    return unweldedVertexCount;
+}
+
+DXGI_FORMAT Mesh::GetIndexFormat()
+{
+    return indexFormat;
+}
+
+XMFLOAT3 Mesh::GetBoundsMin()
+{
+    return boundsMin;
+}
+
+XMFLOAT3 Mesh::GetBoundsMax()
+{
+    return boundsMax;
+}
+
+XMFLOAT3 Mesh::GetBoundsCenter()
+{
+    return boundsCenter;
+}
+
+float Mesh::GetBoundsRadius()
+{
+    return boundsRadius;
+}
+
+unsigned int Mesh::GetLodCount()
+{
+    return (unsigned int)lods.size();
+}
+
+MeshLod Mesh::GetLod(unsigned int lod)
+{
+    if (lods.empty())
+        return MeshLod{};
+    return lods[lod < lods.size() ? lod : lods.size() - 1];
+}
+
+const OccluderMesh& Mesh::GetOccluder()
+{
+    return occluder;
+}
+
+/// <summary>
+/// Works out how many pixels one local unit of the mesh covers on screen
+/// (using its bounding sphere and the camera projection) and picks the
+/// coarsest level of detail whose error stays under the pixel threshold.
+/// </summary>
+unsigned int Mesh::SelectLod(const XMFLOAT4X4& worldMatrix, Camera& camera, float screenHeight, float maxPixelError)
+{
+	if (lods.size() <= 1)
+		return 0;
+
+	// World space bounding sphere, scaled by the largest axis scale.
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&boundsCenter), world);
+	float scale = sqrtf(fmaxf(XMVectorGetX(XMVector3LengthSq(world.r[0])),
+		fmaxf(XMVectorGetX(XMVector3LengthSq(world.r[1])), XMVectorGetX(XMVector3LengthSq(world.r[2])))));
+	float radius = boundsRadius * scale;
+
+	// Pixels per world unit: _22 of the projection is 1 / tan(fov / 2) for
+	// perspective cameras and 2 / view height for orthographic ones.
+	XMFLOAT4X4 projection = camera.GetProjectionMatrix();
+	float pixelsPerUnit = screenHeight * projection._22 * 0.5f;
+	if (camera.GetPerspective())
+	{
+		XMFLOAT3 cameraPosition = camera.GetTransform().GetPosition();
+		float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, XMLoadFloat3(&cameraPosition)))) - radius;
+
+		// Inside the bounding sphere, so use full detail.
+		if (distance <= 0.0f)
+			return 0;
+		pixelsPerUnit /= distance;
+	}
+
+	return MeshProcessing::SelectLod(lods.data(), lods.size(), pixelsPerUnit * scale, maxPixelError);
+}
+
 // --------------------------------------------------------
 // Author: Chris Cascioli
 // Purpose: Calculates the tangents of the vertices in a mesh
@@ -457,93 +345,32 @@ int Mesh::GetIndexCount()
 // --------------------------------------------------------
 void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = XMFLOAT3(0, 0, 0);
-	}
-
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->uv.x - v1->uv.x;
-		float t1 = v2->uv.y - v1->uv.y;
-
-		float s2 = v3->uv.x - v1->uv.x;
-		float t2 = v3->uv.y - v1->uv.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
-
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+	// Use the SIMD and multithreaded tangent generator.
+	// - TangentGenerator::CalculateTangentsScalar is the one-triangle-at-a-time reference
+	TangentGenerator::CalculateTangentsParallel(verts, numVerts, indices, numIndices);
+}
 
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
 
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
-	}
+void Mesh::BindBuffers()
+{
+	// Set buffers in the input assembler (IA) stage
+	//  - Do this ONCE PER OBJECT, since each object may have different geometry
+	//  - This needs to be done between DrawIndexed() calls that draw
+	//     different geometry, but consecutive draws of this mesh can share it
+	UINT stride = sizeof(Vertex);
+	UINT offset = 0;
+	Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+	Graphics::Context->IASetIndexBuffer(GetIndexBuffer(), indexFormat, 0);
 }
 
-
-void Mesh::Draw()
+void Mesh::Draw(unsigned int lod, bool bindBuffers)
 {
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
 	// - Other Direct3D calls will also be necessary to do more complex things
 	{
-		// Set buffers in the input assembler (IA) stage
-		//  - Do this ONCE PER OBJECT, since each object may have different geometry
-		//  - For this demo, this step *could* simply be done once during Init()
-		//  - However, this needs to be done between EACH DrawIndexed() call
-		//     when drawing different geometry, so it's here as an example
-		UINT stride = sizeof(Vertex);
-		UINT offset = 0;
-		Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-		Graphics::Context->IASetIndexBuffer(GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+		if (bindBuffers)
+			BindBuffers();
 
 		// Tell Direct3D to draw
 		//  - Begins the rendering pipeline on the GPU
@@ -551,9 +378,81 @@ void Mesh::Draw()
 		//  - This will use all currently set Direct3D resources (shaders, buffers, etc)
 		//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 		//     vertices in the currently set VERTEX BUFFER
+		//  - Each level of detail is its own range of the index buffer
+		if (lods.empty())
+			return;
+		const MeshLod& range = lods[lod < lods.size() ? lod : lods.size() - 1];
 		Graphics::Context->DrawIndexed(
-			indexCount,     // The number of indices to use (we could draw a subset if we wanted)
-			0,     // Offset to the first index we want to use
+			range.indexCount,     // The number of indices to use (we could draw a subset if we wanted)
+			range.indexStart,     // Offset to the first index we want to use
 			0);    // Offset to add to each index when looking up vertices
 	}
 }
+
+/// <summary>
+/// Draws one level of detail once per instance. The vertex shader tells
+/// the instances apart by SV_InstanceID.
+/// </summary>
+void Mesh::DrawInstanced(unsigned int lod, unsigned int instanceCount, bool bindBuffers)
+{
+	if (bindBuffers)
+		BindBuffers();
+
+	if (lods.empty() || instanceCount == 0)
+		return;
+	const MeshLod& range = lods[lod < lods.size() ? lod : lods.size() - 1];
+	Graphics::Context->DrawIndexedInstanced(range.indexCount, instanceCount, range.indexStart, 0, 0);
+}
+
+/// <summary>
+/// Culls the meshlets of one level of detail against the camera frustum
+/// and their normal cones, then draws the index ranges that are left.
+/// Levels without meshlets are drawn whole.
+/// </summary>
+unsigned int Mesh::DrawCulled(unsigned int lod, const XMFLOAT4X4& worldMatrix, const XMFLOAT4X4& viewProjectionMatrix, XMFLOAT3 cameraPosition, bool bindBuffers)
+{
+	if (lods.empty())
+		return 0;
+
+	// Bind even if every meshlet is culled, since the caller may skip
+	// binding for the next draw of this mesh.
+	if (bindBuffers)
+		BindBuffers();
+
+	const MeshLod& range = lods[lod < lods.size() ? lod : lods.size() - 1];
+	if (range.meshletCount == 0)
+	{
+		Draw(lod, false);
+		return range.indexCount / 3;
+	}
+
+	// Move the frustum and camera into the mesh's local space rather than
+	// moving every meshlet into world space.
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+	XMFLOAT4X4 worldViewProjection;
+	XMStoreFloat4x4(&worldViewProjection, XMMatrixMultiply(world, XMLoadFloat4x4(&viewProjectionMatrix)));
+	Frustum localFrustum = Culling::ExtractFrustum(worldViewProjection);
+
+	XMFLOAT3 localCameraPosition;
+	XMStoreFloat3(&localCameraPosition, XMVector3Transform(XMLoadFloat3(&cameraPosition), XMMatrixInverse(nullptr, world)));
+
+	// The cones only hold if the world matrix scales every axis alike; with
+	// non-uniform scale the normals bend, so fall back to frustum culling.
+	float scaleX = XMVectorGetX(XMVector3LengthSq(world.r[0]));
+	float scaleY = XMVectorGetX(XMVector3LengthSq(world.r[1]));
+	float scaleZ = XMVectorGetX(XMVector3LengthSq(world.r[2]));
+	float largest = scaleX > scaleY ? (scaleX > scaleZ ? scaleX : scaleZ) : (scaleY > scaleZ ? scaleY : scaleZ);
+	float smallest = scaleX < scaleY ? (scaleX < scaleZ ? scaleX : scaleZ) : (scaleY < scaleZ ? scaleY : scaleZ);
+	bool uniformScale = largest - smallest <= largest * 0.001f;
+
+	unsigned int visibleTriangles = (unsigned int)MeshletBuilder::CullMeshlets(&meshlets[range.meshletStart], range.meshletCount,
+		localFrustum, localCameraPosition, visibleRanges, uniformScale);
+	if (visibleRanges.empty())
+		return 0;
+
+	// One DrawIndexed per visible range.
+	for (const IndexRange& visible : visibleRanges)
+		Graphics::Context->DrawIndexed(visible.indexCount, visible.indexStart, 0);
+
+	return visibleTriangles;
+}
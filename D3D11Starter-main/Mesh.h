@@ -10,7 +10,15 @@
 #include <stdexcept>
 
 #include "Graphics.h"
+#include "Camera.h"
 #include "Vertex.h"
+#include "MeshData.h"
+#include "Culling.h"
+#include "OcclusionBuffer.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "TangentGenerator.h"
 #include "Input.h"
 #include "PathHelpers.h"
 #include "Window.h"
@@ -30,18 +38,71 @@ public:
 	// Create a second overload constructor for mesh that accepts the file name to load mesh v, vt, vn & f information.
 	Mesh(const char* name);
 
+	// Upload mesh data that was already processed on the CPU (see MeshProcessing).
+	Mesh(const MeshData<unsigned int>& data);
+
 	// Other required mesh data information.
 	ID3D11Buffer* GetVertexBuffer();
 	ID3D11Buffer* GetIndexBuffer();
 	int GetVertexCount();
 	int GetIndexCount();
 
+	// Number of vertices the mesh would have had if every face corner was its own vertex.
+	int GetUnweldedVertexCount();
+
+	// Format of the index buffer (R16_UINT when the vertex count allows, otherwise R32_UINT).
+	DXGI_FORMAT GetIndexFormat();
+
+	// Local space bounding box of the mesh.
+	XMFLOAT3 GetBoundsMin();
+	XMFLOAT3 GetBoundsMax();
+
+	// Local space bounding sphere around the box, for frustum culling.
+	XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
+
+	// Levels of detail, finest first (always at least one for a non-empty mesh).
+	unsigned int GetLodCount();
+	MeshLod GetLod(unsigned int lod);
+
+	// Pick the coarsest level of detail whose error covers at most maxPixelError
+	// pixels when drawn with the given world matrix from the camera.
+	unsigned int SelectLod(const XMFLOAT4X4& worldMatrix, Camera& camera, float screenHeight, float maxPixelError = 1.0f);
+
+	// Positions and triangles of the coarsest level of detail, for occlusion buffers.
+	const OccluderMesh& GetOccluder();
+
 	// Add a method to create the tangent U texture for the geometry.
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 
-	void Draw();
+	// Bind the vertex and index buffers.
+	void BindBuffers();
+
+	// Draw one level of detail (level 0 is the full resolution mesh).
+	// - "bindBuffers" can be false when this mesh's buffers are still bound
+	void Draw(unsigned int lod = 0, bool bindBuffers = true);
+
+	// Draw one level of detail "instanceCount" times with DrawIndexedInstanced,
+	// for vertex shaders that read per-instance data themselves.
+	void DrawInstanced(unsigned int lod, unsigned int instanceCount, bool bindBuffers = true);
+
+	// Draw only the meshlets of one level of detail that are inside the
+	// camera frustum and not facing away from the camera.
+	// - Returns the number of triangles drawn
+	unsigned int DrawCulled(unsigned int lod, const XMFLOAT4X4& worldMatrix, const XMFLOAT4X4& viewProjectionMatrix, XMFLOAT3 cameraPosition, bool bindBuffers = true);
 
 private:
+	// Create the GPU vertex and index buffers from CPU-side arrays.
+	// - The index buffer format follows the width of IndexType
+	template <typename IndexType>
+	void CreateBuffers(const Vertex* vertices, const IndexType* indices, int numberOfVerticies, int numberOfIndices);
+
+	// Create the buffers with 16-bit indices when the vertex count allows, otherwise 32-bit.
+	void CreateBuffersWithSmallestIndices(const MeshData<unsigned int>& data);
+
+	// Copy the counts and bounds of processed mesh data and create its buffers.
+	void Upload(const MeshData<unsigned int>& data);
+
 	// Buffer to hold graphic geomentry data for this mesh.
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
@@ -49,6 +110,24 @@ private:
 	// Create a unique pointer for vertices and indicies buffer count.
 	unsigned int vertexCount = 0;
 	unsigned int indexCount = 0;
+	unsigned int unweldedVertexCount = 0;
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R32_UINT;
+
+	// Index ranges of each level of detail in the index buffer.
+	std::vector<MeshLod> lods;
+
+	// CPU copy of the coarsest level of detail for occlusion culling.
+	OccluderMesh occluder;
+
+	// CPU copy of the meshlets for culling, and the ranges left after the last cull.
+	std::vector<Meshlet> meshlets;
+	std::vector<IndexRange> visibleRanges;
+
+	// Local space bounding box.
+	XMFLOAT3 boundsMin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 boundsCenter = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	float boundsRadius = 0.0f;
 
 	// Name of the mesh.
 	std::string filePath = "";
@@ -0,0 +1,559 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MeshCache.h"
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "ObjParser.h"
+#include "TangentGenerator.h"
+#include "VertexPacking.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless mesh processing benchmark
+//
+// - Loads every .obj file in a folder (Assets/Meshes by
+//   default, or the first argument) through MeshProcessing
+//   and prints the parse, weld, optimize, tangent and LOD times
+// - Checks every generated LOD chain, plus one for a large
+//   synthetic grid, and returns 1 if any check fails
+// - Converts every mesh to both MeshData<uint16_t> and
+//   MeshData<unsigned int> and checks they hold the same triangles
+// - Times meshlet building and culling on the same meshes and
+//   on a synthetic grid of about a million triangles
+// - Times the OBJ parser on a synthetic 1000 x 1000 grid from
+//   1 thread up to every hardware thread, checking each thread
+//   count parses exactly what 1 thread does
+// - Times a cold parse of every .obj against mapping its binary
+//   cache (writing the cache first if needed) and checks the
+//   cache holds the same vertices and triangles
+// - Prints the ACMR and ATVR of a simulated 16 entry FIFO
+//   vertex cache before and after optimizing each mesh, and
+//   checks optimizing never makes the ACMR worse
+// - Packs every processed mesh's vertices and checks the
+//   decoded positions and uvs are within one quantization
+//   step and the normals and tangents within a tenth of a degree
+// - Times the scalar, SIMD and multithreaded tangent generators
+//   on a synthetic 1000 x 1000 grid with some degenerate uvs and
+//   on a grid whose uvs are all degenerate, checking the SIMD
+//   and multithreaded tangents are within TANGENT_TOLERANCE of
+//   the scalar ones and every tangent is a unit vector
+//   perpendicular to its normal
+// - Links only the MeshData library, so it builds and runs
+//   off Windows without a Direct3D device
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers and checks
+// only accessible in this file
+namespace
+{
+	// Print a mesh's LOD chain and check it against the LOD generation rules.
+	// - Each level has at most 80% of the triangles of the one before it
+	// - Each level's error is within the budget (5% of the bounds size)
+	// - The largest measured distance to full detail is within each level's error
+	// Returns the number of failed checks.
+	int CheckLods(const char* name, const MeshData<unsigned int>& data)
+	{
+		float dx = data.boundsMax.x - data.boundsMin.x;
+		float dy = data.boundsMax.y - data.boundsMin.y;
+		float dz = data.boundsMax.z - data.boundsMin.z;
+		float budget = std::sqrt(dx * dx + dy * dy + dz * dz) * 0.05f;
+
+		int failures = 0;
+		for (size_t i = 0; i < data.lods.size(); i++)
+		{
+			const MeshLod& lod = data.lods[i];
+			float measured = MeshSimplifier::MeasureError(data.vertices, &data.indices[0], data.lods[0].indexCount,
+				&data.indices[lod.indexStart], lod.indexCount);
+
+			bool reduced = (i == 0) || (size_t)lod.indexCount * 5 <= (size_t)data.lods[i - 1].indexCount * 4;
+			bool withinBudget = lod.error <= budget * 1.0001f;
+			bool withinError = measured <= lod.error * 1.0001f + 1e-6f;
+
+			std::printf("  %-22s LOD %zu: %8u triangles, error %.5f, measured %.5f%s\n", name, i, lod.indexCount / 3,
+				lod.error, measured, (reduced && withinBudget && withinError) ? "" : "  FAILED");
+			if (!reduced || !withinBudget || !withinError)
+				failures++;
+		}
+		return failures;
+	}
+
+	// Narrow a mesh to 16-bit indices with ConvertIndexWidth, as Mesh does before
+	// uploading a small mesh, widen it back, and check every triangle and level
+	// of detail survives both conversions.
+	// - Meshes with too many vertices for 16-bit indices are only reported
+	// Returns 1 if any triangle differs.
+	int CheckIndexWidths(const char* name, const MeshData<unsigned int>& data)
+	{
+		if (!FitsIn16BitIndices(data.vertices.size()))
+		{
+			std::printf("  %-22s %8zu vertices, 32-bit indices only\n", name, data.vertices.size());
+			return 0;
+		}
+
+		MeshData<uint16_t> narrow = ConvertIndexWidth<uint16_t>(data);
+		MeshData<unsigned int> wide = ConvertIndexWidth<unsigned int>(narrow);
+
+		size_t mismatches = 0;
+		for (size_t i = 0; i < data.indices.size(); i += 3)
+		{
+			for (size_t corner = i; corner < i + 3 && corner < data.indices.size(); corner++)
+			{
+				if (narrow.indices[corner] != data.indices[corner] || wide.indices[corner] != data.indices[corner])
+				{
+					mismatches++;
+					break;
+				}
+			}
+		}
+
+		bool matches = mismatches == 0 && narrow.indices.size() == data.indices.size() && wide.indices.size() == data.indices.size() &&
+			narrow.lods.size() == data.lods.size() && narrow.meshlets.size() == data.meshlets.size();
+		std::printf("  %-22s %8zu triangles, %zu bytes -> %zu bytes of indices, %zu differ%s\n", name, data.indices.size() / 3,
+			data.indices.size() * sizeof(unsigned int), narrow.indices.size() * sizeof(uint16_t), mismatches, matches ? "" : "  FAILED");
+		return matches ? 0 : 1;
+	}
+
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Print meshlet statistics for a mesh's full detail level and time culling
+	// them from a camera looking at the mesh from the -Z side.
+	// - "buildMilliseconds" is reported as given
+	// - Culling runs "repeats" times and the average is reported
+	void ReportMeshlets(const char* name, const MeshData<unsigned int>& data, float buildMilliseconds, int repeats)
+	{
+		const MeshLod& lod = data.lods[0];
+		const Meshlet* meshlets = &data.meshlets[lod.meshletStart];
+
+		size_t vertexTotal = 0;
+		for (unsigned int i = 0; i < lod.meshletCount; i++)
+			vertexTotal += meshlets[i].vertexCount;
+
+		// Camera a little above the mesh and close enough that some of it is off screen.
+		float dx = data.boundsMax.x - data.boundsMin.x;
+		float dy = data.boundsMax.y - data.boundsMin.y;
+		float dz = data.boundsMax.z - data.boundsMin.z;
+		float size = std::sqrt(dx * dx + dy * dy + dz * dz);
+		XMFLOAT3 center((data.boundsMin.x + data.boundsMax.x) * 0.5f, (data.boundsMin.y + data.boundsMax.y) * 0.5f, (data.boundsMin.z + data.boundsMax.z) * 0.5f);
+		XMFLOAT3 cameraPosition(center.x, center.y + size * 0.3f, center.z - size * 0.5f);
+
+		XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&cameraPosition), XMLoadFloat3(&center), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.01f, size * 10.0f);
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, projection));
+		Frustum frustum = Culling::ExtractFrustum(viewProjection);
+
+		std::vector<IndexRange> ranges;
+		size_t visibleTriangles = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeats; r++)
+			visibleTriangles = MeshletBuilder::CullMeshlets(meshlets, lod.meshletCount, frustum, cameraPosition, ranges);
+		float cullMilliseconds = MillisecondsSince(start) / repeats;
+
+		std::printf("  %-22s %8u meshlets, %5.1f vertices %5.1f triangles each, build %8.3f ms, cull %7.3f ms, %u -> %zu triangles in %zu ranges\n",
+			name, lod.meshletCount,
+			lod.meshletCount ? (float)vertexTotal / lod.meshletCount : 0.0f,
+			lod.meshletCount ? (float)(lod.indexCount / 3) / lod.meshletCount : 0.0f,
+			buildMilliseconds, cullMilliseconds, lod.indexCount / 3, visibleTriangles, ranges.size());
+	}
+
+	// Parse a large synthetic OBJ (1000 x 1000 quads) with 1, 2, 4 ... up to the
+	// number of hardware threads, printing each time and the speed up over 1 thread.
+	// Returns the number of thread counts whose result differs from 1 thread's.
+	int CheckParseScaling()
+	{
+		// Build the synthetic file once in memory so only parsing is timed.
+		std::string objText = ObjParser::GenerateSyntheticObj(1000);
+		std::printf("Synthetic OBJ size: %.1f MB\n", objText.size() / (1024.0f * 1024.0f));
+
+		// Double the thread count each run, always ending with every hardware thread.
+		unsigned int maxThreads = std::thread::hardware_concurrency();
+		if (maxThreads == 0)
+			maxThreads = 1;
+
+		int failures = 0;
+		ObjMeshData reference;
+		float referenceMilliseconds = 0.0f;
+		for (unsigned int threads = 1; ; threads *= 2)
+		{
+			if (threads > maxThreads)
+				threads = maxThreads;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			ObjMeshData data = ObjParser::ParseBuffer(objText.data(), objText.size(), threads);
+			float milliseconds = MillisecondsSince(start);
+
+			bool matches = true;
+			if (threads == 1)
+			{
+				reference = std::move(data);
+				referenceMilliseconds = milliseconds;
+			}
+			else
+			{
+				matches = data.vertices.size() == reference.vertices.size() && data.indices == reference.indices &&
+					std::memcmp(data.vertices.data(), reference.vertices.data(), data.vertices.size() * sizeof(Vertex)) == 0;
+			}
+
+			std::printf("  %2u thread(s): %8.2f ms (x%.2f)%s\n", threads, milliseconds,
+				referenceMilliseconds / milliseconds, matches ? "" : "  FAILED");
+			if (!matches)
+				failures++;
+
+			if (threads == maxThreads)
+				break;
+		}
+		return failures;
+	}
+
+	// Time a cold parse of an OBJ (with tangents) against mapping its binary
+	// cache and reading the arrays out of it, and check the two agree.
+	// - The cache is written first when missing or stale, as Mesh does
+	// - A cache that can not be written (e.g. read-only assets) is reported, not failed
+	// - A copy with an out of range index must be rejected, and one with an old
+	//   source time must be accepted and restamped
+	// Returns 1 if the cache's contents differ from the parse or a check fails.
+	int CheckMeshCache(const std::filesystem::path& path)
+	{
+		std::string name = path.filename().string();
+		std::string file = path.string();
+
+		// Parse, optimize and calculate tangents, as a first load does.
+		auto start = std::chrono::high_resolution_clock::now();
+		MeshData<unsigned int> data = MeshProcessing::ProcessObj(file.c_str());
+		float parseMilliseconds = MillisecondsSince(start);
+
+		MappedFile cacheFile;
+		const MeshCacheHeader* header = nullptr;
+		if (!MeshCache::Open(file.c_str(), cacheFile, header) && !data.indices.empty())
+		{
+			MeshCache::Write(file.c_str(), &data.vertices[0], (unsigned int)data.vertices.size(),
+				&data.indices[0], (unsigned int)data.indices.size(), (unsigned int)data.cornerCount, data.boundsMin, data.boundsMax,
+				data.lods.data(), (unsigned int)data.lods.size(), data.meshlets.data(), (unsigned int)data.meshlets.size());
+		}
+		cacheFile.Close();
+
+		// Map the cache and copy the arrays out so every page is actually read.
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<char> copy;
+		if (!MeshCache::Open(file.c_str(), cacheFile, header))
+		{
+			std::printf("  %-22s parse %8.3f ms, no cache\n", name.c_str(), parseMilliseconds);
+			return 0;
+		}
+		const char* begin = reinterpret_cast<const char*>(MeshCache::GetMeshlets(header));
+		copy.assign(begin, cacheFile.GetData() + cacheFile.GetSize());
+		float mapMilliseconds = MillisecondsSince(start);
+
+		bool matches = header->vertexCount == data.vertices.size() && header->indexCount == data.indices.size() &&
+			header->lodCount == data.lods.size() && header->meshletCount == data.meshlets.size() &&
+			std::memcmp(MeshCache::GetVertices(header), data.vertices.data(), data.vertices.size() * sizeof(Vertex)) == 0;
+		for (size_t i = 0; matches && i < data.indices.size(); i++)
+		{
+			unsigned int index = (header->indexSize == 2)
+				? static_cast<const uint16_t*>(MeshCache::GetIndices(header))[i]
+				: static_cast<const unsigned int*>(MeshCache::GetIndices(header))[i];
+			matches = index == data.indices[i];
+		}
+
+		// Keep the whole file so it can be restored after the edited copies.
+		std::vector<char> original(cacheFile.GetData(), cacheFile.GetData() + cacheFile.GetSize());
+		uint32_t indexSize = header->indexSize;
+		size_t lastIndexOffset = original.size() - indexSize;
+		uint32_t vertexCount = header->vertexCount;
+		int64_t sourceTime = header->sourceTime;
+		cacheFile.Close();
+
+		std::string cachePath = file + ".meshcache";
+		auto writeCache = [&cachePath](const std::vector<char>& bytes)
+		{
+			std::ofstream out(cachePath, std::ios::binary | std::ios::trunc);
+			out.write(bytes.data(), bytes.size());
+		};
+
+		// An index past the last vertex.
+		std::vector<char> edited = original;
+		if (data.indices.size() > 0)
+		{
+			if (indexSize == 2)
+			{
+				uint16_t badIndex = (uint16_t)vertexCount;
+				std::memcpy(&edited[lastIndexOffset], &badIndex, sizeof(badIndex));
+			}
+			else
+				std::memcpy(&edited[lastIndexOffset], &vertexCount, sizeof(vertexCount));
+		}
+		writeCache(edited);
+		bool guarded = data.indices.empty() || !MeshCache::Open(file.c_str(), cacheFile, header);
+		cacheFile.Close();
+
+		// An older source time over the same source.
+		edited = original;
+		int64_t oldTime = sourceTime - 1;
+		std::memcpy(&edited[offsetof(MeshCacheHeader, sourceTime)], &oldTime, sizeof(oldTime));
+		writeCache(edited);
+		guarded = guarded && MeshCache::Open(file.c_str(), cacheFile, header) && header->sourceTime == sourceTime;
+		cacheFile.Close();
+
+		writeCache(original);
+
+		std::printf("  %-22s parse %8.3f ms, cache %8.3f ms (x%.1f)%s%s\n", name.c_str(),
+			parseMilliseconds, mapMilliseconds, parseMilliseconds / mapMilliseconds,
+			matches ? "" : "  FAILED", guarded ? "" : "  FAILED (validation)");
+		return matches && guarded ? 0 : 1;
+	}
+
+	// Run an OBJ's index order through a simulated 16 entry FIFO vertex cache,
+	// then optimize the mesh as MeshProcessing does and measure again.
+	// Returns 1 if optimizing raised the ACMR.
+	int CheckVertexCache(const std::filesystem::path& path)
+	{
+		ObjMeshData data = ObjParser::ParseFile(path.string().c_str());
+
+		VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(data.indices, data.vertices.size(), 16, false);
+		MeshOptimizer::OptimizeVertexCache(data.indices, data.vertices.size());
+		MeshOptimizer::OptimizeVertexFetch(data.vertices, data.indices);
+		VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(data.indices, data.vertices.size(), 16, false);
+
+		bool improved = after.acmr <= before.acmr + 1e-6f;
+		std::printf("  %-22s ACMR %.3f -> %.3f, ATVR %.3f -> %.3f%s\n", path.filename().string().c_str(),
+			before.acmr, after.acmr, before.atvr, after.atvr, improved ? "" : "  FAILED");
+		return improved ? 0 : 1;
+	}
+
+	// Largest normal or tangent angle error allowed after packing, in degrees.
+	const float MAX_PACKED_ANGLE_DEGREES = 0.1f;
+
+	// Pack a processed mesh's vertices and print the memory saved and the largest
+	// decoding errors.
+	// - Positions may be off by one snorm16 step of the largest bounds extent and
+	//   uvs by one unorm16 step of the largest uv range
+	// Returns 1 if any error is over its limit.
+	int CheckVertexPacking(const char* name, const MeshData<unsigned int>& data)
+	{
+		VertexQuantization quantization = {};
+		std::vector<PackedVertex> packed = VertexPacking::PackVertices(data.vertices.data(), data.vertices.size(), quantization);
+		VertexPackingError error = VertexPacking::MeasureError(data.vertices.data(), packed.data(), packed.size(), quantization);
+
+		const XMFLOAT3& extent = quantization.positionExtent;
+		float maxPosition = std::max(extent.x, std::max(extent.y, extent.z)) / 32767.0f;
+		float maxUV = std::max(quantization.uvScale.x, quantization.uvScale.y) / 65535.0f;
+		bool withinLimits = error.maxPosition <= maxPosition && error.maxUV <= maxUV &&
+			error.maxNormalDegrees <= MAX_PACKED_ANGLE_DEGREES && error.maxTangentDegrees <= MAX_PACKED_ANGLE_DEGREES;
+
+		std::printf("  %-22s %7.1f KB -> %7.1f KB, max error position %.6f, uv %.6f, normal %.3f deg, tangent %.3f deg%s\n", name,
+			data.vertices.size() * sizeof(Vertex) / 1024.0f, packed.size() * sizeof(PackedVertex) / 1024.0f,
+			error.maxPosition, error.maxUV, error.maxNormalDegrees, error.maxTangentDegrees, withinLimits ? "" : "  FAILED");
+		return withinLimits ? 0 : 1;
+	}
+
+	// Largest per-component difference allowed between the SIMD or multithreaded
+	// tangents and the scalar ones, and between a tangent and a unit vector
+	// perpendicular to its normal.
+	const float TANGENT_TOLERANCE = 1e-4f;
+
+	// Generate a mesh's tangents with the scalar, SIMD and multithreaded versions,
+	// timing each and comparing the SIMD and multithreaded results to the scalar one.
+	// - The multithreaded version always uses 4 threads so its per-thread arrays
+	//   are summed even on a single core machine
+	// Returns the number of versions that fail.
+	int CheckTangents(const char* name, const ObjMeshData& data)
+	{
+		const char* versionNames[3] = { "scalar", "SIMD", "parallel" };
+		std::vector<Vertex> results[3] = { data.vertices, data.vertices, data.vertices };
+		int failures = 0;
+		for (int version = 0; version < 3; version++)
+		{
+			Vertex* vertices = results[version].data();
+			auto start = std::chrono::high_resolution_clock::now();
+			if (version == 0)
+				TangentGenerator::CalculateTangentsScalar(vertices, data.vertices.size(), data.indices.data(), data.indices.size());
+			else if (version == 1)
+				TangentGenerator::CalculateTangentsSIMD(vertices, data.vertices.size(), data.indices.data(), data.indices.size());
+			else
+				TangentGenerator::CalculateTangentsParallel(vertices, data.vertices.size(), data.indices.data(), data.indices.size(), 4);
+			float milliseconds = MillisecondsSince(start);
+
+			// Largest difference from the scalar reference, and from a unit tangent perpendicular to the normal.
+			float maxDifference = 0.0f;
+			float maxOrthonormalError = 0.0f;
+			for (size_t i = 0; i < data.vertices.size(); i++)
+			{
+				const XMFLOAT3& a = results[0][i].Tangent;
+				const XMFLOAT3& b = results[version][i].Tangent;
+				const XMFLOAT3& n = results[version][i].normal;
+				maxDifference = std::max(maxDifference, std::max(std::fabs(a.x - b.x), std::max(std::fabs(a.y - b.y), std::fabs(a.z - b.z))));
+
+				float length = std::sqrt(b.x * b.x + b.y * b.y + b.z * b.z);
+				float dot = b.x * n.x + b.y * n.y + b.z * n.z;
+				float error = std::max(std::fabs(length - 1.0f), std::fabs(dot));
+				maxOrthonormalError = std::isnan(error) ? INFINITY : std::max(maxOrthonormalError, error);
+			}
+
+			bool ok = maxDifference <= TANGENT_TOLERANCE && maxOrthonormalError <= TANGENT_TOLERANCE;
+			std::printf("  %-24s %-8s %8.2f ms, max difference %g, max unit/perpendicular error %g%s\n", name, versionNames[version],
+				milliseconds, maxDifference, maxOrthonormalError, ok ? "" : "  FAILED");
+			if (!ok)
+				failures++;
+		}
+		return failures;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::filesystem::path folder = (argc > 1) ? argv[1] : "Assets/Meshes";
+
+	// Collect the files first so they are reported in a stable order.
+	std::vector<std::filesystem::path> paths;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(folder, error))
+	{
+		if (entry.is_regular_file() && entry.path().extension() == ".obj")
+			paths.push_back(entry.path());
+	}
+
+	if (error)
+	{
+		std::printf("Could not open mesh folder: %s\n", folder.string().c_str());
+		return 1;
+	}
+
+	std::sort(paths.begin(), paths.end());
+
+	std::printf("%-24s %10s %10s %10s %10s %10s %10s %10s\n", "Mesh", "Corners", "Vertices", "Parse ms", "Weld ms", "Optim. ms", "Tangent ms", "LOD ms");
+	int failures = 0;
+	std::vector<std::string> names;
+	std::vector<MeshData<unsigned int>> meshes;
+	std::vector<float> meshletMilliseconds;
+	for (const std::filesystem::path& path : paths)
+	{
+		try
+		{
+			MeshLoadTimings timings = {};
+			MeshData<unsigned int> data = MeshProcessing::ProcessObj(path.string().c_str(), &timings);
+
+			std::printf("%-24s %10zu %10zu %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+				path.filename().string().c_str(), data.cornerCount, data.vertices.size(),
+				timings.parseMilliseconds, timings.weldMilliseconds,
+				timings.optimizeMilliseconds, timings.tangentMilliseconds, timings.lodMilliseconds);
+
+			names.push_back(path.filename().string());
+			meshletMilliseconds.push_back(timings.meshletMilliseconds);
+			meshes.push_back(std::move(data));
+		}
+		catch (const std::exception& e)
+		{
+			std::printf("%-24s failed: %s\n", path.filename().string().c_str(), e.what());
+			failures++;
+		}
+	}
+
+	std::printf("\nLevels of detail\n");
+	for (size_t i = 0; i < meshes.size(); i++)
+		failures += CheckLods(names[i].c_str(), meshes[i]);
+
+	// A smooth seamless grid should always reach the half-triangle target for its first level.
+	std::string gridText = ObjParser::GenerateSyntheticObj(64);
+	MeshData<unsigned int> grid = ObjParser::ParseBuffer(gridText.data(), gridText.size());
+	MeshProcessing::CalculateBounds(grid.vertices.data(), grid.vertices.size(), grid.boundsMin, grid.boundsMax);
+	MeshProcessing::GenerateLods(grid);
+	failures += CheckLods("synthetic 64x64 grid", grid);
+	if (grid.lods.size() < 2 || grid.lods[1].indexCount * 2 > grid.lods[0].indexCount)
+	{
+		std::printf("  synthetic 64x64 grid did not reach half the triangles for LOD 1  FAILED\n");
+		failures++;
+	}
+
+	std::printf("\n16-bit vs 32-bit indices\n");
+	for (size_t i = 0; i < meshes.size(); i++)
+		failures += CheckIndexWidths(names[i].c_str(), meshes[i]);
+
+	std::printf("\nMeshlets (full detail)\n");
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (!meshes[i].lods.empty())
+			ReportMeshlets(names[i].c_str(), meshes[i], meshletMilliseconds[i], 1000);
+	}
+
+	// About a million triangles (708 x 708 quads), cache optimized as a loaded mesh would be.
+	std::string bigGridText = ObjParser::GenerateSyntheticObj(708);
+	MeshData<unsigned int> bigGrid = ObjParser::ParseBuffer(bigGridText.data(), bigGridText.size());
+	MeshOptimizer::OptimizeVertexCache(bigGrid.indices, bigGrid.vertices.size());
+	MeshOptimizer::OptimizeVertexFetch(bigGrid.vertices, bigGrid.indices);
+	MeshProcessing::CalculateBounds(bigGrid.vertices.data(), bigGrid.vertices.size(), bigGrid.boundsMin, bigGrid.boundsMax);
+
+	auto meshletStart = std::chrono::high_resolution_clock::now();
+	MeshProcessing::GenerateMeshlets(bigGrid);
+	ReportMeshlets("synthetic 708x708 grid", bigGrid, MillisecondsSince(meshletStart), 10);
+
+	std::printf("\nOBJ parse thread scaling\n");
+	failures += CheckParseScaling();
+
+	std::printf("\nCold parse vs mapped cache\n");
+	for (const std::filesystem::path& path : paths)
+	{
+		try
+		{
+			failures += CheckMeshCache(path);
+		}
+		catch (const std::exception& e)
+		{
+			std::printf("  %-22s failed: %s\n", path.filename().string().c_str(), e.what());
+			failures++;
+		}
+	}
+
+	std::printf("\nVertex packing\n");
+	for (size_t i = 0; i < meshes.size(); i++)
+		failures += CheckVertexPacking(names[i].c_str(), meshes[i]);
+
+	std::printf("\nTangent generation\n");
+	{
+		// Collapse the uvs of every 7th vertex so some triangles have degenerate uvs.
+		std::string tangentGridText = ObjParser::GenerateSyntheticObj(1000);
+		ObjMeshData tangentGrid = ObjParser::ParseBuffer(tangentGridText.data(), tangentGridText.size());
+		for (size_t i = 0; i < tangentGrid.vertices.size(); i += 7)
+			tangentGrid.vertices[i].uv = XMFLOAT2(0.5f, 0.5f);
+		failures += CheckTangents("synthetic 1000x1000 grid", tangentGrid);
+
+		// Every uv the same, so no triangle adds a tangent and each vertex gets the fallback.
+		ObjMeshData uvlessGrid = ObjParser::ParseBuffer(gridText.data(), gridText.size());
+		for (Vertex& vertex : uvlessGrid.vertices)
+			vertex.uv = XMFLOAT2(0.0f, 0.0f);
+		failures += CheckTangents("uv-less 64x64 grid", uvlessGrid);
+	}
+
+	std::printf("\nVertex cache (16 entry FIFO)\n");
+	for (const std::filesystem::path& path : paths)
+	{
+		try
+		{
+			failures += CheckVertexCache(path);
+		}
+		catch (const std::exception& e)
+		{
+			std::printf("  %-22s failed: %s\n", path.filename().string().c_str(), e.what());
+			failures++;
+		}
+	}
+
+	return failures > 0 ? 1 : 0;
+}
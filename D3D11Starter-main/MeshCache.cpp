@@ -0,0 +1,267 @@
+#include "MeshCache.h"
+#include "MeshData.h"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the cache file helpers
+// only accessible in this file
+namespace
+{
+	const char MAGIC[4] = { 'M', 'S', 'H', 'C' };
+
+	// Size and last write time of the source file.
+	struct SourceStamp
+	{
+		uint64_t size;
+		int64_t time;
+	};
+
+	std::string GetCachePath(const char* objPath)
+	{
+		return std::string(objPath) + ".meshcache";
+	}
+
+	// Get the size and last write time of a file without throwing.
+	bool GetSourceStamp(const char* path, SourceStamp& stamp)
+	{
+		std::error_code error;
+		stamp.size = (uint64_t)std::filesystem::file_size(path, error);
+		if (error)
+			return false;
+
+		auto time = std::filesystem::last_write_time(path, error);
+		if (error)
+			return false;
+
+		stamp.time = (int64_t)time.time_since_epoch().count();
+		return true;
+	}
+
+	// 64-bit FNV-1a hash of the whole source file.
+	uint64_t HashSource(const char* path)
+	{
+		uint64_t hash = 0xCBF29CE484222325ull;
+
+		MappedFile file;
+		if (!file.Open(path))
+			return hash;
+
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file.GetData());
+		for (size_t i = 0; i < file.GetSize(); i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+
+		return hash;
+	}
+
+	// Check every index is below the vertex count.
+	template <typename IndexType>
+	bool IndicesInRange(const void* indices, uint32_t indexCount, uint32_t vertexCount)
+	{
+		const IndexType* typed = static_cast<const IndexType*>(indices);
+		for (uint32_t i = 0; i < indexCount; i++)
+		{
+			if (typed[i] >= vertexCount)
+				return false;
+		}
+		return true;
+	}
+
+	// Check the level of detail and meshlet ranges and the index values stay
+	// inside the cache's arrays, so a corrupt cache is re-parsed instead of
+	// read out of bounds.
+	bool RangesInBounds(const MeshCacheHeader* header)
+	{
+		for (uint32_t i = 0; i < header->lodCount; i++)
+		{
+			const MeshLod& lod = header->lods[i];
+			if ((uint64_t)lod.indexStart + lod.indexCount > header->indexCount ||
+				(uint64_t)lod.meshletStart + lod.meshletCount > header->meshletCount)
+				return false;
+		}
+
+		const Meshlet* meshlets = MeshCache::GetMeshlets(header);
+		for (uint32_t i = 0; i < header->meshletCount; i++)
+		{
+			if ((uint64_t)meshlets[i].indexStart + (uint64_t)meshlets[i].triangleCount * 3 > header->indexCount)
+				return false;
+		}
+
+		const void* indices = MeshCache::GetIndices(header);
+		return header->indexSize == 2
+			? IndicesInRange<uint16_t>(indices, header->indexCount, header->vertexCount)
+			: IndicesInRange<uint32_t>(indices, header->indexCount, header->vertexCount);
+	}
+
+	// Write a new source time into a cache's header, so a source that was only
+	// touched is not hashed again on every load.
+	// - Failing (e.g. read-only assets) only means the hash is checked again next time
+	void RestampCache(const std::string& cachePath, int64_t time)
+	{
+		std::fstream out(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		if (!out.is_open())
+			return;
+
+		out.seekp(offsetof(MeshCacheHeader, sourceTime));
+		out.write(reinterpret_cast<const char*>(&time), sizeof(time));
+	}
+}
+
+bool MeshCache::Open(const char* objPath, MappedFile& file, const MeshCacheHeader*& header)
+{
+	header = nullptr;
+	if (!file.Open(GetCachePath(objPath).c_str()))
+		return false;
+
+	// Check the header matches this build's file and vertex layout.
+	const MeshCacheHeader* fileHeader = reinterpret_cast<const MeshCacheHeader*>(file.GetData());
+	bool valid = file.GetSize() >= sizeof(MeshCacheHeader) &&
+		memcmp(fileHeader->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+		fileHeader->version == VERSION &&
+		fileHeader->vertexSize == sizeof(Vertex) &&
+		(fileHeader->indexSize == 2 || fileHeader->indexSize == 4) &&
+		fileHeader->lodCount <= MAX_MESH_LODS;
+
+	// Check the arrays actually fit in the file.
+	if (valid)
+	{
+		uint64_t expectedSize = sizeof(MeshCacheHeader) +
+			(uint64_t)fileHeader->meshletCount * sizeof(Meshlet) +
+			(uint64_t)fileHeader->vertexCount * sizeof(Vertex) +
+			(uint64_t)fileHeader->indexCount * fileHeader->indexSize;
+		valid = file.GetSize() == expectedSize && RangesInBounds(fileHeader);
+	}
+
+	// Check the cache was built from the current source.
+	// - Matching size and timestamp is trusted without reading the source
+	// - A touched but unchanged source (e.g. copied or checked out again) is
+	//   still accepted if its hash matches, and its new timestamp is saved
+	// - A missing source keeps using the cache
+	SourceStamp stamp = {};
+	bool restamp = false;
+	if (valid && GetSourceStamp(objPath, stamp))
+	{
+		if (stamp.size != fileHeader->sourceSize)
+			valid = false;
+		else if (stamp.time != fileHeader->sourceTime)
+			valid = restamp = HashSource(objPath) == fileHeader->sourceHash;
+	}
+
+	if (!valid)
+	{
+		file.Close();
+		return false;
+	}
+
+	// The mapping is read-only (and blocks writers on Windows), so close it
+	// around the header update and map the file again.
+	if (restamp)
+	{
+		std::string cachePath = GetCachePath(objPath);
+		size_t size = file.GetSize();
+		file.Close();
+		RestampCache(cachePath, stamp.time);
+		if (!file.Open(cachePath.c_str()) || file.GetSize() != size)
+		{
+			file.Close();
+			return false;
+		}
+		fileHeader = reinterpret_cast<const MeshCacheHeader*>(file.GetData());
+	}
+
+	header = fileHeader;
+	return true;
+}
+
+const Meshlet* MeshCache::GetMeshlets(const MeshCacheHeader* header)
+{
+	return reinterpret_cast<const Meshlet*>(header + 1);
+}
+
+const Vertex* MeshCache::GetVertices(const MeshCacheHeader* header)
+{
+	return reinterpret_cast<const Vertex*>(GetMeshlets(header) + header->meshletCount);
+}
+
+const void* MeshCache::GetIndices(const MeshCacheHeader* header)
+{
+	return GetVertices(header) + header->vertexCount;
+}
+
+bool MeshCache::Write(const char* objPath, const Vertex* vertices, unsigned int vertexCount,
+	const unsigned int* indices, unsigned int indexCount, unsigned int unweldedVertexCount,
+	XMFLOAT3 boundsMin, XMFLOAT3 boundsMax, const MeshLod* lods, unsigned int lodCount,
+	const Meshlet* meshlets, unsigned int meshletCount)
+{
+	if (lodCount > MAX_MESH_LODS)
+		return false;
+
+	SourceStamp stamp = {};
+	if (!GetSourceStamp(objPath, stamp))
+		return false;
+
+	// Fill in the header.
+	MeshCacheHeader header = {};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.indexSize = FitsIn16BitIndices(vertexCount) ? 2 : 4;
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+	header.unweldedVertexCount = unweldedVertexCount;
+	header.sourceSize = stamp.size;
+	header.sourceTime = stamp.time;
+	header.sourceHash = HashSource(objPath);
+	header.boundsMin = boundsMin;
+	header.boundsMax = boundsMax;
+	header.lodCount = lodCount;
+	for (unsigned int i = 0; i < lodCount; i++)
+		header.lods[i] = lods[i];
+	header.meshletCount = meshletCount;
+
+	// Write to a temporary file first so a half written cache is never mapped.
+	std::string cachePath = GetCachePath(objPath);
+	std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(meshlets), (std::streamsize)sizeof(Meshlet) * meshletCount);
+		out.write(reinterpret_cast<const char*>(vertices), (std::streamsize)sizeof(Vertex) * vertexCount);
+
+		if (header.indexSize == 2)
+		{
+			std::vector<uint16_t> shortIndices(indices, indices + indexCount);
+			out.write(reinterpret_cast<const char*>(shortIndices.data()), (std::streamsize)sizeof(uint16_t) * indexCount);
+		}
+		else
+		{
+			out.write(reinterpret_cast<const char*>(indices), (std::streamsize)sizeof(unsigned int) * indexCount);
+		}
+
+		if (!out.good())
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+
+#include "MappedFile.h"
+#include "MeshData.h"
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Header at the start of a binary mesh cache file.
+//
+// - The header is followed by "meshletCount" Meshlet structs,
+//   then "vertexCount" Vertex structs (already laid out as in
+//   Vertex.h, tangents included) and then "indexCount" 16 or
+//   32-bit indices
+// - The source OBJ's size, last write time and hash are kept
+//   so a stale cache can be detected and rebuilt
+// - The first "lodCount" entries of "lods" are the index
+//   ranges of each level of detail
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexSize;
+	uint32_t indexSize;
+
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t unweldedVertexCount;
+	uint32_t lodCount;
+
+	uint32_t meshletCount;
+	uint32_t padding;
+
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint64_t sourceHash;
+
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+
+	MeshLod lods[MAX_MESH_LODS];
+};
+
+// --------------------------------------------------------
+// Binary mesh cache written next to each source .obj file
+// (e.g. "sphere.obj" -> "sphere.obj.meshcache").
+//
+// - The first load of an OBJ parses it and writes the cache
+// - Later loads memory-map the cache and hand its arrays
+//   straight to the GPU buffer creation code
+// --------------------------------------------------------
+namespace MeshCache
+{
+	// Bump this whenever the file layout, Vertex or the load-time mesh processing changes.
+	const uint32_t VERSION = 5;
+
+	// Map the cache for the given OBJ.
+	// - Returns false if there is no cache or it no longer matches the source
+	//   (different version, vertex layout, size, timestamp and hash)
+	// - Also returns false if a level of detail, meshlet or index points outside
+	//   the cache's arrays, so the caller re-parses the source
+	// - A source with a new timestamp but the same hash has its stamp rewritten
+	// - On success "header" points into the mapped file, which must stay open
+	bool Open(const char* objPath, MappedFile& file, const MeshCacheHeader*& header);
+
+	// Get the arrays that follow the header.
+	const Meshlet* GetMeshlets(const MeshCacheHeader* header);
+	const Vertex* GetVertices(const MeshCacheHeader* header);
+	const void* GetIndices(const MeshCacheHeader* header);
+
+	// Write the cache for the given OBJ.
+	// - Indices are stored as 16-bit values when every index fits
+	// - Returns false if the file could not be written (e.g. read-only assets)
+	bool Write(const char* objPath, const Vertex* vertices, unsigned int vertexCount,
+		const unsigned int* indices, unsigned int indexCount, unsigned int unweldedVertexCount,
+		DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, const MeshLod* lods, unsigned int lodCount,
+		const Meshlet* meshlets, unsigned int meshletCount);
+}
@@ -0,0 +1,149 @@
+#include "MeshData.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjParser.h"
+#include "TangentGenerator.h"
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the timing helper
+// only accessible in this file
+namespace
+{
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+MeshData<unsigned int> MeshProcessing::ProcessObj(const char* path, MeshLoadTimings* timings)
+{
+	// Parse the .obj file into CPU-side vertex and index arrays.
+	// - ObjParser maps the file and tokenizes it in place, and converts the
+	//   data to DirectX conventions (left-handed, flipped V, flipped winding)
+	ObjParseTimings parseTimings = {};
+	MeshData<unsigned int> data = ObjParser::ParseFile(path, 0, &parseTimings);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Reorder the triangles for vertex cache reuse, then the vertices for fetch order.
+	MeshOptimizer::OptimizeVertexCache(data.indices, data.vertices.size());
+	MeshOptimizer::OptimizeVertexFetch(data.vertices, data.indices);
+	float optimizeMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	if (!data.indices.empty())
+		TangentGenerator::CalculateTangentsParallel(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size());
+	float tangentMilliseconds = MillisecondsSince(start);
+
+	CalculateBounds(data.vertices.data(), data.vertices.size(), data.boundsMin, data.boundsMax);
+
+	start = std::chrono::high_resolution_clock::now();
+	GenerateLods(data);
+	float lodMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	GenerateMeshlets(data);
+	float meshletMilliseconds = MillisecondsSince(start);
+
+	if (timings)
+	{
+		timings->parseMilliseconds = parseTimings.parseMilliseconds;
+		timings->weldMilliseconds = parseTimings.weldMilliseconds;
+		timings->optimizeMilliseconds = optimizeMilliseconds;
+		timings->tangentMilliseconds = tangentMilliseconds;
+		timings->lodMilliseconds = lodMilliseconds;
+		timings->meshletMilliseconds = meshletMilliseconds;
+	}
+	return data;
+}
+
+void MeshProcessing::CalculateBounds(const Vertex* vertices, size_t vertexCount, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)
+{
+	if (vertexCount == 0)
+		return;
+
+	boundsMin = vertices[0].Position;
+	boundsMax = vertices[0].Position;
+	for (size_t i = 1; i < vertexCount; i++)
+	{
+		const XMFLOAT3& p = vertices[i].Position;
+		boundsMin = XMFLOAT3(p.x < boundsMin.x ? p.x : boundsMin.x, p.y < boundsMin.y ? p.y : boundsMin.y, p.z < boundsMin.z ? p.z : boundsMin.z);
+		boundsMax = XMFLOAT3(p.x > boundsMax.x ? p.x : boundsMax.x, p.y > boundsMax.y ? p.y : boundsMax.y, p.z > boundsMax.z ? p.z : boundsMax.z);
+	}
+}
+
+void MeshProcessing::GenerateLods(MeshData<unsigned int>& data, unsigned int maxLods, float maxErrorRatio)
+{
+	data.lods.clear();
+	if (data.indices.empty())
+		return;
+
+	data.lods.push_back({ 0, (unsigned int)data.indices.size(), 0.0f, 0, 0 });
+
+	// Errors are limited relative to the size of the mesh.
+	float dx = data.boundsMax.x - data.boundsMin.x;
+	float dy = data.boundsMax.y - data.boundsMin.y;
+	float dz = data.boundsMax.z - data.boundsMin.z;
+	float maxError = std::sqrt(dx * dx + dy * dy + dz * dz) * maxErrorRatio;
+
+	// Simplify each level from the one before it, so each costs less than the last.
+	// - Errors add up across levels, which keeps them an upper bound
+	while (data.lods.size() < maxLods)
+	{
+		MeshLod previous = data.lods.back();
+		size_t targetIndexCount = (previous.indexCount / 6) * 3;
+
+		float error = 0.0f;
+		std::vector<unsigned int> simplified = MeshSimplifier::Simplify(data.vertices,
+			&data.indices[previous.indexStart], previous.indexCount, targetIndexCount, maxError - previous.error, &error);
+
+		// Not worth a level of its own.
+		if (simplified.empty() || simplified.size() * 5 > (size_t)previous.indexCount * 4)
+			break;
+
+		MeshOptimizer::OptimizeVertexCache(simplified, data.vertices.size());
+
+		MeshLod lod = {};
+		lod.indexStart = (unsigned int)data.indices.size();
+		lod.indexCount = (unsigned int)simplified.size();
+		lod.error = previous.error + error;
+		data.indices.insert(data.indices.end(), simplified.begin(), simplified.end());
+		data.lods.push_back(lod);
+	}
+}
+
+void MeshProcessing::GenerateMeshlets(MeshData<unsigned int>& data)
+{
+	data.meshlets.clear();
+	if (data.indices.empty())
+		return;
+
+	if (data.lods.empty())
+		data.lods.push_back({ 0, (unsigned int)data.indices.size(), 0.0f, 0, 0 });
+
+	for (MeshLod& lod : data.lods)
+	{
+		lod.meshletStart = (unsigned int)data.meshlets.size();
+		MeshletBuilder::BuildMeshlets(data.vertices, data.indices.data(), lod.indexStart, lod.indexCount, data.meshlets);
+		lod.meshletCount = (unsigned int)data.meshlets.size() - lod.meshletStart;
+	}
+}
+
+unsigned int MeshProcessing::SelectLod(const MeshLod* lods, size_t lodCount, float pixelsPerUnit, float maxPixelError)
+{
+	// Levels are ordered finest first, so errors only grow.
+	unsigned int selected = 0;
+	for (size_t i = 1; i < lodCount; i++)
+	{
+		if (lods[i].error * pixelsPerUnit > maxPixelError)
+			break;
+		selected = (unsigned int)i;
+	}
+	return selected;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "MeshletBuilder.h"
+#include "Vertex.h"
+
+// One level of detail: a range of the index buffer.
+// - "error" is how far (in local units) this level may be from
+//   the full resolution surface; level 0 is always exact
+// - "meshletStart" and "meshletCount" pick out the meshlets
+//   covering this range (both 0 when none were built)
+struct MeshLod
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+	float error;
+	unsigned int meshletStart;
+	unsigned int meshletCount;
+};
+
+// Most levels of detail generated for a mesh, including level 0.
+const unsigned int MAX_MESH_LODS = 4;
+
+// --------------------------------------------------------
+// CPU-side mesh data, templated on the index width.
+//
+// - IndexType is uint16_t or unsigned int; the GPU index
+//   buffer format follows from sizeof(IndexType)
+// - "cornerCount" is the number of vertices there would have
+//   been without welding (one per face corner)
+// - "boundsMin" and "boundsMax" are the local space bounding
+//   box, filled in by MeshProcessing::CalculateBounds
+// - "lods" are consecutive ranges of "indices", finest first;
+//   when it is empty the whole index array is the only level
+// - "meshlets" split each level into small clusters for culling
+// - Platform-neutral: nothing here (or in MeshProcessing)
+//   touches Direct3D, Mesh is only the GPU uploader
+// --------------------------------------------------------
+template <typename IndexType>
+struct MeshData
+{
+	static_assert(sizeof(IndexType) == 2 || sizeof(IndexType) == 4, "Index buffers are 16 or 32-bit");
+
+	std::vector<Vertex> vertices;
+	std::vector<IndexType> indices;
+	size_t cornerCount = 0;
+
+	DirectX::XMFLOAT3 boundsMin = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	DirectX::XMFLOAT3 boundsMax = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+};
+
+// The largest vertex count that can use 16-bit indices.
+// - Index 0xFFFF is left unused since it is the strip cut value
+const size_t MAX_16_BIT_INDEX_VERTICES = 65535;
+
+// Check whether every index of a mesh this size fits in 16 bits.
+inline bool FitsIn16BitIndices(size_t vertexCount)
+{
+	return vertexCount <= MAX_16_BIT_INDEX_VERTICES;
+}
+
+// Copy a mesh into a different index width.
+// - Narrowing is only valid when FitsIn16BitIndices(vertices.size())
+template <typename ToIndexType, typename FromIndexType>
+MeshData<ToIndexType> ConvertIndexWidth(const MeshData<FromIndexType>& mesh)
+{
+	MeshData<ToIndexType> converted;
+	converted.vertices = mesh.vertices;
+	converted.indices.assign(mesh.indices.begin(), mesh.indices.end());
+	converted.cornerCount = mesh.cornerCount;
+	converted.boundsMin = mesh.boundsMin;
+	converted.boundsMax = mesh.boundsMax;
+	converted.lods = mesh.lods;
+	converted.meshlets = mesh.meshlets;
+	return converted;
+}
+
+// Time spent in each stage of building a mesh from an OBJ file.
+struct MeshLoadTimings
+{
+	float parseMilliseconds;
+	float weldMilliseconds;
+	float optimizeMilliseconds;
+	float tangentMilliseconds;
+	float lodMilliseconds;
+	float meshletMilliseconds;
+};
+
+// --------------------------------------------------------
+// CPU-side mesh processing, from an OBJ file to the arrays
+// Mesh uploads.
+// --------------------------------------------------------
+namespace MeshProcessing
+{
+	// Parse and weld the file, reorder it for the vertex cache, then
+	// generate tangents, calculate the bounds and build the LOD chain
+	// and its meshlets.
+	// - Throws std::invalid_argument if the file can not be opened or is malformed
+	// - Fills in "timings" when it is not null
+	MeshData<unsigned int> ProcessObj(const char* path, MeshLoadTimings* timings = nullptr);
+
+	// Calculate the local space axis aligned bounding box of the vertices.
+	// - Leaves the bounds untouched when there are no vertices
+	void CalculateBounds(const Vertex* vertices, size_t vertexCount, DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax);
+
+	// Append simplified levels of detail to the index array, each aiming
+	// for half the triangles of the level before it.
+	// - Stops early once a level can not get below 80% of the previous one
+	//   without moving the surface more than maxErrorRatio of the bounds size
+	// - Tangents and bounds should already be calculated from level 0
+	void GenerateLods(MeshData<unsigned int>& data, unsigned int maxLods = MAX_MESH_LODS, float maxErrorRatio = 0.05f);
+
+	// Split every level of detail into meshlets.
+	// - A mesh without levels gets one covering the whole index array
+	void GenerateMeshlets(MeshData<unsigned int>& data);
+
+	// Pick the coarsest level whose error covers at most maxPixelError pixels
+	// on screen, given how many pixels one local unit of the mesh covers.
+	unsigned int SelectLod(const MeshLod* lods, size_t lodCount, float pixelsPerUnit, float maxPixelError = 1.0f);
+}
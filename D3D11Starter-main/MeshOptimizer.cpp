@@ -0,0 +1,237 @@
+#include "MeshOptimizer.h"
+
+#include <climits>
+#include <cmath>
+
+// Annonymous namespace to hold the scoring helpers
+// only accessible in this file
+namespace
+{
+	// Size of the cache modelled while choosing triangles.
+	const int CACHE_SIZE = 32;
+
+	// Tuning values from Forsyth's article.
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	// Score of a vertex from its place in the cache (-1 = not cached)
+	// and the number of triangles that still use it.
+	float ScoreVertex(int cachePosition, unsigned int remainingTriangles)
+	{
+		// No triangles left to draw with this vertex.
+		if (remainingTriangles == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			// The three vertices of the last triangle get a fixed score so the
+			// next triangle does not simply reuse the same edge every time.
+			if (cachePosition < 3)
+			{
+				score = LAST_TRIANGLE_SCORE;
+			}
+			else
+			{
+				float scaler = 1.0f / (CACHE_SIZE - 3);
+				score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+			}
+		}
+
+		// Boost vertices with few triangles left so they are finished off.
+		score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+		return score;
+	}
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	// Count the triangles that use each vertex.
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (unsigned int index : indices)
+		remaining[index]++;
+
+	// Build a compact vertex -> triangle adjacency list.
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t * 3 + c];
+			adjacency[fill[v]++] = (unsigned int)t;
+		}
+	}
+
+	// Initial vertex scores, with nothing in the cache yet.
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = ScoreVertex(-1, remaining[v]);
+
+	std::vector<bool> emitted(triangleCount, false);
+
+	// Model the cache as a small list, with 3 extra slots for the vertices
+	// pushed in by the latest triangle.
+	unsigned int cache[CACHE_SIZE + 3];
+	unsigned int newCache[CACHE_SIZE + 3];
+	int cacheCount = 0;
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+
+	unsigned int bestTriangle = UINT_MAX;
+	size_t scanCursor = 0;
+
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		// If nothing in the cache gave a candidate, take the next unused triangle.
+		if (bestTriangle == UINT_MAX)
+		{
+			while (emitted[scanCursor])
+				scanCursor++;
+			bestTriangle = (unsigned int)scanCursor;
+		}
+
+		// Emit the triangle.
+		const unsigned int* tri = &indices[bestTriangle * 3];
+		output.push_back(tri[0]);
+		output.push_back(tri[1]);
+		output.push_back(tri[2]);
+		emitted[bestTriangle] = true;
+
+		// Remove it from its vertices' adjacency lists.
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = tri[c];
+			unsigned int* begin = &adjacency[adjacencyOffsets[v]];
+			unsigned int* end = begin + remaining[v];
+			for (unsigned int* it = begin; it != end; it++)
+			{
+				if (*it == bestTriangle)
+				{
+					*it = *(end - 1);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// Move the triangle's vertices to the front of the cache.
+		// - Degenerate triangles only add a repeated vertex once
+		int newCount = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			if (newCount == 0 || (newCache[0] != tri[c] && (newCount == 1 || newCache[1] != tri[c])))
+				newCache[newCount++] = tri[c];
+		}
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Vertices pushed past the end fall out of the cache.
+		for (int i = CACHE_SIZE; i < newCount; i++)
+			vertexScores[newCache[i]] = ScoreVertex(-1, remaining[newCache[i]]);
+
+		cacheCount = newCount < CACHE_SIZE ? newCount : CACHE_SIZE;
+		for (int i = 0; i < cacheCount; i++)
+		{
+			cache[i] = newCache[i];
+			vertexScores[cache[i]] = ScoreVertex(i, remaining[cache[i]]);
+		}
+
+		// Rescore the triangles around the cached vertices and pick the best one.
+		// - Only these triangles changed score, so only they are candidates
+		bestTriangle = UINT_MAX;
+		float bestScore = -1.0f;
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			unsigned int* begin = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				unsigned int t = begin[j];
+				float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	// Give each vertex a new index the first time the index buffer uses it.
+	std::vector<unsigned int> remap(vertices.size(), UINT_MAX);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == UINT_MAX)
+		{
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize, bool lru)
+{
+	VertexCacheStats stats = {};
+	if (indices.empty() || vertexCount == 0 || cacheSize == 0)
+		return stats;
+
+	// The cache entries, oldest at the front.
+	std::vector<unsigned int> cache;
+	cache.reserve(cacheSize + 1);
+	size_t misses = 0;
+
+	for (unsigned int index : indices)
+	{
+		size_t position = 0;
+		while (position < cache.size() && cache[position] != index)
+			position++;
+
+		if (position < cache.size())
+		{
+			// A hit only changes the order in an LRU cache.
+			if (lru)
+			{
+				cache.erase(cache.begin() + position);
+				cache.push_back(index);
+			}
+			continue;
+		}
+
+		// A miss pushes the vertex in and evicts the oldest one.
+		misses++;
+		cache.push_back(index);
+		if (cache.size() > cacheSize)
+			cache.erase(cache.begin());
+	}
+
+	stats.acmr = (float)misses / (indices.size() / 3);
+	stats.atvr = (float)misses / vertexCount;
+	return stats;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Results of running an index buffer through a simulated
+// post-transform vertex cache.
+//
+// - ACMR (average cache miss ratio) is misses per triangle,
+//   between 0.5 (ideal for large meshes) and 3.0
+// - ATVR (average transformed vertex ratio) is misses per
+//   vertex, 1.0 meaning each vertex is shaded exactly once
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	float acmr;
+	float atvr;
+};
+
+// --------------------------------------------------------
+// Platform-neutral index and vertex reordering run on meshes
+// at load time, before the GPU buffers are created.
+// --------------------------------------------------------
+namespace MeshOptimizer
+{
+	// Reorder triangles for post-transform vertex cache reuse using
+	// Tom Forsyth's linear-speed vertex cache optimization.
+	void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+	// Reorder vertices in the order the index buffer first uses them, so
+	// vertex fetches walk through memory forwards. Unused vertices are removed.
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	// Count cache misses for a FIFO (like most GPUs) or LRU cache of the given size.
+	VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize, bool lru);
+}
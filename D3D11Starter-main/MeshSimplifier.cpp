@@ -0,0 +1,410 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the quadric and topology helpers
+// only accessible in this file
+namespace
+{
+	// Symmetric 4x4 matrix (upper triangle) summing the squared distance
+	// to a set of planes.
+	struct Quadric
+	{
+		double a00, a01, a02, a03;
+		double a11, a12, a13;
+		double a22, a23;
+		double a33;
+	};
+
+	// Add the plane ax + by + cz + d = 0 (normalized).
+	void AddPlane(Quadric& q, double a, double b, double c, double d)
+	{
+		q.a00 += a * a; q.a01 += a * b; q.a02 += a * c; q.a03 += a * d;
+		q.a11 += b * b; q.a12 += b * c; q.a13 += b * d;
+		q.a22 += c * c; q.a23 += c * d;
+		q.a33 += d * d;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+		q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+		q.a22 += other.a22; q.a23 += other.a23;
+		q.a33 += other.a33;
+	}
+
+	// Square root of the summed squared distances from the point to the
+	// quadric's planes, which is never less than the distance to any one of them.
+	float EvaluateQuadric(const Quadric& q, const XMFLOAT3& p)
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double error =
+			q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x +
+			q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y +
+			q.a22 * z * z + 2.0 * q.a23 * z +
+			q.a33;
+
+		return error > 0.0 ? (float)std::sqrt(error) : 0.0f;
+	}
+
+	XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	// Unnormalized triangle normal (its length is twice the area).
+	XMFLOAT3 TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+	{
+		return Cross(Subtract(p1, p0), Subtract(p2, p0));
+	}
+
+	// Squared distance from a point to the closest point of a triangle.
+	// - Ericson, Real-Time Collision Detection, section 5.1.5
+	float PointTriangleDistanceSquared(const XMFLOAT3& p, const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+	{
+		XMFLOAT3 ab = Subtract(b, a), ac = Subtract(c, a), ap = Subtract(p, a);
+		float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+		XMFLOAT3 closest;
+
+		XMFLOAT3 bp = Subtract(p, b);
+		float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+		XMFLOAT3 cp = Subtract(p, c);
+		float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+
+		float va = d3 * d6 - d5 * d4;
+		float vb = d5 * d2 - d1 * d6;
+		float vc = d1 * d4 - d3 * d2;
+
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			closest = a;
+		else if (d3 >= 0.0f && d4 <= d3)
+			closest = b;
+		else if (d6 >= 0.0f && d5 <= d6)
+			closest = c;
+		else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		{
+			float v = d1 / (d1 - d3);
+			closest = XMFLOAT3(a.x + ab.x * v, a.y + ab.y * v, a.z + ab.z * v);
+		}
+		else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		{
+			float w = d2 / (d2 - d6);
+			closest = XMFLOAT3(a.x + ac.x * w, a.y + ac.y * w, a.z + ac.z * w);
+		}
+		else if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		{
+			float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			closest = XMFLOAT3(b.x + (c.x - b.x) * w, b.y + (c.y - b.y) * w, b.z + (c.z - b.z) * w);
+		}
+		else
+		{
+			float denominator = 1.0f / (va + vb + vc);
+			float v = vb * denominator;
+			float w = vc * denominator;
+			closest = XMFLOAT3(a.x + ab.x * v + ac.x * w, a.y + ab.y * v + ac.y * w, a.z + ab.z * v + ac.z * w);
+		}
+
+		XMFLOAT3 offset = Subtract(p, closest);
+		return Dot(offset, offset);
+	}
+
+	// Map every vertex to the first vertex with exactly the same position.
+	std::vector<unsigned int> BuildPositionGroups(const std::vector<Vertex>& vertices)
+	{
+		std::vector<unsigned int> order(vertices.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = (unsigned int)i;
+
+		auto lessPosition = [&](unsigned int a, unsigned int b)
+			{
+				const XMFLOAT3& pa = vertices[a].Position;
+				const XMFLOAT3& pb = vertices[b].Position;
+				if (pa.x != pb.x) return pa.x < pb.x;
+				if (pa.y != pb.y) return pa.y < pb.y;
+				if (pa.z != pb.z) return pa.z < pb.z;
+				return a < b;
+			};
+		std::sort(order.begin(), order.end(), lessPosition);
+
+		std::vector<unsigned int> groups(vertices.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			bool samePosition = i > 0 &&
+				vertices[order[i]].Position.x == vertices[order[i - 1]].Position.x &&
+				vertices[order[i]].Position.y == vertices[order[i - 1]].Position.y &&
+				vertices[order[i]].Position.z == vertices[order[i - 1]].Position.z;
+			groups[order[i]] = samePosition ? groups[order[i - 1]] : order[i];
+		}
+		return groups;
+	}
+
+	// Find the vertices that must not move: seam vertices (their position is
+	// shared with another vertex) and vertices on an open border edge.
+	std::vector<bool> FindLockedVertices(const std::vector<Vertex>& vertices, const unsigned int* indices, size_t indexCount)
+	{
+		std::vector<unsigned int> groups = BuildPositionGroups(vertices);
+
+		std::vector<bool> locked(vertices.size(), false);
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			if (groups[v] != v)
+			{
+				locked[v] = true;
+				locked[groups[v]] = true;
+			}
+		}
+
+		// Directed edges between position groups; an edge with no opposite is a border.
+		std::vector<uint64_t> edges;
+		edges.reserve(indexCount);
+		for (size_t t = 0; t + 2 < indexCount; t += 3)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				uint64_t a = groups[indices[t + c]];
+				uint64_t b = groups[indices[t + (c + 1) % 3]];
+				edges.push_back((a << 32) | b);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for (uint64_t edge : edges)
+		{
+			uint64_t a = edge >> 32;
+			uint64_t b = edge & 0xFFFFFFFFull;
+			if (!std::binary_search(edges.begin(), edges.end(), (b << 32) | a))
+			{
+				// Lock every vertex at both ends, not just the group's first one.
+				locked[a] = true;
+				locked[b] = true;
+			}
+		}
+
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			if (locked[groups[v]])
+				locked[v] = true;
+		}
+		return locked;
+	}
+
+	// A possible collapse of vertex "from" onto its neighbor "to".
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		float error;
+	};
+}
+
+std::vector<unsigned int> MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount, float maxError, float* resultError)
+{
+	std::vector<unsigned int> result(indices, indices + indexCount);
+	float largestError = 0.0f;
+	size_t vertexCount = vertices.size();
+
+	std::vector<bool> locked = FindLockedVertices(vertices, indices, indexCount);
+
+	// Each vertex starts with the planes of the triangles around it.
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		const XMFLOAT3& p0 = vertices[indices[t]].Position;
+		XMFLOAT3 normal = TriangleNormal(p0, vertices[indices[t + 1]].Position, vertices[indices[t + 2]].Position);
+		float length = std::sqrt(Dot(normal, normal));
+		if (length <= FLT_MIN)
+			continue;
+
+		double a = normal.x / length, b = normal.y / length, c = normal.z / length;
+		double d = -(a * p0.x + b * p0.y + c * p0.z);
+		for (int corner = 0; corner < 3; corner++)
+			AddPlane(quadrics[indices[t + corner]], a, b, c, d);
+	}
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<unsigned int> collapseTarget(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<Collapse> candidates;
+
+	// Each pass collapses a batch of independent edges, cheapest first.
+	while (result.size() > targetIndexCount)
+	{
+		size_t triangleCount = result.size() / 3;
+
+		// Build a compact vertex -> triangle adjacency list.
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (unsigned int index : result)
+			adjacencyOffsets[index + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+		adjacency.resize(result.size());
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int c = 0; c < 3; c++)
+				adjacency[fill[result[t * 3 + c]]++] = (unsigned int)t;
+		}
+
+		// Every edge in both directions, as long as the vertex that moves is unlocked.
+		candidates.clear();
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int a = result[t * 3 + c];
+				unsigned int b = result[t * 3 + (c + 1) % 3];
+				if (!locked[a])
+					candidates.push_back({ a, b, EvaluateQuadric(quadrics[a], vertices[b].Position) });
+				if (!locked[b])
+					candidates.push_back({ b, a, EvaluateQuadric(quadrics[b], vertices[a].Position) });
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b)
+			{
+				if (a.error != b.error) return a.error < b.error;
+				if (a.from != b.from) return a.from < b.from;
+				return a.to < b.to;
+			});
+
+		for (size_t v = 0; v < vertexCount; v++)
+			collapseTarget[v] = (unsigned int)v;
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t remainingTriangles = triangleCount;
+		size_t targetTriangles = targetIndexCount / 3;
+		size_t collapses = 0;
+
+		for (const Collapse& collapse : candidates)
+		{
+			if (remainingTriangles <= targetTriangles || collapse.error > maxError)
+				break;
+
+			unsigned int from = collapse.from;
+			unsigned int to = collapse.to;
+			if (touched[from] || touched[to])
+				continue;
+
+			// Reject the collapse if any other triangle around "from" would flip,
+			// or if its fan overlaps a collapse already made this pass.
+			const XMFLOAT3& target = vertices[to].Position;
+			bool valid = true;
+			size_t removedTriangles = 0;
+			for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && valid; a++)
+			{
+				const unsigned int* tri = &result[adjacency[a] * 3];
+				for (int c = 0; c < 3; c++)
+				{
+					if (tri[c] != from && touched[tri[c]])
+						valid = false;
+				}
+
+				if (tri[0] == to || tri[1] == to || tri[2] == to)
+				{
+					removedTriangles++;
+					continue;
+				}
+
+				XMFLOAT3 p[3];
+				XMFLOAT3 moved[3];
+				for (int c = 0; c < 3; c++)
+				{
+					p[c] = vertices[tri[c]].Position;
+					moved[c] = (tri[c] == from) ? target : p[c];
+				}
+
+				XMFLOAT3 before = TriangleNormal(p[0], p[1], p[2]);
+				XMFLOAT3 after = TriangleNormal(moved[0], moved[1], moved[2]);
+				if (Dot(before, after) <= 0.0f)
+					valid = false;
+			}
+
+			if (!valid || removedTriangles == 0)
+				continue;
+
+			// Freeze the whole fan so later collapses this pass see it unchanged.
+			for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++)
+			{
+				const unsigned int* tri = &result[adjacency[a] * 3];
+				touched[tri[0]] = true;
+				touched[tri[1]] = true;
+				touched[tri[2]] = true;
+			}
+
+			collapseTarget[from] = to;
+			AddQuadric(quadrics[to], quadrics[from]);
+			largestError = std::max(largestError, collapse.error);
+			remainingTriangles -= removedTriangles;
+			collapses++;
+		}
+
+		if (collapses == 0)
+			break;
+
+		// Rewrite the indices and drop the triangles that collapsed to an edge.
+		size_t write = 0;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			unsigned int a = collapseTarget[result[t * 3 + 0]];
+			unsigned int b = collapseTarget[result[t * 3 + 1]];
+			unsigned int c = collapseTarget[result[t * 3 + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	if (resultError)
+		*resultError = largestError;
+	return result;
+}
+
+float MeshSimplifier::MeasureError(const std::vector<Vertex>& vertices, const unsigned int* indices, size_t indexCount,
+	const unsigned int* simplified, size_t simplifiedCount)
+{
+	if (simplifiedCount < 3)
+		return 0.0f;
+
+	std::vector<bool> measured(vertices.size(), false);
+	float largestDistanceSquared = 0.0f;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (measured[v])
+			continue;
+		measured[v] = true;
+
+		const XMFLOAT3& p = vertices[v].Position;
+		float closest = FLT_MAX;
+		for (size_t t = 0; t + 2 < simplifiedCount && closest > 0.0f; t += 3)
+		{
+			closest = std::min(closest, PointTriangleDistanceSquared(p,
+				vertices[simplified[t]].Position, vertices[simplified[t + 1]].Position, vertices[simplified[t + 2]].Position));
+		}
+		largestDistanceSquared = std::max(largestDistanceSquared, closest);
+	}
+
+	return std::sqrt(largestDistanceSquared);
+}
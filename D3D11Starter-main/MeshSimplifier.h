@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Platform-neutral mesh simplification for LOD generation.
+//
+// - Quadric error metric edge collapses (Garland-Heckbert),
+//   always collapsing a vertex onto one of its neighbors so
+//   every level indexes the same vertex buffer
+// - Vertices on UV/normal seams (a position shared by more
+//   than one vertex) or on open borders are never moved,
+//   so seams and silhouettes of open meshes stay intact
+// - Collapses that would flip a triangle are rejected
+// --------------------------------------------------------
+namespace MeshSimplifier
+{
+	// Collapse edges until at most targetIndexCount indices are left, or
+	// the next collapse would move the surface further than maxError
+	// (in mesh local units).
+	// - Returns the simplified indices, which index the same vertices
+	// - Fills in "resultError" with the largest error of any collapse made
+	std::vector<unsigned int> Simplify(const std::vector<Vertex>& vertices, const unsigned int* indices, size_t indexCount,
+		size_t targetIndexCount, float maxError, float* resultError = nullptr);
+
+	// Largest distance from any vertex used by "indices" to the closest
+	// triangle of "simplified". Brute force, so only meant for checking results.
+	float MeasureError(const std::vector<Vertex>& vertices, const unsigned int* indices, size_t indexCount,
+		const unsigned int* simplified, size_t simplifiedCount);
+}
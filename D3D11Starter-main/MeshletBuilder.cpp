@@ -0,0 +1,184 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the bounds helpers
+// only accessible in this file
+namespace
+{
+	XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	XMFLOAT3 Normalize(const XMFLOAT3& v)
+	{
+		float length = std::sqrt(Dot(v, v));
+		if (length <= 0.0f)
+			return XMFLOAT3(0.0f, 0.0f, 0.0f);
+		return XMFLOAT3(v.x / length, v.y / length, v.z / length);
+	}
+
+	// Fill in the bounding sphere and normal cone of a finished meshlet.
+	void CalculateMeshletBounds(const std::vector<Vertex>& vertices, const unsigned int* indices, Meshlet& meshlet)
+	{
+		const unsigned int* begin = indices + meshlet.indexStart;
+		const unsigned int* end = begin + meshlet.triangleCount * 3;
+
+		// Sphere around the center of the vertices' bounding box.
+		XMFLOAT3 boundsMin = vertices[*begin].Position;
+		XMFLOAT3 boundsMax = boundsMin;
+		for (const unsigned int* i = begin; i != end; i++)
+		{
+			const XMFLOAT3& p = vertices[*i].Position;
+			boundsMin = XMFLOAT3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+			boundsMax = XMFLOAT3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+		}
+
+		meshlet.center = XMFLOAT3((boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f);
+		float radiusSquared = 0.0f;
+		for (const unsigned int* i = begin; i != end; i++)
+		{
+			XMFLOAT3 offset = Subtract(vertices[*i].Position, meshlet.center);
+			radiusSquared = std::max(radiusSquared, Dot(offset, offset));
+		}
+		meshlet.radius = std::sqrt(radiusSquared);
+
+		// Face normals of the triangles, and a point on each triangle's plane.
+		std::vector<XMFLOAT3> normals;
+		std::vector<XMFLOAT3> planePoints;
+		normals.reserve(meshlet.triangleCount);
+		planePoints.reserve(meshlet.triangleCount);
+		XMFLOAT3 axis(0.0f, 0.0f, 0.0f);
+		for (const unsigned int* tri = begin; tri != end; tri += 3)
+		{
+			const XMFLOAT3& p0 = vertices[tri[0]].Position;
+			XMFLOAT3 e0 = Subtract(vertices[tri[1]].Position, p0);
+			XMFLOAT3 e1 = Subtract(vertices[tri[2]].Position, p0);
+			XMFLOAT3 normal = Normalize(XMFLOAT3(e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x));
+			if (Dot(normal, normal) == 0.0f)
+				continue;
+
+			normals.push_back(normal);
+			planePoints.push_back(p0);
+			axis = XMFLOAT3(axis.x + normal.x, axis.y + normal.y, axis.z + normal.z);
+		}
+		axis = Normalize(axis);
+
+		// The cone spread is the widest angle between the axis and any normal.
+		float minDot = 1.0f;
+		for (const XMFLOAT3& normal : normals)
+			minDot = std::min(minDot, Dot(axis, normal));
+
+		// Half a sphere or more of normals can never all face away.
+		if (normals.empty() || minDot <= 0.0f)
+		{
+			meshlet.coneApex = meshlet.center;
+			meshlet.coneAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			meshlet.coneCutoff = 1.0f;
+			return;
+		}
+
+		// Move the apex back along the axis until every triangle's plane is in
+		// front of it, so the view direction test works for perspective cameras.
+		float maxT = 0.0f;
+		for (size_t i = 0; i < normals.size(); i++)
+		{
+			float t = Dot(Subtract(meshlet.center, planePoints[i]), normals[i]) / Dot(axis, normals[i]);
+			maxT = std::max(maxT, t);
+		}
+
+		meshlet.coneApex = XMFLOAT3(meshlet.center.x - axis.x * maxT, meshlet.center.y - axis.y * maxT, meshlet.center.z - axis.z * maxT);
+		meshlet.coneAxis = axis;
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+void MeshletBuilder::BuildMeshlets(const std::vector<Vertex>& vertices, const unsigned int* indices,
+	unsigned int indexStart, unsigned int indexCount, std::vector<Meshlet>& meshlets)
+{
+	// Which meshlet last used each vertex, so vertices are only counted once per meshlet.
+	std::vector<unsigned int> lastMeshlet(vertices.size(), UINT_MAX);
+	unsigned int meshletId = (unsigned int)meshlets.size();
+
+	Meshlet current = {};
+	current.indexStart = indexStart;
+
+	unsigned int end = indexStart + indexCount - indexCount % 3;
+	for (unsigned int t = indexStart; t < end; t += 3)
+	{
+		// The triangle's distinct vertices (degenerate triangles repeat one).
+		unsigned int corners[3] = { indices[t], indices[t + 1], indices[t + 2] };
+		unsigned int cornerCount = 1;
+		if (corners[1] != corners[0])
+			corners[cornerCount++] = corners[1];
+		if (corners[2] != corners[0] && corners[2] != corners[1])
+			corners[cornerCount++] = corners[2];
+
+		// Count the vertices this triangle would add.
+		unsigned int newVertices = 0;
+		for (unsigned int c = 0; c < cornerCount; c++)
+		{
+			if (lastMeshlet[corners[c]] != meshletId)
+				newVertices++;
+		}
+
+		// Start a new meshlet when either limit would be passed.
+		if (current.triangleCount == MAX_MESHLET_TRIANGLES || current.vertexCount + newVertices > MAX_MESHLET_VERTICES)
+		{
+			CalculateMeshletBounds(vertices, indices, current);
+			meshlets.push_back(current);
+
+			meshletId++;
+			current = {};
+			current.indexStart = t;
+			newVertices = cornerCount;
+		}
+
+		for (unsigned int c = 0; c < cornerCount; c++)
+			lastMeshlet[corners[c]] = meshletId;
+		current.vertexCount += newVertices;
+		current.triangleCount++;
+	}
+
+	if (current.triangleCount > 0)
+	{
+		CalculateMeshletBounds(vertices, indices, current);
+		meshlets.push_back(current);
+	}
+}
+
+size_t MeshletBuilder::CullMeshlets(const Meshlet* meshlets, size_t meshletCount, const Frustum& localFrustum,
+	const XMFLOAT3& localCameraPosition, std::vector<IndexRange>& ranges, bool testCones)
+{
+	ranges.clear();
+	size_t visibleTriangles = 0;
+
+	for (size_t i = 0; i < meshletCount; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		if (!Culling::SphereInFrustum(localFrustum, meshlet.center, meshlet.radius) ||
+			(testCones && Culling::IsConeBackfacing(meshlet.coneApex, meshlet.coneAxis, meshlet.coneCutoff, localCameraPosition)))
+			continue;
+
+		// Extend the last range when this meshlet follows straight on from it.
+		unsigned int indexCount = meshlet.triangleCount * 3;
+		if (!ranges.empty() && ranges.back().indexStart + ranges.back().indexCount == meshlet.indexStart)
+			ranges.back().indexCount += indexCount;
+		else
+			ranges.push_back({ meshlet.indexStart, indexCount });
+
+		visibleTriangles += meshlet.triangleCount;
+	}
+
+	return visibleTriangles;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "Culling.h"
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A small cluster of consecutive triangles in an index buffer.
+//
+// - "center" and "radius" bound its vertices
+// - The normal cone ("coneApex", "coneAxis", "coneCutoff")
+//   bounds its triangle normals for back face culling; a
+//   cutoff of 1 means the cone is too wide to ever cull
+// - Everything is in the mesh's local space
+// --------------------------------------------------------
+struct Meshlet
+{
+	unsigned int indexStart;
+	unsigned int triangleCount;
+	unsigned int vertexCount;
+
+	DirectX::XMFLOAT3 center;
+	float radius;
+
+	DirectX::XMFLOAT3 coneApex;
+	DirectX::XMFLOAT3 coneAxis;
+	float coneCutoff;
+};
+
+// A range of an index buffer to pass to DrawIndexed.
+struct IndexRange
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+};
+
+// --------------------------------------------------------
+// Platform-neutral meshlet building and CPU culling.
+//
+// - Meshlets are consecutive runs of triangles in the index
+//   order the vertex cache optimizer produced, so building
+//   them never reorders the index buffer and each meshlet
+//   is drawable as a plain index range
+// --------------------------------------------------------
+namespace MeshletBuilder
+{
+	// Limits per meshlet (the usual mesh shader sizes).
+	const unsigned int MAX_MESHLET_VERTICES = 64;
+	const unsigned int MAX_MESHLET_TRIANGLES = 124;
+
+	// Split indices [indexStart, indexStart + indexCount) into meshlets
+	// and append them to "meshlets".
+	void BuildMeshlets(const std::vector<Vertex>& vertices, const unsigned int* indices,
+		unsigned int indexStart, unsigned int indexCount, std::vector<Meshlet>& meshlets);
+
+	// Cull meshlets outside the frustum or facing away from the camera, and
+	// replace "ranges" with the index ranges of the rest (neighboring visible
+	// meshlets are merged into one range).
+	// - The frustum and camera position must be in the mesh's local space
+	// - "testCones" false skips the normal cone test, for world matrices with
+	//   non-uniform scale, which bend normals so the local cones no longer hold
+	// - Returns the number of visible triangles
+	size_t CullMeshlets(const Meshlet* meshlets, size_t meshletCount, const Frustum& localFrustum,
+		const DirectX::XMFLOAT3& localCameraPosition, std::vector<IndexRange>& ranges, bool testCones = true);
+}
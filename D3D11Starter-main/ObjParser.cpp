@@ -0,0 +1,637 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the tokenizer helpers
+// only accessible in this file
+namespace
+{
+	// One face corner after its OBJ indices are resolved to 0-based
+	// array indices (-1 means the attribute was not given).
+	struct ObjCorner
+	{
+		int position;
+		int uv;
+		int normal;
+	};
+
+	// A face corner as written in one chunk of the file, before the
+	// chunk knows how many records came before it.
+	// - Positive OBJ indices are absolute and stored as 0-based indices
+	// - Negative OBJ indices are relative, so they are stored relative to
+	//   the start of the chunk and flagged to be offset when stitching
+	// - Missing attributes are stored as INT_MIN
+	struct RawCorner
+	{
+		int position;
+		int uv;
+		int normal;
+		unsigned char relativeFlags;
+	};
+
+	// Flags for RawCorner::relativeFlags
+	const unsigned char RELATIVE_POSITION = 1;
+	const unsigned char RELATIVE_UV = 2;
+	const unsigned char RELATIVE_NORMAL = 4;
+
+	// All of the records read out of one chunk of the OBJ text.
+	struct ObjChunk
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT2> uvs;
+		std::vector<XMFLOAT3> normals;
+
+		// Triangulated corners (three per triangle, winding already flipped).
+		std::vector<RawCorner> corners;
+	};
+
+	// All of the records of the whole file after the chunks are stitched.
+	struct ObjRecords
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT2> uvs;
+		std::vector<XMFLOAT3> normals;
+
+		// Triangulated corners (three per triangle, winding already flipped).
+		std::vector<ObjCorner> corners;
+	};
+
+	// Chunks smaller than this are not worth a thread of their own.
+	const size_t MIN_BYTES_PER_CHUNK = 256 * 1024;
+
+	// Exact powers of ten that fit in a double.
+	const double powersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22
+	};
+
+	bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p))
+			p++;
+		return p;
+	}
+
+	// Scan a decimal floating point number ("-1.25", "3", "4.5e-3").
+	// Returns the position after the number, or the start position if
+	// there was no number to read.
+	const char* ScanFloat(const char* p, const char* end, float& value)
+	{
+		const char* start = p;
+
+		// Sign
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			p++;
+		}
+
+		// Gather up to 19 significant digits into an integer mantissa and
+		// keep track of where the decimal point ends up as an exponent.
+		uint64_t mantissa = 0;
+		int digitCount = 0;
+		int exponent = 0;
+		bool anyDigits = false;
+
+		while (p < end && IsDigit(*p))
+		{
+			if (digitCount < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0)
+					digitCount++;
+			}
+			else
+			{
+				exponent++;
+			}
+			anyDigits = true;
+			p++;
+		}
+
+		if (p < end && *p == '.')
+		{
+			p++;
+			while (p < end && IsDigit(*p))
+			{
+				if (digitCount < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0)
+						digitCount++;
+					exponent--;
+				}
+				anyDigits = true;
+				p++;
+			}
+		}
+
+		// Not a number at all.
+		if (!anyDigits)
+		{
+			value = 0.0f;
+			return start;
+		}
+
+		// Optional exponent
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* exponentStart = p;
+			p++;
+
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+'))
+			{
+				negativeExponent = (*p == '-');
+				p++;
+			}
+
+			if (p < end && IsDigit(*p))
+			{
+				int writtenExponent = 0;
+				while (p < end && IsDigit(*p))
+				{
+					if (writtenExponent < 10000)
+						writtenExponent = writtenExponent * 10 + (*p - '0');
+					p++;
+				}
+				exponent += negativeExponent ? -writtenExponent : writtenExponent;
+			}
+			else
+			{
+				// "1e" with no digits - the 'e' is not part of the number.
+				p = exponentStart;
+			}
+		}
+
+		// Scale the mantissa by the exponent.
+		double result = static_cast<double>(mantissa);
+		if (exponent < 0)
+		{
+			result = (exponent >= -22) ? result / powersOfTen[-exponent] : result * std::pow(10.0, exponent);
+		}
+		else if (exponent > 0)
+		{
+			result = (exponent <= 22) ? result * powersOfTen[exponent] : result * std::pow(10.0, exponent);
+		}
+
+		value = static_cast<float>(negative ? -result : result);
+		return p;
+	}
+
+	// Scan a (possibly negative) integer. Returns the start position if
+	// there was no integer to read.
+	// - Throws std::invalid_argument if it does not fit in an int
+	const char* ScanInt(const char* p, const char* end, int& value)
+	{
+		const char* start = p;
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			p++;
+		}
+
+		if (p >= end || !IsDigit(*p))
+		{
+			value = 0;
+			return start;
+		}
+
+		int result = 0;
+		while (p < end && IsDigit(*p))
+		{
+			int digit = *p - '0';
+			if (result > (INT_MAX - digit) / 10)
+				throw std::invalid_argument("Error parsing file: Index is too large");
+			result = result * 10 + digit;
+			p++;
+		}
+
+		value = negative ? -result : result;
+		return p;
+	}
+
+	// Turn an OBJ index into a chunk-local index (see RawCorner).
+	int ToRawIndex(int objIndex, size_t localCount, unsigned char relativeFlag, unsigned char& flags)
+	{
+		// Index 0 is invalid in OBJ files.
+		if (objIndex == 0)
+			throw std::invalid_argument("Error parsing file: Face references a vertex that does not exist");
+
+		// Absolute 1-based index.
+		if (objIndex > 0)
+			return objIndex - 1;
+
+		// Relative index - counted back from the records read so far in this chunk.
+		flags |= relativeFlag;
+		return static_cast<int>(localCount) + objIndex;
+	}
+
+	// Turn a chunk-local index into an index into the stitched arrays and
+	// validate it against the final number of records.
+	int ResolveIndex(int rawIndex, bool relative, size_t chunkOffset, size_t count)
+	{
+		long long resolved = relative ? (long long)chunkOffset + rawIndex : (long long)rawIndex;
+		if (resolved < 0 || resolved >= (long long)count)
+			throw std::invalid_argument("Error parsing file: Face references a vertex that does not exist");
+		return static_cast<int>(resolved);
+	}
+
+	// Read every v, vt, vn and f record in one chunk of the text.
+	void ParseChunk(const char* text, const char* end, ObjChunk& records)
+	{
+		// Corners of the face currently being read (reused between faces).
+		std::vector<RawCorner> faceCorners;
+
+		const char* p = text;
+		while (p < end)
+		{
+			// Find the end of this line without copying it anywhere.
+			const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (lineEnd == nullptr)
+				lineEnd = end;
+
+			p = SkipSpaces(p, lineEnd);
+
+			// Check the type of line
+			if (lineEnd - p >= 2 && p[0] == 'v' && p[1] == 'n')
+			{
+				// Read the 3 numbers of the normal
+				XMFLOAT3 norm(0, 0, 0);
+				const char* c = p + 2;
+				c = ScanFloat(SkipSpaces(c, lineEnd), lineEnd, norm.x);
+				c = ScanFloat(SkipSpaces(c, lineEnd), lineEnd, norm.y);
+				c = ScanFloat(SkipSpaces(c, lineEnd), lineEnd, norm.z);
+
+				// Flip normal's Z (LH vs. RH)
+				norm.z *= -1.0f;
+				records.normals.push_back(norm);
+			}
+			else if (lineEnd - p >= 2 && p[0] == 'v' && p[1] == 't')
+			{
+				// Read the 2 numbers of the uv
+				XMFLOAT2 uv(0, 0);
+				const char* c = p + 2;
+				c = ScanFloat(SkipSpaces(c, lineEnd), lineEnd, uv.x);
+				c = ScanFloat(SkipSpaces(c, lineEnd), lineEnd, uv.y);
+
+				// Flip the V since DirectX defines (0,0) as the top left
+				uv.y = 1.0f - uv.y;
+				records.uvs.push_back(uv);
+			}
+			else if (lineEnd - p >= 2 && p[0] == 'v' && IsSpace(p[1]))
+			{
+				// Read the 3 numbers of the position
+				XMFLOAT3 pos(0, 0, 0);
+				const char* c = p + 1;
+				c = ScanFloat(SkipSpaces(c, lineEnd), lineEnd, pos.x);
+				c = ScanFloat(SkipSpaces(c, lineEnd), lineEnd, pos.y);
+				c = ScanFloat(SkipSpaces(c, lineEnd), lineEnd, pos.z);
+
+				// Flip Z (LH vs. RH)
+				pos.z *= -1.0f;
+				records.positions.push_back(pos);
+			}
+			else if (lineEnd - p >= 2 && p[0] == 'f' && IsSpace(p[1]))
+			{
+				faceCorners.clear();
+
+				// Read each "v/vt/vn" group on the line
+				const char* c = p + 1;
+				while (true)
+				{
+					c = SkipSpaces(c, lineEnd);
+					if (c >= lineEnd || *c == '#')
+						break;
+
+					int objPosition = 0;
+					int objUV = 0;
+					int objNormal = 0;
+
+					const char* next = ScanInt(c, lineEnd, objPosition);
+					if (next == c)
+						throw std::invalid_argument("Error parsing file: Malformed face record");
+					c = next;
+
+					// Optional "/vt" and "/vn" parts ("v//vn" skips the uv)
+					if (c < lineEnd && *c == '/')
+					{
+						c++;
+						c = ScanInt(c, lineEnd, objUV);
+						if (c < lineEnd && *c == '/')
+						{
+							c++;
+							c = ScanInt(c, lineEnd, objNormal);
+						}
+					}
+
+					// Skip anything else attached to this corner.
+					while (c < lineEnd && !IsSpace(*c))
+						c++;
+
+					RawCorner corner = {};
+					corner.position = ToRawIndex(objPosition, records.positions.size(), RELATIVE_POSITION, corner.relativeFlags);
+					corner.uv = (objUV != 0) ? ToRawIndex(objUV, records.uvs.size(), RELATIVE_UV, corner.relativeFlags) : INT_MIN;
+					corner.normal = (objNormal != 0) ? ToRawIndex(objNormal, records.normals.size(), RELATIVE_NORMAL, corner.relativeFlags) : INT_MIN;
+					faceCorners.push_back(corner);
+				}
+
+				// Fan the polygon into triangles, flipping the winding order
+				// (the model is most likely in a right-handed space)
+				for (size_t i = 1; i + 1 < faceCorners.size(); i++)
+				{
+					records.corners.push_back(faceCorners[0]);
+					records.corners.push_back(faceCorners[i + 1]);
+					records.corners.push_back(faceCorners[i]);
+				}
+			}
+
+			// Move on to the next line
+			p = lineEnd + 1;
+		}
+	}
+
+	// Split the text into (at most) chunkCount ranges that all end on a
+	// newline, so no record is cut in half.
+	std::vector<const char*> SplitAtNewlines(const char* text, const char* end, size_t chunkCount)
+	{
+		std::vector<const char*> boundaries;
+		boundaries.push_back(text);
+
+		size_t size = end - text;
+		for (size_t i = 1; i < chunkCount; i++)
+		{
+			// Start from the even split point and move forward to the next line.
+			const char* split = text + size * i / chunkCount;
+			if (split <= boundaries.back())
+				continue;
+
+			const char* newline = static_cast<const char*>(memchr(split, '\n', end - split));
+			if (newline == nullptr)
+				break;
+
+			boundaries.push_back(newline + 1);
+		}
+
+		boundaries.push_back(end);
+		return boundaries;
+	}
+
+	// Parse the chunks in parallel and stitch them together, using prefix
+	// sums of the per-chunk record counts as the offset of each chunk.
+	void ParseRecords(const char* text, const char* end, unsigned int threadCount, ObjRecords& records)
+	{
+		// Decide how many chunks (and threads) to use.
+		size_t chunkCount = Parallel::GetJobCount(end - text, MIN_BYTES_PER_CHUNK, threadCount);
+
+		std::vector<const char*> boundaries = SplitAtNewlines(text, end, chunkCount);
+		chunkCount = boundaries.size() - 1;
+
+		// Parse every chunk into its own buffers.
+		std::vector<ObjChunk> chunks(chunkCount);
+		std::vector<std::exception_ptr> errors(chunkCount);
+		Parallel::RunOnThreads(chunkCount, [&](size_t i)
+			{
+				try
+				{
+					ParseChunk(boundaries[i], boundaries[i + 1], chunks[i]);
+				}
+				catch (...)
+				{
+					errors[i] = std::current_exception();
+				}
+			});
+
+		// Report the first error in file order.
+		for (std::exception_ptr& error : errors)
+		{
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+		// Exclusive prefix sums of the record counts give each chunk's
+		// offset into the stitched arrays.
+		std::vector<size_t> positionOffsets(chunkCount + 1, 0);
+		std::vector<size_t> uvOffsets(chunkCount + 1, 0);
+		std::vector<size_t> normalOffsets(chunkCount + 1, 0);
+		std::vector<size_t> cornerOffsets(chunkCount + 1, 0);
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size();
+			uvOffsets[i + 1] = uvOffsets[i] + chunks[i].uvs.size();
+			normalOffsets[i + 1] = normalOffsets[i] + chunks[i].normals.size();
+			cornerOffsets[i + 1] = cornerOffsets[i] + chunks[i].corners.size();
+		}
+
+		records.positions.resize(positionOffsets[chunkCount]);
+		records.uvs.resize(uvOffsets[chunkCount]);
+		records.normals.resize(normalOffsets[chunkCount]);
+		records.corners.resize(cornerOffsets[chunkCount]);
+
+		// Copy each chunk into place and resolve its face corners against
+		// the global position/uv/normal arrays.
+		Parallel::RunOnThreads(chunkCount, [&](size_t i)
+			{
+				try
+				{
+					const ObjChunk& chunk = chunks[i];
+					std::copy(chunk.positions.begin(), chunk.positions.end(), records.positions.begin() + positionOffsets[i]);
+					std::copy(chunk.uvs.begin(), chunk.uvs.end(), records.uvs.begin() + uvOffsets[i]);
+					std::copy(chunk.normals.begin(), chunk.normals.end(), records.normals.begin() + normalOffsets[i]);
+
+					ObjCorner* out = records.corners.data() + cornerOffsets[i];
+					for (const RawCorner& raw : chunk.corners)
+					{
+						ObjCorner corner = {};
+						corner.position = ResolveIndex(raw.position, (raw.relativeFlags & RELATIVE_POSITION) != 0, positionOffsets[i], records.positions.size());
+						corner.uv = (raw.uv != INT_MIN) ? ResolveIndex(raw.uv, (raw.relativeFlags & RELATIVE_UV) != 0, uvOffsets[i], records.uvs.size()) : -1;
+						corner.normal = (raw.normal != INT_MIN) ? ResolveIndex(raw.normal, (raw.relativeFlags & RELATIVE_NORMAL) != 0, normalOffsets[i], records.normals.size()) : -1;
+						*out++ = corner;
+					}
+				}
+				catch (...)
+				{
+					errors[i] = std::current_exception();
+				}
+			});
+
+		for (std::exception_ptr& error : errors)
+		{
+			if (error)
+				std::rethrow_exception(error);
+		}
+	}
+
+	// Mix the three indices of a corner into one hash value.
+	uint64_t HashCorner(const ObjCorner& corner)
+	{
+		uint64_t hash = (uint32_t)corner.position * 0x9E3779B97F4A7C15ull;
+		hash ^= ((uint32_t)corner.uv + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+		hash ^= ((uint32_t)corner.normal + 0x8CB92BA72F3D8DD7ull) * 0x165667B19E3779F9ull;
+		return hash ^ (hash >> 29);
+	}
+
+	// Build the final vertex and index arrays.
+	// - Corners that share the same (position, uv, normal) triple are welded
+	//   into one vertex, so the index buffer actually shares vertices
+	// - Uses an open-addressed hash table of vertex indices sized to a power
+	//   of two at least twice the corner count (no per-entry allocations)
+	ObjMeshData AssembleVertices(const ObjRecords& records)
+	{
+		ObjMeshData mesh;
+		mesh.cornerCount = records.corners.size();
+		mesh.indices.resize(records.corners.size());
+		mesh.vertices.reserve(records.corners.size() / 2 + 1);
+
+		// The corner each welded vertex was created from, for key comparisons.
+		std::vector<ObjCorner> uniqueCorners;
+		uniqueCorners.reserve(records.corners.size() / 2 + 1);
+
+		size_t tableSize = 16;
+		while (tableSize < records.corners.size() * 2)
+			tableSize *= 2;
+		std::vector<unsigned int> table(tableSize, UINT_MAX);
+		size_t mask = tableSize - 1;
+
+		for (size_t i = 0; i < records.corners.size(); i++)
+		{
+			const ObjCorner& corner = records.corners[i];
+
+			// Probe linearly until the key or an empty slot is found.
+			size_t slot = (size_t)HashCorner(corner) & mask;
+			while (table[slot] != UINT_MAX)
+			{
+				const ObjCorner& other = uniqueCorners[table[slot]];
+				if (other.position == corner.position && other.uv == corner.uv && other.normal == corner.normal)
+					break;
+				slot = (slot + 1) & mask;
+			}
+
+			// Reuse the existing vertex.
+			if (table[slot] != UINT_MAX)
+			{
+				mesh.indices[i] = table[slot];
+				continue;
+			}
+
+			// Look up the corresponding data from the record arrays.
+			// If the file has no UVs or normals, use a single default value.
+			Vertex v = {};
+			v.Position = records.positions[corner.position];
+			v.uv = (corner.uv >= 0) ? records.uvs[corner.uv] : XMFLOAT2(0.0f, 1.0f);
+			v.normal = (corner.normal >= 0) ? records.normals[corner.normal] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+			v.Tangent = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+			unsigned int index = static_cast<unsigned int>(mesh.vertices.size());
+			table[slot] = index;
+			uniqueCorners.push_back(corner);
+			mesh.vertices.push_back(v);
+			mesh.indices[i] = index;
+		}
+
+		return mesh;
+	}
+}
+
+ObjMeshData ObjParser::ParseFile(const char* path, unsigned int threadCount, ObjParseTimings* timings)
+{
+	// Map the whole file read-only.
+	MappedFile file;
+	if (!file.Open(path))
+		throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
+
+	return ParseBuffer(file.GetData(), file.GetSize(), threadCount, timings);
+}
+
+ObjMeshData ObjParser::ParseBuffer(const char* text, size_t size, unsigned int threadCount, ObjParseTimings* timings)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	ObjRecords records;
+	if (text != nullptr && size > 0)
+		ParseRecords(text, text + size, threadCount, records);
+
+	auto parsed = std::chrono::high_resolution_clock::now();
+	ObjMeshData mesh = AssembleVertices(records);
+	auto welded = std::chrono::high_resolution_clock::now();
+
+	if (timings)
+	{
+		timings->parseMilliseconds = std::chrono::duration<float, std::milli>(parsed - start).count();
+		timings->weldMilliseconds = std::chrono::duration<float, std::milli>(welded - parsed).count();
+	}
+
+	return mesh;
+}
+
+std::string ObjParser::GenerateSyntheticObj(unsigned int gridSize)
+{
+	std::string text;
+	text.reserve((size_t)gridSize * gridSize * 160);
+
+	// A (gridSize + 1) x (gridSize + 1) grid of positions, uvs and normals
+	// on a gently curved surface.
+	char line[128];
+	for (unsigned int y = 0; y <= gridSize; y++)
+	{
+		for (unsigned int x = 0; x <= gridSize; x++)
+		{
+			float u = (float)x / gridSize;
+			float v = (float)y / gridSize;
+			float height = 0.25f * std::sin(u * 12.0f) * std::cos(v * 12.0f);
+
+			snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", u * 10.0f - 5.0f, height, v * 10.0f - 5.0f);
+			text += line;
+			snprintf(line, sizeof(line), "vt %.6f %.6f\n", u, v);
+			text += line;
+			snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", 0.0f, 1.0f, 0.0f);
+			text += line;
+		}
+	}
+
+	// One quad per grid cell, written with all three attributes.
+	// - Counter-clockwise seen from above, so the faces agree with the +Y normals
+	unsigned int rowLength = gridSize + 1;
+	for (unsigned int y = 0; y < gridSize; y++)
+	{
+		for (unsigned int x = 0; x < gridSize; x++)
+		{
+			unsigned int a = y * rowLength + x + 1;
+			unsigned int b = a + 1;
+			unsigned int c = a + rowLength + 1;
+			unsigned int d = a + rowLength;
+
+			snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, d, d, d, c, c, c, b, b, b);
+			text += line;
+		}
+	}
+
+	return text;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MeshData.h"
+
+// CPU-side mesh data produced by the OBJ parser.
+// - Positions, normals and UVs are already converted to
+//   DirectX conventions (left-handed, flipped V and winding)
+// - Face corners with the same (position, uv, normal) indices
+//   are welded into one vertex
+// - Indices are always 32-bit here; Mesh narrows them to
+//   16-bit at upload when the vertex count allows
+typedef MeshData<unsigned int> ObjMeshData;
+
+// Time spent in each stage of an OBJ parse.
+// - "parse" covers tokenizing and stitching the records
+// - "weld" covers building the welded vertex and index arrays
+struct ObjParseTimings
+{
+	float parseMilliseconds;
+	float weldMilliseconds;
+};
+
+// --------------------------------------------------------
+// Platform-neutral .OBJ loading
+//
+// - Maps the whole file read-only and tokenizes it in place
+//   with a hand-written number scanner (no per-line copies,
+//   no locale-aware scanf and no line length limit)
+// - Supports v, vt, vn and f records, with faces written as
+//   v, v/vt, v//vn or v/vt/vn and negative (relative) indices
+// - Polygons with more than three corners are fanned into
+//   triangles
+// - Large files are split into chunks at newline boundaries
+//   and parsed on several threads, then stitched back into
+//   global position/uv/normal arrays
+// --------------------------------------------------------
+namespace ObjParser
+{
+	// Parse the file at the given path.
+	// - threadCount of 0 uses one thread per hardware core
+	// - Throws std::invalid_argument if the file can not be opened or is malformed
+	// - Fills in "timings" when it is not null
+	ObjMeshData ParseFile(const char* path, unsigned int threadCount = 0, ObjParseTimings* timings = nullptr);
+
+	// Parse OBJ text that is already in memory.
+	ObjMeshData ParseBuffer(const char* text, size_t size, unsigned int threadCount = 0, ObjParseTimings* timings = nullptr);
+
+	// Build the text of a large tessellated grid (gridSize^2 quads) for
+	// measuring parse times and thread scaling.
+	std::string GenerateSyntheticObj(unsigned int gridSize);
+}
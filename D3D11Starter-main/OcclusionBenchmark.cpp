@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "MeshData.h"
+#include "OcclusionBuffer.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless occlusion culling benchmark
+//
+// - Draws a wall of large cubes (the cube mesh's coarsest
+//   level of detail) into an OcclusionBuffer and tests 1k
+//   to 64k small boxes scattered behind and around it,
+//   timing the occluder rasterization and the box tests and
+//   printing how many boxes were hidden
+// - Checks that every hidden box really is behind the wall
+//   (the rays to its corners and center all hit a wall
+//   cube), and that a box behind the wall is hidden while
+//   ones in front of it or poking out above it are not,
+//   with both a perspective and an orthographic projection;
+//   returns 1 if any check fails
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers
+// only accessible in this file
+namespace
+{
+	const float NEAR_CLIP = 0.1f;
+	const float FAR_CLIP = 1000.0f;
+
+	// The wall: WALL_CUBES cubes of WALL_SCALE side by side, WALL_DISTANCE in front of the camera.
+	const int WALL_CUBES = 8;
+	const float WALL_SCALE = 6.0f;
+	const float WALL_DISTANCE = 20.0f;
+
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	AxisAlignedBox MakeBox(const XMFLOAT3& center, float halfSize)
+	{
+		return {
+			XMFLOAT3(center.x - halfSize, center.y - halfSize, center.z - halfSize),
+			XMFLOAT3(center.x + halfSize, center.y + halfSize, center.z + halfSize) };
+	}
+
+	// World matrices of the wall's cubes, centered on the camera's line of sight.
+	// - "cubeSize" is the mesh's width, so each is scaled to WALL_SCALE across
+	std::vector<XMFLOAT4X4> MakeWall(float cubeSize)
+	{
+		float scale = WALL_SCALE / cubeSize;
+		std::vector<XMFLOAT4X4> wall(WALL_CUBES);
+		for (int i = 0; i < WALL_CUBES; i++)
+		{
+			float x = (i - (WALL_CUBES - 1) * 0.5f) * WALL_SCALE;
+			XMStoreFloat4x4(&wall[i], XMMatrixMultiply(
+				XMMatrixScaling(scale, scale, scale),
+				XMMatrixTranslation(x, 0.0f, WALL_DISTANCE)));
+		}
+		return wall;
+	}
+
+	void DrawWall(OcclusionBuffer& buffer, const XMFLOAT4X4& viewProjection, const OccluderMesh& cube, const std::vector<XMFLOAT4X4>& wall)
+	{
+		buffer.Begin(viewProjection);
+		for (const XMFLOAT4X4& world : wall)
+			buffer.RasterizeOccluder(cube, world);
+		buffer.BuildHierarchy();
+	}
+
+	// Check whether a ray from the origin in "direction" enters the box before "length" (slab test).
+	bool RayHitsBox(const XMFLOAT3& origin, const XMFLOAT3& direction, float length, const AxisAlignedBox& box)
+	{
+		float enter = 0.0f;
+		float exit = length;
+		const float o[3] = { origin.x, origin.y, origin.z };
+		const float d[3] = { direction.x, direction.y, direction.z };
+		const float lo[3] = { box.min.x, box.min.y, box.min.z };
+		const float hi[3] = { box.max.x, box.max.y, box.max.z };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (d[axis] == 0.0f)
+			{
+				if (o[axis] < lo[axis] || o[axis] > hi[axis])
+					return false;
+				continue;
+			}
+			float t0 = (lo[axis] - o[axis]) / d[axis];
+			float t1 = (hi[axis] - o[axis]) / d[axis];
+			enter = std::max(enter, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+		}
+		return enter <= exit;
+	}
+
+	// Check whether the lines of sight to a box's corners and center all pass through the wall.
+	// - "orthographic" looks along +z from z = 0 instead of from the origin
+	bool BehindWall(const AxisAlignedBox& box, const std::vector<AxisAlignedBox>& wallBoxes, bool orthographic)
+	{
+		XMFLOAT3 points[9];
+		for (int i = 0; i < 8; i++)
+		{
+			points[i] = XMFLOAT3(
+				(i & 1) ? box.max.x : box.min.x,
+				(i & 2) ? box.max.y : box.min.y,
+				(i & 4) ? box.max.z : box.min.z);
+		}
+		points[8] = XMFLOAT3((box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f);
+
+		for (const XMFLOAT3& point : points)
+		{
+			XMFLOAT3 origin = orthographic ? XMFLOAT3(point.x, point.y, 0.0f) : XMFLOAT3(0.0f, 0.0f, 0.0f);
+			XMFLOAT3 direction(point.x - origin.x, point.y - origin.y, point.z - origin.z);
+			bool blocked = false;
+			for (const AxisAlignedBox& wallBox : wallBoxes)
+				blocked = blocked || RayHitsBox(origin, direction, 1.0f, wallBox);
+			if (!blocked)
+				return false;
+		}
+		return true;
+	}
+
+	// Check a box behind the wall is hidden and boxes in front of it or above it are not.
+	int CheckPlacedBoxes(const char* name, const OcclusionBuffer& buffer)
+	{
+		float top = WALL_SCALE * 0.5f;
+		bool behind = !buffer.IsBoxVisible(MakeBox(XMFLOAT3(2.0f, 0.0f, WALL_DISTANCE * 3.0f), 1.0f));
+		bool inFront = buffer.IsBoxVisible(MakeBox(XMFLOAT3(2.0f, 0.0f, WALL_DISTANCE * 0.5f), 1.0f));
+		bool pokingOut = buffer.IsBoxVisible(MakeBox(XMFLOAT3(2.0f, top * 3.0f + 1.5f, WALL_DISTANCE * 3.0f), 2.0f));
+		bool ok = behind && inFront && pokingOut;
+		std::printf("%s: behind wall %s, in front %s, above wall %s\n", name,
+			behind ? "hidden" : "VISIBLE", inFront ? "visible" : "HIDDEN", pokingOut ? "visible" : "HIDDEN");
+		return ok ? 0 : 1;
+	}
+
+	// Time drawing the wall and testing "count" scattered boxes, and check every hidden one.
+	int RunBenchmark(size_t count, const XMFLOAT4X4& viewProjection, const OccluderMesh& cube,
+		const std::vector<XMFLOAT4X4>& wall, const std::vector<AxisAlignedBox>& wallBoxes, std::mt19937& random)
+	{
+		// Boxes from just behind the wall out to 200 units, in a cone a little wider than the view.
+		std::uniform_real_distribution<float> depth(WALL_DISTANCE + WALL_SCALE, 200.0f);
+		std::uniform_real_distribution<float> spread(-0.6f, 0.6f);
+		std::uniform_real_distribution<float> size(0.25f, 4.0f);
+		std::vector<AxisAlignedBox> boxes(count);
+		for (AxisAlignedBox& box : boxes)
+		{
+			float z = depth(random);
+			box = MakeBox(XMFLOAT3(spread(random) * z, spread(random) * z * 0.5f, z), size(random));
+		}
+
+		OcclusionBuffer buffer;
+		std::vector<unsigned char> visible(count, 1);
+		const int repeats = 20;
+		float rasterizeMilliseconds = 0.0f;
+		float testMilliseconds = 0.0f;
+		size_t hidden = 0;
+		for (int r = 0; r < repeats; r++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			DrawWall(buffer, viewProjection, cube, wall);
+			rasterizeMilliseconds += MillisecondsSince(start);
+
+			std::fill(visible.begin(), visible.end(), (unsigned char)1);
+			start = std::chrono::high_resolution_clock::now();
+			hidden = buffer.CullBoxes(boxes.data(), count, visible.data());
+			testMilliseconds += MillisecondsSince(start);
+		}
+
+		size_t wrong = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!visible[i] && !BehindWall(boxes[i], wallBoxes, false))
+				wrong++;
+		}
+
+		std::printf("%8zu %10zu %9zu %12.3f %10.3f %10.1f %8zu\n",
+			count, buffer.GetTriangleCount(), hidden,
+			rasterizeMilliseconds / repeats, testMilliseconds / repeats,
+			testMilliseconds / repeats * 1000000.0f / count, wrong);
+		return wrong > 0 ? 1 : 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string folder = (argc > 1) ? argv[1] : "Assets/Meshes";
+	std::mt19937 random(12345);
+	int failures = 0;
+
+	// The cube's coarsest level of detail, as the Game's meshes keep for occlusion.
+	MeshData<unsigned int> cubeData = MeshProcessing::ProcessObj((folder + "/cube.obj").c_str());
+	const MeshLod& coarsest = cubeData.lods.back();
+	OccluderMesh cube = MakeOccluderMesh(cubeData.vertices.data(), cubeData.vertices.size(), cubeData.indices.data(), coarsest);
+
+	std::vector<XMFLOAT4X4> wall = MakeWall(cubeData.boundsMax.x - cubeData.boundsMin.x);
+	std::vector<AxisAlignedBox> wallBoxes(wall.size());
+	for (size_t i = 0; i < wall.size(); i++)
+		Culling::TransformBox(wall[i], { cubeData.boundsMin, cubeData.boundsMax }, wallBoxes[i]);
+
+	// A camera at the origin looking down +z, and an orthographic view of the same wall.
+	XMFLOAT4X4 perspective, orthographic;
+	XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMStoreFloat4x4(&perspective, XMMatrixMultiply(view, XMMatrixPerspectiveFovLH(XM_PI / 3.0f, 2.0f, NEAR_CLIP, FAR_CLIP)));
+	XMStoreFloat4x4(&orthographic, XMMatrixMultiply(view, XMMatrixOrthographicLH(80.0f, 40.0f, 0.0f, 200.0f)));
+
+	OcclusionBuffer buffer;
+	DrawWall(buffer, perspective, cube, wall);
+	failures += CheckPlacedBoxes("Perspective", buffer);
+	DrawWall(buffer, orthographic, cube, wall);
+	failures += CheckPlacedBoxes("Orthographic", buffer);
+
+	// Orthographic hidden boxes must be behind the wall along +z.
+	size_t orthographicWrong = 0;
+	std::uniform_real_distribution<float> spread(-30.0f, 30.0f);
+	std::uniform_real_distribution<float> depth(WALL_DISTANCE + WALL_SCALE, 190.0f);
+	for (int i = 0; i < 4000; i++)
+	{
+		AxisAlignedBox box = MakeBox(XMFLOAT3(spread(random), spread(random) * 0.3f, depth(random)), 1.0f);
+		if (!buffer.IsBoxVisible(box) && !BehindWall(box, wallBoxes, true))
+			orthographicWrong++;
+	}
+	std::printf("Orthographic: %zu boxes hidden but not behind the wall\n", orthographicWrong);
+	if (orthographicWrong > 0)
+		failures++;
+
+	std::printf("%u x %u buffer, %d occluders of %zu triangles\n",
+		OcclusionBuffer::WIDTH, OcclusionBuffer::HEIGHT, WALL_CUBES, cube.indices.size() / 3);
+	std::printf("%8s %10s %9s %12s %10s %10s %8s\n",
+		"Boxes", "Triangles", "Hidden", "Raster ms", "Test ms", "ns/box", "Wrong");
+	for (size_t count : { (size_t)1000, (size_t)4000, (size_t)16000, (size_t)64000 })
+		failures += RunBenchmark(count, perspective, cube, wall, wallBoxes, random);
+
+	return failures > 0 ? 1 : 0;
+}
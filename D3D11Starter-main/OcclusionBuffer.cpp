@@ -0,0 +1,299 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the level size helpers
+// only accessible in this file
+namespace
+{
+	// Levels from WIDTH x HEIGHT down to 1 x 1.
+	const unsigned int LEVEL_COUNT = 9;
+
+	// Texels across the most a box is tested against in each direction.
+	const int MAX_TEST_TEXELS = 4;
+
+	unsigned int LevelWidth(unsigned int level)
+	{
+		return std::max(OcclusionBuffer::WIDTH >> level, 1u);
+	}
+
+	unsigned int LevelHeight(unsigned int level)
+	{
+		return std::max(OcclusionBuffer::HEIGHT >> level, 1u);
+	}
+}
+
+OcclusionBuffer::OcclusionBuffer()
+	: levels(LEVEL_COUNT), occluderCount(0), triangleCount(0)
+{
+	XMStoreFloat4x4(&viewProjectionMatrix, XMMatrixIdentity());
+	for (unsigned int level = 0; level < LEVEL_COUNT; level++)
+		levels[level].assign((size_t)LevelWidth(level) * LevelHeight(level), 1.0f);
+}
+
+void OcclusionBuffer::Begin(const XMFLOAT4X4& viewProjection)
+{
+	viewProjectionMatrix = viewProjection;
+	std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+	occluderCount = 0;
+	triangleCount = 0;
+}
+
+void OcclusionBuffer::RasterizeOccluder(const OccluderMesh& occluder, const XMFLOAT4X4& worldMatrix)
+{
+	occluderCount++;
+
+	// Move every vertex to the screen once, since most are shared by several triangles.
+	XMMATRIX worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&worldMatrix), XMLoadFloat4x4(&viewProjectionMatrix));
+	projected.resize(occluder.positions.size());
+	for (size_t i = 0; i < occluder.positions.size(); i++)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&occluder.positions[i]), worldViewProjection));
+		if (clip.w <= 0.0f || clip.z < 0.0f)
+		{
+			projected[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+			continue;
+		}
+
+		float invW = 1.0f / clip.w;
+		projected[i] = XMFLOAT4(
+			(clip.x * invW * 0.5f + 0.5f) * WIDTH,
+			(0.5f - clip.y * invW * 0.5f) * HEIGHT,
+			clip.z * invW,
+			1.0f);
+	}
+
+	// Triangles reaching behind the near plane are left out rather than clipped.
+	for (size_t t = 0; t + 2 < occluder.indices.size(); t += 3)
+	{
+		const XMFLOAT4& a = projected[occluder.indices[t]];
+		const XMFLOAT4& b = projected[occluder.indices[t + 1]];
+		const XMFLOAT4& c = projected[occluder.indices[t + 2]];
+		if (a.w <= 0.0f || b.w <= 0.0f || c.w <= 0.0f)
+			continue;
+
+		float x[3] = { a.x, b.x, c.x };
+		float y[3] = { a.y, b.y, c.y };
+		float z[3] = { a.z, b.z, c.z };
+		RasterizeTriangle(x, y, z);
+	}
+}
+
+void OcclusionBuffer::RasterizeTriangle(const float* x, const float* y, const float* z)
+{
+	// Facing the camera means clockwise on screen (y down), so a positive area.
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 0.0f))
+		return;
+
+	float minX = std::max(std::min({ x[0], x[1], x[2] }), 0.0f);
+	float minY = std::max(std::min({ y[0], y[1], y[2] }), 0.0f);
+	float maxX = std::min(std::max({ x[0], x[1], x[2] }), WIDTH - 1.0f);
+	float maxY = std::min(std::max({ y[0], y[1], y[2] }), HEIGHT - 1.0f);
+	if (minX > maxX || minY > maxY)
+		return;
+	triangleCount++;
+
+	// Edge e runs from vertex (e + 1) % 3 to (e + 2) % 3 and is positive inside;
+	// divided by the area it is the weight of vertex e.
+	XMVECTOR edgeA[3];
+	float edgeB[3];
+	float edgeC[3];
+	for (int e = 0; e < 3; e++)
+	{
+		int i = (e + 1) % 3;
+		int j = (e + 2) % 3;
+		edgeA[e] = XMVectorReplicate(y[i] - y[j]);
+		edgeB[e] = x[j] - x[i];
+		edgeC[e] = x[i] * y[j] - x[j] * y[i];
+	}
+
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	float invArea = 1.0f / area;
+	XMVECTOR z0 = XMVectorReplicate(z[0]);
+	XMVECTOR dz1 = XMVectorReplicate((z[1] - z[0]) * invArea);
+	XMVECTOR dz2 = XMVectorReplicate((z[2] - z[0]) * invArea);
+
+	std::vector<float>& depth = levels[0];
+	for (int py = (int)minY; py <= (int)maxY; py++)
+	{
+		float centerY = py + 0.5f;
+		XMVECTOR rowEdge[3];
+		for (int e = 0; e < 3; e++)
+			rowEdge[e] = XMVectorReplicate(edgeB[e] * centerY + edgeC[e]);
+
+		// Four pixels at a time, from a multiple of four (WIDTH is one too).
+		for (int px = (int)minX & ~3; px <= (int)maxX; px += 4)
+		{
+			XMVECTOR centerX = XMVectorAdd(XMVectorReplicate((float)px), laneOffsets);
+			XMVECTOR edges[3];
+			XMVECTOR covered = XMVectorTrueInt();
+			for (int e = 0; e < 3; e++)
+			{
+				edges[e] = XMVectorMultiplyAdd(edgeA[e], centerX, rowEdge[e]);
+				covered = XMVectorAndInt(covered, XMVectorGreaterOrEqual(edges[e], zero));
+			}
+			if (XMVector4EqualInt(covered, XMVectorFalseInt()))
+				continue;
+
+			// Keep the nearest occluder.
+			XMVECTOR pixelDepth = XMVectorMultiplyAdd(edges[2], dz2, XMVectorMultiplyAdd(edges[1], dz1, z0));
+			XMFLOAT4* lanes = reinterpret_cast<XMFLOAT4*>(&depth[(size_t)py * WIDTH + px]);
+			XMVECTOR stored = XMLoadFloat4(lanes);
+			XMStoreFloat4(lanes, XMVectorSelect(stored, XMVectorMin(stored, pixelDepth), covered));
+		}
+	}
+}
+
+void OcclusionBuffer::BuildHierarchy()
+{
+	for (unsigned int level = 1; level < LEVEL_COUNT; level++)
+	{
+		const std::vector<float>& source = levels[level - 1];
+		std::vector<float>& destination = levels[level];
+		unsigned int sourceWidth = LevelWidth(level - 1);
+		unsigned int sourceHeight = LevelHeight(level - 1);
+		unsigned int width = LevelWidth(level);
+		unsigned int height = LevelHeight(level);
+
+		for (unsigned int y = 0; y < height; y++)
+		{
+			// The last row and column repeat once a side is down to 1.
+			const float* top = &source[(size_t)std::min(y * 2, sourceHeight - 1) * sourceWidth];
+			const float* bottom = &source[(size_t)std::min(y * 2 + 1, sourceHeight - 1) * sourceWidth];
+			float* out = &destination[(size_t)y * width];
+
+			// Four output texels from eight source columns at a time.
+			unsigned int x = 0;
+			if (sourceWidth >= 8)
+			{
+				for (; x + 4 <= width; x += 4)
+				{
+					XMVECTOR left = XMVectorMax(
+						XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(top + x * 2)),
+						XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(bottom + x * 2)));
+					XMVECTOR right = XMVectorMax(
+						XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(top + x * 2 + 4)),
+						XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(bottom + x * 2 + 4)));
+					XMVECTOR even = XMVectorPermute<0, 2, 4, 6>(left, right);
+					XMVECTOR odd = XMVectorPermute<1, 3, 5, 7>(left, right);
+					XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out + x), XMVectorMax(even, odd));
+				}
+			}
+			for (; x < width; x++)
+			{
+				unsigned int x0 = std::min(x * 2, sourceWidth - 1);
+				unsigned int x1 = std::min(x * 2 + 1, sourceWidth - 1);
+				out[x] = std::max(std::max(top[x0], top[x1]), std::max(bottom[x0], bottom[x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::IsBoxVisible(const AxisAlignedBox& box) const
+{
+	// Project the eight corners four at a time, one per lane: the four at the
+	// box's smallest z, then the four at its largest.
+	const XMFLOAT4X4& m = viewProjectionMatrix;
+	XMVECTOR cornerX = XMVectorSet(box.min.x, box.max.x, box.min.x, box.max.x);
+	XMVECTOR cornerY = XMVectorSet(box.min.y, box.min.y, box.max.y, box.max.y);
+	XMVECTOR partX = XMVectorMultiplyAdd(cornerY, XMVectorReplicate(m._21), XMVectorMultiply(cornerX, XMVectorReplicate(m._11)));
+	XMVECTOR partY = XMVectorMultiplyAdd(cornerY, XMVectorReplicate(m._22), XMVectorMultiply(cornerX, XMVectorReplicate(m._12)));
+	XMVECTOR partZ = XMVectorMultiplyAdd(cornerY, XMVectorReplicate(m._23), XMVectorMultiply(cornerX, XMVectorReplicate(m._13)));
+	XMVECTOR partW = XMVectorMultiplyAdd(cornerY, XMVectorReplicate(m._24), XMVectorMultiply(cornerX, XMVectorReplicate(m._14)));
+
+	float minX = WIDTH;
+	float minY = HEIGHT;
+	float maxX = 0.0f;
+	float maxY = 0.0f;
+	float nearest = 1.0f;
+	for (int face = 0; face < 2; face++)
+	{
+		XMVECTOR cornerZ = XMVectorReplicate(face == 0 ? box.min.z : box.max.z);
+		XMFLOAT4A clipX, clipY, clipZ, clipW;
+		XMStoreFloat4A(&clipX, XMVectorAdd(XMVectorMultiplyAdd(cornerZ, XMVectorReplicate(m._31), partX), XMVectorReplicate(m._41)));
+		XMStoreFloat4A(&clipY, XMVectorAdd(XMVectorMultiplyAdd(cornerZ, XMVectorReplicate(m._32), partY), XMVectorReplicate(m._42)));
+		XMStoreFloat4A(&clipZ, XMVectorAdd(XMVectorMultiplyAdd(cornerZ, XMVectorReplicate(m._33), partZ), XMVectorReplicate(m._43)));
+		XMStoreFloat4A(&clipW, XMVectorAdd(XMVectorMultiplyAdd(cornerZ, XMVectorReplicate(m._34), partW), XMVectorReplicate(m._44)));
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			float w = (&clipW.x)[lane];
+			float z = (&clipZ.x)[lane];
+			if (w <= 0.0f || z < 0.0f)
+				return true;
+
+			float invW = 1.0f / w;
+			float screenX = ((&clipX.x)[lane] * invW * 0.5f + 0.5f) * WIDTH;
+			float screenY = (0.5f - (&clipY.x)[lane] * invW * 0.5f) * HEIGHT;
+			minX = std::min(minX, screenX);
+			minY = std::min(minY, screenY);
+			maxX = std::max(maxX, screenX);
+			maxY = std::max(maxY, screenY);
+			nearest = std::min(nearest, z * invW);
+		}
+	}
+
+	// Off screen boxes are left to frustum culling.
+	if (maxX < 0.0f || maxY < 0.0f || minX >= WIDTH || minY >= HEIGHT)
+		return true;
+
+	// Every pixel the box's rectangle touches, and one more all around: occluders
+	// cover whole pixels whose centers they cover, so a box can show through the
+	// uncovered part of an occluder's edge pixels.
+	int x0 = (int)std::max(minX - 1.0f, 0.0f);
+	int y0 = (int)std::max(minY - 1.0f, 0.0f);
+	int x1 = (int)std::min(maxX + 1.0f, WIDTH - 1.0f);
+	int y1 = (int)std::min(maxY + 1.0f, HEIGHT - 1.0f);
+
+	// The smallest level where that is at most MAX_TEST_TEXELS texels across.
+	unsigned int level = 0;
+	while ((x1 >> level) - (x0 >> level) >= MAX_TEST_TEXELS || (y1 >> level) - (y0 >> level) >= MAX_TEST_TEXELS)
+		level++;
+
+	const std::vector<float>& depth = levels[level];
+	unsigned int width = LevelWidth(level);
+	for (int y = y0 >> level; y <= y1 >> level; y++)
+	{
+		for (int x = x0 >> level; x <= x1 >> level; x++)
+		{
+			if (depth[(size_t)y * width + x] >= nearest)
+				return true;
+		}
+	}
+	return false;
+}
+
+size_t OcclusionBuffer::CullBoxes(const AxisAlignedBox* boxes, size_t count, unsigned char* visible) const
+{
+	size_t hidden = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (visible[i] && !IsBoxVisible(boxes[i]))
+		{
+			visible[i] = 0;
+			hidden++;
+		}
+	}
+	return hidden;
+}
+
+size_t OcclusionBuffer::GetOccluderCount() const
+{
+	return occluderCount;
+}
+
+size_t OcclusionBuffer::GetTriangleCount() const
+{
+	return triangleCount;
+}
+
+float OcclusionBuffer::GetDepth(unsigned int x, unsigned int y) const
+{
+	return levels[0][(size_t)y * WIDTH + x];
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "Culling.h"
+#include "MeshData.h"
+
+// --------------------------------------------------------
+// Positions and triangles of a mesh drawn into occlusion
+// buffers, usually its coarsest level of detail.
+// --------------------------------------------------------
+struct OccluderMesh
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+};
+
+// Copy one level of detail's triangles and the vertices they use into an occluder mesh.
+template <typename IndexType>
+OccluderMesh MakeOccluderMesh(const Vertex* vertices, size_t vertexCount, const IndexType* indices, const MeshLod& lod)
+{
+	OccluderMesh occluder;
+	std::vector<unsigned int> remap(vertexCount, 0xFFFFFFFF);
+	occluder.indices.reserve(lod.indexCount);
+	for (unsigned int i = lod.indexStart; i < lod.indexStart + lod.indexCount; i++)
+	{
+		unsigned int& index = remap[indices[i]];
+		if (index == 0xFFFFFFFF)
+		{
+			index = (unsigned int)occluder.positions.size();
+			occluder.positions.push_back(vertices[indices[i]].Position);
+		}
+		occluder.indices.push_back(index);
+	}
+	return occluder;
+}
+
+// --------------------------------------------------------
+// Low resolution depth buffer of a few large occluders,
+// for skipping entities hidden behind them.
+//
+// - Occluders are drawn at WIDTH x HEIGHT, four pixels at a
+//   time against the triangles' edge functions, keeping the
+//   nearest depth; triangles facing away or crossing the
+//   near plane are skipped, which only hides less
+// - BuildHierarchy() then keeps the farthest depth of every
+//   2x2 block in each smaller level, so a box of any size is
+//   tested against at most 4x4 texels: it is hidden when its
+//   nearest corner is behind the farthest occluder depth of
+//   every texel it covers
+// - Works with any view-projection, so the light's
+//   orthographic one can cull shadow casters hidden from the
+//   light just as the camera's culls the main pass
+// --------------------------------------------------------
+class OcclusionBuffer
+{
+public:
+	static constexpr unsigned int WIDTH = 256;
+	static constexpr unsigned int HEIGHT = 128;
+
+	OcclusionBuffer();
+
+	// Clear the buffer to the far plane and set the view-projection the
+	// occluders and boxes are projected with.
+	void Begin(const DirectX::XMFLOAT4X4& viewProjectionMatrix);
+
+	// Draw an occluder's triangles with the given world matrix.
+	void RasterizeOccluder(const OccluderMesh& occluder, const DirectX::XMFLOAT4X4& worldMatrix);
+
+	// Build the smaller levels; call after the last occluder and before testing.
+	void BuildHierarchy();
+
+	// Check whether any part of a world space box could be in front of the occluders.
+	// - Conservative: boxes crossing the near plane, or off screen, are visible
+	bool IsBoxVisible(const AxisAlignedBox& box) const;
+
+	// Test the boxes whose "visible" entry is 1, clearing the entries of the hidden ones.
+	// - Returns the number of boxes hidden
+	size_t CullBoxes(const AxisAlignedBox* boxes, size_t count, unsigned char* visible) const;
+
+	// Occluders and their triangles drawn since Begin(), and the level 0 depth of a pixel.
+	size_t GetOccluderCount() const;
+	size_t GetTriangleCount() const;
+	float GetDepth(unsigned int x, unsigned int y) const;
+
+private:
+	// Draw one triangle given in screen pixels (y down) and depth.
+	void RasterizeTriangle(const float* x, const float* y, const float* z);
+
+	DirectX::XMFLOAT4X4 viewProjectionMatrix;
+
+	// An occluder's vertices in screen pixels and depth, with w <= 0 for
+	// ones behind the near plane.
+	std::vector<DirectX::XMFLOAT4> projected;
+
+	// Level 0 is WIDTH x HEIGHT, each next level half as wide and high down to 1 x 1.
+	std::vector<std::vector<float>> levels;
+
+	size_t occluderCount;
+	size_t triangleCount;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// A compressed alternative to Vertex (20 bytes vs 44 bytes)
+//
+// - position: snorm16 x4, relative to the mesh bounds
+//   (w is unused padding so the element stays 8 bytes)
+// - uv: unorm16 x2, relative to the mesh uv range
+// - normal and tangent: octahedral encoded snorm16 x2
+//
+// CPU-only for now: VertexPacking measures the memory saved
+// and the decoding error (see MeshBenchmark), but no mesh is
+// uploaded or drawn in this layout yet.
+// --------------------------------------------------------
+struct PackedVertex
+{
+	int16_t Position[4];
+	uint16_t uv[2];
+	int16_t normal[2];
+	int16_t Tangent[2];
+};
+
+// --------------------------------------------------------
+// Per-mesh values for turning a PackedVertex back into full
+// floats (position = center + snorm * extent,
+// uv = min + unorm * scale).
+//
+// Padded to 16-byte rows so it can go straight into a
+// constant buffer once a packed vertex shader exists.
+// --------------------------------------------------------
+struct VertexQuantization
+{
+	DirectX::XMFLOAT3 positionCenter;
+	float positionCenterPadding;
+
+	DirectX::XMFLOAT3 positionExtent;
+	float positionExtentPadding;
+
+	DirectX::XMFLOAT2 uvMin;
+	DirectX::XMFLOAT2 uvScale;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Small helpers for splitting CPU work across threads.
+//
+// - Jobs are plain std::threads joined before returning, so
+//   they can safely capture locals by reference
+// - The calling thread always runs job 0 itself
+// --------------------------------------------------------
+namespace Parallel
+{
+	// Number of threads to use: the requested count, or one per
+	// hardware thread when 0 is requested.
+	inline unsigned int GetThreadCount(unsigned int requested = 0)
+	{
+		if (requested > 0)
+			return requested;
+
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		return hardwareThreads > 0 ? hardwareThreads : 1;
+	}
+
+	// Run job(i) for i in [0, count), each on its own thread.
+	template<typename Job>
+	void RunOnThreads(size_t count, Job job)
+	{
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < count; i++)
+			threads.emplace_back(job, i);
+
+		if (count > 0)
+			job(0);
+
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	// Number of jobs to split itemCount items into so every job gets at
+	// least minItemsPerJob items (always at least 1 job).
+	inline size_t GetJobCount(size_t itemCount, size_t minItemsPerJob, unsigned int threadCount = 0)
+	{
+		size_t jobs = GetThreadCount(threadCount);
+		size_t maxJobs = minItemsPerJob > 0 ? itemCount / minItemsPerJob : itemCount;
+		if (jobs > maxJobs)
+			jobs = maxJobs;
+		return jobs > 0 ? jobs : 1;
+	}
+
+	// Split [0, itemCount) into jobCount contiguous ranges and run
+	// job(begin, end, jobIndex) for each range on its own thread.
+	template<typename Job>
+	void ForRanges(size_t itemCount, size_t jobCount, Job job)
+	{
+		RunOnThreads(jobCount, [&](size_t jobIndex)
+			{
+				size_t begin = itemCount * jobIndex / jobCount;
+				size_t end = itemCount * (jobIndex + 1) / jobCount;
+				job(begin, end, jobIndex);
+			});
+	}
+}
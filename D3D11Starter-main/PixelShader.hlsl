@@ -23,34 +23,51 @@ SamplerState BasicSampler : register(s0);
 // Add a shadow sampler.
 SamplerComparisonState ShadowSampler : register(s1);
 
-// Create a cbuffer struct for the pixel shader.
-cbuffer PSExternalData1 : register(b0)
+// Per-frame data, the same for every entity (uploaded once per frame).
+cbuffer PSFrameData : register(b0)
 {
-    float4 colorTint;
-	
     float2 time;
     float2 timePadding;
-	
+
+	// Get the camera position.
+    float4 cameraCurrentPosition;
+
+    float4 ambientColor;
+
+	// Add the light to the pixel shader CBH.
+    Lights directionalLight1;
+
+	// Directional lights reach every pixel, so they stay here.
+    Lights directionalLights[MAX_DIRECTIONAL_LIGHTS];
+    uint directionalLightCount;
+
+	// Turn the pixel's depth and position into its light cluster.
+    float clusterSliceScale;
+    float clusterSliceBias;
+    float clusterPadding;
+    float2 clusterTileScale;
+    float2 clusterTilePadding;
+}
+
+// Point and spot lights, and each light cluster's (first index, count) in
+// the list of the lights that reach it (built by LightClusters on the CPU).
+StructuredBuffer<Lights> LocalLights : register(t5);
+StructuredBuffer<uint2> ClusterRanges : register(t6);
+StructuredBuffer<uint> ClusterLightIndices : register(t7);
+
+// Per-material data, uploaded by the material only when it changes.
+cbuffer PSMaterialData : register(b1)
+{
+    float4 colorTint;
+
     float2 scale;
     float2 scalePadding;
-	
+
     float2 offset;
     float2 offsetPadding;
-	
-	// Get the camera position and the entity material object.
-    float4 cameraCurrentPosition;
-	
+
     float2 roughness;
     float2 roughnessPadding;
-	
-    float4 ambientColor;
-	
-	// Add the light to the pixel shader CBH.
-    Lights directionalLight1;
-	
-	// Add five lights array to match CBH:
-    Lights lightsArray[5];
-	
 }
 
 
@@ -65,9 +82,6 @@ cbuffer PSExternalData1 : register(b0)
 // --------------------------------------------------------
 float4 main(VertexToPixel input) : SV_TARGET
 {
-	// Enter the light count.
-    int lightCount = 5;
-
 	// Check the shadow map.
 	// Perform a perspective divide our self.
     input.shadowMapPos /= input.shadowMapPos.w;
@@ -162,10 +176,18 @@ float4 main(VertexToPixel input) : SV_TARGET
 	// Create a for loop that gets the light in an array, does some calculation
 	// based on its type using a switch statement and adds the light color to
 	// the total light color combination for the pixel.
-    for (int i = 0; i < 5; i++)
+	// - The directional lights come first, then only the point and spot lights
+	//   listed for this pixel's cluster
+    uint2 cluster = ClusterRanges[GetClusterIndex(input.screenPosition, clusterTileScale, clusterSliceScale, clusterSliceBias)];
+    uint lightCount = directionalLightCount + cluster.y;
+    for (uint i = 0; i < lightCount; i++)
     {
 		// Get the light in the current loop.
-        Lights light = lightsArray[i];
+        Lights light;
+        if (i < directionalLightCount)
+            light = directionalLights[i];
+        else
+            light = LocalLights[ClusterLightIndices[cluster.x + i - directionalLightCount]];
 		
 		// Get the normalised light direction.
         float3 normalizedLightDirection = normalize(-light.direction);
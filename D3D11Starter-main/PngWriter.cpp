@@ -0,0 +1,112 @@
+#include "PngWriter.h"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Annonymous namespace to hold the checksums and chunk helpers
+// only accessible in this file
+namespace
+{
+	// Largest stored deflate block.
+	const size_t MAX_STORED_BLOCK = 65535;
+
+	uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+	{
+		static const std::array<uint32_t, 256> table = []()
+			{
+				std::array<uint32_t, 256> values = {};
+				for (uint32_t n = 0; n < 256; n++)
+				{
+					uint32_t c = n;
+					for (int k = 0; k < 8; k++)
+						c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					values[n] = c;
+				}
+				return values;
+			}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	uint32_t Adler32(const unsigned char* data, size_t size)
+	{
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for (size_t i = 0; i < size; i++)
+		{
+			a = (a + data[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	void AppendBigEndian(std::vector<unsigned char>& bytes, uint32_t value)
+	{
+		bytes.push_back((unsigned char)(value >> 24));
+		bytes.push_back((unsigned char)(value >> 16));
+		bytes.push_back((unsigned char)(value >> 8));
+		bytes.push_back((unsigned char)value);
+	}
+
+	// Length, type, data and the CRC of type and data.
+	void AppendChunk(std::vector<unsigned char>& file, const char* type, const std::vector<unsigned char>& data)
+	{
+		AppendBigEndian(file, (uint32_t)data.size());
+		size_t typeStart = file.size();
+		file.insert(file.end(), type, type + 4);
+		file.insert(file.end(), data.begin(), data.end());
+		AppendBigEndian(file, Crc32(&file[typeStart], file.size() - typeStart));
+	}
+}
+
+bool PngWriter::Write(const char* path, unsigned int width, unsigned int height, const unsigned char* rgba)
+{
+	// Each row gets filter type 0 (none) in front of it.
+	size_t rowBytes = (size_t)width * 4;
+	std::vector<unsigned char> raw;
+	raw.reserve((rowBytes + 1) * height);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), rgba + y * rowBytes, rgba + (y + 1) * rowBytes);
+	}
+
+	// A zlib stream of stored blocks.
+	std::vector<unsigned char> compressed = { 0x78, 0x01 };
+	size_t offset = 0;
+	do
+	{
+		size_t blockSize = raw.size() - offset < MAX_STORED_BLOCK ? raw.size() - offset : MAX_STORED_BLOCK;
+		bool last = offset + blockSize == raw.size();
+		compressed.push_back(last ? 1 : 0);
+		compressed.push_back((unsigned char)blockSize);
+		compressed.push_back((unsigned char)(blockSize >> 8));
+		compressed.push_back((unsigned char)~blockSize);
+		compressed.push_back((unsigned char)(~blockSize >> 8));
+		compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+		offset += blockSize;
+	} while (offset < raw.size());
+	AppendBigEndian(compressed, Adler32(raw.data(), raw.size()));
+
+	// Header: size, 8 bits per channel, RGBA, default compression, filtering and no interlacing.
+	std::vector<unsigned char> header;
+	AppendBigEndian(header, width);
+	AppendBigEndian(header, height);
+	header.insert(header.end(), { 8, 6, 0, 0, 0 });
+
+	std::vector<unsigned char> file = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	AppendChunk(file, "IHDR", header);
+	AppendChunk(file, "IDAT", compressed);
+	AppendChunk(file, "IEND", {});
+
+	std::ofstream output(path, std::ios::binary);
+	if (!output)
+		return false;
+	output.write(reinterpret_cast<const char*>(file.data()), file.size());
+	return (bool)output;
+}
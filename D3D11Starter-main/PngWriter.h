@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// Minimal PNG output for headless frame captures.
+//
+// - Writes 8 bit RGBA, with the image data in uncompressed
+//   (stored) deflate blocks: bigger files than a real
+//   encoder makes, but no zlib dependency and the same
+//   bytes for the same pixels on every platform
+// --------------------------------------------------------
+namespace PngWriter
+{
+	// Write "width" by "height" RGBA pixels (rows top to bottom, no padding).
+	// - Returns false if the file can not be written
+	bool Write(const char* path, unsigned int width, unsigned int height, const unsigned char* rgba);
+}
@@ -0,0 +1,178 @@
+#include "RenderQueue.h"
+
+#include <cmath>
+
+// Annonymous namespace to hold the key layout
+// only accessible in this file
+namespace
+{
+	// Bit offsets of each key field.
+	const unsigned int DEPTH_SHIFT = 0;
+	const unsigned int MESH_SHIFT = DEPTH_SHIFT + RenderQueue::DEPTH_BITS;
+	const unsigned int MATERIAL_SHIFT = MESH_SHIFT + RenderQueue::MESH_BITS;
+	const unsigned int SHADER_SHIFT = MATERIAL_SHIFT + RenderQueue::MATERIAL_BITS;
+	const unsigned int PASS_SHIFT = SHADER_SHIFT + RenderQueue::SHADER_BITS;
+	static_assert(PASS_SHIFT + RenderQueue::PASS_BITS == 64, "Key fields must fill 64 bits");
+
+	// Quantized depth steps per doubling of (1 + depth).
+	const float DEPTH_STEPS_PER_OCTAVE = 4096.0f;
+
+	uint64_t Field(unsigned int value, unsigned int bits, unsigned int shift)
+	{
+		return ((uint64_t)value & ((1ull << bits) - 1)) << shift;
+	}
+
+	unsigned int ReadField(uint64_t key, unsigned int bits, unsigned int shift)
+	{
+		return (unsigned int)((key >> shift) & ((1ull << bits) - 1));
+	}
+}
+
+uint64_t RenderQueue::MakeKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, unsigned int depth)
+{
+	return
+		Field(pass, PASS_BITS, PASS_SHIFT) |
+		Field(shader, SHADER_BITS, SHADER_SHIFT) |
+		Field(material, MATERIAL_BITS, MATERIAL_SHIFT) |
+		Field(mesh, MESH_BITS, MESH_SHIFT) |
+		Field(depth, DEPTH_BITS, DEPTH_SHIFT);
+}
+
+unsigned int RenderQueue::QuantizeDepth(float depth)
+{
+	// Behind the camera (or NaN) sorts first.
+	if (!(depth > 0.0f))
+		return 0;
+
+	const float maxDepth = (float)((1u << DEPTH_BITS) - 1);
+	float steps = std::log2(1.0f + depth) * DEPTH_STEPS_PER_OCTAVE;
+	return steps >= maxDepth ? (unsigned int)maxDepth : (unsigned int)steps;
+}
+
+unsigned int RenderQueue::GetPass(uint64_t key) { return ReadField(key, PASS_BITS, PASS_SHIFT); }
+unsigned int RenderQueue::GetShader(uint64_t key) { return ReadField(key, SHADER_BITS, SHADER_SHIFT); }
+unsigned int RenderQueue::GetMaterial(uint64_t key) { return ReadField(key, MATERIAL_BITS, MATERIAL_SHIFT); }
+unsigned int RenderQueue::GetMesh(uint64_t key) { return ReadField(key, MESH_BITS, MESH_SHIFT); }
+unsigned int RenderQueue::GetDepth(uint64_t key) { return ReadField(key, DEPTH_BITS, DEPTH_SHIFT); }
+
+void RenderQueue::Clear()
+{
+	items.clear();
+}
+
+void RenderQueue::Reserve(size_t count)
+{
+	items.reserve(count);
+	sortBuffer.reserve(count);
+}
+
+void RenderQueue::Add(uint64_t key, unsigned int entity)
+{
+	items.push_back({ key, entity });
+}
+
+void RenderQueue::Sort()
+{
+	size_t count = items.size();
+	if (count < 2)
+		return;
+
+	// Count every byte of every key in one read, all eight histograms at once.
+	size_t histograms[8][256] = {};
+	for (const DrawItem& item : items)
+	{
+		uint64_t key = item.key;
+		for (int digit = 0; digit < 8; digit++)
+			histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+	}
+
+	sortBuffer.resize(count);
+	DrawItem* source = items.data();
+	DrawItem* destination = sortBuffer.data();
+
+	for (int digit = 0; digit < 8; digit++)
+	{
+		size_t* histogram = histograms[digit];
+		unsigned int shift = digit * 8;
+
+		// A byte that is the same in every key leaves the order as it is,
+		// which is most of them (unused passes and shader ids, few materials).
+		if (histogram[(source[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		// Turn counts into the first position of each byte value.
+		size_t offset = 0;
+		for (int value = 0; value < 256; value++)
+		{
+			size_t valueCount = histogram[value];
+			histogram[value] = offset;
+			offset += valueCount;
+		}
+
+		// Scatter in order, which keeps the sort stable.
+		for (size_t i = 0; i < count; i++)
+		{
+			const DrawItem& item = source[i];
+			destination[histogram[(item.key >> shift) & 0xFF]++] = item;
+		}
+
+		DrawItem* swap = source;
+		source = destination;
+		destination = swap;
+	}
+
+	// An odd number of passes leaves the result in the sort buffer.
+	if (source != items.data())
+		items.swap(sortBuffer);
+}
+
+RenderQueue::StateChanges RenderQueue::CountStateChanges() const
+{
+	StateChanges changes = {};
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		uint64_t key = items[i].key;
+		bool first = i == 0;
+		uint64_t previous = first ? 0 : items[i - 1].key;
+		if (first || GetShader(key) != GetShader(previous)) changes.shaders++;
+		if (first || GetMaterial(key) != GetMaterial(previous)) changes.materials++;
+		if (first || GetMesh(key) != GetMesh(previous)) changes.meshes++;
+	}
+	return changes;
+}
+
+void RenderQueue::BuildBatches(const unsigned int* entityLods, unsigned int maxInstances, std::vector<DrawBatch>& batches) const
+{
+	batches.clear();
+	if (maxInstances == 0)
+		maxInstances = 1;
+
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		// Everything above the depth bits has to match the batch's first draw.
+		if (!batches.empty())
+		{
+			DrawBatch& batch = batches.back();
+			const DrawItem& first = items[batch.first];
+			bool sameState = (items[i].key >> DEPTH_BITS) == (first.key >> DEPTH_BITS);
+			bool sameLod = !entityLods || entityLods[items[i].entity] == entityLods[first.entity];
+			if (sameState && sameLod && batch.count < maxInstances)
+			{
+				batch.count++;
+				continue;
+			}
+		}
+
+		batches.push_back({ (unsigned int)i, 1 });
+	}
+}
+
+const RenderQueue::DrawItem* RenderQueue::GetItems() const
+{
+	return items.data();
+}
+
+size_t RenderQueue::GetCount() const
+{
+	return items.size();
+}
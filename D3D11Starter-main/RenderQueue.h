@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// A list of draws for one frame, each with a 64 bit key
+// that packs the state it needs, so sorting the keys
+// groups draws that share state.
+//
+// - From the highest bits down a key holds the pass, the
+//   shader program, the material, the mesh and the
+//   quantized view depth, so a sorted queue changes shaders
+//   least often, then materials, then meshes, and draws
+//   each run front to back
+// - Sort() is a least significant digit radix sort, which
+//   skips every byte that is the same in all keys
+// - BuildBatches() splits the sorted draws into runs that
+//   share everything but depth, for instanced drawing
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	// Bits of each key field, from the most significant down.
+	static constexpr unsigned int PASS_BITS = 4;
+	static constexpr unsigned int SHADER_BITS = 12;
+	static constexpr unsigned int MATERIAL_BITS = 16;
+	static constexpr unsigned int MESH_BITS = 16;
+	static constexpr unsigned int DEPTH_BITS = 16;
+
+	// One draw: its key and the entity (dense index) to draw.
+	struct DrawItem
+	{
+		uint64_t key;
+		unsigned int entity;
+	};
+
+	// How many times a queue's draws switch shader program, material and mesh
+	// in their current order (the first draw binds all three).
+	struct StateChanges
+	{
+		unsigned int shaders;
+		unsigned int materials;
+		unsigned int meshes;
+	};
+
+	// A run of consecutive draws, from "first" in the queue, that can be drawn
+	// as "count" instances of one draw.
+	struct DrawBatch
+	{
+		unsigned int first;
+		unsigned int count;
+	};
+
+	// Pack a key; fields are masked to their widths.
+	static uint64_t MakeKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, unsigned int depth);
+
+	// Quantize a view depth so nearer draws get smaller values.
+	// - Logarithmic, so nearby draws keep their order more finely than
+	//   distant ones; depths past the last step share it
+	static unsigned int QuantizeDepth(float depth);
+
+	// Read the fields back out of a key.
+	static unsigned int GetPass(uint64_t key);
+	static unsigned int GetShader(uint64_t key);
+	static unsigned int GetMaterial(uint64_t key);
+	static unsigned int GetMesh(uint64_t key);
+	static unsigned int GetDepth(uint64_t key);
+
+	void Clear();
+	void Reserve(size_t count);
+	void Add(uint64_t key, unsigned int entity);
+
+	// Sort the draws by key, keeping draws with equal keys in the order they were added.
+	void Sort();
+
+	// Count the state changes submitting the draws in their current order needs.
+	StateChanges CountStateChanges() const;
+
+	// Split the draws, in their current order, into batches of consecutive
+	// draws with the same pass, shader, material and mesh.
+	// - "entityLods" (indexed by entity, or null) also splits batches where
+	//   the level of detail changes
+	// - Batches hold at most "maxInstances" draws, so 1 gives one batch per draw
+	void BuildBatches(const unsigned int* entityLods, unsigned int maxInstances, std::vector<DrawBatch>& batches) const;
+
+	const DrawItem* GetItems() const;
+	size_t GetCount() const;
+
+private:
+	std::vector<DrawItem> items;
+
+	// Second buffer the radix sort moves items through.
+	std::vector<DrawItem> sortBuffer;
+};
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "RenderQueue.h"
+
+// --------------------------------------------------------
+// Headless draw queue benchmark
+//
+// - Fills queues of 1k to 1M draws for a random scene (a
+//   few shader programs, a few hundred materials and meshes
+//   and random depths) and times RenderQueue::Sort against
+//   std::stable_sort of the same items
+// - Checks that both orders match, that every key reads back
+//   the fields it was made from, and that sorting does not
+//   need more state changes than the unsorted order, and
+//   returns 1 if any check fails
+// - Prints the shader, material and mesh changes before and
+//   after sorting
+// - Batches sorted queues of grid-like scenes (a few meshes
+//   and materials repeated many times) for instancing,
+//   checks that every batch shares one state and level of
+//   detail and that the batches cover the queue in order,
+//   and prints how many draw calls batching removes
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers
+// only accessible in this file
+namespace
+{
+	const unsigned int SHADER_COUNT = 8;
+	const unsigned int MATERIAL_COUNT = 300;
+	const unsigned int MESH_COUNT = 200;
+
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	unsigned int TotalChanges(const RenderQueue::StateChanges& changes)
+	{
+		return changes.shaders + changes.materials + changes.meshes;
+	}
+
+	// Time one queue size and return the number of failed checks.
+	int RunBenchmark(size_t count, std::mt19937& random)
+	{
+		// Each material always uses the same shader program.
+		std::uniform_int_distribution<unsigned int> materials(0, MATERIAL_COUNT - 1);
+		std::uniform_int_distribution<unsigned int> meshes(0, MESH_COUNT - 1);
+		std::uniform_real_distribution<float> depths(0.1f, 2000.0f);
+
+		RenderQueue queue;
+		queue.Reserve(count);
+		size_t keyErrors = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			unsigned int pass = (unsigned int)(i % 2);
+			unsigned int material = materials(random);
+			unsigned int shader = material % SHADER_COUNT;
+			unsigned int mesh = meshes(random);
+			unsigned int depth = RenderQueue::QuantizeDepth(depths(random));
+			uint64_t key = RenderQueue::MakeKey(pass, shader, material, mesh, depth);
+			queue.Add(key, (unsigned int)i);
+
+			if (RenderQueue::GetPass(key) != pass || RenderQueue::GetShader(key) != shader ||
+				RenderQueue::GetMaterial(key) != material || RenderQueue::GetMesh(key) != mesh ||
+				RenderQueue::GetDepth(key) != depth)
+				keyErrors++;
+		}
+
+		std::vector<RenderQueue::DrawItem> reference(queue.GetItems(), queue.GetItems() + count);
+		RenderQueue::StateChanges unsorted = queue.CountStateChanges();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::stable_sort(reference.begin(), reference.end(),
+			[](const RenderQueue::DrawItem& a, const RenderQueue::DrawItem& b) { return a.key < b.key; });
+		float stdSortTime = MillisecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		queue.Sort();
+		float radixSortTime = MillisecondsSince(start);
+
+		RenderQueue::StateChanges sorted = queue.CountStateChanges();
+
+		// Both sorts are stable, so they agree on entities too.
+		size_t orderErrors = 0;
+		const RenderQueue::DrawItem* items = queue.GetItems();
+		for (size_t i = 0; i < count; i++)
+		{
+			if (items[i].key != reference[i].key || items[i].entity != reference[i].entity)
+				orderErrors++;
+		}
+
+		std::printf("%10zu %12.3f %12.3f %10u %10u %10u %10u %10u %10u\n",
+			count, stdSortTime, radixSortTime,
+			unsorted.shaders, unsorted.materials, unsorted.meshes,
+			sorted.shaders, sorted.materials, sorted.meshes);
+
+		int failures = 0;
+		if (keyErrors > 0)
+		{
+			std::printf("FAIL: %zu keys did not read back their fields\n", keyErrors);
+			failures++;
+		}
+		if (orderErrors > 0)
+		{
+			std::printf("FAIL: %zu draws differ from std::stable_sort\n", orderErrors);
+			failures++;
+		}
+		if (TotalChanges(sorted) > TotalChanges(unsorted))
+		{
+			std::printf("FAIL: sorting added state changes\n");
+			failures++;
+		}
+		return failures;
+	}
+
+	// Batch one grid-like scene and return the number of failed checks.
+	int RunInstancingBenchmark(size_t count, unsigned int meshCount, unsigned int materialCount, unsigned int maxInstances, std::mt19937& random)
+	{
+		const unsigned int LOD_COUNT = 4;
+		std::uniform_real_distribution<float> depths(0.1f, 500.0f);
+
+		// Levels of detail follow depth, as Mesh::SelectLod picks them.
+		// - Taken from the quantized depth, so they follow the sorted order exactly
+		unsigned int depthSteps = RenderQueue::QuantizeDepth(500.0f) + 1;
+		RenderQueue queue;
+		queue.Reserve(count);
+		std::vector<unsigned int> lods(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			unsigned int mesh = (unsigned int)(i % meshCount);
+			unsigned int material = (unsigned int)((i / meshCount) % materialCount);
+			unsigned int depth = RenderQueue::QuantizeDepth(depths(random));
+			lods[i] = depth * LOD_COUNT / depthSteps;
+			queue.Add(RenderQueue::MakeKey(0, material % SHADER_COUNT, material, mesh, depth), (unsigned int)i);
+		}
+		queue.Sort();
+
+		std::vector<RenderQueue::DrawBatch> batches;
+		auto start = std::chrono::high_resolution_clock::now();
+		queue.BuildBatches(lods.data(), maxInstances, batches);
+		float batchTime = MillisecondsSince(start);
+
+		// Batches cover the queue in order, and each one shares its first draw's state and level.
+		size_t batchErrors = 0;
+		size_t next = 0;
+		const RenderQueue::DrawItem* items = queue.GetItems();
+		for (const RenderQueue::DrawBatch& batch : batches)
+		{
+			if (batch.first != next || batch.count == 0 || batch.count > maxInstances)
+				batchErrors++;
+			for (unsigned int d = batch.first; d < batch.first + batch.count && d < count; d++)
+			{
+				const RenderQueue::DrawItem& firstItem = items[batch.first];
+				if ((items[d].key >> RenderQueue::DEPTH_BITS) != (firstItem.key >> RenderQueue::DEPTH_BITS) ||
+					lods[items[d].entity] != lods[firstItem.entity])
+					batchErrors++;
+			}
+			next = batch.first + batch.count;
+		}
+		if (next != count)
+			batchErrors++;
+
+		// The fewest batches possible: one per state and level, split at the instance limit.
+		std::vector<size_t> groupSizes(meshCount * materialCount * LOD_COUNT, 0);
+		for (size_t i = 0; i < count; i++)
+			groupSizes[((i % meshCount) * materialCount + (i / meshCount) % materialCount) * LOD_COUNT + lods[i]]++;
+		size_t fewestBatches = 0;
+		for (size_t size : groupSizes)
+			fewestBatches += (size + maxInstances - 1) / maxInstances;
+
+		std::printf("%10zu %8u %10u %10zu %10zu %12.1f %12.3f\n",
+			count, meshCount, materialCount, count, batches.size(),
+			100.0f * (1.0f - (float)batches.size() / (float)count), batchTime);
+
+		int failures = 0;
+		if (batchErrors > 0)
+		{
+			std::printf("FAIL: %zu batches mix states or do not cover the queue\n", batchErrors);
+			failures++;
+		}
+		if (batches.size() != fewestBatches)
+		{
+			std::printf("FAIL: %zu batches where %zu are enough\n", batches.size(), fewestBatches);
+			failures++;
+		}
+		return failures;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(12345);
+	int failures = 0;
+
+	// Depths must keep their order through quantization.
+	unsigned int lastDepth = 0;
+	for (float depth = 0.0f; depth < 100000.0f; depth = depth * 1.01f + 0.01f)
+	{
+		unsigned int quantized = RenderQueue::QuantizeDepth(depth);
+		if (quantized < lastDepth)
+		{
+			std::printf("FAIL: depth %f quantized below a nearer depth\n", depth);
+			failures++;
+			break;
+		}
+		lastDepth = quantized;
+	}
+
+	std::printf("%10s %12s %12s %10s %10s %10s %10s %10s %10s\n", "",
+		"", "", "Unsorted", "", "", "Sorted", "", "");
+	std::printf("%10s %12s %12s %10s %10s %10s %10s %10s %10s\n", "Draws",
+		"std ms", "Radix ms", "Shaders", "Materials", "Meshes", "Shaders", "Materials", "Meshes");
+	for (size_t count : { (size_t)1000, (size_t)10000, (size_t)100000, (size_t)1000000 })
+		failures += RunBenchmark(count, random);
+
+	// The Game scene's grid (every mesh and material pair only once), then
+	// larger grids that repeat the same seven meshes and thirteen materials.
+	std::printf("\n%10s %8s %10s %10s %10s %12s %12s\n", "Entities", "Meshes", "Materials", "Draws", "Instanced", "Saved %", "Batch ms");
+	failures += RunInstancingBenchmark(42, 7, 6, 1024, random);
+	for (size_t count : { (size_t)10000, (size_t)100000, (size_t)1000000 })
+		failures += RunInstancingBenchmark(count, 7, 13, 1024, random);
+	failures += RunInstancingBenchmark(100000, 200, 300, 1024, random);
+
+	return failures > 0 ? 1 : 0;
+}
@@ -12,6 +12,15 @@
 #define LIGHT_TYPE_POINT			1
 #define LIGHT_TYPE_SPOT				2
 
+// Directional lights in the frame data (matches Lights.h).
+#define MAX_DIRECTIONAL_LIGHTS		4
+
+// Light cluster grid (matches LightClusters.h): screen tiles across and
+// down, and depth slices.
+#define CLUSTER_TILES_X		16
+#define CLUSTER_TILES_Y		9
+#define CLUSTER_SLICES		24
+
 // Create PI.
 #define PI 3.14159265359
 
@@ -107,6 +116,17 @@ struct VertexToPixel
     float4 shadowMapPos : SHADOW_POSITION;
 };
 
+// Find the light cluster a pixel is in, the way LightClusters numbers them.
+// - The tile comes from the pixel's screen position, scaled by tiles per pixel
+// - The slice comes from its view depth (SV_POSITION's w), on the same
+//   exponential spacing the clusters were built with
+uint GetClusterIndex(float4 screenPosition, float2 tileScale, float sliceScale, float sliceBias)
+{
+    uint2 tile = min(uint2(screenPosition.xy * tileScale), uint2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    uint slice = (uint)clamp(log(screenPosition.w) * sliceScale + sliceBias, 0.0f, CLUSTER_SLICES - 1);
+    return (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+}
+
 struct VertexToPixel_SkyBox
 {
 	// Data type
@@ -257,6 +277,8 @@ float maxSpecularReflection)
 
 // ------------------------------------------------------------------------------------------
 // Using Cook-Torrance BRDF Lighting equation:
+// - CookTorrance.cpp ports these functions (and Attenuate) to C++, for
+//   CookTorranceBenchmark's checks; change both together.
 // Create a Normal distribution funtion that gives the percent of microfacet that reflect light
 // in our direction.
 float D_GGX(float3 n, float3 h, float roughness)
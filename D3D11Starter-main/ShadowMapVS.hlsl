@@ -1,9 +1,17 @@
 // Using shader include file:
 #include "ShaderIncludeFile.hlsli"
 
+// Same per-object and per-pass data as VertexShader.hlsl.
 cbuffer ExternalVSData : register(b0)
 {
     matrix world;
+    matrix worldInverseTranspose;
+}
+
+cbuffer VSPassData : register(b2)
+{
+    matrix viewMatrix;
+    matrix projectionMatrix;
     matrix lightView;
     matrix lightProjection;
     //matrix cameraView;
@@ -0,0 +1,490 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include "Parallel.h"
+#include "PngWriter.h"
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the timing and clipping helpers
+// only accessible in this file
+namespace
+{
+	// Fewest triangles worth a setup job of their own.
+	const size_t MIN_TRIANGLES_PER_JOB = 4096;
+
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	XMFLOAT3 Lerp(const XMFLOAT3& a, const XMFLOAT3& b, float t)
+	{
+		return XMFLOAT3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+	}
+}
+
+SoftwareRasterizer::SoftwareRasterizer()
+	: width(0), height(0), stride(0), paddedHeight(0), tilesX(0), tilesY(0),
+	cameraPosition(0.0f, 0.0f, 0.0f), clearColor(0.0f, 0.0f, 0.0f), triangleCount(0), timings()
+{
+	XMStoreFloat4x4(&viewProjectionMatrix, XMMatrixIdentity());
+}
+
+void SoftwareRasterizer::Resize(unsigned int newWidth, unsigned int newHeight)
+{
+	width = newWidth;
+	height = newHeight;
+	stride = (width + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+	paddedHeight = (height + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+	tilesX = stride / TILE_SIZE;
+	tilesY = paddedHeight / TILE_SIZE;
+
+	size_t pixelCount = (size_t)stride * paddedHeight;
+	depth.assign(pixelCount, 1.0f);
+	gbuffer.Resize(stride, paddedHeight);
+	litColors.assign(pixelCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	colors.assign((size_t)width * height * 4, 0);
+}
+
+void SoftwareRasterizer::SetCamera(const XMFLOAT4X4& viewMatrix, const XMFLOAT4X4& projectionMatrix, const XMFLOAT3& position)
+{
+	XMStoreFloat4x4(&viewProjectionMatrix, XMMatrixMultiply(XMLoadFloat4x4(&viewMatrix), XMLoadFloat4x4(&projectionMatrix)));
+	cameraPosition = position;
+}
+
+void SoftwareRasterizer::SetClearColor(const XMFLOAT3& color)
+{
+	clearColor = color;
+}
+
+void SoftwareRasterizer::Render(
+	const SoftwareDraw* draws,
+	size_t drawCount,
+	const SoftwareMaterial* materials,
+	const Lights* lights,
+	size_t lightCount,
+	unsigned int threadCount)
+{
+	unsigned int threads = Parallel::GetThreadCount(threadCount);
+	size_t tileCount = (size_t)tilesX * tilesY;
+
+	// Vertices: clip space positions, and world space positions and normals for the G-buffer.
+	auto start = std::chrono::high_resolution_clock::now();
+	drawVertices.resize(drawCount);
+	XMMATRIX viewProjection = XMLoadFloat4x4(&viewProjectionMatrix);
+	Parallel::ForRanges(drawCount, Parallel::GetJobCount(drawCount, 1, threads), [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t d = begin; d < end; d++)
+			{
+				const SoftwareDraw& draw = draws[d];
+				XMMATRIX world = XMLoadFloat4x4(&draw.worldMatrix);
+				XMMATRIX worldViewProjection = XMMatrixMultiply(world, viewProjection);
+				XMMATRIX worldInverseTranspose = XMLoadFloat4x4(&draw.worldInverseTransposeMatrix);
+
+				std::vector<ClipVertex>& vertices = drawVertices[d];
+				vertices.resize(draw.vertexCount);
+				for (unsigned int v = 0; v < draw.vertexCount; v++)
+				{
+					XMVECTOR position = XMLoadFloat3(&draw.vertices[v].Position);
+					XMStoreFloat4(&vertices[v].clip, XMVector3Transform(position, worldViewProjection));
+					XMStoreFloat3(&vertices[v].world, XMVector3Transform(position, world));
+					XMStoreFloat3(&vertices[v].normal, XMVector3TransformNormal(XMLoadFloat3(&draw.vertices[v].normal), worldInverseTranspose));
+				}
+			}
+		});
+	timings.vertexMilliseconds = MillisecondsSince(start);
+
+	// Triangles: clip, cull and set up each one, and list it in every tile its bounds touch.
+	// - Each job keeps its own triangles and tile lists, so nothing is shared while
+	//   binning, and job order keeps the triangles in submission order
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<size_t> firstTriangles(drawCount + 1, 0);
+	for (size_t d = 0; d < drawCount; d++)
+		firstTriangles[d + 1] = firstTriangles[d] + draws[d].indexCount / 3;
+	size_t inputTriangles = firstTriangles[drawCount];
+
+	size_t setupJobs = Parallel::GetJobCount(inputTriangles, MIN_TRIANGLES_PER_JOB, threads);
+	jobTriangles.resize(setupJobs);
+	jobBins.resize(setupJobs * tileCount);
+	Parallel::ForRanges(inputTriangles, setupJobs, [&](size_t begin, size_t end, size_t job)
+		{
+			std::vector<Triangle>& triangles = jobTriangles[job];
+			triangles.clear();
+			for (size_t tile = 0; tile < tileCount; tile++)
+				jobBins[job * tileCount + tile].clear();
+
+			size_t d = std::upper_bound(firstTriangles.begin(), firstTriangles.end(), begin) - firstTriangles.begin() - 1;
+			for (size_t t = begin; t < end; t++)
+			{
+				while (t >= firstTriangles[d + 1])
+					d++;
+
+				const unsigned int* index = draws[d].indices + (t - firstTriangles[d]) * 3;
+				const std::vector<ClipVertex>& vertices = drawVertices[d];
+				ClipVertex corners[3] = { vertices[index[0]], vertices[index[1]], vertices[index[2]] };
+
+				size_t first = triangles.size();
+				SetupTriangle(corners, draws[d].materialIndex, triangles);
+				for (size_t i = first; i < triangles.size(); i++)
+				{
+					const Triangle& triangle = triangles[i];
+					for (int tileY = triangle.minY / (int)TILE_SIZE; tileY <= triangle.maxY / (int)TILE_SIZE; tileY++)
+					{
+						for (int tileX = triangle.minX / (int)TILE_SIZE; tileX <= triangle.maxX / (int)TILE_SIZE; tileX++)
+							jobBins[job * tileCount + tileY * tilesX + tileX].push_back((unsigned int)i);
+					}
+				}
+			}
+		});
+
+	triangleCount = 0;
+	for (size_t job = 0; job < setupJobs; job++)
+		triangleCount += jobTriangles[job].size();
+	timings.setupMilliseconds = MillisecondsSince(start);
+
+	// Tiles: threads take the next unfinished tile until there are none left.
+	start = std::chrono::high_resolution_clock::now();
+	std::atomic<size_t> nextTile(0);
+	Parallel::RunOnThreads(threads, [&](size_t)
+		{
+			for (size_t tile = nextTile++; tile < tileCount; tile = nextTile++)
+				RasterizeTile((unsigned int)tile, materials);
+		});
+	timings.rasterMilliseconds = MillisecondsSince(start);
+
+	// Lighting, a row at a time.
+	start = std::chrono::high_resolution_clock::now();
+	Parallel::ForRanges(height, Parallel::GetJobCount(height, 8, threads), [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t y = begin; y < end; y++)
+				CookTorrance::ShadePixels(gbuffer, y * stride, width, lights, lightCount, cameraPosition, litColors.data());
+		});
+	timings.shadeMilliseconds = MillisecondsSince(start);
+
+	// Resolve: gamma correct the lit pixels, and fill the rest with the clear color.
+	start = std::chrono::high_resolution_clock::now();
+	XMFLOAT3 clearGamma = CookTorrance::GammaCorrect(clearColor);
+	Parallel::ForRanges(height, Parallel::GetJobCount(height, 8, threads), [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t y = begin; y < end; y++)
+			{
+				for (size_t x = 0; x < width; x++)
+				{
+					size_t pixel = y * stride + x;
+					XMFLOAT3 color = depth[pixel] < 1.0f ? CookTorrance::GammaCorrect(litColors[pixel]) : clearGamma;
+					float channels[3] = { color.x, color.y, color.z };
+
+					unsigned char* out = &colors[(y * width + x) * 4];
+					for (int c = 0; c < 3; c++)
+					{
+						float value = std::min(std::max(channels[c], 0.0f), 1.0f);
+						out[c] = (unsigned char)(value * 255.0f + 0.5f);
+					}
+					out[3] = 255;
+				}
+			}
+		});
+	timings.resolveMilliseconds = MillisecondsSince(start);
+}
+
+void SoftwareRasterizer::SetupTriangle(const ClipVertex* corners, unsigned int materialIndex, std::vector<Triangle>& triangles) const
+{
+	// Skip triangles wholly outside one plane of the view volume.
+	const XMFLOAT4& a = corners[0].clip;
+	const XMFLOAT4& b = corners[1].clip;
+	const XMFLOAT4& c = corners[2].clip;
+	if ((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+		(a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+		(a.z > a.w && b.z > b.w && c.z > c.w) || (a.z < 0.0f && b.z < 0.0f && c.z < 0.0f))
+		return;
+
+	if (a.z >= 0.0f && b.z >= 0.0f && c.z >= 0.0f)
+	{
+		AddTriangle(corners[0], corners[1], corners[2], materialIndex, triangles);
+		return;
+	}
+
+	// Clip to the near plane (z = 0 in Direct3D's clip space), which leaves three or four corners.
+	ClipVertex polygon[4];
+	int cornerCount = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		const ClipVertex& from = corners[i];
+		const ClipVertex& to = corners[(i + 1) % 3];
+		if (from.clip.z >= 0.0f)
+			polygon[cornerCount++] = from;
+
+		if ((from.clip.z >= 0.0f) != (to.clip.z >= 0.0f))
+		{
+			float t = from.clip.z / (from.clip.z - to.clip.z);
+			ClipVertex& crossing = polygon[cornerCount++];
+			crossing.clip = XMFLOAT4(
+				from.clip.x + (to.clip.x - from.clip.x) * t,
+				from.clip.y + (to.clip.y - from.clip.y) * t,
+				0.0f,
+				from.clip.w + (to.clip.w - from.clip.w) * t);
+			crossing.world = Lerp(from.world, to.world, t);
+			crossing.normal = Lerp(from.normal, to.normal, t);
+		}
+	}
+
+	for (int i = 2; i < cornerCount; i++)
+		AddTriangle(polygon[0], polygon[i - 1], polygon[i], materialIndex, triangles);
+}
+
+void SoftwareRasterizer::AddTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, unsigned int materialIndex, std::vector<Triangle>& triangles) const
+{
+	const ClipVertex* corners[3] = { &a, &b, &c };
+	Triangle triangle;
+	for (int i = 0; i < 3; i++)
+	{
+		const ClipVertex& corner = *corners[i];
+		float invW = 1.0f / corner.clip.w;
+		triangle.x[i] = (corner.clip.x * invW * 0.5f + 0.5f) * width;
+		triangle.y[i] = (0.5f - corner.clip.y * invW * 0.5f) * height;
+		triangle.z[i] = corner.clip.z * invW;
+		triangle.invW[i] = invW;
+		triangle.worldOverW[i] = XMFLOAT3(corner.world.x * invW, corner.world.y * invW, corner.world.z * invW);
+		triangle.normalOverW[i] = XMFLOAT3(corner.normal.x * invW, corner.normal.y * invW, corner.normal.z * invW);
+	}
+
+	// Facing the camera means clockwise on screen (y down), so a positive area.
+	float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+	if (!(area > 0.0f))
+		return;
+	triangle.invArea = 1.0f / area;
+
+	// Pixels whose centers could be inside, on screen.
+	float minX = std::max(std::min({ triangle.x[0], triangle.x[1], triangle.x[2] }), 0.0f);
+	float minY = std::max(std::min({ triangle.y[0], triangle.y[1], triangle.y[2] }), 0.0f);
+	float maxX = std::min(std::max({ triangle.x[0], triangle.x[1], triangle.x[2] }), width - 1.0f);
+	float maxY = std::min(std::max({ triangle.y[0], triangle.y[1], triangle.y[2] }), height - 1.0f);
+	if (minX > maxX || minY > maxY)
+		return;
+	triangle.minX = (int)minX;
+	triangle.minY = (int)minY;
+	triangle.maxX = (int)maxX;
+	triangle.maxY = (int)maxY;
+
+	// Top-left rule: pixel centers exactly on an edge belong to the triangle only
+	// for its left edges (inside is to the right) and top edges (flat, inside below).
+	for (int e = 0; e < 3; e++)
+	{
+		int i = (e + 1) % 3;
+		int j = (e + 2) % 3;
+		float edgeA = triangle.y[i] - triangle.y[j];
+		float edgeB = triangle.x[j] - triangle.x[i];
+		triangle.topLeft[e] = edgeA > 0.0f || (edgeA == 0.0f && edgeB > 0.0f);
+	}
+
+	triangle.materialIndex = materialIndex;
+	triangles.push_back(triangle);
+}
+
+void SoftwareRasterizer::RasterizeTile(unsigned int tile, const SoftwareMaterial* materials)
+{
+	int tileX = (int)(tile % tilesX * TILE_SIZE);
+	int tileY = (int)(tile / tilesX * TILE_SIZE);
+
+	// Clear the tile; pixels nothing covers keep a harmless surface under the camera.
+	for (int y = tileY; y < tileY + (int)TILE_SIZE; y++)
+	{
+		size_t rowStart = (size_t)y * stride + tileX;
+		std::fill_n(&depth[rowStart], TILE_SIZE, 1.0f);
+		std::fill_n(&gbuffer.positionX[rowStart], TILE_SIZE, cameraPosition.x);
+		std::fill_n(&gbuffer.positionY[rowStart], TILE_SIZE, cameraPosition.y - 1.0f);
+		std::fill_n(&gbuffer.positionZ[rowStart], TILE_SIZE, cameraPosition.z);
+		std::fill_n(&gbuffer.normalX[rowStart], TILE_SIZE, 0.0f);
+		std::fill_n(&gbuffer.normalY[rowStart], TILE_SIZE, 1.0f);
+		std::fill_n(&gbuffer.normalZ[rowStart], TILE_SIZE, 0.0f);
+		std::fill_n(&gbuffer.albedoR[rowStart], TILE_SIZE, 0.0f);
+		std::fill_n(&gbuffer.albedoG[rowStart], TILE_SIZE, 0.0f);
+		std::fill_n(&gbuffer.albedoB[rowStart], TILE_SIZE, 0.0f);
+		std::fill_n(&gbuffer.roughness[rowStart], TILE_SIZE, 1.0f);
+		std::fill_n(&gbuffer.metalness[rowStart], TILE_SIZE, 0.0f);
+		std::fill_n(&gbuffer.shadow[rowStart], TILE_SIZE, 1.0f);
+	}
+
+	size_t tileCount = (size_t)tilesX * tilesY;
+	for (size_t job = 0; job < jobTriangles.size(); job++)
+	{
+		for (unsigned int i : jobBins[job * tileCount + tile])
+			RasterizeTriangle(jobTriangles[job][i], tileX, tileY, materials);
+	}
+}
+
+void SoftwareRasterizer::RasterizeTriangle(const Triangle& triangle, int tileX, int tileY, const SoftwareMaterial* materials)
+{
+	int minX = std::max(triangle.minX, tileX);
+	int minY = std::max(triangle.minY, tileY);
+	int maxX = std::min(triangle.maxX, tileX + (int)TILE_SIZE - 1);
+	int maxY = std::min(triangle.maxY, tileY + (int)TILE_SIZE - 1);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	// Edge functions relative to the tile's corner, to keep them small. The same
+	// edge of a neighbouring triangle is exactly the negation, so between them
+	// every pixel center on it is drawn once.
+	float edgeA[3];
+	float edgeB[3];
+	float edgeC[3];
+	XMVECTOR edgeAVector[3];
+	for (int e = 0; e < 3; e++)
+	{
+		int i = (e + 1) % 3;
+		int j = (e + 2) % 3;
+		float xi = triangle.x[i] - tileX;
+		float yi = triangle.y[i] - tileY;
+		float xj = triangle.x[j] - tileX;
+		float yj = triangle.y[j] - tileY;
+		edgeA[e] = triangle.y[i] - triangle.y[j];
+		edgeB[e] = triangle.x[j] - triangle.x[i];
+		edgeC[e] = xi * yj - xj * yi;
+		edgeAVector[e] = XMVectorReplicate(edgeA[e]);
+	}
+
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	XMVECTOR invArea = XMVectorReplicate(triangle.invArea);
+	XMVECTOR z0 = XMVectorReplicate(triangle.z[0]);
+	XMVECTOR dz1 = XMVectorReplicate(triangle.z[1] - triangle.z[0]);
+	XMVECTOR dz2 = XMVectorReplicate(triangle.z[2] - triangle.z[0]);
+	const SoftwareMaterial& material = materials[triangle.materialIndex];
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		float py = (float)(y - tileY) + 0.5f;
+		XMVECTOR rowEdge[3];
+		for (int e = 0; e < 3; e++)
+			rowEdge[e] = XMVectorReplicate(edgeB[e] * py + edgeC[e]);
+
+		// Four pixels at a time, from a multiple of four (tiles are too).
+		for (int x = minX & ~3; x <= maxX; x += 4)
+		{
+			XMVECTOR px = XMVectorAdd(XMVectorReplicate((float)(x - tileX)), laneOffsets);
+			XMVECTOR edges[3];
+			XMVECTOR covered = XMVectorTrueInt();
+			for (int e = 0; e < 3; e++)
+			{
+				edges[e] = XMVectorMultiplyAdd(edgeAVector[e], px, rowEdge[e]);
+				covered = XMVectorAndInt(covered, triangle.topLeft[e] ?
+					XMVectorGreaterOrEqual(edges[e], zero) :
+					XMVectorGreater(edges[e], zero));
+			}
+			if (XMVector4EqualInt(covered, XMVectorFalseInt()))
+				continue;
+
+			// Depth is linear in screen space.
+			XMVECTOR z = XMVectorMultiplyAdd(XMVectorMultiply(edges[1], invArea), dz1, z0);
+			z = XMVectorMultiplyAdd(XMVectorMultiply(edges[2], invArea), dz2, z);
+
+			size_t index = (size_t)y * stride + x;
+			XMFLOAT4* depthLanes = reinterpret_cast<XMFLOAT4*>(&depth[index]);
+			XMVECTOR stored = XMLoadFloat4(depthLanes);
+			XMVECTOR passed = XMVectorAndInt(covered, XMVectorLess(z, stored));
+			if (XMVector4EqualInt(passed, XMVectorFalseInt()))
+				continue;
+			XMStoreFloat4(depthLanes, XMVectorSelect(stored, z, passed));
+
+			// The G-buffer, with perspective correct world positions and normals.
+			uint32_t laneMask[4];
+			XMStoreInt4(laneMask, passed);
+			XMFLOAT4A lambda[3];
+			for (int e = 0; e < 3; e++)
+				XMStoreFloat4A(&lambda[e], XMVectorMultiply(edges[e], invArea));
+
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (laneMask[lane] == 0)
+					continue;
+
+				float weights[3] = {
+					(&lambda[0].x)[lane] * triangle.invW[0],
+					(&lambda[1].x)[lane] * triangle.invW[1],
+					(&lambda[2].x)[lane] * triangle.invW[2] };
+				float w = 1.0f / (weights[0] + weights[1] + weights[2]);
+
+				XMFLOAT3 world(0.0f, 0.0f, 0.0f);
+				XMFLOAT3 normal(0.0f, 0.0f, 0.0f);
+				for (int i = 0; i < 3; i++)
+				{
+					float weight = (&lambda[i].x)[lane];
+					world.x += triangle.worldOverW[i].x * weight;
+					world.y += triangle.worldOverW[i].y * weight;
+					world.z += triangle.worldOverW[i].z * weight;
+					normal.x += triangle.normalOverW[i].x * weight;
+					normal.y += triangle.normalOverW[i].y * weight;
+					normal.z += triangle.normalOverW[i].z * weight;
+				}
+				float normalScale = 1.0f / std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+
+				size_t pixel = index + lane;
+				gbuffer.positionX[pixel] = world.x * w;
+				gbuffer.positionY[pixel] = world.y * w;
+				gbuffer.positionZ[pixel] = world.z * w;
+				gbuffer.normalX[pixel] = normal.x * normalScale;
+				gbuffer.normalY[pixel] = normal.y * normalScale;
+				gbuffer.normalZ[pixel] = normal.z * normalScale;
+				gbuffer.albedoR[pixel] = material.albedo.x;
+				gbuffer.albedoG[pixel] = material.albedo.y;
+				gbuffer.albedoB[pixel] = material.albedo.z;
+				gbuffer.roughness[pixel] = material.roughness;
+				gbuffer.metalness[pixel] = material.metalness;
+			}
+		}
+	}
+}
+
+unsigned int SoftwareRasterizer::GetWidth() const
+{
+	return width;
+}
+
+unsigned int SoftwareRasterizer::GetHeight() const
+{
+	return height;
+}
+
+const unsigned char* SoftwareRasterizer::GetColors() const
+{
+	return colors.data();
+}
+
+float SoftwareRasterizer::GetDepth(unsigned int x, unsigned int y) const
+{
+	return depth[(size_t)y * stride + x];
+}
+
+XMFLOAT3 SoftwareRasterizer::GetNormal(unsigned int x, unsigned int y) const
+{
+	size_t pixel = (size_t)y * stride + x;
+	return XMFLOAT3(gbuffer.normalX[pixel], gbuffer.normalY[pixel], gbuffer.normalZ[pixel]);
+}
+
+XMFLOAT3 SoftwareRasterizer::GetAlbedo(unsigned int x, unsigned int y) const
+{
+	size_t pixel = (size_t)y * stride + x;
+	return XMFLOAT3(gbuffer.albedoR[pixel], gbuffer.albedoG[pixel], gbuffer.albedoB[pixel]);
+}
+
+size_t SoftwareRasterizer::GetTriangleCount() const
+{
+	return triangleCount;
+}
+
+const SoftwarePassTimings& SoftwareRasterizer::GetTimings() const
+{
+	return timings;
+}
+
+bool SoftwareRasterizer::WritePng(const char* path) const
+{
+	return PngWriter::Write(path, width, height, colors.data());
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "CookTorrance.h"
+#include "Lights.h"
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// What the software rasterizer shades a surface with.
+//
+// - It has no textures, so "albedo" is the linear color a
+//   material's tint (or its albedo texture) comes to, and
+//   roughness and metalness are the values its maps hold
+// --------------------------------------------------------
+struct SoftwareMaterial
+{
+	DirectX::XMFLOAT3 albedo;
+	float roughness;
+	float metalness;
+};
+
+// --------------------------------------------------------
+// One mesh drawn with one world matrix and material.
+//
+// - "vertices" and "indices" are a MeshData's arrays (or one
+//   of its levels of detail), so the same data Mesh uploads
+// - Triangles are clockwise on screen when facing the
+//   camera, and back faces are culled, as with Direct3D's
+//   default rasterizer state
+// --------------------------------------------------------
+struct SoftwareDraw
+{
+	const Vertex* vertices;
+	unsigned int vertexCount;
+	const unsigned int* indices;
+	unsigned int indexCount;
+	DirectX::XMFLOAT4X4 worldMatrix;
+	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
+	unsigned int materialIndex;
+};
+
+// Milliseconds each pass of the last frame took.
+struct SoftwarePassTimings
+{
+	float vertexMilliseconds;
+	float setupMilliseconds;
+	float rasterMilliseconds;
+	float shadeMilliseconds;
+	float resolveMilliseconds;
+};
+
+// --------------------------------------------------------
+// Headless CPU renderer for frame captures and timings off
+// Direct3D.
+//
+// - Each frame runs as passes: transform every draw's
+//   vertices, set up (near clip, cull) and bin triangles
+//   into TILE_SIZE square screen tiles, rasterize each tile
+//   into depth and a G-buffer, light that with
+//   CookTorrance::ShadePixels and resolve it to gamma
+//   corrected 8 bit color
+// - Rasterization tests four pixels at a time against the
+//   triangle's edge functions, using Direct3D's top-left
+//   rule so shared edges are drawn exactly once, and keeps
+//   the nearest depth (LESS, cleared to 1)
+// - Tiles are handed out to threads, and every tile draws
+//   its triangles in submission order, so the image is the
+//   same for any thread count
+// --------------------------------------------------------
+class SoftwareRasterizer
+{
+public:
+	static constexpr unsigned int TILE_SIZE = 32;
+
+	SoftwareRasterizer();
+
+	void Resize(unsigned int newWidth, unsigned int newHeight);
+	void SetCamera(const DirectX::XMFLOAT4X4& viewMatrix, const DirectX::XMFLOAT4X4& projectionMatrix, const DirectX::XMFLOAT3& position);
+	void SetClearColor(const DirectX::XMFLOAT3& color);
+
+	// Render a frame of the given draws.
+	// - Uses one thread per hardware thread when "threadCount" is 0
+	void Render(
+		const SoftwareDraw* draws,
+		size_t drawCount,
+		const SoftwareMaterial* materials,
+		const Lights* lights,
+		size_t lightCount,
+		unsigned int threadCount = 0);
+
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+
+	// Gamma corrected RGBA, rows top to bottom.
+	const unsigned char* GetColors() const;
+
+	// Depth (z / w, 1 where nothing was drawn) and G-buffer values of a pixel.
+	float GetDepth(unsigned int x, unsigned int y) const;
+	DirectX::XMFLOAT3 GetNormal(unsigned int x, unsigned int y) const;
+	DirectX::XMFLOAT3 GetAlbedo(unsigned int x, unsigned int y) const;
+
+	// Triangles left after clipping and culling in the last frame.
+	size_t GetTriangleCount() const;
+	const SoftwarePassTimings& GetTimings() const;
+
+	// Write the last frame as a PNG.
+	bool WritePng(const char* path) const;
+
+private:
+	// A transformed vertex: clip space position, and world space position and normal.
+	struct ClipVertex
+	{
+		DirectX::XMFLOAT4 clip;
+		DirectX::XMFLOAT3 world;
+		DirectX::XMFLOAT3 normal;
+	};
+
+	// A triangle ready to rasterize.
+	// - Edge e runs between the other two vertices, (e + 1) % 3 to (e + 2) % 3,
+	//   and is positive on the triangle's side
+	// - Attributes are divided by w, for perspective correct interpolation
+	struct Triangle
+	{
+		float x[3];
+		float y[3];
+		float z[3];
+		float invW[3];
+		DirectX::XMFLOAT3 worldOverW[3];
+		DirectX::XMFLOAT3 normalOverW[3];
+		float invArea;
+		bool topLeft[3];
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+		unsigned int materialIndex;
+	};
+
+	// Clip a triangle to the near plane, cull it if it faces away and add what is left.
+	void SetupTriangle(const ClipVertex* corners, unsigned int materialIndex, std::vector<Triangle>& triangles) const;
+	void AddTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, unsigned int materialIndex, std::vector<Triangle>& triangles) const;
+
+	// Clear one tile, then draw every triangle binned to it.
+	void RasterizeTile(unsigned int tile, const SoftwareMaterial* materials);
+	void RasterizeTriangle(const Triangle& triangle, int tileX, int tileY, const SoftwareMaterial* materials);
+
+	unsigned int width;
+	unsigned int height;
+
+	// Buffers are padded out to whole tiles.
+	unsigned int stride;
+	unsigned int paddedHeight;
+	unsigned int tilesX;
+	unsigned int tilesY;
+
+	DirectX::XMFLOAT4X4 viewProjectionMatrix;
+	DirectX::XMFLOAT3 cameraPosition;
+	DirectX::XMFLOAT3 clearColor;
+
+	std::vector<float> depth;
+	GBuffer gbuffer;
+	std::vector<DirectX::XMFLOAT3> litColors;
+	std::vector<unsigned char> colors;
+
+	// Per draw transformed vertices, then per setup job triangles and their
+	// tile lists (job * tile count + tile).
+	std::vector<std::vector<ClipVertex>> drawVertices;
+	std::vector<std::vector<Triangle>> jobTriangles;
+	std::vector<std::vector<unsigned int>> jobBins;
+
+	size_t triangleCount;
+	SoftwarePassTimings timings;
+};
@@ -0,0 +1,394 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MeshData.h"
+#include "Parallel.h"
+#include "SoftwareRasterizer.h"
+#include "Transform.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless software rasterizer benchmark and regression
+// test
+//
+// - Renders the Game's scene (six rows of seven meshes over
+//   the ground, seen from its second camera under its five
+//   default lights) at 1280 x 720, times each pass on one
+//   thread and on all of them, and writes the frame as a PNG
+//   (SoftwareFrame.png, or the path given after the mesh
+//   folder)
+// - Checks that any thread count draws the same image, that
+//   a triangle fan covers every pixel inside it exactly once
+//   (no cracks or double drawn pixels on shared edges) and
+//   nothing outside, that back faces are culled and that the
+//   nearer surface wins in either draw order; returns 1 if
+//   any check fails
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers
+// only accessible in this file
+namespace
+{
+	const unsigned int WIDTH = 1280;
+	const unsigned int HEIGHT = 720;
+
+	// Sides of the fan the coverage checks draw.
+	const int FAN_SIDES = 64;
+
+	SoftwareDraw MakeDraw(const MeshData<unsigned int>& mesh, const XMFLOAT4X4& world, const XMFLOAT4X4& worldInverseTranspose, unsigned int materialIndex)
+	{
+		SoftwareDraw draw = {};
+		draw.vertices = mesh.vertices.data();
+		draw.vertexCount = (unsigned int)mesh.vertices.size();
+		draw.indices = mesh.indices.data();
+		draw.indexCount = (unsigned int)mesh.indices.size();
+		draw.worldMatrix = world;
+		draw.worldInverseTransposeMatrix = worldInverseTranspose;
+		draw.materialIndex = materialIndex;
+		return draw;
+	}
+
+	// The Game's five default lights (see Game::Initialize).
+	std::vector<Lights> MakeLights()
+	{
+		std::vector<Lights> lights(5);
+		for (Lights& light : lights)
+			light = {};
+
+		lights[0].type = LIGHT_TYPE_DIRECTIONAL;
+		lights[0].direction = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		lights[1].type = LIGHT_TYPE_DIRECTIONAL;
+		lights[1].direction = XMFLOAT3(-2.0f, 0.0f, 0.0f);
+		lights[2].type = LIGHT_TYPE_DIRECTIONAL;
+		lights[2].direction = XMFLOAT3(10.0f, -3.0f, -6.0f);
+		for (int i = 0; i < 3; i++)
+		{
+			lights[i].color = XMFLOAT3(0.8f, 0.8f, 0.8f);
+			lights[i].intensity = 1.0f;
+		}
+
+		lights[3].type = LIGHT_TYPE_POINT;
+		lights[3].position = XMFLOAT3(0.0f, 10.0f, 0.0f);
+		lights[3].range = 10.0f;
+		lights[3].color = XMFLOAT3(0.0f, 0.0f, 1.0f);
+		lights[3].intensity = 4.0f;
+
+		lights[4].type = LIGHT_TYPE_SPOT;
+		lights[4].position = XMFLOAT3(0.0f, 5.0f, 0.0f);
+		lights[4].range = 10.0f;
+		lights[4].spotInnerAngle = XMConvertToRadians(30.0f);
+		lights[4].spotOuterAngle = XMConvertToRadians(60.0f);
+		lights[4].direction = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		lights[4].color = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		lights[4].intensity = 5.0f;
+		return lights;
+	}
+
+	// Stand-ins for the Game's materials, without their textures.
+	// - 0 to 5 are the rows' materials (custom, white, texture combine, red,
+	//   normals and UVs debug), 6 to 12 the second row's PBR spheres
+	std::vector<SoftwareMaterial> MakeMaterials()
+	{
+		return {
+			{ XMFLOAT3(0.3f, 0.3f, 0.3f), 0.6f, 0.0f },
+			{ XMFLOAT3(1.0f, 1.0f, 1.0f), 0.5f, 0.0f },
+			{ XMFLOAT3(0.7f, 0.6f, 0.5f), 0.7f, 0.0f },
+			{ XMFLOAT3(1.0f, 0.0f, 0.0f), 0.4f, 0.0f },
+			{ XMFLOAT3(0.5f, 0.5f, 1.0f), 0.5f, 0.0f },
+			{ XMFLOAT3(0.5f, 0.5f, 0.0f), 0.5f, 0.0f },
+			{ XMFLOAT3(0.9f, 0.6f, 0.4f), 0.2f, 1.0f },
+			{ XMFLOAT3(0.5f, 0.5f, 0.5f), 0.8f, 0.0f },
+			{ XMFLOAT3(0.4f, 0.3f, 0.2f), 0.9f, 0.0f },
+			{ XMFLOAT3(0.9f, 0.9f, 0.9f), 0.3f, 1.0f },
+			{ XMFLOAT3(0.2f, 0.4f, 0.2f), 0.7f, 0.0f },
+			{ XMFLOAT3(0.6f, 0.1f, 0.1f), 0.5f, 0.0f },
+			{ XMFLOAT3(1.0f, 0.8f, 0.3f), 0.4f, 1.0f },
+		};
+	}
+
+	// A regular polygon of FAN_SIDES triangles around (centerX, centerY) at depth z,
+	// in clip space (so drawn with identity matrices), facing the camera or away.
+	MeshData<unsigned int> MakeFan(float centerX, float centerY, float radius, float z, bool facing)
+	{
+		MeshData<unsigned int> fan;
+		Vertex center = {};
+		center.Position = XMFLOAT3(centerX, centerY, z);
+		center.normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
+		fan.vertices.push_back(center);
+		for (int i = 0; i < FAN_SIDES; i++)
+		{
+			// Counterclockwise in clip space (y up) is clockwise on screen.
+			float angle = 2.0f * XM_PI * i / FAN_SIDES;
+			Vertex corner = center;
+			corner.Position = XMFLOAT3(centerX + radius * std::cos(angle), centerY + radius * std::sin(angle), z);
+			fan.vertices.push_back(corner);
+		}
+		for (unsigned int i = 0; i < (unsigned int)FAN_SIDES; i++)
+		{
+			unsigned int next = (i + 1) % FAN_SIDES;
+			fan.indices.insert(fan.indices.end(), { 0, facing ? next + 1 : i + 1, facing ? i + 1 : next + 1 });
+		}
+		return fan;
+	}
+
+	// One draw per triangle of a mesh, each with its own material, in order or reversed.
+	std::vector<SoftwareDraw> SplitTriangles(const MeshData<unsigned int>& mesh, bool reversed)
+	{
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+		std::vector<SoftwareDraw> draws;
+		size_t triangles = mesh.indices.size() / 3;
+		for (size_t i = 0; i < triangles; i++)
+		{
+			size_t t = reversed ? triangles - 1 - i : i;
+			SoftwareDraw draw = MakeDraw(mesh, identity, identity, (unsigned int)t);
+			draw.indices += t * 3;
+			draw.indexCount = 3;
+			draws.push_back(draw);
+		}
+		return draws;
+	}
+
+	// A material per fan triangle, told apart by albedo.
+	std::vector<SoftwareMaterial> MakeFanMaterials()
+	{
+		std::vector<SoftwareMaterial> materials(FAN_SIDES);
+		for (int i = 0; i < FAN_SIDES; i++)
+			materials[i] = { XMFLOAT3((i + 1.0f) / FAN_SIDES, 0.5f, 0.5f), 0.5f, 0.0f };
+		return materials;
+	}
+
+	void SetIdentityCamera(SoftwareRasterizer& rasterizer)
+	{
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		rasterizer.SetCamera(identity, identity, XMFLOAT3(0.0f, 0.0f, -1.0f));
+	}
+
+	// Check the fan covers every pixel center inside it, nothing outside it, and
+	// that drawing its triangles in reverse order draws each pixel from the same one.
+	int CheckFanCoverage(const std::vector<Lights>& lights)
+	{
+		const unsigned int size = 200;
+		const float radius = 0.8f;
+		SoftwareRasterizer rasterizer;
+		rasterizer.Resize(size, size);
+		SetIdentityCamera(rasterizer);
+
+		MeshData<unsigned int> fan = MakeFan(0.013f, -0.021f, radius, 0.5f, true);
+		std::vector<SoftwareMaterial> materials = MakeFanMaterials();
+
+		std::vector<SoftwareDraw> forward = SplitTriangles(fan, false);
+		rasterizer.Render(forward.data(), forward.size(), materials.data(), lights.data(), lights.size());
+		std::vector<float> forwardOwners;
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+				forwardOwners.push_back(rasterizer.GetDepth(x, y) < 1.0f ? rasterizer.GetAlbedo(x, y).x : 0.0f);
+		}
+
+		std::vector<SoftwareDraw> backward = SplitTriangles(fan, true);
+		rasterizer.Render(backward.data(), backward.size(), materials.data(), lights.data(), lights.size());
+
+		// The polygon's edges are at least radius * cos(pi / sides) from its center.
+		float inner = radius * std::cos(XM_PI / FAN_SIDES) - 1.0f / size;
+		float outer = radius + 1.0f / size;
+		size_t cracks = 0;
+		size_t outside = 0;
+		size_t changed = 0;
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				float dx = (x + 0.5f) / size * 2.0f - 1.0f - 0.013f;
+				float dy = 1.0f - (y + 0.5f) / size * 2.0f + 0.021f;
+				float distance = std::sqrt(dx * dx + dy * dy);
+				bool covered = rasterizer.GetDepth(x, y) < 1.0f;
+				float owner = covered ? rasterizer.GetAlbedo(x, y).x : 0.0f;
+
+				if (distance < inner && !covered)
+					cracks++;
+				if (distance > outer && covered)
+					outside++;
+				if (owner != forwardOwners[y * size + x])
+					changed++;
+			}
+		}
+
+		std::printf("Fan coverage: %zu cracks, %zu pixels outside, %zu pixels drawn twice\n", cracks, outside, changed);
+		return (cracks > 0 || outside > 0 || changed > 0) ? 1 : 0;
+	}
+
+	// Check the fan wound the other way draws nothing.
+	int CheckBackFaces(const std::vector<Lights>& lights)
+	{
+		SoftwareRasterizer rasterizer;
+		rasterizer.Resize(64, 64);
+		SetIdentityCamera(rasterizer);
+
+		MeshData<unsigned int> fan = MakeFan(0.0f, 0.0f, 0.9f, 0.5f, false);
+		std::vector<SoftwareMaterial> materials = MakeFanMaterials();
+		std::vector<SoftwareDraw> draws = SplitTriangles(fan, false);
+		rasterizer.Render(draws.data(), draws.size(), materials.data(), lights.data(), lights.size());
+
+		std::printf("Back faces: %zu triangles drawn\n", rasterizer.GetTriangleCount());
+		return rasterizer.GetTriangleCount() > 0 ? 1 : 0;
+	}
+
+	// Check a near fan in front of a far one wins whichever is drawn first.
+	int CheckDepth(const std::vector<Lights>& lights)
+	{
+		const unsigned int size = 64;
+		SoftwareRasterizer rasterizer;
+		rasterizer.Resize(size, size);
+		SetIdentityCamera(rasterizer);
+
+		MeshData<unsigned int> nearFan = MakeFan(0.0f, 0.0f, 0.5f, 0.3f, true);
+		MeshData<unsigned int> farFan = MakeFan(0.0f, 0.0f, 0.9f, 0.6f, true);
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		std::vector<SoftwareMaterial> materials = {
+			{ XMFLOAT3(1.0f, 0.0f, 0.0f), 0.5f, 0.0f },
+			{ XMFLOAT3(0.0f, 0.0f, 1.0f), 0.5f, 0.0f } };
+
+		int failures = 0;
+		for (int order = 0; order < 2; order++)
+		{
+			SoftwareDraw draws[2] = { MakeDraw(nearFan, identity, identity, 0), MakeDraw(farFan, identity, identity, 1) };
+			if (order == 1)
+				std::swap(draws[0], draws[1]);
+			rasterizer.Render(draws, 2, materials.data(), lights.data(), lights.size());
+
+			bool nearWins = rasterizer.GetAlbedo(size / 2, size / 2).x == 1.0f && std::fabs(rasterizer.GetDepth(size / 2, size / 2) - 0.3f) < 1e-5f;
+			bool farAround = rasterizer.GetAlbedo(2 * size / 16, size / 2).z == 1.0f;
+			if (!nearWins || !farAround)
+				failures++;
+		}
+
+		std::printf("Depth test: %s\n", failures > 0 ? "FAILED" : "nearest wins in either order");
+		return failures > 0 ? 1 : 0;
+	}
+
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void PrintTimings(const char* label, const SoftwarePassTimings& timings, float total)
+	{
+		std::printf("%-10s %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n", label,
+			timings.vertexMilliseconds, timings.setupMilliseconds, timings.rasterMilliseconds,
+			timings.shadeMilliseconds, timings.resolveMilliseconds, total);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string folder = (argc > 1) ? argv[1] : "Assets/Meshes";
+	const char* outputPath = (argc > 2) ? argv[2] : "SoftwareFrame.png";
+	int failures = 0;
+
+	// The Game's meshes, in the order its rows list them.
+	const char* names[7] = { "torus", "sphere", "quad_double_sided", "quad", "helix", "cylinder", "cube" };
+	std::vector<MeshData<unsigned int>> meshes;
+	for (const char* name : names)
+	{
+		meshes.push_back(MeshProcessing::ProcessObj((folder + "/" + name + ".obj").c_str()));
+		if (meshes.back().vertices.empty())
+		{
+			std::printf("Could not load %s/%s.obj\n", folder.c_str(), name);
+			return 1;
+		}
+	}
+
+	// Six rows of seven entities under their row's parent, and the ground (see Game::CreateGeometry).
+	std::vector<Lights> lights = MakeLights();
+	std::vector<SoftwareMaterial> materials = MakeMaterials();
+	Transform rows[6];
+	std::vector<Transform> entityTransforms(6 * 7 + 1);
+	std::vector<SoftwareDraw> draws;
+	for (int x = 0; x < 6; x++)
+	{
+		for (int j = 0; j < 7; j++)
+		{
+			Transform& transform = entityTransforms[x * 7 + j];
+			transform.SetPosition((float)(-9 + 3 * j), 0.0f, 0.0f);
+			transform.SetParent(&rows[x]);
+		}
+		rows[x].SetPosition(0.0f, (float)(4 * x), 0.0f);
+	}
+	Transform& ground = entityTransforms[6 * 7];
+	ground.SetPosition(0.0f, -4.0f, 0.0f);
+	ground.SetScale(50.0f, 50.0f, 50.0f);
+
+	for (int x = 0; x < 6; x++)
+	{
+		for (int j = 0; j < 7; j++)
+		{
+			Transform& transform = entityTransforms[x * 7 + j];
+			draws.push_back(x == 1 ?
+				MakeDraw(meshes[1], transform.GetWorldMatrix(), transform.GetInverseTransposeMatrix(), 6 + j) :
+				MakeDraw(meshes[j], transform.GetWorldMatrix(), transform.GetInverseTransposeMatrix(), x));
+		}
+	}
+	draws.push_back(MakeDraw(meshes[2], ground.GetWorldMatrix(), ground.GetInverseTransposeMatrix(), 1));
+
+	// The Game's second camera: at (0, 10, -60) looking down +z with a 30 degree field of view.
+	XMFLOAT3 cameraPosition(0.0f, 10.0f, -60.0f);
+	XMFLOAT4X4 viewMatrix, projectionMatrix;
+	XMStoreFloat4x4(&viewMatrix, XMMatrixLookToLH(XMLoadFloat3(&cameraPosition), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+	XMStoreFloat4x4(&projectionMatrix, XMMatrixPerspectiveFovLH(XM_PI / 6.0f, (float)WIDTH / HEIGHT, 0.01f, 900.0f));
+
+	SoftwareRasterizer rasterizer;
+	rasterizer.Resize(WIDTH, HEIGHT);
+	rasterizer.SetCamera(viewMatrix, projectionMatrix, cameraPosition);
+
+	size_t inputTriangles = 0;
+	for (const SoftwareDraw& draw : draws)
+		inputTriangles += draw.indexCount / 3;
+
+	// Warm up, then time one thread and every thread.
+	rasterizer.Render(draws.data(), draws.size(), materials.data(), lights.data(), lights.size(), 1);
+	std::vector<unsigned char> singleThreaded;
+	std::printf("%zu draws, %zu triangles (%zu after clipping and culling), %u x %u, %u threads\n",
+		draws.size(), inputTriangles, rasterizer.GetTriangleCount(), WIDTH, HEIGHT, Parallel::GetThreadCount());
+	std::printf("%-10s %8s %8s %8s %8s %8s %8s\n", "Threads", "Vertex", "Setup", "Raster", "Shade", "Resolve", "Total");
+	for (unsigned int threads : { 1u, 0u })
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		rasterizer.Render(draws.data(), draws.size(), materials.data(), lights.data(), lights.size(), threads);
+		float total = MillisecondsSince(start);
+		PrintTimings(threads == 1 ? "1" : "All", rasterizer.GetTimings(), total);
+
+		if (threads == 1)
+			singleThreaded.assign(rasterizer.GetColors(), rasterizer.GetColors() + (size_t)WIDTH * HEIGHT * 4);
+	}
+
+	// An odd thread count splits the setup and tiles differently, but must draw the same image.
+	rasterizer.Render(draws.data(), draws.size(), materials.data(), lights.data(), lights.size(), 7);
+	bool sameImage = std::memcmp(singleThreaded.data(), rasterizer.GetColors(), singleThreaded.size()) == 0;
+	std::printf("Thread counts: %s\n", sameImage ? "same image" : "FAILED, images differ");
+	if (!sameImage)
+		failures++;
+
+	if (rasterizer.WritePng(outputPath))
+		std::printf("Wrote %s\n", outputPath);
+	else
+	{
+		std::printf("Could not write %s\n", outputPath);
+		failures++;
+	}
+
+	failures += CheckFanCoverage(lights);
+	failures += CheckBackFaces(lights);
+	failures += CheckDepth(lights);
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,298 @@
+#include "TangentGenerator.h"
+#include "Parallel.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the accumulate and orthogonalize passes
+// only accessible in this file
+namespace
+{
+	// Triangles whose uv determinant is smaller than this have no usable
+	// uv direction and are skipped.
+	const float MIN_UV_DETERMINANT = 1e-12f;
+
+	// Below this many triangles per thread, threads cost more than they save.
+	const size_t MIN_TRIANGLES_PER_THREAD = 16384;
+
+	// Any unit vector perpendicular to the normal, for vertices whose
+	// triangles gave them no tangent.
+	XMFLOAT3 PerpendicularTo(const XMFLOAT3& normal)
+	{
+		// Cross the normal with whichever axis it is least aligned with.
+		XMVECTOR n = XMLoadFloat3(&normal);
+		XMVECTOR axis = (std::fabs(normal.x) < 0.9f) ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		XMVECTOR perpendicular = XMVector3Normalize(XMVector3Cross(n, axis));
+
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, perpendicular);
+		if (result.x == 0.0f && result.y == 0.0f && result.z == 0.0f)
+			result = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		return result;
+	}
+
+	// Add the tangent of triangles [begin, end) to their vertices, one at a time.
+	void AccumulateScalar(const Vertex* verts, const unsigned int* indices, size_t begin, size_t end, XMFLOAT3* tangents)
+	{
+		for (size_t triangle = begin; triangle < end; triangle++)
+		{
+			// Grab indices and vertices of the triangle
+			unsigned int i1 = indices[triangle * 3];
+			unsigned int i2 = indices[triangle * 3 + 1];
+			unsigned int i3 = indices[triangle * 3 + 2];
+			const Vertex* v1 = &verts[i1];
+			const Vertex* v2 = &verts[i2];
+			const Vertex* v3 = &verts[i3];
+
+			// Calculate vectors relative to triangle positions
+			float x1 = v2->Position.x - v1->Position.x;
+			float y1 = v2->Position.y - v1->Position.y;
+			float z1 = v2->Position.z - v1->Position.z;
+
+			float x2 = v3->Position.x - v1->Position.x;
+			float y2 = v3->Position.y - v1->Position.y;
+			float z2 = v3->Position.z - v1->Position.z;
+
+			// Do the same for vectors relative to triangle uv's
+			float s1 = v2->uv.x - v1->uv.x;
+			float t1 = v2->uv.y - v1->uv.y;
+
+			float s2 = v3->uv.x - v1->uv.x;
+			float t2 = v3->uv.y - v1->uv.y;
+
+			// Create vectors for tangent calculation, skipping degenerate uvs
+			float determinant = s1 * t2 - s2 * t1;
+			float r = (std::fabs(determinant) >= MIN_UV_DETERMINANT) ? 1.0f / determinant : 0.0f;
+
+			float tx = (t2 * x1 - t1 * x2) * r;
+			float ty = (t2 * y1 - t1 * y2) * r;
+			float tz = (t2 * z1 - t1 * z2) * r;
+
+			// Adjust tangents of each vert of the triangle
+			unsigned int corners[3] = { i1, i2, i3 };
+			for (unsigned int corner : corners)
+			{
+				tangents[corner].x += tx;
+				tangents[corner].y += ty;
+				tangents[corner].z += tz;
+			}
+		}
+	}
+
+	// Add the tangent of triangles [begin, end) to their vertices, four at a time.
+	// - Each XMVECTOR lane holds one triangle (SoA), so the math for four
+	//   triangles is done by one set of vector instructions
+	// - Lanes are added to the vertices in triangle order, but the vector math
+	//   may round differently (e.g. fused multiply-adds), so the results match
+	//   the scalar version within float rounding rather than bit for bit
+	void AccumulateSIMD(const Vertex* verts, const unsigned int* indices, size_t begin, size_t end, XMFLOAT3* tangents)
+	{
+		const XMVECTOR minDeterminant = XMVectorReplicate(MIN_UV_DETERMINANT);
+		const XMVECTOR one = XMVectorSplatOne();
+
+		size_t triangle = begin;
+		for (; triangle + 4 <= end; triangle += 4)
+		{
+			// Gather the four triangles' positions and uvs into SoA lanes.
+			XMFLOAT4A p1x, p1y, p1z, p2x, p2y, p2z, p3x, p3y, p3z;
+			XMFLOAT4A u1, v1, u2, v2, u3, v3;
+			float* lanes[15] = { &p1x.x, &p1y.x, &p1z.x, &p2x.x, &p2y.x, &p2z.x, &p3x.x, &p3y.x, &p3z.x, &u1.x, &v1.x, &u2.x, &v2.x, &u3.x, &v3.x };
+			for (int lane = 0; lane < 4; lane++)
+			{
+				const Vertex& a = verts[indices[(triangle + lane) * 3]];
+				const Vertex& b = verts[indices[(triangle + lane) * 3 + 1]];
+				const Vertex& c = verts[indices[(triangle + lane) * 3 + 2]];
+
+				lanes[0][lane] = a.Position.x; lanes[1][lane] = a.Position.y; lanes[2][lane] = a.Position.z;
+				lanes[3][lane] = b.Position.x; lanes[4][lane] = b.Position.y; lanes[5][lane] = b.Position.z;
+				lanes[6][lane] = c.Position.x; lanes[7][lane] = c.Position.y; lanes[8][lane] = c.Position.z;
+				lanes[9][lane] = a.uv.x; lanes[10][lane] = a.uv.y;
+				lanes[11][lane] = b.uv.x; lanes[12][lane] = b.uv.y;
+				lanes[13][lane] = c.uv.x; lanes[14][lane] = c.uv.y;
+			}
+
+			// Position and uv edges.
+			XMVECTOR x1 = XMVectorSubtract(XMLoadFloat4A(&p2x), XMLoadFloat4A(&p1x));
+			XMVECTOR y1 = XMVectorSubtract(XMLoadFloat4A(&p2y), XMLoadFloat4A(&p1y));
+			XMVECTOR z1 = XMVectorSubtract(XMLoadFloat4A(&p2z), XMLoadFloat4A(&p1z));
+			XMVECTOR x2 = XMVectorSubtract(XMLoadFloat4A(&p3x), XMLoadFloat4A(&p1x));
+			XMVECTOR y2 = XMVectorSubtract(XMLoadFloat4A(&p3y), XMLoadFloat4A(&p1y));
+			XMVECTOR z2 = XMVectorSubtract(XMLoadFloat4A(&p3z), XMLoadFloat4A(&p1z));
+			XMVECTOR s1 = XMVectorSubtract(XMLoadFloat4A(&u2), XMLoadFloat4A(&u1));
+			XMVECTOR t1 = XMVectorSubtract(XMLoadFloat4A(&v2), XMLoadFloat4A(&v1));
+			XMVECTOR s2 = XMVectorSubtract(XMLoadFloat4A(&u3), XMLoadFloat4A(&u1));
+			XMVECTOR t2 = XMVectorSubtract(XMLoadFloat4A(&v3), XMLoadFloat4A(&v1));
+
+			// 1 / determinant, or 0 in lanes with degenerate uvs.
+			XMVECTOR determinant = XMVectorSubtract(XMVectorMultiply(s1, t2), XMVectorMultiply(s2, t1));
+			XMVECTOR valid = XMVectorGreaterOrEqual(XMVectorAbs(determinant), minDeterminant);
+			XMVECTOR r = XMVectorSelect(XMVectorZero(), XMVectorDivide(one, determinant), valid);
+
+			XMFLOAT4A tx, ty, tz;
+			XMStoreFloat4A(&tx, XMVectorMultiply(XMVectorSubtract(XMVectorMultiply(t2, x1), XMVectorMultiply(t1, x2)), r));
+			XMStoreFloat4A(&ty, XMVectorMultiply(XMVectorSubtract(XMVectorMultiply(t2, y1), XMVectorMultiply(t1, y2)), r));
+			XMStoreFloat4A(&tz, XMVectorMultiply(XMVectorSubtract(XMVectorMultiply(t2, z1), XMVectorMultiply(t1, z2)), r));
+
+			// Scatter each lane to its three vertices.
+			const float* outX = &tx.x;
+			const float* outY = &ty.x;
+			const float* outZ = &tz.x;
+			for (int lane = 0; lane < 4; lane++)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					XMFLOAT3& tangent = tangents[indices[(triangle + lane) * 3 + corner]];
+					tangent.x += outX[lane];
+					tangent.y += outY[lane];
+					tangent.z += outZ[lane];
+				}
+			}
+		}
+
+		// Leftover triangles.
+		AccumulateScalar(verts, indices, triangle, end, tangents);
+	}
+
+	// Make one vertex's summed tangent orthogonal to its normal.
+	void Orthogonalize(Vertex& vertex, const XMFLOAT3& summedTangent)
+	{
+		// Grab the two vectors
+		XMVECTOR normal = XMLoadFloat3(&vertex.normal);
+		XMVECTOR tangent = XMLoadFloat3(&summedTangent);
+
+		// Use Gram-Schmidt orthonormalize to ensure
+		// the normal and tangent are exactly 90 degrees apart
+		tangent = XMVector3Normalize(
+			tangent - normal * XMVector3Dot(normal, tangent));
+
+		// Store the tangent
+		XMStoreFloat3(&vertex.Tangent, tangent);
+
+		const XMFLOAT3& t = vertex.Tangent;
+		if (t.x == 0.0f && t.y == 0.0f && t.z == 0.0f)
+			vertex.Tangent = PerpendicularTo(vertex.normal);
+	}
+
+	// Make the summed tangents of vertices [begin, end) orthogonal to their normals, four at a time.
+	// - The summed tangent of each vertex is the sum of "partialCount" arrays
+	//   (one per thread that accumulated triangles)
+	void OrthogonalizeSIMD(Vertex* verts, size_t begin, size_t end, const XMFLOAT3* const* partials, size_t partialCount)
+	{
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			// Gather normals and summed tangents into SoA lanes.
+			XMFLOAT4A nx, ny, nz, tx, ty, tz;
+			for (int lane = 0; lane < 4; lane++)
+			{
+				const XMFLOAT3& normal = verts[i + lane].normal;
+				(&nx.x)[lane] = normal.x;
+				(&ny.x)[lane] = normal.y;
+				(&nz.x)[lane] = normal.z;
+
+				XMFLOAT3 sum = partials[0][i + lane];
+				for (size_t p = 1; p < partialCount; p++)
+				{
+					sum.x += partials[p][i + lane].x;
+					sum.y += partials[p][i + lane].y;
+					sum.z += partials[p][i + lane].z;
+				}
+				(&tx.x)[lane] = sum.x;
+				(&ty.x)[lane] = sum.y;
+				(&tz.x)[lane] = sum.z;
+			}
+
+			XMVECTOR vnx = XMLoadFloat4A(&nx);
+			XMVECTOR vny = XMLoadFloat4A(&ny);
+			XMVECTOR vnz = XMLoadFloat4A(&nz);
+			XMVECTOR vtx = XMLoadFloat4A(&tx);
+			XMVECTOR vty = XMLoadFloat4A(&ty);
+			XMVECTOR vtz = XMLoadFloat4A(&tz);
+
+			// Gram-Schmidt: remove the part of the tangent along the normal.
+			XMVECTOR dot = XMVectorAdd(XMVectorAdd(XMVectorMultiply(vnx, vtx), XMVectorMultiply(vny, vty)), XMVectorMultiply(vnz, vtz));
+			vtx = XMVectorSubtract(vtx, XMVectorMultiply(vnx, dot));
+			vty = XMVectorSubtract(vty, XMVectorMultiply(vny, dot));
+			vtz = XMVectorSubtract(vtz, XMVectorMultiply(vnz, dot));
+
+			// Normalize, leaving zero length tangents at zero.
+			XMVECTOR lengthSq = XMVectorAdd(XMVectorAdd(XMVectorMultiply(vtx, vtx), XMVectorMultiply(vty, vty)), XMVectorMultiply(vtz, vtz));
+			XMVECTOR length = XMVectorSqrt(lengthSq);
+			XMVECTOR nonZero = XMVectorGreater(lengthSq, XMVectorZero());
+			XMStoreFloat4A(&tx, XMVectorSelect(XMVectorZero(), XMVectorDivide(vtx, length), nonZero));
+			XMStoreFloat4A(&ty, XMVectorSelect(XMVectorZero(), XMVectorDivide(vty, length), nonZero));
+			XMStoreFloat4A(&tz, XMVectorSelect(XMVectorZero(), XMVectorDivide(vtz, length), nonZero));
+
+			for (int lane = 0; lane < 4; lane++)
+			{
+				XMFLOAT3 t((&tx.x)[lane], (&ty.x)[lane], (&tz.x)[lane]);
+				if (t.x == 0.0f && t.y == 0.0f && t.z == 0.0f)
+					t = PerpendicularTo(verts[i + lane].normal);
+				verts[i + lane].Tangent = t;
+			}
+		}
+
+		// Leftover vertices.
+		for (; i < end; i++)
+		{
+			XMFLOAT3 sum = partials[0][i];
+			for (size_t p = 1; p < partialCount; p++)
+			{
+				sum.x += partials[p][i].x;
+				sum.y += partials[p][i].y;
+				sum.z += partials[p][i].z;
+			}
+			Orthogonalize(verts[i], sum);
+		}
+	}
+}
+
+void TangentGenerator::CalculateTangentsScalar(Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount)
+{
+	std::vector<XMFLOAT3> tangents(vertexCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	AccumulateScalar(vertices, indices, 0, indexCount / 3, tangents.data());
+
+	for (size_t i = 0; i < vertexCount; i++)
+		Orthogonalize(vertices[i], tangents[i]);
+}
+
+void TangentGenerator::CalculateTangentsSIMD(Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount)
+{
+	std::vector<XMFLOAT3> tangents(vertexCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	AccumulateSIMD(vertices, indices, 0, indexCount / 3, tangents.data());
+
+	const XMFLOAT3* partials[1] = { tangents.data() };
+	OrthogonalizeSIMD(vertices, 0, vertexCount, partials, 1);
+}
+
+void TangentGenerator::CalculateTangentsParallel(Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, unsigned int threadCount)
+{
+	size_t triangleCount = indexCount / 3;
+	size_t jobCount = Parallel::GetJobCount(triangleCount, MIN_TRIANGLES_PER_THREAD, threadCount);
+	if (jobCount == 1)
+	{
+		CalculateTangentsSIMD(vertices, vertexCount, indices, indexCount);
+		return;
+	}
+
+	// Each job adds its range of triangles into its own array, so no two
+	// threads ever write the same vertex.
+	std::vector<std::vector<XMFLOAT3>> partialTangents(jobCount);
+	Parallel::ForRanges(triangleCount, jobCount, [&](size_t begin, size_t end, size_t job)
+		{
+			partialTangents[job].assign(vertexCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+			AccumulateSIMD(vertices, indices, begin, end, partialTangents[job].data());
+		});
+
+	// Sum the arrays and orthogonalize, split by vertex range.
+	std::vector<const XMFLOAT3*> partials(jobCount);
+	for (size_t i = 0; i < jobCount; i++)
+		partials[i] = partialTangents[i].data();
+
+	Parallel::ForRanges(vertexCount, jobCount, [&](size_t begin, size_t end, size_t)
+		{
+			OrthogonalizeSIMD(vertices, begin, end, partials.data(), jobCount);
+		});
+}
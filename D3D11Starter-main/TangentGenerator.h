@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Platform-neutral per-vertex tangent generation
+//
+// - Each triangle's tangent (from its position and uv edges)
+//   is added to its three vertices, then every tangent is
+//   made orthogonal to its normal (Gram-Schmidt) and normalized
+// - Triangles with degenerate UVs (a zero uv determinant) add
+//   nothing instead of dividing by zero
+// - Vertices left without a tangent get an arbitrary unit
+//   vector perpendicular to their normal
+// --------------------------------------------------------
+namespace TangentGenerator
+{
+	// Reference version: one triangle at a time with scalar float math.
+	void CalculateTangentsScalar(Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+
+	// SIMD version: four triangles per iteration in SoA form, and four
+	// vertices per iteration for the orthogonalize pass.
+	void CalculateTangentsSIMD(Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+
+	// Multithreaded SIMD version: each thread adds its triangles into its own
+	// tangent array, then the arrays are summed and orthogonalized in parallel.
+	// - threadCount of 0 uses one thread per hardware core
+	// - Small meshes run on a single thread
+	void CalculateTangentsParallel(Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, unsigned int threadCount = 0);
+}
@@ -1,9 +1,28 @@
 #pragma once
 #include <DirectXMath.h>
+
+// --------------------------------------------------------
+// A handle onto one slot of the global TransformSystem.
+//
+// - The components and matrices live in the system, so
+//   this only stores the slot index
+// - Copying a Transform creates a new slot with the same
+//   components and parent, so copies move independently;
+//   moving one hands its slot (and children) over
+// - Position, rotation and scale are relative to the parent;
+//   the world matrix includes every ancestor
+// - The rotation is a quaternion; pitch/yaw/roll is kept as
+//   an editing view, and the up/forward/right axes are
+//   cached until the rotation changes
+// --------------------------------------------------------
 class Transform
 {
 public:
 	Transform();
+	Transform(const Transform& other);
+	Transform(Transform&& other) noexcept;
+	Transform& operator=(const Transform& other);
+	Transform& operator=(Transform&& other) noexcept;
 	~Transform();
 
 	// Create Setters: Replace former raw transform data with new data information.
@@ -13,11 +32,14 @@ public:
 	void SetRotation(DirectX::XMFLOAT3 rotationInput);
 	void SetPosition(float x, float y, float z);
 	void SetPosition(DirectX::XMFLOAT3 translate);
+	void SetOrientation(DirectX::XMFLOAT4 quaternion);
 
 	// Create Getter: Get data information.
 	DirectX::XMFLOAT3 GetScale();
 	DirectX::XMFLOAT3 GetPitchYawRoll();
 	DirectX::XMFLOAT3 GetPosition();
+	DirectX::XMFLOAT4 GetOrientation();
+	DirectX::XMFLOAT4X4 GetLocalMatrix();
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetInverseTransposeMatrix();
 
@@ -36,13 +58,14 @@ public:
 	DirectX::XMFLOAT3 GetForward();
 	DirectX::XMFLOAT3 GetRight();
 
+	// Attach to a parent (or detach with nullptr), keeping the local values.
+	// The parent must outlive the link or be detached first; destroying it
+	// moves this transform back to the top of the hierarchy.
+	void SetParent(Transform* parent);
+
+	// The slot this transform uses in TransformSystem::Global().
+	unsigned int GetId() const;
+
 private:
-	DirectX::XMFLOAT3 scale;
-	DirectX::XMFLOAT3 rotation;
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
-	bool matrixUpdate;
-	bool setUpITMatrix;
+	unsigned int id;
 };
-
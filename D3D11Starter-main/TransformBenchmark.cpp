@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Transform.h"
+#include "TransformSystem.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless transform update benchmark
+//
+// - Times rebuilding 10k, 100k and 1M transforms the way
+//   Transform used to (one XMMatrix product and a general
+//   4x4 inverse per transform) against TransformSystem's
+//   batch update on one thread, on every thread, and with
+//   only a tenth of the transforms dirty
+// - Times full and partial updates of wide (one parent with
+//   many children) and deep (long parent chains) hierarchies
+// - Times the transform calls of one Camera::Update frame
+//   (moving, optionally turning, then rebuilding the view)
+//   with Euler angles converted on every call, as Transform
+//   used to, against the cached quaternion and axes
+// - Checks the batch results against the per-transform ones
+//   and returns 1 if any matrix differs
+// - Checks copying a transform (also onto a moved-from one)
+//   keeps its orientation exactly, even at 90 degrees of pitch,
+//   and that many small Rotate calls add up to one large one
+// --------------------------------------------------------
+
+// Annonymous namespace to hold the benchmark helpers
+// only accessible in this file
+namespace
+{
+	// Components of one transform, as Transform used to store them.
+	struct TransformComponents
+	{
+		XMFLOAT3 position;
+		XMFLOAT3 rotation;
+		XMFLOAT3 scale;
+	};
+
+	// Milliseconds since the given start time.
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Largest difference between two matrices relative to the larger element.
+	float MatrixDifference(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+	{
+		float difference = 0.0f;
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				float x = a.m[row][column];
+				float y = b.m[row][column];
+				float size = std::max(1.0f, std::max(std::fabs(x), std::fabs(y)));
+				difference = std::max(difference, std::fabs(x - y) / size);
+			}
+		}
+		return difference;
+	}
+
+	// Time one transform count and return the number of failed checks.
+	int RunBenchmark(size_t count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> positions(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> angles(-3.14159f, 3.14159f);
+		std::uniform_real_distribution<float> scales(0.25f, 4.0f);
+
+		std::vector<TransformComponents> components(count);
+		for (TransformComponents& c : components)
+		{
+			c.position = XMFLOAT3(positions(random), positions(random), positions(random));
+			c.rotation = XMFLOAT3(angles(random), angles(random), angles(random));
+			c.scale = XMFLOAT3(scales(random), scales(random), scales(random));
+		}
+
+		// The old path: build and invert every matrix on its own.
+		std::vector<XMFLOAT4X4> worlds(count);
+		std::vector<XMFLOAT4X4> inverseTransposes(count);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < count; i++)
+		{
+			const TransformComponents& c = components[i];
+			XMMATRIX world = XMMatrixScaling(c.scale.x, c.scale.y, c.scale.z) *
+				XMMatrixRotationRollPitchYaw(c.rotation.x, c.rotation.y, c.rotation.z) *
+				XMMatrixTranslation(c.position.x, c.position.y, c.position.z);
+			XMStoreFloat4x4(&worlds[i], world);
+			XMStoreFloat4x4(&inverseTransposes[i], XMMatrixInverse(0, XMMatrixTranspose(world)));
+		}
+		float perTransformMilliseconds = MillisecondsSince(start);
+
+		TransformSystem system;
+		system.Reserve(count);
+		std::vector<unsigned int> ids(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			ids[i] = system.Create();
+			system.SetPosition(ids[i], components[i].position);
+			system.SetPitchYawRoll(ids[i], components[i].rotation);
+			system.SetScale(ids[i], components[i].scale);
+		}
+
+		start = std::chrono::high_resolution_clock::now();
+		system.UpdateDirty(1);
+		float singleThreadMilliseconds = MillisecondsSince(start);
+
+		// Compare before anything else touches the matrices.
+		float worstDifference = 0.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			worstDifference = std::max(worstDifference, MatrixDifference(system.GetWorldMatrix(ids[i]), worlds[i]));
+			worstDifference = std::max(worstDifference, MatrixDifference(system.GetWorldInverseTransposeMatrix(ids[i]), inverseTransposes[i]));
+		}
+
+		for (size_t i = 0; i < count; i++)
+			system.SetPosition(ids[i], components[i].position);
+		start = std::chrono::high_resolution_clock::now();
+		system.UpdateDirty();
+		float allThreadsMilliseconds = MillisecondsSince(start);
+
+		for (size_t i = 0; i < count; i += 10)
+			system.SetPosition(ids[i], components[i].position);
+		start = std::chrono::high_resolution_clock::now();
+		system.UpdateDirty();
+		float tenthDirtyMilliseconds = MillisecondsSince(start);
+
+		bool passed = worstDifference < 1e-3f && system.GetDirtyCount() == 0;
+		std::printf("%10zu %14.3f %14.3f %14.3f %14.3f %12.2e%s\n", count, perTransformMilliseconds,
+			singleThreadMilliseconds, allThreadsMilliseconds, tenthDirtyMilliseconds, worstDifference,
+			passed ? "" : "  FAILED");
+		return passed ? 0 : 1;
+	}
+
+	// The camera side of the old Transform: Euler angles, converted to a
+	// quaternion on every axis or relative move call.
+	struct EulerTransform
+	{
+		XMFLOAT3 position = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		XMFLOAT3 rotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+		XMFLOAT3 Rotated(float x, float y, float z)
+		{
+			XMFLOAT3 rotated;
+			XMStoreFloat3(&rotated, XMVector3Rotate(XMVectorSet(x, y, z, 0.0f),
+				XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z)));
+			return rotated;
+		}
+
+		XMFLOAT3 GetPosition() { return position; }
+		XMFLOAT3 GetPitchYawRoll() { return rotation; }
+		XMFLOAT3 GetForward() { return Rotated(0.0f, 0.0f, 1.0f); }
+		XMFLOAT3 GetRight() { return Rotated(1.0f, 0.0f, 0.0f); }
+		XMFLOAT3 GetUp() { return Rotated(0.0f, 1.0f, 0.0f); }
+		void SetRotation(float x, float y, float z) { rotation = XMFLOAT3(x, y, z); }
+		void MoveRelative(XMFLOAT3 offset)
+		{
+			XMFLOAT3 rotated = Rotated(offset.x, offset.y, offset.z);
+			position = XMFLOAT3(position.x + rotated.x, position.y + rotated.y, position.z + rotated.z);
+		}
+	};
+
+	// Run the transform calls Camera::Update makes with W and D held (and the
+	// mouse moving, when "turning") for "frames" frames, and return the
+	// average nanoseconds per frame.
+	template<typename TransformType>
+	float TimeCameraFrames(TransformType& transform, int frames, bool turning, float& sink)
+	{
+		const float step = 0.01f;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			XMFLOAT3 forward = transform.GetForward();
+			transform.MoveRelative(XMFLOAT3(forward.x * step, forward.y * step, forward.z * step));
+			XMFLOAT3 right = transform.GetRight();
+			transform.MoveRelative(XMFLOAT3(right.x * step, right.y * step, right.z * step));
+
+			if (turning)
+			{
+				XMFLOAT3 rotation = transform.GetPitchYawRoll();
+				transform.SetRotation(rotation.x - 0.0001f, rotation.y + 0.0001f, 0.0f);
+			}
+
+			// Camera::UpdateViewMatrix
+			XMFLOAT3 position = transform.GetPosition();
+			XMFLOAT3 viewForward = transform.GetForward();
+			XMFLOAT3 up = transform.GetUp();
+			XMFLOAT4X4 view;
+			XMStoreFloat4x4(&view, XMMatrixLookToLH(XMLoadFloat3(&position), XMLoadFloat3(&viewForward), XMLoadFloat3(&up)));
+			sink += view._41;
+		}
+		return MillisecondsSince(start) * 1e6f / frames;
+	}
+
+	// Time the camera frames both ways and return 1 if the two cameras end up apart.
+	int RunCameraBenchmark()
+	{
+		const int frames = 1000000;
+		float sink = 0.0f;
+		int failures = 0;
+		for (bool turning : { false, true })
+		{
+			EulerTransform before;
+			before.SetRotation(0.2f, 0.5f, 0.0f);
+			Transform after;
+			after.SetRotation(0.2f, 0.5f, 0.0f);
+
+			float beforeNanoseconds = TimeCameraFrames(before, frames, turning, sink);
+			float afterNanoseconds = TimeCameraFrames(after, frames, turning, sink);
+
+			XMFLOAT3 a = before.GetPosition();
+			XMFLOAT3 b = after.GetPosition();
+			float distance = std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+			bool passed = distance < 1e-2f * std::max(1.0f, std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z));
+			std::printf("%-28s %12.1f %12.1f %12.2e%s\n", turning ? "moving and turning" : "moving", beforeNanoseconds,
+				afterNanoseconds, distance, passed ? "" : "  FAILED");
+			failures += passed ? 0 : 1;
+		}
+
+		// Keep the work from being optimized away.
+		if (sink == 12345.0f)
+			std::printf(" ");
+		return failures;
+	}
+
+	// Largest component difference between two orientations, treating q and -q as equal.
+	float OrientationDifference(const XMFLOAT4& a, const XMFLOAT4& b)
+	{
+		float same = std::max(std::max(std::fabs(a.x - b.x), std::fabs(a.y - b.y)), std::max(std::fabs(a.z - b.z), std::fabs(a.w - b.w)));
+		float opposite = std::max(std::max(std::fabs(a.x + b.x), std::fabs(a.y + b.y)), std::max(std::fabs(a.z + b.z), std::fabs(a.w + b.w)));
+		return std::min(same, opposite);
+	}
+
+	// Check Transform copies and Rotate, returning the number of failed checks.
+	int CheckTransformCopies()
+	{
+		int failures = 0;
+
+		// Straight up, where converting through the angles loses the yaw and roll.
+		Transform source;
+		source.SetOrientation(XMFLOAT4(0.5f, 0.5f, -0.5f, 0.5f));
+		source.SetPosition(1.0f, 2.0f, 3.0f);
+
+		Transform copy;
+		copy = source;
+		Transform movedFrom;
+		Transform taken(std::move(movedFrom));
+		movedFrom = source;
+
+		float copyDifference = std::max(
+			OrientationDifference(copy.GetOrientation(), source.GetOrientation()),
+			OrientationDifference(movedFrom.GetOrientation(), source.GetOrientation()));
+		bool copied = copyDifference < 1e-6f && movedFrom.GetPosition().z == 3.0f;
+		std::printf("%-28s %12.2e%s\n", "copy at 90 degrees pitch", copyDifference, copied ? "" : "  FAILED");
+		failures += copied ? 0 : 1;
+
+		// A thousand small yaw turns against the same turn made at once.
+		Transform turned;
+		turned.SetRotation(0.3f, 0.2f, 0.1f);
+		XMFLOAT4 expectedOrientation = turned.GetOrientation();
+		for (int i = 0; i < 1000; i++)
+			turned.Rotate(0.0f, 0.001f, 0.0f);
+		XMStoreFloat4(&expectedOrientation, XMQuaternionMultiply(
+			XMLoadFloat4(&expectedOrientation), XMQuaternionRotationRollPitchYaw(0.0f, 1.0f, 0.0f)));
+
+		float rotateDifference = OrientationDifference(turned.GetOrientation(), expectedOrientation);
+		bool rotated = rotateDifference < 1e-4f;
+		std::printf("%-28s %12.2e%s\n", "1000 small yaw turns", rotateDifference, rotated ? "" : "  FAILED");
+		failures += rotated ? 0 : 1;
+		return failures;
+	}
+
+	// Time a hierarchy of "rootCount" roots, each with "childrenPerNode"
+	// children per node down to "depth" levels, and return the number of
+	// failed checks.
+	// - Times the first full update, moving one root (its whole subtree is
+	//   rebuilt) and moving one leaf (nothing else is rebuilt)
+	// - Checks sampled world matrices against the product of their chain
+	int RunHierarchyBenchmark(const char* name, size_t rootCount, size_t childrenPerNode, size_t depth, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> offsets(-2.0f, 2.0f);
+		std::uniform_real_distribution<float> angles(-0.5f, 0.5f);
+
+		TransformSystem system;
+		std::vector<unsigned int> ids;
+		std::vector<unsigned int> level;
+		for (size_t r = 0; r < rootCount; r++)
+		{
+			level.assign(1, system.Create());
+			ids.push_back(level[0]);
+			for (size_t d = 1; d < depth; d++)
+			{
+				std::vector<unsigned int> next;
+				for (unsigned int parent : level)
+				{
+					for (size_t c = 0; c < childrenPerNode; c++)
+					{
+						unsigned int id = system.Create();
+						system.SetParent(id, parent);
+						next.push_back(id);
+						ids.push_back(id);
+					}
+				}
+				level.swap(next);
+			}
+		}
+
+		for (unsigned int id : ids)
+		{
+			system.SetPosition(id, XMFLOAT3(offsets(random), offsets(random), offsets(random)));
+			system.SetPitchYawRoll(id, XMFLOAT3(angles(random), angles(random), angles(random)));
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		system.UpdateDirty();
+		float fullMilliseconds = MillisecondsSince(start);
+
+		system.SetPosition(ids[0], XMFLOAT3(1.0f, 2.0f, 3.0f));
+		start = std::chrono::high_resolution_clock::now();
+		system.UpdateDirty();
+		float rootMilliseconds = MillisecondsSince(start);
+
+		system.SetPosition(ids.back(), XMFLOAT3(1.0f, 2.0f, 3.0f));
+		start = std::chrono::high_resolution_clock::now();
+		system.UpdateDirty();
+		float leafMilliseconds = MillisecondsSince(start);
+
+		// Compare against the product of each sampled slot's local matrices up its chain.
+		float worstDifference = 0.0f;
+		size_t step = std::max<size_t>(1, ids.size() / 1000);
+		for (size_t i = 0; i < ids.size(); i += step)
+		{
+			XMMATRIX world = XMMatrixIdentity();
+			XMMATRIX inverseTranspose = XMMatrixIdentity();
+			for (unsigned int id = ids[i]; id != TransformSystem::NO_PARENT; id = system.GetParent(id))
+			{
+				XMFLOAT3 p = system.GetPosition(id);
+				XMFLOAT3 r = system.GetPitchYawRoll(id);
+				XMFLOAT3 s = system.GetScale(id);
+				XMMATRIX local = XMMatrixScaling(s.x, s.y, s.z) * XMMatrixRotationRollPitchYaw(r.x, r.y, r.z) * XMMatrixTranslation(p.x, p.y, p.z);
+				world = world * local;
+			}
+			inverseTranspose = XMMatrixInverse(0, XMMatrixTranspose(world));
+
+			XMFLOAT4X4 expectedWorld, expectedInverseTranspose;
+			XMStoreFloat4x4(&expectedWorld, world);
+			XMStoreFloat4x4(&expectedInverseTranspose, inverseTranspose);
+			worstDifference = std::max(worstDifference, MatrixDifference(system.GetWorldMatrix(ids[i]), expectedWorld));
+			worstDifference = std::max(worstDifference, MatrixDifference(system.GetWorldInverseTransposeMatrix(ids[i]), expectedInverseTranspose));
+		}
+
+		bool passed = worstDifference < 1e-3f;
+		std::printf("%-28s %10zu %12.3f %12.3f %12.4f %12.2e%s\n", name, ids.size(), fullMilliseconds,
+			rootMilliseconds, leafMilliseconds, worstDifference, passed ? "" : "  FAILED");
+		return passed ? 0 : 1;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(12345);
+
+	std::printf("%10s %14s %14s %14s %14s %12s\n", "Transforms", "Per-item ms", "Batch 1T ms", "Batch all ms", "10% dirty ms", "Max diff");
+	int failures = 0;
+	for (size_t count : { (size_t)10000, (size_t)100000, (size_t)1000000 })
+		failures += RunBenchmark(count, random);
+
+	std::printf("\n%-28s %10s %12s %12s %12s %12s\n", "Hierarchy", "Transforms", "Full ms", "Root ms", "Leaf ms", "Max diff");
+	failures += RunHierarchyBenchmark("wide (1 x 100k children)", 1, 99999, 2, random);
+	failures += RunHierarchyBenchmark("wide (1k x 100 children)", 1000, 99, 2, random);
+	failures += RunHierarchyBenchmark("deep (400 chains of 250)", 400, 1, 250, random);
+	failures += RunHierarchyBenchmark("tree (8 children, 6 levels)", 1, 8, 6, random);
+
+	std::printf("\n%-28s %12s %12s %12s\n", "Camera frame", "Euler ns", "Cached ns", "Drift");
+	failures += RunCameraBenchmark();
+
+	std::printf("\n%-28s %12s\n", "Transform copies", "Max diff");
+	failures += CheckTransformCopies();
+
+	return failures > 0 ? 1 : 0;
+}
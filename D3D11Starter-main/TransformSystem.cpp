@@ -0,0 +1,641 @@
+#include "TransformSystem.h"
+
+#include "Parallel.h"
+
+#include <cmath>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the bit and lane helpers
+// only accessible in this file
+namespace
+{
+	// Slots per dirty word.
+	const unsigned int BITS_PER_WORD = 64;
+
+	// Dirty words per thread when splitting a large update (16k slots).
+	const size_t MIN_WORDS_PER_JOB = 256;
+
+	// Dirty subtrees per thread when splitting the world matrix pass.
+	const size_t MIN_ROOTS_PER_JOB = 16384;
+
+	// Index of the lowest set bit of a non-zero word.
+	unsigned int LowestBit(uint64_t word)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, word);
+		return (unsigned int)index;
+#else
+		return (unsigned int)__builtin_ctzll(word);
+#endif
+	}
+
+	bool TestBit(const std::vector<uint64_t>& bits, unsigned int id)
+	{
+		return (bits[id / BITS_PER_WORD] >> (id % BITS_PER_WORD)) & 1;
+	}
+
+	void SetBit(std::vector<uint64_t>& bits, unsigned int id)
+	{
+		bits[id / BITS_PER_WORD] |= 1ull << (id % BITS_PER_WORD);
+	}
+
+	void ClearBit(std::vector<uint64_t>& bits, unsigned int id)
+	{
+		bits[id / BITS_PER_WORD] &= ~(1ull << (id % BITS_PER_WORD));
+	}
+
+	// One lane of a stored vector.
+	float Lane(const XMFLOAT4A& v, unsigned int lane)
+	{
+		return (&v.x)[lane];
+	}
+}
+
+TransformSystem::TransformSystem() :
+	hierarchyChanged(false)
+{
+}
+
+TransformSystem& TransformSystem::Global()
+{
+	static TransformSystem system;
+	return system;
+}
+
+unsigned int TransformSystem::Create()
+{
+	unsigned int id;
+	if (!freeSlots.empty())
+	{
+		id = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		id = (unsigned int)positionX.size();
+		positionX.push_back(0.0f);
+		positionY.push_back(0.0f);
+		positionZ.push_back(0.0f);
+		orientationX.push_back(0.0f);
+		orientationY.push_back(0.0f);
+		orientationZ.push_back(0.0f);
+		orientationW.push_back(1.0f);
+		scaleX.push_back(1.0f);
+		scaleY.push_back(1.0f);
+		scaleZ.push_back(1.0f);
+		localMatrices.emplace_back();
+		localInverseTransposeMatrices.emplace_back();
+		worldMatrices.emplace_back();
+		worldInverseTransposeMatrices.emplace_back();
+		parents.push_back(NO_PARENT);
+		firstChildren.push_back(NO_PARENT);
+		nextSiblings.push_back(NO_PARENT);
+		previousSiblings.push_back(NO_PARENT);
+		pitchYawRolls.emplace_back();
+		rights.emplace_back();
+		ups.emplace_back();
+		forwards.emplace_back();
+		flatIndices.push_back(0);
+		if (dirtyBits.size() * BITS_PER_WORD < positionX.size())
+		{
+			dirtyBits.push_back(0);
+			liveBits.push_back(0);
+			pitchYawRollStaleBits.push_back(0);
+			basisStaleBits.push_back(0);
+		}
+	}
+
+	// Reset the slot to an identity root.
+	positionX[id] = positionY[id] = positionZ[id] = 0.0f;
+	orientationX[id] = orientationY[id] = orientationZ[id] = 0.0f;
+	orientationW[id] = 1.0f;
+	scaleX[id] = scaleY[id] = scaleZ[id] = 1.0f;
+	pitchYawRolls[id] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	rights[id] = XMFLOAT3(1.0f, 0.0f, 0.0f);
+	ups[id] = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	forwards[id] = XMFLOAT3(0.0f, 0.0f, 1.0f);
+	ClearBit(pitchYawRollStaleBits, id);
+	ClearBit(basisStaleBits, id);
+	XMStoreFloat4x4(&localMatrices[id], XMMatrixIdentity());
+	localInverseTransposeMatrices[id] = localMatrices[id];
+	worldMatrices[id] = localMatrices[id];
+	worldInverseTransposeMatrices[id] = localMatrices[id];
+	parents[id] = firstChildren[id] = nextSiblings[id] = previousSiblings[id] = NO_PARENT;
+	ClearBit(dirtyBits, id);
+	SetBit(liveBits, id);
+	hierarchyChanged = true;
+	return id;
+}
+
+unsigned int TransformSystem::Clone(unsigned int id)
+{
+	unsigned int copy = Create();
+	positionX[copy] = positionX[id];
+	positionY[copy] = positionY[id];
+	positionZ[copy] = positionZ[id];
+	orientationX[copy] = orientationX[id];
+	orientationY[copy] = orientationY[id];
+	orientationZ[copy] = orientationZ[id];
+	orientationW[copy] = orientationW[id];
+	scaleX[copy] = scaleX[id];
+	scaleY[copy] = scaleY[id];
+	scaleZ[copy] = scaleZ[id];
+	pitchYawRolls[copy] = GetPitchYawRoll(id);
+	SetBit(basisStaleBits, copy);
+	SetParent(copy, parents[id]);
+	MarkDirty(copy);
+	return copy;
+}
+
+void TransformSystem::Destroy(unsigned int id)
+{
+	// Move the children to the top of the hierarchy.
+	while (firstChildren[id] != NO_PARENT)
+		SetParent(firstChildren[id], NO_PARENT);
+
+	Unlink(id);
+	ClearBit(dirtyBits, id);
+	ClearBit(liveBits, id);
+	freeSlots.push_back(id);
+	hierarchyChanged = true;
+}
+
+void TransformSystem::Reserve(size_t count)
+{
+	positionX.reserve(count);
+	positionY.reserve(count);
+	positionZ.reserve(count);
+	orientationX.reserve(count);
+	orientationY.reserve(count);
+	orientationZ.reserve(count);
+	orientationW.reserve(count);
+	scaleX.reserve(count);
+	scaleY.reserve(count);
+	scaleZ.reserve(count);
+	pitchYawRolls.reserve(count);
+	rights.reserve(count);
+	ups.reserve(count);
+	forwards.reserve(count);
+	localMatrices.reserve(count);
+	localInverseTransposeMatrices.reserve(count);
+	worldMatrices.reserve(count);
+	worldInverseTransposeMatrices.reserve(count);
+	parents.reserve(count);
+	firstChildren.reserve(count);
+	nextSiblings.reserve(count);
+	previousSiblings.reserve(count);
+	flatIndices.reserve(count);
+	size_t wordCount = (count + BITS_PER_WORD - 1) / BITS_PER_WORD;
+	dirtyBits.reserve(wordCount);
+	liveBits.reserve(wordCount);
+	pitchYawRollStaleBits.reserve(wordCount);
+	basisStaleBits.reserve(wordCount);
+}
+
+size_t TransformSystem::GetCount() const
+{
+	return positionX.size() - freeSlots.size();
+}
+
+size_t TransformSystem::GetDirtyCount() const
+{
+	size_t count = 0;
+	for (uint64_t word : dirtyBits)
+	{
+		for (; word != 0; word &= word - 1)
+			count++;
+	}
+	return count;
+}
+
+XMFLOAT3 TransformSystem::GetPosition(unsigned int id) const
+{
+	return XMFLOAT3(positionX[id], positionY[id], positionZ[id]);
+}
+
+XMFLOAT4 TransformSystem::GetOrientation(unsigned int id) const
+{
+	return XMFLOAT4(orientationX[id], orientationY[id], orientationZ[id], orientationW[id]);
+}
+
+XMFLOAT3 TransformSystem::GetPitchYawRoll(unsigned int id)
+{
+	if (TestBit(pitchYawRollStaleBits, id))
+	{
+		// Recover the angles from the rotation matrix elements, which for
+		// roll, then pitch, then yaw are:
+		// _32 = -sin(pitch), _31 / _33 = tan(yaw), _12 / _22 = tan(roll)
+		float x = orientationX[id], y = orientationY[id], z = orientationZ[id], w = orientationW[id];
+		float m12 = 2.0f * (x * y + z * w);
+		float m22 = 1.0f - 2.0f * (x * x + z * z);
+		float m31 = 2.0f * (x * z + y * w);
+		float m32 = 2.0f * (y * z - x * w);
+		float m33 = 1.0f - 2.0f * (x * x + y * y);
+
+		XMFLOAT3& angles = pitchYawRolls[id];
+		if (std::fabs(m32) < 0.99999f)
+		{
+			angles.x = std::asin(-m32);
+			angles.y = std::atan2(m31, m33);
+			angles.z = std::atan2(m12, m22);
+		}
+		else
+		{
+			// Looking straight up or down: only yaw - roll is defined, so keep roll at 0.
+			float m11 = 1.0f - 2.0f * (y * y + z * z);
+			float m13 = 2.0f * (x * z - y * w);
+			angles.x = m32 < 0.0f ? XM_PIDIV2 : -XM_PIDIV2;
+			angles.y = std::atan2(-m13, m11);
+			angles.z = 0.0f;
+		}
+		ClearBit(pitchYawRollStaleBits, id);
+	}
+	return pitchYawRolls[id];
+}
+
+XMFLOAT3 TransformSystem::GetScale(unsigned int id) const
+{
+	return XMFLOAT3(scaleX[id], scaleY[id], scaleZ[id]);
+}
+
+void TransformSystem::SetPosition(unsigned int id, const XMFLOAT3& position)
+{
+	positionX[id] = position.x;
+	positionY[id] = position.y;
+	positionZ[id] = position.z;
+	MarkDirty(id);
+}
+
+void TransformSystem::SetOrientation(unsigned int id, const XMFLOAT4& orientation)
+{
+	XMFLOAT4 normalized;
+	XMStoreFloat4(&normalized, XMQuaternionNormalize(XMLoadFloat4(&orientation)));
+	orientationX[id] = normalized.x;
+	orientationY[id] = normalized.y;
+	orientationZ[id] = normalized.z;
+	orientationW[id] = normalized.w;
+	SetBit(pitchYawRollStaleBits, id);
+	SetBit(basisStaleBits, id);
+	MarkDirty(id);
+}
+
+void TransformSystem::SetPitchYawRoll(unsigned int id, const XMFLOAT3& rotation)
+{
+	// Keep the angles as given, so editing them never snaps to another
+	// set of angles for the same orientation.
+	XMFLOAT4 orientation;
+	XMStoreFloat4(&orientation, XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z));
+	orientationX[id] = orientation.x;
+	orientationY[id] = orientation.y;
+	orientationZ[id] = orientation.z;
+	orientationW[id] = orientation.w;
+	pitchYawRolls[id] = rotation;
+	ClearBit(pitchYawRollStaleBits, id);
+	SetBit(basisStaleBits, id);
+	MarkDirty(id);
+}
+
+void TransformSystem::SetScale(unsigned int id, const XMFLOAT3& scale)
+{
+	scaleX[id] = scale.x;
+	scaleY[id] = scale.y;
+	scaleZ[id] = scale.z;
+	MarkDirty(id);
+}
+
+const XMFLOAT3& TransformSystem::GetRight(unsigned int id)
+{
+	if (TestBit(basisStaleBits, id))
+		UpdateBasis(id);
+	return rights[id];
+}
+
+const XMFLOAT3& TransformSystem::GetUp(unsigned int id)
+{
+	if (TestBit(basisStaleBits, id))
+		UpdateBasis(id);
+	return ups[id];
+}
+
+const XMFLOAT3& TransformSystem::GetForward(unsigned int id)
+{
+	if (TestBit(basisStaleBits, id))
+		UpdateBasis(id);
+	return forwards[id];
+}
+
+unsigned int TransformSystem::GetParent(unsigned int id) const
+{
+	return parents[id];
+}
+
+void TransformSystem::SetParent(unsigned int id, unsigned int parent)
+{
+	if (parents[id] == parent)
+		return;
+
+	// Refuse to make a cycle.
+	for (unsigned int ancestor = parent; ancestor != NO_PARENT; ancestor = parents[ancestor])
+	{
+		if (ancestor == id)
+			return;
+	}
+
+	Unlink(id);
+	parents[id] = parent;
+	if (parent != NO_PARENT)
+	{
+		nextSiblings[id] = firstChildren[parent];
+		if (firstChildren[parent] != NO_PARENT)
+			previousSiblings[firstChildren[parent]] = id;
+		firstChildren[parent] = id;
+	}
+
+	MarkDirty(id);
+	hierarchyChanged = true;
+}
+
+const XMFLOAT4X4& TransformSystem::GetLocalMatrix(unsigned int id)
+{
+	if (IsDirty(id))
+		UpdateDirty(1);
+	return localMatrices[id];
+}
+
+const XMFLOAT4X4& TransformSystem::GetWorldMatrix(unsigned int id)
+{
+	if (NeedsUpdate(id))
+		UpdateDirty(1);
+	return worldMatrices[id];
+}
+
+const XMFLOAT4X4& TransformSystem::GetWorldInverseTransposeMatrix(unsigned int id)
+{
+	if (NeedsUpdate(id))
+		UpdateDirty(1);
+	return worldInverseTransposeMatrices[id];
+}
+
+void TransformSystem::UpdateDirty(unsigned int threadCount)
+{
+	if (hierarchyChanged)
+		RebuildHierarchy();
+
+	// The dirty slots without a dirty ancestor are the roots of every
+	// subtree whose world matrices need rebuilding.
+	dirtyRoots.clear();
+	for (size_t w = 0; w < dirtyBits.size(); w++)
+	{
+		for (uint64_t word = dirtyBits[w]; word != 0; word &= word - 1)
+		{
+			unsigned int id = (unsigned int)(w * BITS_PER_WORD) + LowestBit(word);
+			if (!HasDirtyAncestor(id))
+				dirtyRoots.push_back(id);
+		}
+	}
+
+	// Local matrices of the dirty slots.
+	// Each job owns a range of whole words, so no two jobs touch the same slot or bit.
+	size_t wordCount = dirtyBits.size();
+	size_t jobCount = Parallel::GetJobCount(wordCount, MIN_WORDS_PER_JOB, threadCount);
+	Parallel::ForRanges(wordCount, jobCount, [&](size_t begin, size_t end, size_t)
+		{
+			unsigned int ids[4];
+			unsigned int batchSize = 0;
+			for (size_t w = begin; w < end; w++)
+			{
+				uint64_t word = dirtyBits[w];
+				if (word == 0)
+					continue;
+
+				for (; word != 0; word &= word - 1)
+				{
+					ids[batchSize++] = (unsigned int)(w * BITS_PER_WORD) + LowestBit(word);
+					if (batchSize == 4)
+					{
+						UpdateBatch(ids);
+						batchSize = 0;
+					}
+				}
+				dirtyBits[w] = 0;
+			}
+
+			// Fill a partial batch by repeating its last slot.
+			if (batchSize > 0)
+			{
+				for (unsigned int i = batchSize; i < 4; i++)
+					ids[i] = ids[batchSize - 1];
+				UpdateBatch(ids);
+			}
+		});
+
+	// World matrices of the dirty subtrees, which never overlap.
+	jobCount = Parallel::GetJobCount(dirtyRoots.size(), MIN_ROOTS_PER_JOB, threadCount);
+	Parallel::ForRanges(dirtyRoots.size(), jobCount, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i < end; i++)
+				PropagateWorld(dirtyRoots[i]);
+		});
+}
+
+void TransformSystem::UpdateBatch(const unsigned int ids[4])
+{
+	// Orientation quaternions of four transforms, one component per register.
+	XMVECTOR x = XMVectorSet(orientationX[ids[0]], orientationX[ids[1]], orientationX[ids[2]], orientationX[ids[3]]);
+	XMVECTOR y = XMVectorSet(orientationY[ids[0]], orientationY[ids[1]], orientationY[ids[2]], orientationY[ids[3]]);
+	XMVECTOR z = XMVectorSet(orientationZ[ids[0]], orientationZ[ids[1]], orientationZ[ids[2]], orientationZ[ids[3]]);
+	XMVECTOR w = XMVectorSet(orientationW[ids[0]], orientationW[ids[1]], orientationW[ids[2]], orientationW[ids[3]]);
+
+	// Rotation elements, matching XMMatrixRotationQuaternion.
+	XMVECTOR two = XMVectorReplicate(2.0f);
+	XMVECTOR one = XMVectorReplicate(1.0f);
+	XMVECTOR x2 = XMVectorMultiply(x, two);
+	XMVECTOR y2 = XMVectorMultiply(y, two);
+	XMVECTOR z2 = XMVectorMultiply(z, two);
+	XMVECTOR xx = XMVectorMultiply(x, x2), yy = XMVectorMultiply(y, y2), zz = XMVectorMultiply(z, z2);
+	XMVECTOR xy = XMVectorMultiply(x, y2), xz = XMVectorMultiply(x, z2), yz = XMVectorMultiply(y, z2);
+	XMVECTOR wx = XMVectorMultiply(w, x2), wy = XMVectorMultiply(w, y2), wz = XMVectorMultiply(w, z2);
+	XMVECTOR r[9];
+	r[0] = XMVectorSubtract(one, XMVectorAdd(yy, zz));
+	r[1] = XMVectorAdd(xy, wz);
+	r[2] = XMVectorSubtract(xz, wy);
+	r[3] = XMVectorSubtract(xy, wz);
+	r[4] = XMVectorSubtract(one, XMVectorAdd(xx, zz));
+	r[5] = XMVectorAdd(yz, wx);
+	r[6] = XMVectorAdd(xz, wy);
+	r[7] = XMVectorSubtract(yz, wx);
+	r[8] = XMVectorSubtract(one, XMVectorAdd(xx, yy));
+
+	XMVECTOR scale[3] = {
+		XMVectorSet(scaleX[ids[0]], scaleX[ids[1]], scaleX[ids[2]], scaleX[ids[3]]),
+		XMVectorSet(scaleY[ids[0]], scaleY[ids[1]], scaleY[ids[2]], scaleY[ids[3]]),
+		XMVectorSet(scaleZ[ids[0]], scaleZ[ids[1]], scaleZ[ids[2]], scaleZ[ids[3]]) };
+	XMVECTOR position[3] = {
+		XMVectorSet(positionX[ids[0]], positionX[ids[1]], positionX[ids[2]], positionX[ids[3]]),
+		XMVectorSet(positionY[ids[0]], positionY[ids[1]], positionY[ids[2]], positionY[ids[3]]),
+		XMVectorSet(positionZ[ids[0]], positionZ[ids[1]], positionZ[ids[2]], positionZ[ids[3]]) };
+
+	// Local = scale * rotation * translation: row i of the rotation times scale i.
+	// The inverse transpose of that is row i of the rotation divided by scale i,
+	// with minus each row's dot product with the position in the last column.
+	XMFLOAT4A local[9];
+	XMFLOAT4A inverse[12];
+	for (int row = 0; row < 3; row++)
+	{
+		XMVECTOR inverseScale = XMVectorReciprocal(scale[row]);
+		XMVECTOR dot = XMVectorZero();
+		for (int column = 0; column < 3; column++)
+		{
+			XMVECTOR element = r[row * 3 + column];
+			XMVECTOR inverseElement = XMVectorMultiply(element, inverseScale);
+			XMStoreFloat4A(&local[row * 3 + column], XMVectorMultiply(element, scale[row]));
+			XMStoreFloat4A(&inverse[row * 3 + column], inverseElement);
+			dot = XMVectorMultiplyAdd(inverseElement, position[column], dot);
+		}
+		XMStoreFloat4A(&inverse[9 + row], XMVectorNegate(dot));
+	}
+
+	XMFLOAT4A translation[3];
+	for (int i = 0; i < 3; i++)
+		XMStoreFloat4A(&translation[i], position[i]);
+
+	// Scatter the lanes back out to each slot's matrices.
+	for (unsigned int lane = 0; lane < 4; lane++)
+	{
+		localMatrices[ids[lane]] = XMFLOAT4X4(
+			Lane(local[0], lane), Lane(local[1], lane), Lane(local[2], lane), 0.0f,
+			Lane(local[3], lane), Lane(local[4], lane), Lane(local[5], lane), 0.0f,
+			Lane(local[6], lane), Lane(local[7], lane), Lane(local[8], lane), 0.0f,
+			Lane(translation[0], lane), Lane(translation[1], lane), Lane(translation[2], lane), 1.0f);
+
+		localInverseTransposeMatrices[ids[lane]] = XMFLOAT4X4(
+			Lane(inverse[0], lane), Lane(inverse[1], lane), Lane(inverse[2], lane), Lane(inverse[9], lane),
+			Lane(inverse[3], lane), Lane(inverse[4], lane), Lane(inverse[5], lane), Lane(inverse[10], lane),
+			Lane(inverse[6], lane), Lane(inverse[7], lane), Lane(inverse[8], lane), Lane(inverse[11], lane),
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+void TransformSystem::UpdateBasis(unsigned int id)
+{
+	// The rows of the rotation matrix are the rotated x, y and z axes.
+	float x = orientationX[id], y = orientationY[id], z = orientationZ[id], w = orientationW[id];
+	rights[id] = XMFLOAT3(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w));
+	ups[id] = XMFLOAT3(2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w));
+	forwards[id] = XMFLOAT3(2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y));
+	ClearBit(basisStaleBits, id);
+}
+
+void TransformSystem::PropagateWorld(unsigned int root)
+{
+	// Walk the subtree one level at a time. Each level is one contiguous
+	// range of the flat array, and the next level is the children of that range.
+	size_t begin = flatIndices[root];
+	size_t end = begin + 1;
+	while (begin < end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			unsigned int id = flatSlots[i];
+			unsigned int parent = parents[id];
+			if (parent == NO_PARENT)
+			{
+				worldMatrices[id] = localMatrices[id];
+				worldInverseTransposeMatrices[id] = localInverseTransposeMatrices[id];
+				continue;
+			}
+
+			// (local * parent)^-T = local^-T * parent^-T
+			XMStoreFloat4x4(&worldMatrices[id],
+				XMMatrixMultiply(XMLoadFloat4x4(&localMatrices[id]), XMLoadFloat4x4(&worldMatrices[parent])));
+			XMStoreFloat4x4(&worldInverseTransposeMatrices[id],
+				XMMatrixMultiply(XMLoadFloat4x4(&localInverseTransposeMatrices[id]), XMLoadFloat4x4(&worldInverseTransposeMatrices[parent])));
+		}
+
+		size_t nextBegin = flatChildStarts[begin];
+		end = flatChildStarts[end - 1] + flatChildCounts[end - 1];
+		begin = nextBegin;
+	}
+}
+
+void TransformSystem::RebuildHierarchy()
+{
+	flatSlots.clear();
+	flatChildStarts.clear();
+	flatChildCounts.clear();
+
+	// Every root first, then each entry's children in turn.
+	for (size_t w = 0; w < liveBits.size(); w++)
+	{
+		for (uint64_t word = liveBits[w]; word != 0; word &= word - 1)
+		{
+			unsigned int id = (unsigned int)(w * BITS_PER_WORD) + LowestBit(word);
+			if (parents[id] == NO_PARENT)
+				flatSlots.push_back(id);
+		}
+	}
+
+	for (size_t i = 0; i < flatSlots.size(); i++)
+	{
+		unsigned int id = flatSlots[i];
+		flatIndices[id] = (unsigned int)i;
+		flatChildStarts.push_back((unsigned int)flatSlots.size());
+		unsigned int childCount = 0;
+		for (unsigned int child = firstChildren[id]; child != NO_PARENT; child = nextSiblings[child])
+		{
+			flatSlots.push_back(child);
+			childCount++;
+		}
+		flatChildCounts.push_back(childCount);
+	}
+
+	hierarchyChanged = false;
+}
+
+bool TransformSystem::IsDirty(unsigned int id) const
+{
+	return TestBit(dirtyBits, id);
+}
+
+bool TransformSystem::HasDirtyAncestor(unsigned int id) const
+{
+	for (unsigned int ancestor = parents[id]; ancestor != NO_PARENT; ancestor = parents[ancestor])
+	{
+		if (IsDirty(ancestor))
+			return true;
+	}
+	return false;
+}
+
+bool TransformSystem::NeedsUpdate(unsigned int id) const
+{
+	return IsDirty(id) || HasDirtyAncestor(id);
+}
+
+void TransformSystem::MarkDirty(unsigned int id)
+{
+	SetBit(dirtyBits, id);
+}
+
+void TransformSystem::Unlink(unsigned int id)
+{
+	unsigned int parent = parents[id];
+	if (parent == NO_PARENT)
+		return;
+
+	if (previousSiblings[id] != NO_PARENT)
+		nextSiblings[previousSiblings[id]] = nextSiblings[id];
+	else
+		firstChildren[parent] = nextSiblings[id];
+	if (nextSiblings[id] != NO_PARENT)
+		previousSiblings[nextSiblings[id]] = previousSiblings[id];
+
+	parents[id] = NO_PARENT;
+	nextSiblings[id] = previousSiblings[id] = NO_PARENT;
+}
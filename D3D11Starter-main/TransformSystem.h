@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Structure-of-arrays storage for every Transform.
+//
+// - Each transform is a slot index; positions, orientation
+//   quaternions and scales are kept in one array per
+//   component so the batch update can load four transforms
+//   into each SIMD register
+// - Pitch/yaw/roll is only an editing view of the
+//   quaternion, converted when one of them is set, and the
+//   right/up/forward basis is cached until the rotation
+//   changes, so neither is rebuilt per call
+// - Changing a component only sets the slot's dirty bit;
+//   UpdateDirty() rebuilds the local matrices of every
+//   dirty slot in one pass, then the world matrices of the
+//   dirty slots' subtrees and nothing else
+// - Slots are reused after Destroy(), so indices stay
+//   stable for as long as the transform is alive
+//
+// Hierarchy:
+// - A slot's components are relative to its parent, and
+//   world = local * parent world
+// - The hierarchy is also kept as a flat array in breadth
+//   first order (every parent before its children, and the
+//   children of each level's slots next to each other), so
+//   a subtree is one contiguous range per level and is
+//   updated level by level from its root
+// - The flat array is rebuilt on the next update after any
+//   slot is created, destroyed or reparented
+// --------------------------------------------------------
+class TransformSystem
+{
+public:
+	// Parent of a slot at the top of the hierarchy.
+	static constexpr unsigned int NO_PARENT = 0xFFFFFFFF;
+
+	TransformSystem();
+
+	// The system the game's Transforms are created in.
+	static TransformSystem& Global();
+
+	// Create an identity transform with no parent and return its slot.
+	unsigned int Create();
+
+	// Create a transform with the same components and parent as another one.
+	unsigned int Clone(unsigned int id);
+
+	// Free a slot for reuse. Its children move to the top of the hierarchy.
+	void Destroy(unsigned int id);
+
+	// Reserve room for "count" slots so creating them does not reallocate.
+	void Reserve(size_t count);
+
+	// Number of live transforms.
+	size_t GetCount() const;
+
+	// Number of dirty transforms waiting for UpdateDirty().
+	size_t GetDirtyCount() const;
+
+	// Components, relative to the parent.
+	// - Setting the orientation normalizes it; the pitch/yaw/roll view is then
+	//   recovered from it the next time it is read
+	DirectX::XMFLOAT3 GetPosition(unsigned int id) const;
+	DirectX::XMFLOAT4 GetOrientation(unsigned int id) const;
+	DirectX::XMFLOAT3 GetPitchYawRoll(unsigned int id);
+	DirectX::XMFLOAT3 GetScale(unsigned int id) const;
+	void SetPosition(unsigned int id, const DirectX::XMFLOAT3& position);
+	void SetOrientation(unsigned int id, const DirectX::XMFLOAT4& orientation);
+	void SetPitchYawRoll(unsigned int id, const DirectX::XMFLOAT3& rotation);
+	void SetScale(unsigned int id, const DirectX::XMFLOAT3& scale);
+
+	// Local axes rotated by the orientation, cached until it changes.
+	const DirectX::XMFLOAT3& GetRight(unsigned int id);
+	const DirectX::XMFLOAT3& GetUp(unsigned int id);
+	const DirectX::XMFLOAT3& GetForward(unsigned int id);
+
+	// Parent links.
+	// - SetParent keeps the local components, so the slot moves with its new parent
+	// - Parenting a slot to itself or one of its descendants is ignored
+	unsigned int GetParent(unsigned int id) const;
+	void SetParent(unsigned int id, unsigned int parent);
+
+	// Matrices of a slot. Reading one while it (or an ancestor) has
+	// pending changes runs UpdateDirty() first.
+	const DirectX::XMFLOAT4X4& GetLocalMatrix(unsigned int id);
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(unsigned int id);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(unsigned int id);
+
+	// Rebuild the matrices of every dirty slot and its descendants and
+	// clear the dirty bits.
+	// - Large batches are split across threads ("threadCount" 0 means one
+	//   per hardware thread, only used when there is enough work)
+	void UpdateDirty(unsigned int threadCount = 0);
+
+private:
+	// Rebuild the local matrices of four slots at once ("ids" may repeat a
+	// slot to fill the batch).
+	void UpdateBatch(const unsigned int ids[4]);
+
+	// Rebuild the cached axes of a slot from its orientation.
+	void UpdateBasis(unsigned int id);
+
+	// Rebuild the world matrices of a slot and all its descendants.
+	void PropagateWorld(unsigned int root);
+
+	// Rebuild the breadth first hierarchy array.
+	void RebuildHierarchy();
+
+	bool IsDirty(unsigned int id) const;
+	bool HasDirtyAncestor(unsigned int id) const;
+	bool NeedsUpdate(unsigned int id) const;
+	void MarkDirty(unsigned int id);
+	void Unlink(unsigned int id);
+
+	// Components, one array each.
+	std::vector<float> positionX;
+	std::vector<float> positionY;
+	std::vector<float> positionZ;
+	std::vector<float> orientationX;
+	std::vector<float> orientationY;
+	std::vector<float> orientationZ;
+	std::vector<float> orientationW;
+	std::vector<float> scaleX;
+	std::vector<float> scaleY;
+	std::vector<float> scaleZ;
+
+	// Pitch/yaw/roll editing view and cached axes, each with a stale bit.
+	std::vector<DirectX::XMFLOAT3> pitchYawRolls;
+	std::vector<DirectX::XMFLOAT3> rights;
+	std::vector<DirectX::XMFLOAT3> ups;
+	std::vector<DirectX::XMFLOAT3> forwards;
+	std::vector<uint64_t> pitchYawRollStaleBits;
+	std::vector<uint64_t> basisStaleBits;
+
+	// Results of the last update.
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localInverseTransposeMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposeMatrices;
+
+	// Parent and child links per slot (children as a doubly linked list).
+	std::vector<unsigned int> parents;
+	std::vector<unsigned int> firstChildren;
+	std::vector<unsigned int> nextSiblings;
+	std::vector<unsigned int> previousSiblings;
+
+	// The breadth first hierarchy: each entry's slot, where its children
+	// start in the array and how many there are, plus each slot's entry.
+	std::vector<unsigned int> flatSlots;
+	std::vector<unsigned int> flatChildStarts;
+	std::vector<unsigned int> flatChildCounts;
+	std::vector<unsigned int> flatIndices;
+	bool hierarchyChanged;
+
+	// One bit per slot.
+	std::vector<uint64_t> dirtyBits;
+	std::vector<uint64_t> liveBits;
+
+	std::vector<unsigned int> freeSlots;
+	std::vector<unsigned int> dirtyRoots;
+};
@@ -0,0 +1,211 @@
+#include "VertexPacking.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold the quantization helpers
+// only accessible in this file
+namespace
+{
+	// Convert [-1, 1] to a signed 16-bit normalized value, as D3D reads SNORM.
+	int16_t ToSnorm16(float value)
+	{
+		value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+		return (int16_t)std::lround(value * 32767.0f);
+	}
+
+	float FromSnorm16(int16_t value)
+	{
+		float result = value / 32767.0f;
+		return result < -1.0f ? -1.0f : result;
+	}
+
+	// Convert [0, 1] to an unsigned 16-bit normalized value, as D3D reads UNORM.
+	uint16_t ToUnorm16(float value)
+	{
+		value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+		return (uint16_t)std::lround(value * 65535.0f);
+	}
+
+	float FromUnorm16(uint16_t value)
+	{
+		return value / 65535.0f;
+	}
+
+	float Length(XMFLOAT3 v)
+	{
+		return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+	}
+
+	// Angle in degrees between two directions (0 if either has no length).
+	float AngleDegrees(XMFLOAT3 a, XMFLOAT3 b)
+	{
+		float lengths = Length(a) * Length(b);
+		if (lengths <= 0.0f)
+			return 0.0f;
+
+		float cosine = (a.x * b.x + a.y * b.y + a.z * b.z) / lengths;
+		cosine = cosine < -1.0f ? -1.0f : (cosine > 1.0f ? 1.0f : cosine);
+		return std::acos(cosine) * (180.0f / XM_PI);
+	}
+}
+
+XMFLOAT2 VertexPacking::EncodeOctahedral(XMFLOAT3 direction)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1.
+	float sum = std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z);
+	if (sum <= 0.0f)
+		return XMFLOAT2(0.0f, 0.0f);
+
+	float x = direction.x / sum;
+	float y = direction.y / sum;
+
+	// Fold the lower half over the diagonals.
+	if (direction.z < 0.0f)
+	{
+		float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	return XMFLOAT2(x, y);
+}
+
+XMFLOAT3 VertexPacking::DecodeOctahedral(XMFLOAT2 encoded)
+{
+	XMFLOAT3 direction(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+
+	// Unfold the lower half.
+	float t = direction.z < 0.0f ? -direction.z : 0.0f;
+	direction.x += direction.x >= 0.0f ? -t : t;
+	direction.y += direction.y >= 0.0f ? -t : t;
+
+	float length = Length(direction);
+	return XMFLOAT3(direction.x / length, direction.y / length, direction.z / length);
+}
+
+VertexQuantization VertexPacking::ComputeQuantization(const Vertex* vertices, size_t vertexCount)
+{
+	VertexQuantization quantization = {};
+	quantization.positionExtent = XMFLOAT3(1.0f, 1.0f, 1.0f);
+	quantization.uvScale = XMFLOAT2(1.0f, 1.0f);
+	if (vertexCount == 0)
+		return quantization;
+
+	XMFLOAT3 minPosition = vertices[0].Position;
+	XMFLOAT3 maxPosition = vertices[0].Position;
+	XMFLOAT2 minUV = vertices[0].uv;
+	XMFLOAT2 maxUV = vertices[0].uv;
+	for (size_t i = 1; i < vertexCount; i++)
+	{
+		const Vertex& v = vertices[i];
+		minPosition = XMFLOAT3(fminf(minPosition.x, v.Position.x), fminf(minPosition.y, v.Position.y), fminf(minPosition.z, v.Position.z));
+		maxPosition = XMFLOAT3(fmaxf(maxPosition.x, v.Position.x), fmaxf(maxPosition.y, v.Position.y), fmaxf(maxPosition.z, v.Position.z));
+		minUV = XMFLOAT2(fminf(minUV.x, v.uv.x), fminf(minUV.y, v.uv.y));
+		maxUV = XMFLOAT2(fmaxf(maxUV.x, v.uv.x), fmaxf(maxUV.y, v.uv.y));
+	}
+
+	// Flat axes keep an extent of 1 so nothing divides by zero.
+	quantization.positionCenter = XMFLOAT3(
+		(minPosition.x + maxPosition.x) * 0.5f,
+		(minPosition.y + maxPosition.y) * 0.5f,
+		(minPosition.z + maxPosition.z) * 0.5f);
+
+	float extentX = (maxPosition.x - minPosition.x) * 0.5f;
+	float extentY = (maxPosition.y - minPosition.y) * 0.5f;
+	float extentZ = (maxPosition.z - minPosition.z) * 0.5f;
+	quantization.positionExtent = XMFLOAT3(
+		extentX > 0.0f ? extentX : 1.0f,
+		extentY > 0.0f ? extentY : 1.0f,
+		extentZ > 0.0f ? extentZ : 1.0f);
+
+	quantization.uvMin = minUV;
+	quantization.uvScale = XMFLOAT2(
+		maxUV.x > minUV.x ? maxUV.x - minUV.x : 1.0f,
+		maxUV.y > minUV.y ? maxUV.y - minUV.y : 1.0f);
+
+	return quantization;
+}
+
+PackedVertex VertexPacking::PackVertex(const Vertex& vertex, const VertexQuantization& quantization)
+{
+	const XMFLOAT3& center = quantization.positionCenter;
+	const XMFLOAT3& extent = quantization.positionExtent;
+
+	PackedVertex packed = {};
+	packed.Position[0] = ToSnorm16((vertex.Position.x - center.x) / extent.x);
+	packed.Position[1] = ToSnorm16((vertex.Position.y - center.y) / extent.y);
+	packed.Position[2] = ToSnorm16((vertex.Position.z - center.z) / extent.z);
+	packed.Position[3] = 0;
+
+	packed.uv[0] = ToUnorm16((vertex.uv.x - quantization.uvMin.x) / quantization.uvScale.x);
+	packed.uv[1] = ToUnorm16((vertex.uv.y - quantization.uvMin.y) / quantization.uvScale.y);
+
+	XMFLOAT2 normal = EncodeOctahedral(vertex.normal);
+	packed.normal[0] = ToSnorm16(normal.x);
+	packed.normal[1] = ToSnorm16(normal.y);
+
+	XMFLOAT2 tangent = EncodeOctahedral(vertex.Tangent);
+	packed.Tangent[0] = ToSnorm16(tangent.x);
+	packed.Tangent[1] = ToSnorm16(tangent.y);
+
+	return packed;
+}
+
+Vertex VertexPacking::UnpackVertex(const PackedVertex& vertex, const VertexQuantization& quantization)
+{
+	const XMFLOAT3& center = quantization.positionCenter;
+	const XMFLOAT3& extent = quantization.positionExtent;
+
+	Vertex unpacked = {};
+	unpacked.Position = XMFLOAT3(
+		center.x + FromSnorm16(vertex.Position[0]) * extent.x,
+		center.y + FromSnorm16(vertex.Position[1]) * extent.y,
+		center.z + FromSnorm16(vertex.Position[2]) * extent.z);
+
+	unpacked.uv = XMFLOAT2(
+		quantization.uvMin.x + FromUnorm16(vertex.uv[0]) * quantization.uvScale.x,
+		quantization.uvMin.y + FromUnorm16(vertex.uv[1]) * quantization.uvScale.y);
+
+	unpacked.normal = DecodeOctahedral(XMFLOAT2(FromSnorm16(vertex.normal[0]), FromSnorm16(vertex.normal[1])));
+	unpacked.Tangent = DecodeOctahedral(XMFLOAT2(FromSnorm16(vertex.Tangent[0]), FromSnorm16(vertex.Tangent[1])));
+
+	return unpacked;
+}
+
+std::vector<PackedVertex> VertexPacking::PackVertices(const Vertex* vertices, size_t vertexCount, VertexQuantization& quantization)
+{
+	quantization = ComputeQuantization(vertices, vertexCount);
+
+	std::vector<PackedVertex> packed(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+		packed[i] = PackVertex(vertices[i], quantization);
+
+	return packed;
+}
+
+VertexPackingError VertexPacking::MeasureError(const Vertex* vertices, const PackedVertex* packedVertices, size_t vertexCount, const VertexQuantization& quantization)
+{
+	VertexPackingError error = {};
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const Vertex& original = vertices[i];
+		Vertex decoded = UnpackVertex(packedVertices[i], quantization);
+
+		XMFLOAT3 offset(
+			decoded.Position.x - original.Position.x,
+			decoded.Position.y - original.Position.y,
+			decoded.Position.z - original.Position.z);
+		error.maxPosition = fmaxf(error.maxPosition, Length(offset));
+
+		error.maxUV = fmaxf(error.maxUV, fmaxf(std::fabs(decoded.uv.x - original.uv.x), std::fabs(decoded.uv.y - original.uv.y)));
+
+		// Vertices without a normal or tangent (zero length) are skipped.
+		error.maxNormalDegrees = fmaxf(error.maxNormalDegrees, AngleDegrees(original.normal, decoded.normal));
+		error.maxTangentDegrees = fmaxf(error.maxTangentDegrees, AngleDegrees(original.Tangent, decoded.Tangent));
+	}
+
+	return error;
+}
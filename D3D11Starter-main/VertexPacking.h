@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+#include "PackedVertex.h"
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Largest differences between full vertices and their
+// packed versions once decoded.
+// - Position error is in object space units
+// - Normal and tangent errors are angles in degrees
+// --------------------------------------------------------
+struct VertexPackingError
+{
+	float maxPosition;
+	float maxUV;
+	float maxNormalDegrees;
+	float maxTangentDegrees;
+};
+
+// --------------------------------------------------------
+// Platform-neutral conversion between Vertex and PackedVertex
+// --------------------------------------------------------
+namespace VertexPacking
+{
+	// Octahedral encoding of a unit vector into two values in [-1, 1].
+	DirectX::XMFLOAT2 EncodeOctahedral(DirectX::XMFLOAT3 direction);
+	DirectX::XMFLOAT3 DecodeOctahedral(DirectX::XMFLOAT2 encoded);
+
+	// Find the position bounds and uv range of the vertices.
+	VertexQuantization ComputeQuantization(const Vertex* vertices, size_t vertexCount);
+
+	// Convert one vertex to and from the packed layout.
+	PackedVertex PackVertex(const Vertex& vertex, const VertexQuantization& quantization);
+	Vertex UnpackVertex(const PackedVertex& vertex, const VertexQuantization& quantization);
+
+	// Pack a whole vertex array, filling in the quantization used.
+	std::vector<PackedVertex> PackVertices(const Vertex* vertices, size_t vertexCount, VertexQuantization& quantization);
+
+	// Decode every packed vertex and compare it against the original.
+	VertexPackingError MeasureError(const Vertex* vertices, const PackedVertex* packedVertices, size_t vertexCount, const VertexQuantization& quantization);
+}
@@ -3,17 +3,22 @@
 
 // Create an external data for the constant buffer for the vertex
 // shader to recognize it.
+// - Only the per-object matrices are uploaded for every entity
 cbuffer VSExternalData : register(b0)
 {
     //float4 tint;
     matrix worldMatrix;
-    matrix viewMatrix;
-    matrix projectionMatrix;
 	
 	// Add the object inverse transpose matrix in the world space.
     matrix worldInverseTransposeMatrix;
-	
-	// Add light matrix.
+}
+
+// Per-pass camera and light matrices, uploaded once per pass.
+// - The shadow pass puts the light's matrices in the view and projection
+cbuffer VSPassData : register(b2)
+{
+    matrix viewMatrix;
+    matrix projectionMatrix;
     matrix lightView;
     matrix lightProjection;
 }